@@ -0,0 +1,556 @@
+/**
+ * @file benchmark.cpp
+ * @brief 微基准测试程序
+ *
+ * 在按固定种子生成的合成语料上测量文本处理、文件解析、写入索引、搜索与JSON转义的耗时，
+ * 结果以JSON输出，便于比较不同构建之间的差异。语料规模、重复次数与种子均可由命令行指定，
+ * 相同参数下生成的语料与查询完全相同。
+ *
+ * 用法：bench [--docs=1000] [--doc-words=300] [--queries=200] [--repetitions=3] [--seed=42]
+ *             [--shards=1] [--filter=名字子串] [--output=结果文件]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include "http_server.h"
+#include "indexer.h"
+#include "search_coordinator.h"
+#include "search_engine.h"
+#include "text_processor.h"
+
+/**
+ * @brief HTTP服务器模块需要的全局实例访问函数；基准测试只调用其中的静态函数，不提供实例
+ */
+SearchEngine* get_search_engine() {
+    return nullptr;
+}
+
+SearchCoordinator* get_search_coordinator() {
+    return nullptr;
+}
+
+namespace {
+
+/**
+ * 基准测试参数
+ */
+struct BenchmarkOptions {
+    size_t docs;            // 合成文档数
+    size_t doc_words;       // 每篇文档的平均词数
+    size_t queries;         // 每种搜索基准的查询数
+    size_t repetitions;     // 每个基准的计时重复次数（另有一次不计时的预热）
+    unsigned int seed;      // 生成语料与查询的随机种子
+    size_t shards;          // 搜索引擎的分片数
+    std::string filter;     // 只运行名字包含该子串的基准
+    std::string output;     // 结果文件，为空时输出到标准输出
+
+    BenchmarkOptions()
+        : docs(1000), doc_words(300), queries(200), repetitions(3), seed(42), shards(1) {}
+};
+
+/**
+ * 一个基准的测量结果：每次重复的单次操作耗时（纳秒）
+ */
+struct BenchmarkResult {
+    std::string name;
+    size_t operations;      // 每次重复的操作数
+    size_t bytes;           // 每次重复处理的输入字节数，0表示不按字节计
+    std::vector<double> ns_per_op;
+};
+
+/**
+ * 合成语料
+ *
+ * 词汇由英文音节拼成的词与双字汉语词组成，词频服从Zipf分布，使高频词的倒排列表远长于低频词，
+ * 接近真实文本的分布；正文中夹杂标点、引号与换行，同时用于测量JSON转义。
+ */
+class SyntheticCorpus
+{
+public:
+    SyntheticCorpus(const BenchmarkOptions& options) : random_(options.seed) {
+        build_vocabulary(std::max<size_t>(2000, options.docs * 4));
+        for (size_t i = 0; i < options.docs; ++i) {
+            std::string title = sentence(3 + random_() % 5, false);
+            std::string content = paragraph(options.doc_words / 2 + random_() % (options.doc_words + 1));
+            documents_.push_back(Document("doc_" + std::to_string(i), title, content, ""));
+        }
+        for (size_t i = 0; i < options.queries; ++i) {
+            short_queries_.push_back(query(1 + random_() % 2));
+            long_queries_.push_back(query(8 + random_() % 5));
+        }
+    }
+
+    const std::vector<Document>& documents() const { return documents_; }
+    const std::vector<std::string>& short_queries() const { return short_queries_; }
+    const std::vector<std::string>& long_queries() const { return long_queries_; }
+
+    // 所有文档正文的总字节数
+    size_t content_bytes() const {
+        size_t bytes = 0;
+        for (const Document& document : documents_) {
+            bytes += document.content.size();
+        }
+        return bytes;
+    }
+
+private:
+    std::mt19937 random_;
+    std::vector<std::string> vocabulary_;
+    std::vector<double> cumulative_;    // Zipf分布的累积概率
+    std::vector<Document> documents_;
+    std::vector<std::string> short_queries_;
+    std::vector<std::string> long_queries_;
+
+    // 生成size个互不相同的词，并按Zipf分布（指数1）计算累积概率
+    void build_vocabulary(size_t size) {
+        static const char* const onsets[] = {"b", "c", "d", "f", "g", "h", "k", "l", "m", "n", "p", "r", "s", "t",
+                                             "v", "w", "st", "tr", "pl", "ch"};
+        static const char* const vowels[] = {"a", "e", "i", "o", "u", "ou", "ea", "io"};
+        std::vector<std::string> words;
+        std::set<std::string> seen;
+        while (words.size() < size) {
+            std::string word;
+            if (random_() % 10 < 3) {
+                // 双字汉语词，取自CJK统一汉字的常用区段
+                for (int i = 0; i < 2; ++i) {
+                    unsigned int code = 0x4E00 + random_() % 3000;
+                    word += static_cast<char>(0xE0 | (code >> 12));
+                    word += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    word += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            } else {
+                size_t syllables = 1 + random_() % 4;
+                for (size_t i = 0; i < syllables; ++i) {
+                    word += onsets[random_() % (sizeof(onsets) / sizeof(onsets[0]))];
+                    word += vowels[random_() % (sizeof(vowels) / sizeof(vowels[0]))];
+                }
+            }
+            if (seen.insert(word).second) {
+                words.push_back(word);
+            }
+        }
+        vocabulary_ = words;
+
+        double total = 0.0;
+        for (size_t rank = 1; rank <= size; ++rank) {
+            total += 1.0 / rank;
+            cumulative_.push_back(total);
+        }
+        for (double& value : cumulative_) {
+            value /= total;
+        }
+    }
+
+    // 按Zipf分布抽取一个词
+    const std::string& word() {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(random_);
+        size_t rank = std::lower_bound(cumulative_.begin(), cumulative_.end(), u) - cumulative_.begin();
+        return vocabulary_[std::min(rank, vocabulary_.size() - 1)];
+    }
+
+    // 由words个词组成的句子，punctuate为true时以标点结尾，偶尔带引号
+    std::string sentence(size_t words, bool punctuate) {
+        std::string text;
+        for (size_t i = 0; i < words; ++i) {
+            if (i > 0) text += ' ';
+            text += word();
+        }
+        if (punctuate) {
+            static const char* const endings[] = {". ", ", ", "! ", "? ", "; "};
+            if (random_() % 8 == 0) {
+                text = "\"" + text + "\"";
+            }
+            text += endings[random_() % (sizeof(endings) / sizeof(endings[0]))];
+        }
+        return text;
+    }
+
+    // 约words个词组成的正文，每若干句换行
+    std::string paragraph(size_t words) {
+        std::string text;
+        size_t written = 0;
+        while (written < words) {
+            size_t length = 4 + random_() % 12;
+            text += sentence(length, true);
+            written += length;
+            if (random_() % 6 == 0) {
+                text += "\n";
+            }
+        }
+        return text;
+    }
+
+    // terms个词组成的查询，跳过最常见的几十个词，使查询不全由停用词一样的高频词组成
+    std::string query(size_t terms) {
+        std::string text;
+        for (size_t i = 0; i < terms; ++i) {
+            if (i > 0) text += ' ';
+            size_t rank = 20 + random_() % std::min<size_t>(2000, vocabulary_.size() - 20);
+            text += vocabulary_[rank];
+        }
+        return text;
+    }
+};
+
+/**
+ * 防止被测函数的结果被编译器优化掉
+ */
+volatile size_t g_sink = 0;
+
+/**
+ * 丢弃所有输出的流缓冲区，用于屏蔽搜索引擎的日志
+ */
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) { return c; }
+};
+
+/**
+ * @brief 测量一个基准
+ * @param name 基准名
+ * @param options 基准测试参数
+ * @param run 执行一轮并返回本轮的操作数；第一轮预热，不计时
+ * @param bytes 每轮处理的输入字节数，0表示不按字节计
+ * @return 每轮的单次操作耗时
+ */
+BenchmarkResult measure(const std::string& name, const BenchmarkOptions& options,
+                        const std::function<size_t()>& run, size_t bytes) {
+    BenchmarkResult result;
+    result.name = name;
+    result.operations = run();
+    result.bytes = bytes;
+    for (size_t i = 0; i < options.repetitions; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t operations = run();
+        double elapsed = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        result.ns_per_op.push_back(elapsed / std::max<size_t>(1, operations));
+    }
+    return result;
+}
+
+/**
+ * @brief 测量写入索引：每轮在新的搜索引擎中逐篇添加全部文档
+ * @param options 基准测试参数
+ * @param documents 文档
+ * @return 每轮的单次添加耗时，不含搜索引擎的构造与析构
+ */
+BenchmarkResult measure_add_document(const BenchmarkOptions& options, const std::vector<Document>& documents) {
+    BenchmarkResult result;
+    result.name = "search_engine/add_document";
+    result.operations = documents.size();
+    result.bytes = 0;
+    IndexOptions index;
+    index.cache_bytes = 0;
+    index.shards = options.shards;
+    for (size_t i = 0; i <= options.repetitions; ++i) {
+        SearchEngine engine(index);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (const Document& document : documents) {
+            engine.add_document(document.id, document.title, document.content);
+        }
+        double elapsed = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        if (i > 0) {
+            result.ns_per_op.push_back(elapsed / std::max<size_t>(1, documents.size()));
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief 把合成文档写成文本文件与HTML文件
+ * @param directory 输出目录
+ * @param documents 文档
+ * @param text_files 输出的文本文件路径
+ * @param html_files 输出的HTML文件路径
+ */
+void write_files(const boost::filesystem::path& directory, const std::vector<Document>& documents,
+                 std::vector<std::string>& text_files, std::vector<std::string>& html_files) {
+    boost::filesystem::create_directories(directory);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        std::string base = (directory / ("doc_" + std::to_string(i))).string();
+        std::ofstream text((base + ".txt").c_str(), std::ios::binary);
+        text << documents[i].title << "\n\n" << documents[i].content;
+        text_files.push_back(base + ".txt");
+
+        std::ofstream html((base + ".html").c_str(), std::ios::binary);
+        html << "<!DOCTYPE html>\n<html>\n<head><meta charset=\"UTF-8\"><title>" << documents[i].title
+             << "</title>\n<style>body { margin: 0; }</style>\n<script>var page = " << i << ";</script></head>\n"
+             << "<body>\n<h1>" << documents[i].title << "</h1>\n<div class=\"content\"><p>";
+        std::istringstream lines(documents[i].content);
+        std::string line;
+        while (std::getline(lines, line)) {
+            html << line << "</p>\n<p>";
+        }
+        html << "</p></div>\n</body>\n</html>\n";
+        html_files.push_back(base + ".html");
+    }
+}
+
+/**
+ * @brief 计算样本的中位数
+ */
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+/**
+ * @brief 以JSON输出全部结果
+ * @param out 输出流
+ * @param options 基准测试参数，写入context以便确认两次运行可比
+ * @param results 各基准的结果
+ *
+ * 每个基准给出单次操作耗时的最小值、中位数与平均值（纳秒）以及按中位数计算的吞吐量；
+ * 比较不同构建时以最小值或中位数为准。
+ */
+void write_json(std::ostream& out, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results) {
+    out << std::fixed << std::setprecision(1);
+    out << "{\n"
+        << "  \"context\": {"
+        << "\"docs\": " << options.docs << ", "
+        << "\"doc_words\": " << options.doc_words << ", "
+        << "\"queries\": " << options.queries << ", "
+        << "\"repetitions\": " << options.repetitions << ", "
+        << "\"seed\": " << options.seed << ", "
+        << "\"shards\": " << options.shards << ", "
+#ifdef NDEBUG
+        << "\"assertions\": false"
+#else
+        << "\"assertions\": true"
+#endif
+        << "},\n"
+        << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        double min = *std::min_element(result.ns_per_op.begin(), result.ns_per_op.end());
+        double mid = median(result.ns_per_op);
+        double mean = 0.0;
+        for (double value : result.ns_per_op) {
+            mean += value / result.ns_per_op.size();
+        }
+        out << "    {\"name\": \"" << HttpConnection::escape_json(result.name) << "\", "
+            << "\"operations\": " << result.operations << ", "
+            << "\"ns_per_op\": {\"min\": " << min << ", \"median\": " << mid << ", \"mean\": " << mean << "}, "
+            << "\"ops_per_second\": " << (mid > 0.0 ? 1e9 / mid : 0.0);
+        if (result.bytes > 0) {
+            double bytes_per_op = static_cast<double>(result.bytes) / std::max<size_t>(1, result.operations);
+            out << ", \"mb_per_second\": " << (mid > 0.0 ? bytes_per_op / mid * 1e9 / (1024 * 1024) : 0.0);
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+/**
+ * @brief 解析命令行参数
+ * @return 如果所有参数都合法返回`true`，否则返回`false`。
+ */
+bool parse_options(int argc, char* argv[], BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (name == "--docs") {
+                options.docs = boost::lexical_cast<size_t>(value);
+            } else if (name == "--doc-words") {
+                options.doc_words = boost::lexical_cast<size_t>(value);
+            } else if (name == "--queries") {
+                options.queries = boost::lexical_cast<size_t>(value);
+            } else if (name == "--repetitions") {
+                options.repetitions = boost::lexical_cast<size_t>(value);
+            } else if (name == "--seed") {
+                options.seed = boost::lexical_cast<unsigned int>(value);
+            } else if (name == "--shards") {
+                options.shards = boost::lexical_cast<size_t>(value);
+            } else if (name == "--filter") {
+                options.filter = value;
+            } else if (name == "--output") {
+                options.output = value;
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const boost::bad_lexical_cast&) {
+            std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+            return false;
+        }
+    }
+    if (options.docs == 0 || options.doc_words == 0 || options.queries == 0 || options.repetitions == 0) {
+        std::cerr << "--docs, --doc-words, --queries and --repetitions must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 依次运行名字与--filter匹配的基准
+ * @param options 基准测试参数
+ * @param corpus 合成语料
+ * @return 各基准的结果，顺序固定
+ */
+std::vector<BenchmarkResult> run_benchmarks(const BenchmarkOptions& options, const SyntheticCorpus& corpus) {
+    const std::vector<Document>& documents = corpus.documents();
+    size_t content_bytes = corpus.content_bytes();
+    std::vector<BenchmarkResult> results;
+    auto selected = [&options](const std::string& name) {
+        bool run = options.filter.empty() || name.find(options.filter) != std::string::npos;
+        if (run) {
+            std::cerr << "Running " << name << std::endl;
+        }
+        return run;
+    };
+
+    // 文本处理
+    TextProcessor processor;
+    if (selected("text_processor/preprocess_text")) {
+        results.push_back(measure("text_processor/preprocess_text", options, [&]() {
+            for (const Document& document : documents) {
+                g_sink += processor.preprocess_text(document.content).size();
+            }
+            return documents.size();
+        }, content_bytes));
+    }
+    if (selected("text_processor/tokenize")) {
+        results.push_back(measure("text_processor/tokenize", options, [&]() {
+            for (const Document& document : documents) {
+                g_sink += processor.tokenize(document.content).size();
+            }
+            return documents.size();
+        }, content_bytes));
+    }
+
+    // 文件解析：HTML文件经parse_file分派到parse_html_file，多出去除标签与脚本的开销
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+                                        boost::filesystem::unique_path("bse-bench-%%%%-%%%%");
+    if (selected("indexer/parse_file")) {
+        std::vector<std::string> text_files;
+        std::vector<std::string> html_files;
+        write_files(directory, documents, text_files, html_files);
+        Indexer indexer;
+        const std::vector<std::string>* file_sets[] = {&text_files, &html_files};
+        const char* const names[] = {"indexer/parse_file/text", "indexer/parse_file/html"};
+        for (int set = 0; set < 2; ++set) {
+            const std::vector<std::string>& files = *file_sets[set];
+            size_t bytes = 0;
+            for (const std::string& file : files) {
+                bytes += static_cast<size_t>(boost::filesystem::file_size(file));
+            }
+            results.push_back(measure(names[set], options, [&]() {
+                for (const std::string& file : files) {
+                    g_sink += indexer.parse_file(file).content.size();
+                }
+                return files.size();
+            }, bytes));
+        }
+        boost::system::error_code ignored;
+        boost::filesystem::remove_all(directory, ignored);
+    }
+
+    // 写入索引
+    if (selected("search_engine/add_document")) {
+        results.push_back(measure_add_document(options, documents));
+    }
+
+    // 搜索：关闭查询结果缓存，每次都完整求值并生成摘要
+    bool short_search = selected("search_engine/search/short");
+    bool long_search = selected("search_engine/search/long");
+    if (short_search || long_search) {
+        IndexOptions index;
+        index.cache_bytes = 0;
+        index.shards = options.shards;
+        SearchEngine engine(index);
+        engine.add_documents(documents);
+        engine.build_index();
+        const std::vector<std::string>* query_sets[] = {&corpus.short_queries(), &corpus.long_queries()};
+        const char* const names[] = {"search_engine/search/short", "search_engine/search/long"};
+        bool enabled[] = {short_search, long_search};
+        for (int set = 0; set < 2; ++set) {
+            if (!enabled[set]) {
+                continue;
+            }
+            const std::vector<std::string>& queries = *query_sets[set];
+            results.push_back(measure(names[set], options, [&]() {
+                for (const std::string& query : queries) {
+                    g_sink += engine.search(query, 10).size();
+                }
+                return queries.size();
+            }, 0));
+        }
+    }
+
+    // JSON转义：每个结果的标题与正文
+    if (selected("http/escape_json")) {
+        size_t bytes = 0;
+        for (const Document& document : documents) {
+            bytes += document.title.size() + document.content.size();
+        }
+        results.push_back(measure("http/escape_json", options, [&]() {
+            for (const Document& document : documents) {
+                g_sink += HttpConnection::escape_json(document.title).size();
+                g_sink += HttpConnection::escape_json(document.content).size();
+            }
+            return documents.size();
+        }, bytes));
+    }
+
+    return results;
+}
+
+} // namespace
+
+/**
+ * @brief 基准测试主函数
+ *
+ * 进度输出到标准错误，结果以JSON输出到--output或标准输出。
+ * 被测代码的日志（包括各对象析构时的日志）被丢弃，不会混入结果。
+ */
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    std::cerr << "Generating synthetic corpus: " << options.docs << " documents, ~" << options.doc_words
+              << " words each (seed " << options.seed << ")" << std::endl;
+    SyntheticCorpus corpus(options);
+
+    NullBuffer null_buffer;
+    std::streambuf* console = std::cout.rdbuf(&null_buffer);
+    std::vector<BenchmarkResult> results = run_benchmarks(options, corpus);
+    std::cout.rdbuf(console);
+
+    if (results.empty()) {
+        std::cerr << "No benchmark matches filter: " << options.filter << std::endl;
+        return 1;
+    }
+    if (options.output.empty()) {
+        write_json(std::cout, options, results);
+    } else {
+        std::ofstream out(options.output.c_str());
+        write_json(out, options, results);
+        if (!out) {
+            std::cerr << "Failed to write " << options.output << std::endl;
+            return 1;
+        }
+        std::cerr << "Results written to " << options.output << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+
+/**
+ * 有界阻塞队列
+ *
+ * 流水线各阶段之间的通道：队列满时生产者阻塞（反压），队列空时消费者阻塞。
+ * 元素按移动语义传递，不做复制。close()之后不再接受新元素，
+ * 消费者取完剩余元素后pop()返回false；被阻塞的生产者立即返回false。
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1), closed_(false) {}
+
+    // 放入一个元素，队列满时阻塞；队列已关闭时返回false
+    bool push(T value) {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (items_.size() >= capacity_ && !closed_) {
+            not_full_.wait(lock);
+        }
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // 取出一个元素，队列空时阻塞；队列已关闭且为空时返回false
+    bool pop(T& value) {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (items_.empty() && !closed_) {
+            not_empty_.wait(lock);
+        }
+        if (items_.empty()) {
+            return false;
+        }
+        value = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // 关闭队列并唤醒所有等待的线程
+    void close() {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    boost::mutex mutex_;
+    boost::condition_variable not_full_;
+    boost::condition_variable not_empty_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_;
+};
+
+/**
+ * 按序号重排的有界队列
+ *
+ * 多个生产者乱序完成、消费者需要按原始顺序处理时使用：
+ * 元素带有从0开始的连续序号，pop()总是按序号顺序返回。
+ * 序号超出“下一个待取序号 + 容量”的生产者阻塞，因此即使某个元素迟迟未完成，
+ * 暂存的元素也不会超过容量。关闭语义与BoundedQueue相同。
+ */
+template <typename T>
+class OrderedQueue
+{
+public:
+    explicit OrderedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1), next_(0), closed_(false) {}
+
+    // 放入序号为seq的元素，领先下一个待取序号太多时阻塞；队列已关闭时返回false
+    bool push(size_t seq, T value) {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (seq >= next_ + capacity_ && !closed_) {
+            not_full_.wait(lock);
+        }
+        if (closed_) {
+            return false;
+        }
+        items_.insert(std::make_pair(seq, std::move(value)));
+        if (seq == next_) {
+            ready_.notify_one();
+        }
+        return true;
+    }
+
+    // 按序号取出下一个元素，尚未到达时阻塞；队列已关闭且下一个元素不存在时返回false
+    bool pop(T& value) {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        typename std::map<size_t, T>::iterator it;
+        while ((it = items_.find(next_)) == items_.end() && !closed_) {
+            ready_.wait(lock);
+        }
+        if (it == items_.end()) {
+            return false;
+        }
+        value = std::move(it->second);
+        items_.erase(it);
+        next_++;
+        not_full_.notify_all();
+        return true;
+    }
+
+    // 关闭队列并唤醒所有等待的线程
+    void close() {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        ready_.notify_all();
+    }
+
+private:
+    boost::mutex mutex_;
+    boost::condition_variable not_full_;
+    boost::condition_variable ready_;
+    std::map<size_t, T> items_;
+    size_t capacity_;
+    size_t next_;
+    bool closed_;
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,104 @@
+#ifndef DIRECTORY_WATCHER_H
+#define DIRECTORY_WATCHER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include "indexer.h"
+
+class SearchEngine;
+
+/**
+ * 数据目录监视器类
+ *
+ * 用inotify监视数据目录及其所有子目录，只对新建、修改、改名和删除的文件重新调用Indexer::parse_file，
+ * 不需要重启就能更新索引。事件只记录发生变化的路径，在静默期（debounce_ms内没有新事件）结束后
+ * 整批提交到搜索引擎，整批只发布一个新快照：批量复制成千上万个文件只触发一次提交。
+ * 持续不断的事件流最多推迟MAX_WAIT_FACTOR个静默期也会提交。
+ *
+ * 监视在构造时就已建立，应先于加载索引创建：加载期间发生的变化留在inotify队列中，start后补上。
+ * 只支持Linux，其他平台上valid()返回false。
+ */
+class DirectoryWatcher
+{
+public:
+    // data_dir为数据目录，partition/partitions与Indexer相同，debounce_ms为提交前的静默期
+    DirectoryWatcher(const std::string& data_dir, size_t partition, size_t partitions, long debounce_ms);
+    ~DirectoryWatcher();
+
+    // 监视是否已建立
+    bool valid() const;
+
+    // 启动监视线程，把变化提交到engine
+    void start(SearchEngine& engine);
+
+    // 停止监视线程，可重复调用
+    void stop();
+
+    // 持续有事件时，一批最多推迟的静默期个数
+    static const long MAX_WAIT_FACTOR = 10;
+
+private:
+    // 文件的大小、修改时间（纳秒）与inode，事件队列溢出后核对时用于找出变化的文件
+    struct FileStamp {
+        boost::uint64_t size;
+        boost::int64_t mtime_ns;
+        boost::uint64_t inode;
+
+        bool operator==(const FileStamp& other) const {
+            return size == other.size && mtime_ns == other.mtime_ns && inode == other.inode;
+        }
+    };
+
+    std::string data_dir_;
+    Indexer indexer_;
+    long debounce_ms_;
+    int fd_;
+
+    // 监视描述符与目录路径的双向映射
+    std::map<int, boost::filesystem::path> watch_dirs_;
+    std::map<std::string, int> dir_watches_;
+
+    // 已编入索引的文件及其状态（只在监视线程中访问）
+    std::map<std::string, FileStamp> indexed_;
+
+    // 等待提交的路径，提交时再检查文件的当前状态
+    std::set<std::string> pending_;
+    boost::posix_time::ptime first_event_;
+    boost::posix_time::ptime last_event_;
+
+    SearchEngine* engine_;
+    boost::thread thread_;
+    boost::atomic<bool> stopping_;
+
+    // 监视dir及其所有子目录；enqueue为true时把其中状态与已编入索引时不同的文件加入待提交路径，否则只记录状态
+    void watch_tree(const boost::filesystem::path& dir, bool enqueue);
+
+    // 取消dir及其子目录的监视，并把其中已编入索引的文件加入待提交路径
+    void forget_tree(const std::string& dir);
+
+    // 事件队列溢出后重新监视整个目录并核对所有文件
+    void resync();
+
+    // 读取并处理当前可读的全部事件
+    void read_events();
+
+    // 记录一个待提交的路径
+    void enqueue(const std::string& path);
+
+    // 把待提交的路径整批提交到搜索引擎
+    void flush();
+
+    // 监视线程主循环
+    void run();
+
+    // 文件是否应当被编入索引，是时输出其状态
+    bool indexable(const std::string& path, FileStamp& stamp);
+};
+
+#endif // DIRECTORY_WATCHER_H
@@ -0,0 +1,102 @@
+#ifndef DOCUMENT_STORE_H
+#define DOCUMENT_STORE_H
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "posting_list.h"
+
+/**
+ * 存储的原始文档
+ */
+struct StoredDocument {
+    std::string id;         // 字符串ID（仅用于生成/doc/链接）
+    std::string title;      // 标题
+    std::string content;    // 正文
+
+    // 按值接收，传入右值时直接移动，不复制正文
+    StoredDocument(std::string i, std::string t, std::string c)
+        : id(std::move(i)), title(std::move(t)), content(std::move(c)) {}
+};
+
+/**
+ * 压缩文档存储
+ *
+ * 按添加顺序把文档打包为约BLOCK_BYTES大小的块，每块用LZ编解码器压缩；
+ * 每个文档只额外记录它在解压后块内的偏移。读取一个文档只解压它所在的块，
+ * 最近解压的CACHE_BLOCKS个块保存在LRU缓存中，热门文档无需重复解压。
+ * 尚未凑满一块的文档以原文保存在尾部，flush()时压缩。
+ * 复制存储只复制块的指针；从索引文件读取的存储直接引用映射内存中的压缩块。
+ */
+class DocumentStore
+{
+public:
+    // 一个块内原始数据的目标大小（字节）
+    static const size_t BLOCK_BYTES = 16 * 1024;
+
+    // 解压块缓存的容量（块数）
+    static const size_t CACHE_BLOCKS = 16;
+
+    DocumentStore();
+
+    // 共享已压缩的块，缓存不复制
+    DocumentStore(const DocumentStore& other);
+
+    // 追加一个文档，返回其编号
+    DocId add(const boost::shared_ptr<const StoredDocument>& document);
+
+    // 压缩尾部尚未成块的文档
+    void flush();
+
+    // 读取一个文档，必要时解压其所在的块；数据损坏时抛出std::runtime_error
+    boost::shared_ptr<const StoredDocument> get(DocId doc) const;
+
+    // 文档数
+    size_t size() const { return doc_offsets_.size() + tail_.size(); }
+
+    // 压缩块的总字节数与其原始字节数（不含尾部）
+    size_t compressed_bytes() const;
+    size_t raw_bytes() const;
+
+    // 写入索引文件（尾部文档作为最后一块一并压缩）
+    void write(IndexFileWriter& writer) const;
+
+    // 从映射的索引文件读取，压缩块引用映射内存，映射必须在存储销毁前保持有效
+    void read(IndexFileReader& reader);
+
+private:
+    /**
+     * 压缩块
+     */
+    struct Block {
+        const char* data;               // 压缩数据
+        boost::uint32_t size;           // 压缩字节数
+        boost::uint32_t raw_size;       // 原始字节数
+        DocId first_doc;                // 块内第一个文档的编号
+    };
+
+    typedef boost::shared_ptr<const std::string> BlockData;
+
+    std::vector<Block> blocks_;
+    std::vector<BlockData> owned_;                  // 自己压缩的块的存储（映射的块不在其中）
+    std::vector<boost::uint32_t> doc_offsets_;      // 已成块的文档在解压后块内的偏移
+
+    // 尚未压缩的尾部文档
+    std::vector<boost::shared_ptr<const StoredDocument>> tail_;
+    size_t tail_bytes_;
+
+    // 解压块的LRU缓存：块序号 -> 解压数据，最近使用的在前
+    mutable boost::mutex cache_mutex_;
+    mutable std::list<std::pair<size_t, BlockData>> cache_;
+
+    DocumentStore& operator=(const DocumentStore&) = delete;
+
+    // 取得解压后的块，优先从缓存读取
+    BlockData block_data(size_t block) const;
+};
+
+#endif // DOCUMENT_STORE_H
@@ -5,8 +5,13 @@
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <chrono>
 #include <string>
 #include <map>
+#include <vector>
+
+struct SearchResult;
+struct Suggestion;
 
 using boost::asio::ip::tcp;
 
@@ -19,25 +24,80 @@ public:
     typedef boost::shared_ptr<HttpConnection> pointer;
 
     static pointer create(boost::asio::io_context& io_context);
+    ~HttpConnection();
 
     tcp::socket& socket();
 
     void start();
 
+    // 转义JSON字符串中的特殊字符与ASCII控制字符，UTF-8多字节字符原样保留
+    static std::string escape_json(const std::string& str);
+
 private:
     HttpConnection(boost::asio::io_context& io_context);
 
-    void handle_read(const boost::system::error_code& error, size_t bytes_transferred);
+    void handle_read_headers(const boost::system::error_code& error, size_t bytes_transferred);
+    void handle_read_body(const boost::system::error_code& error, size_t bytes_transferred);
     void handle_write(const boost::system::error_code& error);
 
+    // 请求头与请求体读取完整后处理请求并写回响应
+    void dispatch();
+
+    // 异步写回完整的响应
+    void write_response(const std::string& response);
+
+    // 响应写完后记录整个请求的耗时并结束请求
+    void finish_request();
+
     std::string process_request(const std::string& request);
-    std::string create_response(const std::string& content, const std::string& content_type = "text/html");
+
+    // 协调节点需要请求分片的接口在分片应答后异步写回响应；已开始处理时返回true，其他请求交给process_request
+    bool serve_coordinator(const std::string& method, const std::string& path);
+
+    std::string create_response(const std::string& content, const std::string& content_type = "text/html",
+                                const std::string& status = "200 OK");
     std::string get_file_content(const std::string& file_path);
     std::string url_decode(const std::string& encoded);
-    std::string escape_json(const std::string& str);
     std::string serve_document(const std::string& doc_id);
+    std::string document_page(const std::pair<std::string, std::string>& doc_info);
     std::string escape_html(const std::string& str);
 
+    // 搜索结果列表的JSON数组
+    std::string results_json(const std::vector<SearchResult>& results);
+
+    // 搜索接口的JSON对象；failed_shards不为空时（协调节点）另外报告结果是否完整
+    std::string search_json(const std::vector<SearchResult>& results, const std::vector<std::string>* failed_shards);
+
+    // 补全接口的JSON对象
+    std::string suggestions_json(const std::vector<Suggestion>& suggestions);
+
+    // 字符串列表的JSON数组
+    std::string string_array_json(const std::vector<std::string>& values);
+
+    // 批量搜索（POST /api/search/batch）：请求体每行一个查询，结果每行一个JSON对象，以分块传输编码逐窗口写回
+    void start_batch(const std::string& path, const std::string& body);
+
+    // 上一块写完后求值下一个窗口并写出，全部写完后结束
+    void write_batch_window(const boost::system::error_code& error);
+
+    // 协调节点：把窗口中下一个尚未开始的查询扇出到各分片
+    void start_batch_search();
+
+    // 把当前窗口的结果作为一个分块写出
+    void write_batch_chunk();
+
+    // 分片服务器的内部接口（/internal/...），供协调节点调用
+    std::string serve_internal(const std::string& path);
+
+    // Prometheus文本格式的服务指标（GET /metrics）
+    std::string serve_metrics();
+
+    // 取查询字符串中的参数并做URL解码，不存在时返回空字符串
+    std::string query_parameter(const std::string& path, const std::string& name);
+
+    // 取请求头中的字段值（名称不区分大小写），不存在时返回空字符串
+    std::string header_value(const std::string& headers, const std::string& name);
+
     // 编码检测和转换函数
     std::string detect_and_convert_encoding(const std::string& raw_content);
     std::string detect_encoding(const std::string& content);
@@ -45,9 +105,36 @@ private:
     std::string convert_gbk_to_utf8(const std::string& gbk_content);
     std::string simple_gbk_to_utf8(const std::string& gbk_content);
 
+    // 请求头与请求体的长度上限；批量搜索一次最多的查询数、每个查询最多的结果数、每个窗口的查询数，
+    // 以及协调节点同时扇出的查询数
+    enum { max_header_length = 64 * 1024, max_body_length = 16 * 1024 * 1024 };
+    enum { max_batch_queries = 100000, max_batch_results = 100, batch_window = 256, batch_parallelism = 16 };
+
     tcp::socket socket_;
-    enum { max_length = 8192 };
-    char data_[max_length];
+    boost::asio::streambuf buffer_;     // 读取请求头的缓冲区，可能包含请求体的开头
+    std::string headers_;               // 请求行与请求头
+    std::string body_;                  // 请求体
+    std::string response_;              // 正在写出的响应，写完之前必须保持有效
+
+    // 批量搜索的查询、下一个待求值的查询与每个查询的结果数
+    std::vector<std::string> batch_queries_;
+    size_t batch_next_;
+    int batch_results_;
+
+    // 当前窗口[batch_next_, batch_last_)的结果；协调节点另有各查询失败的分片、已开始与已完成的查询数
+    size_t batch_last_;
+    std::vector<std::vector<SearchResult>> batch_window_results_;
+    std::vector<std::vector<std::string>> batch_failed_shards_;
+    size_t batch_started_;
+    size_t batch_completed_;
+
+    // 连接是否已计入打开的连接数，请求是否正在处理
+    bool open_;
+    bool in_flight_;
+
+    // 读完请求头的时间与开始写出当前响应（或分块）的时间
+    std::chrono::steady_clock::time_point request_start_;
+    std::chrono::steady_clock::time_point write_start_;
 };
 
 /**
@@ -56,7 +143,7 @@ private:
 class HttpServer
 {
 public:
-    HttpServer(boost::asio::io_context& io_context, short port);
+    HttpServer(boost::asio::io_context& io_context, unsigned short port);
 
 private:
     void start_accept();
@@ -0,0 +1,49 @@
+#ifndef INDEX_FIELD_H
+#define INDEX_FIELD_H
+
+#include <string>
+
+/**
+ * 索引字段
+ *
+ * 默认字段包含标题与正文中的全部词项；标题字段只包含标题中的词项，倒排列表短得多，
+ * 各自有独立的词典与倒排列表，因此文档频率等统计也按字段分别计算。
+ * 查询中限定字段的词项表示为"字段名:词项"，例如title:asio；
+ * 分词结果不含冒号，这种表示不会与普通词项混淆，也可以像普通词项一样作为缓存键与统计的键。
+ */
+enum IndexField {
+    FIELD_DEFAULT = 0,  // 标题与正文
+    FIELD_TITLE = 1,    // 只含标题
+    FIELD_COUNT = 2
+};
+
+// 字段名，默认字段没有名字
+inline const char* field_name(IndexField field) {
+    return field == FIELD_TITLE ? "title" : "";
+}
+
+// 按字段名查找字段，不是已知字段名时返回FIELD_COUNT
+inline IndexField find_field(const std::string& name) {
+    return name == "title" ? FIELD_TITLE : FIELD_COUNT;
+}
+
+// 字段限定的词项
+inline std::string field_term(IndexField field, const std::string& term) {
+    return field == FIELD_DEFAULT ? term : std::string(field_name(field)) + ":" + term;
+}
+
+// 拆分字段限定的词项，返回字段，term输出不含字段名的索引词项
+inline IndexField split_field_term(const std::string& key, std::string& term) {
+    size_t colon = key.find(':');
+    if (colon != std::string::npos) {
+        IndexField field = find_field(key.substr(0, colon));
+        if (field != FIELD_COUNT) {
+            term = key.substr(colon + 1);
+            return field;
+        }
+    }
+    term = key;
+    return FIELD_DEFAULT;
+}
+
+#endif // INDEX_FIELD_H
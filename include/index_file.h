@@ -0,0 +1,140 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include <string>
+#include <fstream>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/**
+ * 索引文件头中的描述信息
+ */
+struct IndexFileInfo {
+    boost::uint32_t flags;          // 索引选项，见FLAG_*
+    boost::uint64_t fingerprint;    // 建立索引时数据目录的指纹，用于判断索引是否过期
+
+    IndexFileInfo() : flags(0), fingerprint(0) {}
+};
+
+/**
+ * 索引文件格式
+ *
+ * 文件由固定长度的文件头与正文组成，所有整数按本机字节序存放：
+ *   文件头：魔数"BSEINDEX"、格式版本、选项标志、数据目录指纹、正文长度、正文的FNV-1a校验和、
+ *          文件头其余字段的FNV-1a校验和
+ *   正文：  由各模块依次写入（段、文档、词典与倒排列表），数组按其元素大小对齐，
+ *          因此映射到内存后可以直接原地读取。
+ * 版本、选项或校验和不一致的文件都被视为无效，调用方应回退为重新建立索引。
+ * 文件先完整写入并落盘再改名替换，不会出现写了一半的索引文件；因此打开时默认只校验文件头，
+ * 正文的校验和需要读取每一页，只在要求时校验。
+ */
+namespace index_file {
+
+// 魔数
+const char MAGIC[8] = {'B', 'S', 'E', 'I', 'N', 'D', 'E', 'X'};
+
+// 当前格式版本，任何布局变化都必须递增
+const boost::uint32_t VERSION = 6;
+
+// 文件头长度（字节），正文从该偏移开始
+const size_t HEADER_SIZE = 48;
+
+// 选项标志：倒排列表存储了位置
+const boost::uint32_t FLAG_POSITIONS = 1;
+
+} // namespace index_file
+
+/**
+ * 索引文件写入器：顺序写入正文，同时计算校验和，最后回填文件头
+ *
+ * 先写入同目录下的临时文件，finish()把它落盘后才替换目标文件，再把目录落盘，
+ * 写入中途失败或断电都不会破坏已有的索引文件。
+ */
+class IndexFileWriter
+{
+public:
+    // 创建临时文件，失败时抛出std::runtime_error
+    explicit IndexFileWriter(const std::string& path);
+    ~IndexFileWriter();
+
+    void write(const void* data, size_t size);
+    void write_u8(boost::uint8_t value);
+    void write_u32(boost::uint32_t value);
+    void write_u64(boost::uint64_t value);
+
+    // 写入32位长度与字符串内容
+    void write_string(const std::string& value);
+
+    // 填充0直到文件偏移是alignment的整数倍
+    void align(size_t alignment);
+
+    // 写入文件头、落盘并替换目标文件，失败时抛出std::runtime_error
+    void finish(const IndexFileInfo& info);
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    boost::uint64_t offset_;    // 当前文件偏移（包括文件头）
+    boost::uint64_t checksum_;  // 已写入正文的校验和
+    bool finished_;
+};
+
+/**
+ * 以只读方式映射的索引文件
+ *
+ * 打开时校验文件头及其校验和，verify_body为true时还校验整个正文的校验和（读取每一页）；
+ * 映射在对象销毁前一直有效，引用其中数据的对象需要持有该对象的shared_ptr。
+ */
+class MappedIndexFile
+{
+public:
+    // 映射并校验文件，文件不存在、格式版本不符或数据损坏时抛出std::runtime_error
+    explicit MappedIndexFile(const std::string& path, bool verify_body = false);
+
+    const IndexFileInfo& info() const { return info_; }
+
+    // 正文的起始地址与长度
+    const boost::uint8_t* body() const;
+    size_t body_size() const { return body_size_; }
+
+private:
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region region_;
+    IndexFileInfo info_;
+    size_t body_size_;
+};
+
+/**
+ * 映射正文的顺序读取游标，越界时抛出std::runtime_error
+ */
+class IndexFileReader
+{
+public:
+    // body为正文起始地址（对应文件偏移HEADER_SIZE）
+    IndexFileReader(const boost::uint8_t* body, size_t size);
+
+    // 返回当前位置并向后移动size字节
+    const boost::uint8_t* read(size_t size);
+    boost::uint8_t read_u8();
+    boost::uint32_t read_u32();
+    boost::uint64_t read_u64();
+    std::string read_string();
+
+    // 跳过填充直到文件偏移是alignment的整数倍
+    void align(size_t alignment);
+
+    bool at_end() const { return pos_ == size_; }
+
+private:
+    const boost::uint8_t* body_;
+    size_t size_;
+    size_t pos_;
+};
+
+// 64位FNV-1a散列，seed为之前数据的散列值
+boost::uint64_t fnv1a64(const void* data, size_t size, boost::uint64_t seed = 14695981039346656037ULL);
+
+#endif // INDEX_FILE_H
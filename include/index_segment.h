@@ -0,0 +1,173 @@
+#ifndef INDEX_SEGMENT_H
+#define INDEX_SEGMENT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include "document_store.h"
+#include "index_field.h"
+#include "levenshtein_automaton.h"
+#include "persistent_map.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+class MappedIndexFile;
+
+/**
+ * 段的内存占用
+ */
+struct SegmentFootprint {
+    size_t dictionary_bytes;    // 词典，包括按编号排列的倒排列表指针与尚未并入词典的新词项
+    size_t posting_bytes;       // 倒排列表
+    size_t bitmap_terms;        // 以位图存储的倒排列表数
+    size_t store_bytes;         // 文档存储压缩后的字节数
+    size_t store_raw_bytes;     // 文档存储压缩前的字节数
+
+    SegmentFootprint() : dictionary_bytes(0), posting_bytes(0), bitmap_terms(0), store_bytes(0), store_raw_bytes(0) {}
+};
+
+/**
+ * 索引段
+ *
+ * 一批连续添加的文档及其倒排列表，段内使用从0开始的局部文档编号，
+ * 因此每个段都可以独立求值。新文档先写入未封存的缓冲段；
+ * 缓冲段写满后封存（压缩所有倒排列表），之后只读，由后台合并为更大的段。
+ * 复制段只复制倒排列表的指针；写入时只复制仍被其他副本共享的列表，
+ * 已发布的段因此始终保持不变。新词项保存在持久化映射中，复制段不复制词汇，
+ * 写入一个文档只复制它的词项所在的路径，代价与缓冲段的词汇量无关。
+ * 原始文档保存在压缩文档存储中，封存时压缩尾部文档。
+ * 词项保存在前缀压缩的不可变词典中，倒排列表按词项编号排列；
+ * 未封存段中新出现的词项先放在散列表里，封存时并入词典。
+ * 每个字段（见index_field.h）各有一套词典与倒排列表，标题字段只含标题中的出现。
+ * 从索引文件加载的段，倒排列表与压缩文档直接引用文件映射，段持有映射的引用直到销毁。
+ */
+class IndexSegment
+{
+public:
+    IndexSegment();
+
+    // 追加一个文档，返回局部编号
+    DocId add_document(const boost::shared_ptr<const StoredDocument>& document,
+                       boost::uint32_t doc_len, boost::uint32_t title_len);
+
+    // 为局部编号doc追加一条倒排记录，doc必须是最近添加的文档；title_tf大于0时同时写入标题字段
+    void add_posting(const std::string& term, DocId doc, boost::uint32_t tf, boost::uint32_t title_tf,
+                     const std::vector<boost::uint32_t>* positions);
+
+    // 封存：压缩尾部文档，把新词项并入词典，并为每个词项选择更紧凑的表示
+    void seal();
+
+    // 合并若干段，deleted[i]为第i个段中需要丢弃的文档（可以为空指针）
+    // remap输出各段的局部编号到合并后编号的映射，被丢弃的文档映射为PostingList::END_DOC
+    static boost::shared_ptr<IndexSegment> merge(const std::vector<const IndexSegment*>& segments,
+                                                 const std::vector<const std::vector<bool>*>& deleted,
+                                                 std::vector<std::vector<DocId>>& remap);
+
+    // 写入索引文件
+    void write(IndexFileWriter& writer) const;
+
+    // 从映射的索引文件读取一个段，倒排列表引用storage中的映射内存
+    // 数据不一致时抛出std::runtime_error
+    static boost::shared_ptr<IndexSegment> load(IndexFileReader& reader,
+                                                const boost::shared_ptr<const MappedIndexFile>& storage);
+
+    // 查找词项的倒排列表，term可以是字段限定的词项，不存在时返回空指针
+    const PostingList* find_postings(const std::string& term) const;
+
+    // 查找字符串ID在段内最新的局部编号，不存在时返回PostingList::END_DOC
+    DocId find_document(const std::string& id) const;
+
+    // 读取原始文档，必要时解压其所在的块；数据损坏时抛出std::runtime_error
+    boost::shared_ptr<const StoredDocument> document(DocId doc) const { return store_.get(doc); }
+
+    // 文档数（包括已被取代的文档）
+    size_t size() const { return store_.size(); }
+
+    // 字符串ID -> 段内最新的局部编号
+    const std::unordered_map<std::string, DocId>& ids() const { return ids_; }
+
+    // 文档存储
+    const DocumentStore& store() const { return store_; }
+
+    bool sealed() const { return sealed_; }
+
+    // 文档长度与标题长度：局部编号 -> 词项数
+    const std::vector<boost::uint32_t>& doc_lengths() const { return doc_lengths_; }
+    const std::vector<boost::uint32_t>& title_lengths() const { return title_lengths_; }
+
+    // 默认字段的词项数
+    size_t term_count() const {
+        return fields_[FIELD_DEFAULT].dictionary.size() + fields_[FIELD_DEFAULT].pending.size();
+    }
+
+    // 将默认字段中以prefix开头的词项按字节序追加到out，prefix为空时追加全部词项
+    void collect_terms(std::vector<std::string>& out, const std::string& prefix = std::string()) const;
+
+    // 追加field中与自动机目标词项编辑距离不超过其上限的词项（不含字段名）及编辑距离
+    void collect_fuzzy_terms(const LevenshteinAutomaton& automaton, std::vector<std::pair<std::string, size_t>>& out,
+                             IndexField field = FIELD_DEFAULT) const;
+
+    // 按字节序追加默认字段的全部词项及其文档频率（倒排列表中的文档数）
+    void collect_term_frequencies(std::vector<std::pair<std::string, boost::uint32_t>>& out) const;
+
+    // 默认字段已并入词典的词项（未封存段中新出现的词项在封存之前不在其中）
+    const TermDictionary& dictionary() const { return fields_[FIELD_DEFAULT].dictionary; }
+
+    // 词典占用的内存字节数
+    size_t dictionary_memory() const;
+
+    // 倒排列表占用的内存字节数，bitmap_terms输出使用位图表示的词项数
+    size_t posting_memory(size_t& bitmap_terms) const;
+
+    // 内存占用；已封存的段在封存或加载时统计一次，之后直接返回，未封存的段每次重新统计
+    SegmentFootprint footprint() const;
+
+private:
+    typedef boost::shared_ptr<PostingList> PostingPtr;
+
+    DocumentStore store_;
+    std::vector<boost::uint32_t> doc_lengths_;
+    std::vector<boost::uint32_t> title_lengths_;
+
+    /**
+     * 一个字段的词项与倒排列表
+     */
+    struct FieldIndex {
+        // 词典与按词项编号排列的倒排列表（记录中的文档编号为局部编号）
+        TermDictionary dictionary;
+        std::vector<PostingPtr> postings;
+
+        // 上次封存之后新出现的词项 -> 倒排列表，段的副本之间共享未修改的部分
+        PersistentMap<PostingPtr> pending;
+    };
+
+    FieldIndex fields_[FIELD_COUNT];
+
+    // 字符串ID -> 段内最新的局部编号
+    std::unordered_map<std::string, DocId> ids_;
+
+    bool sealed_;
+
+    // 封存（或加载已封存的段）时统计的内存占用
+    SegmentFootprint footprint_;
+
+    // 倒排列表引用的索引文件映射，不是从文件加载时为空
+    boost::shared_ptr<const MappedIndexFile> storage_;
+
+    // 查找字段中不含字段名的词项的倒排列表
+    const PostingList* field_postings(IndexField field, const std::string& term) const;
+
+    // 取得字段中可以修改的倒排列表：列表仍被其他段副本共享时先复制
+    PostingList& writable_postings(IndexField field, const std::string& term);
+
+    // 遍历词典与倒排列表统计内存占用
+    SegmentFootprint measure_footprint() const;
+
+    // 按字节序列出字段的全部词项及其倒排列表（词典与新词项归并）
+    void sorted_terms(IndexField field, std::vector<std::string>& terms, std::vector<PostingPtr>& postings) const;
+};
+
+#endif // INDEX_SEGMENT_H
@@ -1,8 +1,10 @@
 #ifndef INDEXER_H
 #define INDEXER_H
 
+#include <functional>
 #include <string>
 #include <vector>
+#include <boost/cstdint.hpp>
 #include <boost/filesystem.hpp>
 
 /**
@@ -20,35 +22,55 @@ struct Document {
 
 /**
  * 索引构建器类
+ *
+ * 解析文件只读取构造时确定的扩展名列表，可以被多个线程同时调用。
+ * 分布式部署时数据目录按文件相对路径的散列分为partitions个分区，每个分片服务器只遍历自己的分区。
  */
 class Indexer
 {
 public:
-    Indexer();
+    // partition为只遍历的分区序号，partitions为分区总数（1表示不分区）
+    explicit Indexer(size_t partition = 0, size_t partitions = 1);
     ~Indexer();
 
     // 扫描目录并构建文档列表
     std::vector<Document> scan_directory(const std::string& directory_path);
 
+    // 列出目录中所有受支持的文件（按遍历顺序）
+    std::vector<std::string> list_files(const std::string& directory_path);
+
+    // 按遍历顺序把每个受支持的文件交给visit，visit返回false时停止
+    void for_each_file(const std::string& directory_path, const std::function<bool(const std::string&)>& visit);
+
     // 解析单个文件
     Document parse_file(const std::string& file_path);
 
     // 支持的文件类型检查
     bool is_supported_file(const std::string& file_path);
 
+    // 文件是否属于本分区（按相对数据目录的路径散列）
+    bool in_partition(const boost::filesystem::path& file_path, const std::string& directory_path) const;
+
+    // 从文件路径生成文档ID（同一文件须使用与遍历时相同形式的路径）
+    std::string generate_doc_id(const std::string& file_path);
+
+    // 目录指纹：由分区内所有受支持文件的路径、大小与修改时间以及分区设置计算，任何文件增删改都会改变指纹
+    boost::uint64_t fingerprint(const std::string& directory_path);
+
 private:
     // 支持的文件扩展名
     std::vector<std::string> supported_extensions_;
 
+    // 分区序号与分区总数
+    size_t partition_;
+    size_t partitions_;
+
     // 解析文本文件
     std::string parse_text_file(const std::string& file_path);
 
     // 解析HTML文件
     std::string parse_html_file(const std::string& file_path);
 
-    // 从文件路径生成文档ID
-    std::string generate_doc_id(const std::string& file_path);
-
     // 从文件路径提取标题
     std::string extract_title(const std::string& file_path);
 
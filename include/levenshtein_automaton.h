@@ -0,0 +1,71 @@
+#ifndef LEVENSHTEIN_AUTOMATON_H
+#define LEVENSHTEIN_AUTOMATON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "term_dictionary.h"
+
+/**
+ * Levenshtein自动机：接受与给定词项编辑距离（插入、删除、替换单个字节）不超过max_edits的字符串
+ *
+ * 状态是编辑距离矩阵当前行中不超过max_edits的稀疏部分，即若干(已匹配的词项长度, 编辑数)，
+ * 至多2 * max_edits + 1项，逐字节转移。状态为空时任何后缀都无法再被接受。
+ * 与词典求交时按字节序遍历词典，相邻词项共享前缀对应的状态；
+ * 某个前缀的状态为空时，直接跳转到下一个可能被接受的前缀，不逐个检查被跳过的词项。
+ * 构建后只读，可以被多个线程同时使用。
+ */
+class LevenshteinAutomaton
+{
+public:
+    // 支持的最大编辑距离
+    static const size_t MAX_EDITS = 2;
+
+    // term为目标词项，max_edits超过MAX_EDITS时按MAX_EDITS处理
+    LevenshteinAutomaton(const std::string& term, size_t max_edits);
+
+    // 按词项长度选择默认的最大编辑距离：只对以英文字母开头的ASCII词项做模糊匹配，短词不做
+    static size_t default_edits(const std::string& term);
+
+    // 词项是否可以做模糊匹配（以英文字母开头的ASCII词项）
+    static bool supports(const std::string& term);
+
+    // 与candidate的编辑距离，超过max_edits时返回max_edits + 1
+    size_t distance(const std::string& candidate) const;
+
+    // 按字节序追加词典中被接受的词项及其编辑距离
+    void intersect(const TermDictionary& dictionary, std::vector<std::pair<std::string, size_t>>& out) const;
+
+    size_t max_edits() const { return max_edits_; }
+
+private:
+    /**
+     * 编辑距离矩阵当前行中的一项：已匹配词项的前index个字节，用了edits次编辑
+     */
+    struct Entry {
+        boost::uint32_t index;
+        boost::uint32_t edits;
+
+        Entry(boost::uint32_t i, boost::uint32_t e) : index(i), edits(e) {}
+    };
+
+    typedef std::vector<Entry> State;
+
+    std::string term_;
+    size_t max_edits_;
+
+    // 初始状态（尚未读入任何字节）
+    void start(State& state) const;
+
+    // 读入字节c后的状态
+    void step(const State& state, unsigned char c, State& next) const;
+
+    // 状态读完时被接受则返回编辑距离，否则返回max_edits_ + 1
+    size_t accepted(const State& state) const;
+
+    // 读入比c大的字节中能使状态非空的最小字节，不存在时返回-1（状态读入c后必须为空）
+    int next_label(const State& state, unsigned char c) const;
+};
+
+#endif // LEVENSHTEIN_AUTOMATON_H
@@ -0,0 +1,27 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <string>
+
+/**
+ * LZ77系列的字节压缩编解码器（格式与LZ4的块格式相近）
+ *
+ * 压缩数据由若干序列组成，每个序列依次为：
+ *   标记字节：高4位为字面量长度，低4位为匹配长度减4，值为15时后续以255累加的字节扩展长度
+ *   字面量：原样复制的字节
+ *   匹配偏移：16位小端整数，表示从已输出数据末尾向前的距离
+ *   扩展的匹配长度
+ * 最后一个序列只有字面量。压缩使用4字节散列查找最近一次出现的位置，
+ * 速度优先，对文本通常能压缩到原大小的一半左右；解压只做顺序复制。
+ */
+namespace lz {
+
+// 压缩size字节，结果追加到out
+void compress(const char* data, size_t size, std::string& out);
+
+// 解压为raw_size字节，结果写入out（覆盖原内容）；数据损坏时返回false
+bool decompress(const char* data, size_t size, size_t raw_size, std::string& out);
+
+} // namespace lz
+
+#endif // LZ_CODEC_H
@@ -0,0 +1,221 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/**
+ * 无锁延迟直方图
+ *
+ * 按HDR直方图的方式对数-线性分桶：每个2的幂区间再均分为SUB_BUCKETS个子桶，
+ * 任意取值的相对误差不超过1/SUB_BUCKETS。记录只做一次最高置位查找与两次relaxed原子加，
+ * 不加锁、不分配内存；导出时才读取各桶，读取与记录并发时只会相差正在记录的几个样本。
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    // 记录一个以纳秒为单位的取值
+    void record(boost::uint64_t nanos) {
+        counts_[bucket_index(nanos)].fetch_add(1, boost::memory_order_relaxed);
+        sum_.fetch_add(nanos, boost::memory_order_relaxed);
+    }
+
+    // 以Prometheus文本格式输出名为name的直方图样本（_bucket、_sum与_count，单位为秒），
+    // labels为附加在每个样本上的标签（不含花括号，可以为空）
+    void write(std::ostream& out, const std::string& name, const std::string& labels) const;
+
+    // 分位数q（0到1之间）所在子桶的最大取值（纳秒），没有记录时为0
+    boost::uint64_t quantile(double q) const;
+
+    // 每个2的幂区间的子桶数（2的SUB_BUCKET_BITS次幂）
+    static const int SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKETS = static_cast<size_t>(1) << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // 导出的Prometheus桶上界为2的幂纳秒，从2^MIN_EXPORT_BIT（约1微秒）到2^MAX_EXPORT_BIT（约17秒）
+    static const int MIN_EXPORT_BIT = 10;
+    static const int MAX_EXPORT_BIT = 34;
+
+private:
+    boost::atomic<boost::uint64_t> counts_[BUCKET_COUNT];
+    boost::atomic<boost::uint64_t> sum_;
+
+    // 取值所在的子桶：小于2*SUB_BUCKETS的取值各占一个桶，更大的取值保留最高的SUB_BUCKET_BITS+1位
+    static size_t bucket_index(boost::uint64_t value) {
+        int shift = highest_bit(value | SUB_BUCKETS) - SUB_BUCKET_BITS;
+        return static_cast<size_t>(shift) * SUB_BUCKETS + static_cast<size_t>(value >> shift);
+    }
+
+    // 子桶能容纳的最大取值
+    static boost::uint64_t bucket_max(size_t index);
+
+    // 最高置位的位置，value不能为0
+    static int highest_bit(boost::uint64_t value) {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<int>(index);
+#else
+        int index = 0;
+        while (value >>= 1) {
+            index++;
+        }
+        return index;
+#endif
+    }
+};
+
+/**
+ * 按秒计数的事件速率
+ *
+ * 环形数组的每一格记录某一秒的事件数，格中的秒数过期时由第一个写入者清零；
+ * 清零与同一秒的并发写入之间可能丢失个别事件，用于监控足够精确。
+ */
+class RateMeter
+{
+public:
+    RateMeter();
+
+    // 记录count个事件
+    void mark(boost::uint64_t count);
+
+    // 最近WINDOW_SECONDS个完整秒内的平均每秒事件数
+    double rate() const;
+
+    static const size_t WINDOW_SECONDS = 10;
+
+private:
+    static const size_t SLOTS = 16;
+
+    boost::atomic<boost::uint64_t> seconds_[SLOTS];
+    boost::atomic<boost::uint64_t> counts_[SLOTS];
+
+    // 单调时钟的当前秒数
+    static boost::uint64_t now_seconds();
+};
+
+/**
+ * 进程级的服务指标
+ *
+ * 各处理阶段的延迟直方图、请求与连接计数以及查询速率，由GET /metrics以Prometheus文本格式导出。
+ * 全部是原子计数，热路径上记录一次只需几十纳秒（主要是读取两次单调时钟）。
+ */
+class Metrics
+{
+public:
+    // 请求的处理阶段；REQUEST为从读完请求头到写完响应的整个请求
+    enum Stage {
+        REQUEST_PARSE,      // 解析请求头
+        TOKENIZE,           // 解析查询并分词
+        FUZZY_EXPAND,       // 把模糊查询词展开为词汇中的词项
+        CANDIDATE_GATHER,   // 查找各段词典、累计文档频率并计算查询词权重
+        SCORING,            // 遍历倒排列表并求每组段的前k名
+        SORT,               // 合并各组的候选并排序
+        SNIPPET,            // 读取文档并生成摘要
+        JSON_SERIALIZE,     // 把结果序列化为JSON
+        SOCKET_WRITE,       // 把响应写入套接字
+        REQUEST,
+        STAGE_COUNT
+    };
+
+    // 进程内唯一的实例
+    static Metrics& instance();
+
+    // 阶段在导出标签中的名字
+    static const char* stage_name(Stage stage);
+
+    // 记录一个阶段的耗时
+    void record(Stage stage, boost::uint64_t nanos) {
+        stages_[stage].record(nanos);
+    }
+
+    // 记录一个从start开始、到现在结束的阶段
+    void record(Stage stage, std::chrono::steady_clock::time_point start) {
+        record(stage, static_cast<boost::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+
+    // 连接建立与关闭
+    void connection_opened() {
+        connections_total_.fetch_add(1, boost::memory_order_relaxed);
+        connections_open_.fetch_add(1, boost::memory_order_relaxed);
+    }
+    void connection_closed() {
+        connections_open_.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    // 请求开始处理与处理结束
+    void request_started() {
+        requests_total_.fetch_add(1, boost::memory_order_relaxed);
+        requests_in_flight_.fetch_add(1, boost::memory_order_relaxed);
+    }
+    void request_finished() {
+        requests_in_flight_.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    // 执行了count个搜索查询
+    void queries_served(size_t count) {
+        queries_total_.fetch_add(count, boost::memory_order_relaxed);
+        query_rate_.mark(count);
+    }
+
+    // 以Prometheus文本格式输出所有指标
+    void write(std::ostream& out) const;
+
+private:
+    Metrics();
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+
+    LatencyHistogram stages_[STAGE_COUNT];
+
+    boost::atomic<boost::uint64_t> requests_total_;
+    boost::atomic<boost::int64_t> requests_in_flight_;
+    boost::atomic<boost::uint64_t> connections_total_;
+    boost::atomic<boost::int64_t> connections_open_;
+    boost::atomic<boost::uint64_t> queries_total_;
+    RateMeter query_rate_;
+};
+
+/**
+ * 阶段计时器：构造时开始计时，stop或析构时把耗时记录到阶段的直方图
+ */
+class StageTimer
+{
+public:
+    explicit StageTimer(Metrics::Stage stage)
+        : stage_(stage), start_(std::chrono::steady_clock::now()), running_(true) {}
+
+    ~StageTimer() {
+        stop();
+    }
+
+    // 提前结束计时，之后不再重复记录
+    void stop() {
+        if (running_) {
+            running_ = false;
+            Metrics::instance().record(stage_, start_);
+        }
+    }
+
+private:
+    Metrics::Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    bool running_;
+
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+};
+
+#endif // METRICS_H
@@ -0,0 +1,202 @@
+#ifndef PERSISTENT_MAP_H
+#define PERSISTENT_MAP_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * 持久化映射 - 以字符串为键的哈希数组映射字典树（HAMT）
+ *
+ * 键的散列值每5位决定一层的分支，每个节点只为存在的分支分配槽位（32位位图加紧凑数组）。
+ * 复制映射只复制根指针，副本之间共享全部节点与条目；修改一个键时只复制从根到该条目的路径上
+ * 仍被其他副本共享的节点（每个节点至多32个指针），代价与映射的大小无关。
+ * 只被一个副本持有的节点与条目直接原地修改，连续写入同一个未共享的映射不产生复制。
+ * 未封存的缓冲段用它保存新词项：已发布的快照与写入线程手中的副本共享绝大部分节点。
+ */
+template <typename Value>
+class PersistentMap
+{
+public:
+    PersistentMap() : size_(0) {}
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    void clear() {
+        root_.reset();
+        size_ = 0;
+    }
+
+    // 查找键，不存在时返回空指针
+    const Value* find(const std::string& key) const {
+        const Node* node = root_.get();
+        size_t hash = hash_key(key);
+        for (size_t shift = 0; node; shift += BITS) {
+            if (shift >= HASH_BITS) {
+                for (const EntryPtr& entry : node->collisions) {
+                    if (entry->key == key) {
+                        return &entry->value;
+                    }
+                }
+                return nullptr;
+            }
+            boost::uint32_t bit = branch_bit(hash, shift);
+            if (!(node->bitmap & bit)) {
+                return nullptr;
+            }
+            const Slot& slot = node->slots[slot_index(node->bitmap, bit)];
+            if (!slot.child) {
+                return slot.entry->key == key ? &slot.entry->value : nullptr;
+            }
+            node = slot.child.get();
+        }
+        return nullptr;
+    }
+
+    // 取得键对应的可修改的值，不存在时插入默认值；路径上仍被其他副本共享的节点与条目先被复制
+    Value& operator[](const std::string& key) {
+        size_t hash = hash_key(key);
+        NodePtr* link = &root_;
+        for (size_t shift = 0;; shift += BITS) {
+            Node& node = writable(*link);
+            if (shift >= HASH_BITS) {
+                for (EntryPtr& entry : node.collisions) {
+                    if (entry->key == key) {
+                        return writable(entry).value;
+                    }
+                }
+                node.collisions.push_back(EntryPtr(new Entry(key)));
+                size_++;
+                return node.collisions.back()->value;
+            }
+
+            boost::uint32_t bit = branch_bit(hash, shift);
+            size_t index = slot_index(node.bitmap, bit);
+            if (!(node.bitmap & bit)) {
+                node.bitmap |= bit;
+                node.slots.insert(node.slots.begin() + index, Slot());
+                node.slots[index].entry.reset(new Entry(key));
+                size_++;
+                return node.slots[index].entry->value;
+            }
+
+            Slot& slot = node.slots[index];
+            if (!slot.child) {
+                if (slot.entry->key == key) {
+                    return writable(slot.entry).value;
+                }
+                // 散列值在这一层冲突：把已有条目下移一层，再继续插入
+                NodePtr child(new Node());
+                size_t next = shift + BITS;
+                if (next >= HASH_BITS) {
+                    child->collisions.push_back(slot.entry);
+                } else {
+                    child->bitmap = branch_bit(hash_key(slot.entry->key), next);
+                    child->slots.push_back(Slot());
+                    child->slots[0].entry = slot.entry;
+                }
+                slot.entry.reset();
+                slot.child = child;
+            }
+            link = &slot.child;
+        }
+    }
+
+    // 按任意顺序访问每个条目：visit(键, 值)
+    template <typename Visitor>
+    void for_each(Visitor visit) const {
+        if (root_) {
+            visit_node(*root_, visit);
+        }
+    }
+
+private:
+    static const size_t BITS = 5;
+    static const size_t HASH_BITS = sizeof(size_t) * 8;
+
+    struct Entry {
+        std::string key;
+        Value value;
+
+        explicit Entry(const std::string& k) : key(k), value() {}
+    };
+
+    struct Node;
+    typedef boost::shared_ptr<Entry> EntryPtr;
+    typedef boost::shared_ptr<Node> NodePtr;
+
+    // 一个分支：子节点，或者（没有子节点时）一个条目
+    struct Slot {
+        NodePtr child;
+        EntryPtr entry;
+    };
+
+    struct Node {
+        boost::uint32_t bitmap;             // 存在的分支
+        std::vector<Slot> slots;            // 按分支序号排列，只含存在的分支
+        std::vector<EntryPtr> collisions;   // 散列值的各位用尽后，完全冲突的条目
+
+        Node() : bitmap(0) {}
+    };
+
+    NodePtr root_;
+    size_t size_;
+
+    static size_t hash_key(const std::string& key) { return std::hash<std::string>()(key); }
+
+    static boost::uint32_t branch_bit(size_t hash, size_t shift) {
+        return boost::uint32_t(1) << ((hash >> shift) & ((1u << BITS) - 1));
+    }
+
+    // 分支在紧凑数组中的位置：位图中低于它的置位数
+    static size_t slot_index(boost::uint32_t bitmap, boost::uint32_t bit) {
+        boost::uint32_t below = bitmap & (bit - 1);
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_popcount(below));
+#else
+        size_t count = 0;
+        while (below != 0) {
+            below &= below - 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    // 只属于本副本的节点（不存在时新建）；引用计数大于1说明还有其他副本能看到它，先复制
+    static Node& writable(NodePtr& node) {
+        if (!node) {
+            node.reset(new Node());
+        } else if (node.use_count() > 1) {
+            node.reset(new Node(*node));
+        }
+        return *node;
+    }
+
+    static Entry& writable(EntryPtr& entry) {
+        if (entry.use_count() > 1) {
+            entry.reset(new Entry(*entry));
+        }
+        return *entry;
+    }
+
+    template <typename Visitor>
+    static void visit_node(const Node& node, Visitor& visit) {
+        for (const Slot& slot : node.slots) {
+            if (slot.child) {
+                visit_node(*slot.child, visit);
+            } else {
+                visit(slot.entry->key, slot.entry->value);
+            }
+        }
+        for (const EntryPtr& entry : node.collisions) {
+            visit(entry->key, entry->value);
+        }
+    }
+};
+
+#endif // PERSISTENT_MAP_H
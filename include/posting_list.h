@@ -0,0 +1,261 @@
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+class IndexFileWriter;
+class IndexFileReader;
+
+/**
+ * 内部文档编号：按添加顺序分配的稠密32位整数
+ */
+typedef boost::uint32_t DocId;
+
+/**
+ * 倒排记录：文档编号及词项在该文档中的出现次数
+ */
+struct Posting {
+    DocId doc;                  // 内部文档编号
+    boost::uint32_t tf;         // 词频（标题与正文合计）
+    boost::uint32_t title_tf;   // 其中出现在标题中的次数
+
+    Posting(DocId d, boost::uint32_t f, boost::uint32_t t = 0) : doc(d), tf(f), title_tf(t) {}
+};
+
+/**
+ * 压缩倒排列表
+ *
+ * 存储结构：
+ * 1. 块模式：每128条记录组成一个完整块，文档编号差值、词频与标题词频按位打包
+ *    （四路交错的纵向布局，可用SSE2一次解码4个整数）；
+ *    不足一块的尾部记录使用变长字节编码，可以继续追加。
+ * 2. 位图模式：对极高频词项（如常见汉字的n-gram）使用文档位图，
+ *    词频与标题词频以固定位宽打包存放。
+ * 调用optimize()时根据两种表示的空间大小为每个词项选择其一。
+ * 每个块（以及整个列表）额外记录最大词频与最短文档长度，
+ * 供查询时计算分数上界、跳过不可能进入前k名的文档。
+ * 文档编号以 doc - prev - 1 的差值存储，词频以 tf - 1 存储。
+ * 可选的位置信息独立存放：每条记录的tf个位置做差值变长字节编码，
+ * 每128条记录（块模式下即每个块）保存一个起始偏移，两种表示共用同一份位置数据。
+ * 从索引文件读取的列表直接引用映射内存中的跳表、数据与位置数组，不做复制；
+ * 只有在被修改（追加或重新优化）时才复制为自有存储。
+ */
+class PostingList
+{
+public:
+    // 完整块包含的记录数
+    static const size_t BLOCK_SIZE = 128;
+
+    // 迭代结束后doc()返回的哨兵值
+    static const DocId END_DOC = 0xFFFFFFFFu;
+
+    enum Representation {
+        BLOCKS,     // 位打包块 + 变长字节尾部
+        BITMAP      // 文档位图 + 定宽词频
+    };
+
+    /**
+     * 倒排列表迭代器 - 按文档编号升序遍历，支持跳转
+     */
+    class Iterator
+    {
+    public:
+        explicit Iterator(const PostingList* list);
+
+        // 当前文档编号，结束时为END_DOC
+        DocId doc() const { return doc_; }
+
+        // 当前文档中的词频
+        boost::uint32_t tf() const;
+
+        // 当前文档标题中的词频
+        boost::uint32_t title_tf() const;
+
+        // 当前文档中词项出现的位置（升序），列表未存储位置时为空
+        void positions(std::vector<boost::uint32_t>& out);
+
+        bool at_end() const { return doc_ == END_DOC; }
+
+        // 移动到下一条记录
+        void next();
+
+        // 跳转到第一个编号不小于target的记录
+        void advance(DocId target);
+
+        // 不解码地定位包含target的块，返回其最大词频、最短文档长度及块内最后一个文档编号
+        // target之后已无记录时返回END_DOC
+        DocId block_bounds(DocId target, boost::uint32_t& max_tf, boost::uint32_t& min_len) const;
+
+    private:
+        const PostingList* list_;
+        DocId doc_;
+
+        // 块模式：当前已解码的块
+        size_t block_;                          // 当前块序号（等于块数时表示尾部）
+        size_t pos_;                            // 块内位置
+        size_t count_;                          // 块内记录数
+        boost::uint32_t docs_[BLOCK_SIZE];
+        boost::uint32_t tfs_[BLOCK_SIZE];
+        boost::uint32_t title_tfs_[BLOCK_SIZE];
+
+        // 位图模式：当前所在的位图字及其之前的记录总数
+        size_t word_;
+        size_t word_rank_;
+
+        // 位置数据游标：第pos_rank_条记录的位置数据从pos_offset_开始
+        size_t pos_rank_;
+        size_t pos_offset_;
+
+        void load_block(size_t block);
+        void seek_bitmap(DocId from);
+        size_t bitmap_rank() const;
+
+        // 当前记录的秩（之前的记录数）
+        size_t rank() const;
+
+        // 与当前记录位于同一采样区间内第rank条记录的词频
+        boost::uint32_t tf_at(size_t rank) const;
+    };
+
+    PostingList();
+
+    // 追加一条记录，doc必须大于已有的最后一个文档编号，doc_len为该文档的词项总数
+    // positions为词项在文档中的tf个升序位置；同一列表要么每条记录都带位置，要么都传空指针
+    void append(DocId doc, boost::uint32_t tf, boost::uint32_t title_tf, boost::uint32_t doc_len,
+                const std::vector<boost::uint32_t>* positions = nullptr);
+
+    // 收缩存储并为该词项选择更紧凑的表示
+    void optimize();
+
+    // 记录条数（即文档频率）
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    Representation representation() const { return representation_; }
+
+    // 是否存储了位置信息
+    bool has_positions() const { return position_bytes() != 0; }
+
+    // 整个列表的最大词频与最短文档长度，用于计算词项分数上界
+    boost::uint32_t max_tf() const { return max_tf_; }
+    boost::uint32_t min_len() const { return min_len_; }
+
+    Iterator iterator() const { return Iterator(this); }
+
+    // 完整解码为倒排记录数组
+    std::vector<Posting> decode() const;
+
+    // 估算占用的内存字节数
+    size_t memory_usage() const;
+
+    // 当前编译是否启用了SIMD解码内核
+    static bool simd_enabled();
+
+    // 写入索引文件
+    void write(IndexFileWriter& writer) const;
+
+    // 从映射的索引文件读取，列表引用映射内存，映射必须在列表销毁前保持有效
+    void read(IndexFileReader& reader);
+
+private:
+    /**
+     * 完整块的跳表信息
+     */
+    struct BlockInfo {
+        DocId last_doc;             // 块内最后一个文档编号
+        boost::uint32_t offset;     // 块数据在data_中的起始偏移
+        boost::uint32_t max_tf;     // 块内最大词频
+        boost::uint32_t min_len;    // 块内最短文档长度
+        boost::uint32_t pos_offset; // 块内第一条记录的位置数据在positions_中的偏移
+    };
+
+    Representation representation_;
+    boost::uint32_t size_;
+    DocId last_doc_;
+
+    // 分数上界统计：整个列表及尚未封存的尾部
+    boost::uint32_t max_tf_;
+    boost::uint32_t min_len_;
+    boost::uint32_t tail_max_tf_;
+    boost::uint32_t tail_min_len_;
+
+    // 块模式：完整块的跳表；data_中依次存放各完整块，尾部变长字节紧随其后
+    // 位图模式：data_中依次存放文档位图、按秩排列的定宽词频与定宽标题词频
+    std::vector<BlockInfo> blocks_;
+    std::vector<boost::uint8_t> data_;
+    boost::uint32_t tail_offset_;
+    boost::uint8_t tf_bits_;
+    boost::uint8_t title_bits_;
+
+    // 位置数据：按记录顺序排列的差值变长字节；块模式下每块的起始偏移记在跳表中，
+    // 位图模式下每128条记录的起始偏移以32位整数存放在data_末尾
+    std::vector<boost::uint8_t> positions_;
+    boost::uint32_t tail_pos_offset_;
+
+    // 映射模式：以上三个数组改为引用索引文件映射内存中的只读数据
+    bool mapped_;
+    const BlockInfo* mapped_blocks_;
+    size_t mapped_block_count_;
+    const boost::uint8_t* mapped_data_;
+    size_t mapped_data_size_;
+    const boost::uint8_t* mapped_positions_;
+    size_t mapped_positions_size_;
+
+    // 跳表、数据与位置数组的只读访问，自有存储与映射模式通用
+    const BlockInfo* blocks() const { return mapped_ ? mapped_blocks_ : blocks_.data(); }
+    size_t block_count() const { return mapped_ ? mapped_block_count_ : blocks_.size(); }
+    const boost::uint8_t* bytes() const { return mapped_ ? mapped_data_ : data_.data(); }
+    size_t byte_count() const { return mapped_ ? mapped_data_size_ : data_.size(); }
+    const boost::uint8_t* position_data() const { return mapped_ ? mapped_positions_ : positions_.data(); }
+    size_t position_bytes() const { return mapped_ ? mapped_positions_size_ : positions_.size(); }
+
+    // 映射模式下复制为自有存储，修改列表之前调用
+    void detach();
+
+    // 检查从索引文件读取的列表结构，不一致时抛出std::runtime_error
+    void validate() const;
+
+    // 将尾部的128条变长记录重新编码为位打包块
+    void seal_tail();
+
+    // 解码尾部变长字节记录
+    size_t decode_tail(boost::uint32_t* docs, boost::uint32_t* tfs, boost::uint32_t* title_tfs) const;
+
+    // 解码第block个完整块
+    void decode_block(size_t block, boost::uint32_t* docs, boost::uint32_t* tfs, boost::uint32_t* title_tfs) const;
+
+    // 从first开始倍增查找第一个last_doc不小于target的完整块，没有时返回块数（即尾部）
+    size_t find_block(size_t first, DocId target) const;
+
+    // 位图模式转换回块模式（用于继续追加）
+    void convert_to_blocks();
+
+    // 位图模式下的位图字数
+    size_t bitmap_words() const { return static_cast<size_t>(last_doc_) / 64 + 1; }
+
+    // 位图模式下读取第index个位图字
+    boost::uint64_t bitmap_word(size_t index) const;
+
+    // 位图模式下定宽词频与定宽标题词频的起始偏移
+    size_t bitmap_tf_offset() const { return bitmap_words() * sizeof(boost::uint64_t); }
+    size_t bitmap_title_offset() const;
+
+    // 位图模式下按秩读取第rank条记录的定宽字段
+    boost::uint32_t bitmap_field(size_t offset, boost::uint8_t bits, size_t rank) const;
+
+    // 位图模式下位置偏移表的起始偏移
+    size_t bitmap_positions_offset() const;
+
+    // 第sample组（每组128条记录）第一条记录的位置数据偏移
+    boost::uint32_t position_offset(size_t sample) const;
+
+    // 位置数据的分组数
+    size_t position_samples() const { return (size_ + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+    friend class Iterator;
+};
+
+#endif // POSTING_LIST_H
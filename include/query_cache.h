@@ -0,0 +1,197 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+/**
+ * 查询缓存统计信息
+ */
+struct CacheStats {
+    boost::uint64_t hits;           // 命中次数
+    boost::uint64_t misses;         // 未命中次数（包括因索引版本变化而失效的条目）
+    boost::uint64_t evictions;      // 因容量不足被淘汰的条目数
+    boost::uint64_t invalidations;  // 因索引版本变化被丢弃的条目数
+    size_t entries;                 // 当前条目数
+    size_t memory_bytes;            // 当前估算占用的字节数
+    size_t capacity_bytes;          // 容量上限
+
+    CacheStats()
+        : hits(0), misses(0), evictions(0), invalidations(0),
+          entries(0), memory_bytes(0), capacity_bytes(0) {}
+
+    // 命中率，没有请求时为0
+    double hit_ratio() const {
+        boost::uint64_t total = hits + misses;
+        return total > 0 ? static_cast<double>(hits) / total : 0.0;
+    }
+};
+
+/**
+ * 查询结果缓存 - 分片、按字节数限容的LRU
+ *
+ * 键为规范化后的查询加结果窗口，值带有写入时的索引版本号；
+ * 读取时版本号与当前索引版本不一致的条目视为未命中并被丢弃，
+ * 因此索引更新只需递增版本号，无需遍历缓存。
+ * 每个分片有独立的互斥锁与容量（总容量平均分配），并发查询只在同一分片上竞争。
+ */
+template <typename Value>
+class QueryCache
+{
+public:
+    // 分片数
+    static const size_t SHARD_COUNT = 16;
+
+    explicit QueryCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {
+        for (size_t i = 0; i < SHARD_COUNT; ++i) {
+            shards_.push_back(boost::shared_ptr<Shard>(new Shard()));
+        }
+    }
+
+    /**
+     * @brief 查找缓存结果
+     * @param key 规范化的查询键
+     * @param epoch 当前索引版本
+     * @param value 输出：命中时的缓存值
+     * @return 命中且版本一致时返回true
+     */
+    bool get(const std::string& key, boost::uint64_t epoch, Value& value) {
+        Shard& shard = shard_for(key);
+        boost::lock_guard<boost::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            shard.stats.misses++;
+            return false;
+        }
+        if (it->second->epoch != epoch) {
+            shard.stats.misses++;
+            shard.stats.invalidations++;
+            remove(shard, it->second);
+            return false;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        shard.stats.hits++;
+        value = it->second->value;
+        return true;
+    }
+
+    /**
+     * @brief 写入缓存结果
+     * @param key 规范化的查询键
+     * @param epoch 计算结果时的索引版本
+     * @param value 缓存值
+     * @param bytes 缓存值占用的估算字节数
+     *
+     * 超过单个分片容量的条目不缓存；写入后从LRU尾部淘汰直到不超过分片容量。
+     */
+    void put(const std::string& key, boost::uint64_t epoch, const Value& value, size_t bytes) {
+        Shard& shard = shard_for(key);
+        size_t entry_bytes = bytes + key.size() * 2 + ENTRY_OVERHEAD;
+        size_t shard_capacity = capacity_bytes_ / SHARD_COUNT;
+
+        boost::lock_guard<boost::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            remove(shard, it->second);
+        }
+        if (entry_bytes > shard_capacity) {
+            return;
+        }
+
+        shard.lru.push_front(Entry(key, epoch, value, entry_bytes));
+        shard.index[key] = shard.lru.begin();
+        shard.memory_bytes += entry_bytes;
+        while (shard.memory_bytes > shard_capacity) {
+            remove(shard, --shard.lru.end());
+            shard.stats.evictions++;
+        }
+    }
+
+    /**
+     * @brief 清空所有分片
+     */
+    void clear() {
+        for (size_t i = 0; i < SHARD_COUNT; ++i) {
+            Shard& shard = *shards_[i];
+            boost::lock_guard<boost::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+            shard.memory_bytes = 0;
+        }
+    }
+
+    /**
+     * @brief 汇总各分片的统计信息
+     */
+    CacheStats stats() const {
+        CacheStats total;
+        total.capacity_bytes = capacity_bytes_;
+        for (size_t i = 0; i < SHARD_COUNT; ++i) {
+            const Shard& shard = *shards_[i];
+            boost::lock_guard<boost::mutex> lock(shard.mutex);
+            total.hits += shard.stats.hits;
+            total.misses += shard.stats.misses;
+            total.evictions += shard.stats.evictions;
+            total.invalidations += shard.stats.invalidations;
+            total.entries += shard.lru.size();
+            total.memory_bytes += shard.memory_bytes;
+        }
+        return total;
+    }
+
+    size_t capacity_bytes() const { return capacity_bytes_; }
+
+private:
+    // 每个条目除键与值以外的估算开销（链表节点、哈希表节点与簿记字段）
+    static const size_t ENTRY_OVERHEAD = 96;
+
+    /**
+     * 缓存条目
+     */
+    struct Entry {
+        std::string key;
+        boost::uint64_t epoch;
+        Value value;
+        size_t bytes;
+
+        Entry(const std::string& k, boost::uint64_t e, const Value& v, size_t b)
+            : key(k), epoch(e), value(v), bytes(b) {}
+    };
+
+    typedef typename std::list<Entry>::iterator EntryIterator;
+
+    /**
+     * 缓存分片：LRU链表（表头最近使用）与键索引
+     */
+    struct Shard {
+        mutable boost::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<std::string, EntryIterator> index;
+        size_t memory_bytes;
+        CacheStats stats;
+
+        Shard() : memory_bytes(0) {}
+    };
+
+    size_t capacity_bytes_;
+    std::vector<boost::shared_ptr<Shard>> shards_;
+
+    Shard& shard_for(const std::string& key) {
+        return *shards_[std::hash<std::string>()(key) % SHARD_COUNT];
+    }
+
+    void remove(Shard& shard, EntryIterator entry) {
+        shard.memory_bytes -= entry->bytes;
+        shard.index.erase(entry->key);
+        shard.lru.erase(entry);
+    }
+};
+
+#endif // QUERY_CACHE_H
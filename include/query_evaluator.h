@@ -0,0 +1,80 @@
+#ifndef QUERY_EVALUATOR_H
+#define QUERY_EVALUATOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <boost/shared_ptr.hpp>
+#include "posting_list.h"
+#include "query_parser.h"
+#include "ranking.h"
+#include "top_k_evaluator.h"
+
+/**
+ * 文档迭代器 - 按文档编号升序枚举满足某个匹配条件的文档
+ */
+class DocIterator
+{
+public:
+    virtual ~DocIterator() {}
+
+    // 当前文档编号，结束时为PostingList::END_DOC
+    virtual DocId doc() const = 0;
+
+    // 移动到下一个匹配文档
+    virtual void next() = 0;
+
+    // 跳转到第一个编号不小于target的匹配文档
+    virtual void advance(DocId target) = 0;
+
+    // 估计的匹配文档数，规划器据此决定求交顺序
+    virtual size_t cost() const = 0;
+};
+
+typedef boost::shared_ptr<DocIterator> DocIteratorPtr;
+
+/**
+ * 结构化查询求值器
+ *
+ * 先把语法树规划为文档迭代器树：
+ * - 查询词与短语是其索引词项的交集，MUST子句求交，SHOULD子句求并，MUST_NOT子句做差；
+ * - 求交时按估计代价（文档频率）从小到大排列，由最稀有的列表领跑，
+ *   其余列表用跳表倍增查找（galloping）跳到领跑文档，代价接近最短列表的长度。
+ * 再对匹配文档按参与打分的词项逐一定位词频并打分，维护大小为k的最小堆。
+ */
+class QueryEvaluator
+{
+public:
+    // 词项 -> 倒排列表，词项不存在时返回空指针
+    typedef std::function<const PostingList*(const std::string&)> PostingLookup;
+
+    QueryEvaluator(const Scorer& scorer, const PostingLookup& lookup, size_t k);
+
+    // 添加一个参与打分的词项，weight为该词在查询中的权重（出现次数乘以IDF）
+    void add_term(const PostingList* postings, double weight);
+
+    // 执行求值，返回按分数降序排列的前k个匹配文档
+    std::vector<ScoredDoc> evaluate(const QueryNode& query, const TopKEvaluator::DocFilter& filter);
+
+private:
+    /**
+     * 打分词项游标
+     */
+    struct ScoringTerm {
+        PostingList::Iterator it;   // 倒排迭代器
+        double weight;              // 词项权重
+
+        ScoringTerm(const PostingList* postings, double w) : it(postings->iterator()), weight(w) {}
+    };
+
+    const Scorer& scorer_;
+    PostingLookup lookup_;
+    size_t k_;
+    std::vector<ScoringTerm> terms_;
+    double max_score_;              // 所有打分词项上界之和
+
+    // 把语法树节点规划为文档迭代器，不可能有匹配时返回空指针
+    DocIteratorPtr plan(const QueryNode& node) const;
+};
+
+#endif // QUERY_EVALUATOR_H
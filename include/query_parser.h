@@ -0,0 +1,118 @@
+#ifndef QUERY_PARSER_H
+#define QUERY_PARSER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "index_field.h"
+#include "text_processor.h"
+
+struct QueryNode;
+typedef boost::shared_ptr<QueryNode> QueryNodePtr;
+
+/**
+ * 布尔子句：子查询及其出现要求
+ */
+struct QueryClause {
+    enum Occur {
+        SHOULD,     // 可选：只影响分数；没有MUST子句时至少命中一个
+        MUST,       // 必须命中（+term、AND两侧）
+        MUST_NOT    // 必须不命中（-term、NOT）
+    };
+
+    Occur occur;
+    QueryNodePtr node;
+
+    QueryClause(Occur o, const QueryNodePtr& n) : occur(o), node(n) {}
+};
+
+/**
+ * 查询语法树节点
+ */
+struct QueryNode {
+    enum Type {
+        TERM,       // 单个查询词，命中需包含其分出的全部索引词项
+        PHRASE,     // 引号括起的短语，命中需包含其全部索引词项，存储了位置时还需相对位置一致
+        BOOLEAN     // 布尔组合
+    };
+
+    Type type;
+    std::string text;                   // 原始文本（TERM/PHRASE）
+    std::vector<std::string> terms;     // 分词并去除停用词后的索引词项（TERM/PHRASE），限定字段时为title:asio形式
+    std::vector<boost::uint32_t> positions; // 各词项相对于第一个词项的位置（PHRASE）
+    std::vector<QueryClause> clauses;   // 子句（BOOLEAN）
+    boost::uint32_t max_edits;          // 允许的最大编辑距离（只含一个词项的TERM），0表示精确匹配
+    double boost;                       // 词项权重的倍数，模糊匹配展开得到的词项小于1
+
+    explicit QueryNode(Type t) : type(t), max_edits(0), boost(1.0) {}
+
+    // 统计参与打分的索引词项及其出现次数（按boost加权），MUST_NOT子句中的词项不参与打分
+    void collect_terms(std::map<std::string, double>& counts) const;
+
+    // 按查询顺序列出每个非排除的查询词或短语中最长的索引词项，用于计算邻近度
+    void collect_key_terms(std::vector<std::string>& keys) const;
+
+    // 是否只是若干可选查询词的并集（与旧的隐式OR查询等价，可直接做动态剪枝）
+    bool is_disjunction() const;
+
+    // 规范化字符串，分词结果与结构相同的查询得到相同的字符串（用于调试与查询缓存的键）
+    std::string to_string() const;
+};
+
+/**
+ * 查询解析器
+ *
+ * 支持的语法：
+ * - 空格分隔的查询词：可选（OR），与旧版本行为一致
+ * - a AND b、a OR b、NOT a：运算符必须大写，AND使两侧子句变为必选
+ * - +a 必须包含，-a 必须不包含
+ * - "a b"：短语，索引存储了位置时要求各词项按查询中的相对位置出现
+ * - a~、a~1、a~2：模糊匹配，允许与a的编辑距离不超过给定值（省略时按词长选择），只对英文单词有效
+ * - title:a、title:"a b"、title:(a b)：只在标题字段中匹配，字段名与其后的单元之间可以有空格
+ * - (...)：分组
+ * 解析是宽松的：多余的右括号与未闭合的括号、引号都会被容忍，不会抛出异常。
+ */
+class QueryParser
+{
+public:
+    QueryParser();
+
+    // 解析查询字符串，总是返回一个BOOLEAN节点
+    QueryNodePtr parse(const std::string& query);
+
+private:
+    /**
+     * 词法单元
+     */
+    struct Token {
+        enum Kind { WORD, PHRASE, LPAREN, RPAREN, AND, OR, NOT, PLUS, MINUS };
+
+        Kind kind;
+        std::string text;
+
+        Token(Kind k, const std::string& t) : kind(k), text(t) {}
+    };
+
+    TextProcessor processor_;
+    std::vector<Token> tokens_;
+    size_t pos_;
+    IndexField field_;      // 当前单元限定的字段
+
+    // 把查询字符串切分为词法单元
+    void lex(const std::string& query);
+
+    // 解析一个子句序列，直到右括号或输入结束
+    QueryNodePtr parse_sequence();
+
+    // 解析一个基本单元：查询词、短语或括号分组，可以带字段限定，无法生成索引词项时返回空指针
+    QueryNodePtr parse_primary();
+
+    // 解析查询词、短语或括号分组（不含字段限定），词项限定在field_中
+    QueryNodePtr parse_unit();
+
+    // 对查询词或短语做与索引相同的文本处理，positions为各词项相对于第一个词项的位置
+    void analyze(const std::string& text, std::vector<std::string>& terms, std::vector<boost::uint32_t>& positions);
+};
+
+#endif // QUERY_PARSER_H
@@ -0,0 +1,194 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include "posting_list.h"
+
+/**
+ * 排序模型配置
+ */
+struct RankingConfig {
+    std::string model;          // 排序模型："tfidf"、"bm25" 或 "bm25f"
+    double k1;                  // BM25/BM25F词频饱和参数
+    double b;                   // BM25长度归一化参数
+    double title_weight;        // BM25F标题字段权重
+    double content_weight;      // BM25F正文字段权重
+    double title_b;             // BM25F标题字段长度归一化参数
+    double content_b;           // BM25F正文字段长度归一化参数
+    double proximity_weight;    // 邻近度加分权重，0表示不加分
+
+    RankingConfig()
+        : model("bm25"), k1(1.2), b(0.75),
+          title_weight(2.0), content_weight(1.0), title_b(0.5), content_b(0.75),
+          proximity_weight(1.0) {}
+};
+
+/**
+ * 集合统计信息，在提交索引时预先计算
+ */
+struct CollectionStats {
+    size_t doc_count;           // 有效文档数
+    double avg_doc_len;         // 平均文档长度（词项数）
+    double avg_title_len;       // 平均标题长度
+    double avg_content_len;     // 平均正文长度
+
+    CollectionStats() : doc_count(0), avg_doc_len(0.0), avg_title_len(0.0), avg_content_len(0.0) {}
+};
+
+/**
+ * 打分器接口
+ *
+ * 提交索引时调用commit()，按集合统计为每个文档预先计算长度归一化因子；
+ * 查询时`score()`只做常数次算术运算，不再遍历文档的词表。
+ * 查询词权重由调用方预先乘入IDF与查询中的出现次数。
+ * 单次查询需要按另一组集合统计打分时（分布式查询的全局平均长度），用bind()得到现算归一化因子的打分器，
+ * 已提交的打分器保持不变。
+ */
+class Scorer
+{
+public:
+    // 根据配置创建打分器，模型名未知时抛出std::invalid_argument
+    static boost::shared_ptr<Scorer> create(const RankingConfig& config);
+
+    virtual ~Scorer();
+
+    // 复制打分器（包括已计算的归一化因子），用于在新的索引快照中继续追加文档
+    virtual boost::shared_ptr<Scorer> clone() const = 0;
+
+    // 模型名称
+    virtual std::string name() const = 0;
+
+    // 词项的IDF
+    virtual double idf(size_t df, const CollectionStats& stats) const = 0;
+
+    // 按集合统计重新计算所有文档的归一化因子
+    void commit(const CollectionStats& stats,
+                const std::vector<boost::uint32_t>& doc_lengths,
+                const std::vector<boost::uint32_t>& title_lengths);
+
+    // 为新添加的文档追加归一化因子（使用最近一次提交的统计）
+    void add_document(boost::uint32_t doc_len, boost::uint32_t title_len);
+
+    // 按集合统计打分但不预先计算归一化因子，打分时由文档长度现算；
+    // 用于集合统计与提交时不同的单次查询，两个长度数组必须在打分器使用期间保持有效
+    void bind(const CollectionStats& stats,
+              const std::vector<boost::uint32_t>& doc_lengths,
+              const std::vector<boost::uint32_t>& title_lengths);
+
+    // 一个查询词对文档的贡献
+    virtual double score(double weight, boost::uint32_t tf, boost::uint32_t title_tf, DocId doc) const = 0;
+
+    // 由最大词频与最短文档长度得出的贡献上界
+    virtual double upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const = 0;
+
+    const CollectionStats& stats() const { return stats_; }
+
+protected:
+    // 每个文档最多占用的归一化因子个数
+    static const size_t MAX_NORM_WIDTH = 2;
+
+    // norm_width为每个文档占用的归一化因子个数
+    explicit Scorer(size_t norm_width);
+
+    // 计算一个文档的归一化因子
+    virtual void compute_norms(boost::uint32_t doc_len, boost::uint32_t title_len, float* out) const = 0;
+
+    // 文档的归一化因子：预先计算的值，或（绑定了文档长度时）现算后写入scratch的值
+    const float* norms(DocId doc, float* scratch) const {
+        if (!doc_lengths_) {
+            return &norms_[doc * norm_width_];
+        }
+        compute_norms((*doc_lengths_)[doc], (*title_lengths_)[doc], scratch);
+        return scratch;
+    }
+
+    CollectionStats stats_;
+
+private:
+    size_t norm_width_;
+    std::vector<float> norms_;
+
+    // bind()绑定的文档长度，预先计算归一化因子时为空
+    const std::vector<boost::uint32_t>* doc_lengths_;
+    const std::vector<boost::uint32_t>* title_lengths_;
+};
+
+/**
+ * TF-IDF打分：tf / 文档长度 * log(N / df)
+ */
+class TfIdfScorer : public Scorer
+{
+public:
+    TfIdfScorer();
+
+    boost::shared_ptr<Scorer> clone() const;
+    std::string name() const;
+    double idf(size_t df, const CollectionStats& stats) const;
+    double score(double weight, boost::uint32_t tf, boost::uint32_t title_tf, DocId doc) const;
+    double upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const;
+
+protected:
+    void compute_norms(boost::uint32_t doc_len, boost::uint32_t title_len, float* out) const;
+};
+
+/**
+ * BM25打分：idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * len / avg_len))
+ */
+class Bm25Scorer : public Scorer
+{
+public:
+    Bm25Scorer(double k1, double b);
+
+    boost::shared_ptr<Scorer> clone() const;
+    std::string name() const;
+    double idf(size_t df, const CollectionStats& stats) const;
+    double score(double weight, boost::uint32_t tf, boost::uint32_t title_tf, DocId doc) const;
+    double upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const;
+
+protected:
+    void compute_norms(boost::uint32_t doc_len, boost::uint32_t title_len, float* out) const;
+
+private:
+    double k1_;
+    double b_;
+};
+
+/**
+ * BM25F打分：标题与正文分别做长度归一化并加权合并为伪词频，再统一饱和
+ */
+class Bm25fScorer : public Scorer
+{
+public:
+    explicit Bm25fScorer(const RankingConfig& config);
+
+    boost::shared_ptr<Scorer> clone() const;
+    std::string name() const;
+    double idf(size_t df, const CollectionStats& stats) const;
+    double score(double weight, boost::uint32_t tf, boost::uint32_t title_tf, DocId doc) const;
+    double upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const;
+
+protected:
+    void compute_norms(boost::uint32_t doc_len, boost::uint32_t title_len, float* out) const;
+
+private:
+    double k1_;
+    double title_weight_;
+    double content_weight_;
+    double title_b_;
+    double content_b_;
+
+    // 伪词频经k1饱和后的值
+    double saturate(double pseudo_tf) const;
+};
+
+/**
+ * 邻近度：两个查询词在文档中的最近距离d不超过window时为 1 / d^2，否则为0
+ * a、b为两个词项在文档中的升序位置列表
+ */
+double proximity_score(const std::vector<boost::uint32_t>& a, const std::vector<boost::uint32_t>& b,
+                       boost::uint32_t window = 5);
+
+#endif // RANKING_H
@@ -0,0 +1,103 @@
+#ifndef SEARCH_COORDINATOR_H
+#define SEARCH_COORDINATOR_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/shared_ptr.hpp>
+#include "search_engine.h"
+#include "suggester.h"
+
+/**
+ * 一个分片对一次请求的应答
+ */
+struct ShardReply {
+    bool ok;                // 是否在超时之前收到了完整的应答
+    std::string body;       // 响应体
+    std::string error;      // 失败原因
+
+    ShardReply() : ok(false) {}
+};
+
+/**
+ * 分布式查询的协调节点
+ *
+ * 每个分片服务器是一个只索引数据目录中一个分区的进程（--role=shard --partition=i/n），
+ * 协调节点本身不持有索引，查询分三个阶段扇出到各分片（内部协议见ShardProtocol）：
+ * 1. 统计：各分片返回文档数、长度总和与查询词的本地文档频率，相加得到全局统计；
+ * 2. 求值：全局统计随查询发回各分片，各分片按全局IDF与平均长度打分，只返回前k名的文档ID与分数；
+ * 3. 取摘要：归并出全局前k名，只向持有这些文档的分片请求标题与摘要。
+ * 因此分数与把所有分区放在一个进程中建立索引时相同。
+ * 对分片的请求都在服务器的io_context上异步进行，不阻塞其他连接；结果通过回调交给调用方，回调在io_context的线程中执行。
+ * 一次请求的所有阶段共用一个截止时间（timeout_ms毫秒），每个阶段在剩余时间中分得一份：每个阶段并发请求所有分片，
+ * 本阶段截止时仍未应答的分片在本次查询的后续阶段被跳过，其余分片的结果照常返回，并报告不完整。
+ */
+class SearchCoordinator
+{
+public:
+    typedef boost::asio::steady_timer::time_point Deadline;
+    typedef std::function<void(const std::vector<SearchResult>& results,
+                               const std::vector<std::string>& failed_shards)> SearchHandler;
+    typedef std::function<void(const std::vector<Suggestion>& suggestions,
+                               const std::vector<std::string>& failed_shards)> SuggestHandler;
+    typedef std::function<void(const std::pair<std::string, std::string>& document)> DocumentHandler;
+    typedef std::function<void(size_t documents, const std::vector<std::string>& failed_shards)> CountHandler;
+
+    // shards为分片服务器的"主机:端口"列表，格式不对时抛出std::invalid_argument；请求在io_context上异步进行
+    SearchCoordinator(boost::asio::io_context& io_context, const std::vector<std::string>& shards, long timeout_ms);
+
+    // 分布式查询；回调得到结果与本次查询中超时或出错的分片
+    void async_search(const std::string& query, int max_results, const SearchHandler& handler);
+
+    // 合并各分片的补全建议，文档频率相加
+    void async_suggest(const std::string& query, size_t max_results, const SuggestHandler& handler);
+
+    // 向各分片查找文档，回调得到(标题, 正文)，不存在时标题为空
+    void async_get_document(const std::string& doc_id, const DocumentHandler& handler);
+
+    // 所有分片的有效文档数之和
+    void async_document_count(const CountHandler& handler);
+
+    // 分片服务器列表
+    const std::vector<std::string>& shards() const { return shards_; }
+
+private:
+    typedef std::function<void(const std::vector<ShardReply>& replies)> ReplyHandler;
+
+    // 一次分布式查询在各阶段之间传递的状态
+    struct SearchState;
+    typedef boost::shared_ptr<SearchState> SearchStatePtr;
+
+    boost::asio::io_context& io_context_;
+    std::vector<std::string> shards_;
+    std::vector<std::pair<std::string, std::string>> endpoints_;   // (主机, 端口)
+    long timeout_ms_;
+
+    // 从现在起timeout_ms毫秒后的截止时间
+    Deadline request_deadline() const;
+
+    // 整个请求的截止时间为deadline、还剩phases个阶段（含本阶段）时本阶段的截止时间
+    static Deadline phase_deadline(Deadline deadline, int phases);
+
+    // 查询的三个阶段：收到上一阶段的应答后发出下一阶段的请求，最后调用回调
+    void search_statistics(const SearchStatePtr& state, const std::vector<ShardReply>& replies);
+    void search_hits(const SearchStatePtr& state, const std::vector<ShardReply>& replies);
+    void search_fetched(const SearchStatePtr& state, const std::vector<ShardReply>& replies);
+
+    // 并发向各分片发送GET请求，paths[i]为空的分片不发送；全部应答或截止时间到达后以各分片的应答调用handler
+    void fan_out(const std::vector<std::string>& paths, Deadline deadline, const ReplyHandler& handler) const;
+
+    // 向所有分片发送同一请求
+    void broadcast(const std::string& path, Deadline deadline, const ReplyHandler& handler) const;
+
+    // 应答失败时记录该分片，返回应答是否成功
+    bool check_reply(size_t shard, const ShardReply& reply, std::vector<std::string>& failed_shards) const;
+
+    // 输出失败原因并把分片加入failed_shards（同一分片只记录一次）
+    void mark_failed(size_t shard, const std::string& error, std::vector<std::string>& failed_shards) const;
+};
+
+#endif // SEARCH_COORDINATOR_H
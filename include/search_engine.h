@@ -1,11 +1,27 @@
 #ifndef SEARCH_ENGINE_H
 #define SEARCH_ENGINE_H
 
+#include <map>
 #include <string>
 #include <vector>
-#include <map>
-#include <set>
-#include <boost/thread/shared_mutex.hpp>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "index_segment.h"
+#include "indexer.h"
+#include "posting_list.h"
+#include "ranking.h"
+#include "top_k_evaluator.h"
+#include "query_cache.h"
+#include "snippet.h"
+#include "suggester.h"
+
+struct QueryNode;
+class TextProcessor;
+class ThreadPool;
 
 /**
  * 搜索结果结构体
@@ -15,56 +31,396 @@ struct SearchResult {
     std::string content;    // 文档内容摘要
     std::string url;        // 文档URL或路径
     double score;           // 相关性分数
+    std::vector<Highlight> highlights;  // 摘要中命中查询词的区间（字节偏移）
 
     SearchResult(const std::string& t, const std::string& c, const std::string& u, double s)
         : title(t), content(c), url(u), score(s) {}
 };
 
+/**
+ * 索引选项
+ */
+struct IndexOptions {
+    bool store_positions;   // 是否存储词项位置（短语校验与邻近度加分需要）
+    size_t cache_bytes;     // 查询结果缓存的容量（字节），0表示不缓存
+    size_t build_threads;   // 加载数据文件时的解析线程数，0表示使用硬件线程数
+    bool fuzzy_unknown_terms;   // 索引中不存在的英文查询词是否自动按词长做模糊匹配
+    size_t shards;          // 分片数：建立索引时合并为这么多个段，查询时并行求值，0表示使用硬件线程数
+    size_t partition;       // 分布式部署时只索引数据目录的第partition个分区
+    size_t partitions;      // 数据目录的分区总数，1表示索引整个目录
+    bool verify_index;      // 打开索引文件时是否校验整个正文的校验和（需要读取每一页），否则只校验文件头
+
+    IndexOptions()
+        : store_positions(true), cache_bytes(32 * 1024 * 1024), build_threads(0), fuzzy_unknown_terms(true),
+          shards(0), partition(0), partitions(1), verify_index(false) {}
+};
+
+/**
+ * 查询词的全局统计
+ *
+ * 分布式部署时由协调节点把各分片的本地统计相加得到，再随查询发回各分片，
+ * 使每个分片都按整个集合的文档数、平均长度与文档频率打分。
+ */
+struct TermStatistics {
+    size_t doc_count;                   // 有效文档数
+    boost::uint64_t total_doc_len;      // 有效文档的长度总和
+    boost::uint64_t total_title_len;    // 有效文档的标题长度总和
+    std::map<std::string, size_t> document_frequencies;    // 索引词项 -> 文档频率
+
+    TermStatistics() : doc_count(0), total_doc_len(0), total_title_len(0) {}
+
+    // 累加另一个分片的统计
+    void add(const TermStatistics& other);
+
+    // 文档数与各字段的平均长度
+    CollectionStats collection_stats() const;
+};
+
+/**
+ * 索引规模与内存占用
+ */
+struct IndexSizeStats {
+    boost::uint64_t epoch;      // 统计时的索引版本
+    size_t documents;           // 有效文档数
+    size_t segments;            // 段数（包括缓冲段）
+    size_t vocabulary;          // 默认字段的不同词项数
+    size_t dictionary_bytes;    // 词典占用的字节数
+    size_t posting_bytes;       // 倒排列表占用的字节数
+    size_t bitmap_terms;        // 以位图存储的倒排列表数
+    size_t store_bytes;         // 文档存储压缩后的字节数
+    size_t store_raw_bytes;     // 文档存储压缩前的字节数
+
+    IndexSizeStats()
+        : epoch(0), documents(0), segments(0), vocabulary(0), dictionary_bytes(0), posting_bytes(0),
+          bitmap_terms(0), store_bytes(0), store_raw_bytes(0) {}
+};
+
 /**
  * 搜索引擎核心类
+ *
+ * 索引由若干段组成：新文档写入未封存的缓冲段，缓冲段写满后封存为只读的段，
+ * 后台线程按层级把相邻的小段合并为大段。查询对每个段分别求前k名再合并，
+ * IDF按所有段的文档频率之和计算，因此分段方式不影响分数。
+ *
+ * 索引按分片并行查询：建立索引时所有段合并为若干个大小均衡的段（分片），后台合并也不会把它们合并到一起；
+ * 查询把段分成若干组在线程池上并行求前k名，再合并各组的结果。
+ *
+ * 查询线程读取不可变的索引快照，不需要任何锁：开始查询时原子地取得当前快照的引用，
+ * 查询期间快照不会被修改，也不会被释放。写入线程在锁外完成分词，
+ * 然后在旁边复制出下一个版本（段按指针共享，只复制缓冲段中被修改的倒排列表），
+ * 构建完成后原子地发布。写入线程之间用互斥锁串行化，但从不阻塞查询。
  */
 class SearchEngine
 {
 public:
-    SearchEngine();
+    explicit SearchEngine(const IndexOptions& options = IndexOptions());
     ~SearchEngine();
 
     // 添加文档到索引
     void add_document(const std::string& doc_id, const std::string& title, const std::string& content);
 
+    // 批量添加文档，整批只发布一次新快照；已存在的同ID文档被替换，返回被替换的文档数
+    size_t add_documents(const std::vector<Document>& documents);
+
+    // 替换同ID的文档（不存在时直接添加），返回是否替换了已有文档
+    bool update_document(const std::string& doc_id, const std::string& title, const std::string& content);
+
+    // 删除文档，不存在时返回false
+    bool delete_document(const std::string& doc_id);
+
+    // 批量删除文档，整批只发布一次新快照，返回实际删除的文档数
+    size_t delete_documents(const std::vector<std::string>& doc_ids);
+
+    // 在同一个新快照中删除deleted_ids并写入documents（替换同ID文档），返回被替换的文档数，removed为实际删除的文档数
+    size_t apply_changes(const std::vector<Document>& documents, const std::vector<std::string>& deleted_ids,
+                         size_t& removed);
+
     // 执行搜索
     std::vector<SearchResult> search(const std::string& query, int max_results = 10);
 
-    // 构建索引
+    // 批量执行搜索：批内的查询共用一次词典查找并在线程池上并行求值，结果与逐个调用search相同
+    std::vector<std::vector<SearchResult>> search_batch(const std::vector<std::string>& queries, int max_results = 10);
+
+    // 分布式查询的统计阶段：本分片的集合规模与查询中各词项（含模糊展开得到的词项）的文档频率
+    TermStatistics term_statistics(const std::string& query) const;
+
+    // 分布式查询的求值阶段：按全局统计打分，结果只有文档ID与分数，不生成摘要，也不使用查询缓存；不修改索引
+    std::vector<SearchResult> search(const std::string& query, int max_results, const TermStatistics& global) const;
+
+    // 分布式查询的取摘要阶段：按全局统计的查询词权重为指定文档生成标题与摘要（分数为0），不存在的文档被跳过
+    std::vector<SearchResult> fetch(const std::string& query, const std::vector<std::string>& doc_ids,
+                                    const TermStatistics& global) const;
+
+    // 构建索引：封存缓冲段、合并所有段，并在提交时预先计算排序所需的统计信息
     void build_index();
 
-    // 加载数据文件
+    // 切换排序模型，模型名未知时抛出std::invalid_argument
+    void set_ranking(const RankingConfig& config);
+
+    // 加载数据文件：扫描、解析分词与写入索引组成有界流水线，内存占用与语料规模无关
     void load_data_files(const std::string& data_dir);
 
+    // 把当前索引写入索引文件，fingerprint为数据目录的指纹；写入失败时抛出std::runtime_error
+    void save_index(const std::string& path, boost::uint64_t fingerprint);
+
+    // 映射索引文件并替换当前索引；文件不存在、已过期（指纹或索引选项不一致）或损坏时返回false
+    bool load_index(const std::string& path, boost::uint64_t fingerprint);
+
     // 获取文档内容
     std::pair<std::string, std::string> get_document(const std::string& doc_id);
 
+    // 补全正在输入的查询的最后一个词，按文档频率降序
+    std::vector<Suggestion> suggest(const std::string& query, size_t max_results = 10) const;
+
+    // 查询结果缓存的统计信息
+    CacheStats cache_stats() const;
+
+    // 当前索引版本，每次索引或排序模型变化时递增
+    boost::uint64_t epoch() const;
+
+    // 当前有效的文档数
+    size_t document_count() const;
+
+    // 当前的段数（包括缓冲段）
+    size_t segment_count() const;
+
+    // 分片数（查询的最大并行度）
+    size_t shard_count() const { return shards_; }
+
+    // 当前索引的规模与内存占用：各段封存时的统计之和，词汇量取自补全索引，代价只与段数成正比
+    IndexSizeStats index_size() const;
+
 private:
-    // 倒排索引：词项 -> 文档ID集合
-    std::map<std::string, std::set<std::string>> inverted_index_;
+    // 开启邻近度加分时，先取k的若干倍候选再按邻近度重排
+    static const size_t PROXIMITY_RERANK_FACTOR = 4;
+
+    // 缓冲段达到该文档数时封存
+    static const size_t SEGMENT_BUFFER_DOCS = 256;
+
+    // 同一层级的相邻段达到该数目时合并；第n层的段约有 SEGMENT_BUFFER_DOCS * MERGE_FACTOR^n 个有效文档
+    static const size_t MERGE_FACTOR = 4;
+
+    // 已删除文档达到段内文档数的该比例（百分比）时，单独重写该段以回收空间
+    static const size_t COMPACT_DELETED_PERCENT = 20;
+
+    // 流式加载：每个段对应的连续文件数、每个工作线程允许领先（已建好尚未发布）的段数
+    static const size_t INGEST_RANGE_FILES = 1024;
+    static const size_t INGEST_WINDOW_PER_THREAD = 2;
+
+    // 补全索引两次重建之间的最小间隔（毫秒）
+    static const long SUGGEST_REFRESH_MS = 1000;
+
+    // 一个模糊查询词最多展开的词项数，编辑距离小、文档频率高的优先
+    static const size_t FUZZY_EXPANSIONS = 32;
+
+    // 模糊匹配展开的词项每多一次编辑，权重乘以该系数
+    static const double FUZZY_EDIT_PENALTY;
+
+    /**
+     * 快照中的一个段
+     *
+     * 被删除或被同ID后续添加取代的文档只做标记（墓碑），倒排记录与原始文档留在段中，
+     * 查询时跳过，直到合并或压缩重写该段时才真正丢弃。标记与已发布的快照共享，修改前先复制。
+     * 标记删除时同时累计被删除文档所含词项的文档数，查询时的文档频率只需从倒排列表长度中减去。
+     */
+    struct SegmentView {
+        boost::shared_ptr<const IndexSegment> segment;
+        boost::shared_ptr<const Scorer> scorer;             // 段内文档的归一化因子，按局部编号存放
+        boost::shared_ptr<const std::vector<bool>> deleted; // 已删除或已被取代的文档，为空表示没有
+        boost::shared_ptr<const std::vector<DocId>> deleted_docs;   // 同一组文档的局部编号，升序
+        size_t deleted_count;
+        PersistentMap<boost::uint32_t> deleted_frequencies;  // 索引词项（含字段限定） -> 含该词项的已删除文档数
+
+        SegmentView() : deleted_count(0) {}
+
+        // 局部编号是否仍是有效文档
+        bool is_live(DocId doc) const {
+            return !(deleted && doc < deleted->size() && (*deleted)[doc]);
+        }
+
+        size_t live_count() const { return segment->size() - deleted_count; }
+
+        // 把有效文档标记为已删除
+        void mark_deleted(DocId doc);
+
+        // 重新分析已删除的文档，把它含有的词项计入已删除文档数
+        void count_deleted_terms(DocId doc, TextProcessor& processor);
+
+        // 倒排列表中有效文档的数目
+        size_t live_frequency(const std::string& term, const PostingList& postings) const;
+    };
+
+    /**
+     * 索引快照
+     *
+     * 发布之后只读。复制快照只复制段的指针，写入线程只为本次修改涉及的对象创建副本。
+     */
+    struct IndexSnapshot {
+        // 按添加顺序排列的段；最后一个段未封存时即为缓冲段
+        std::vector<SegmentView> segments;
+
+        // 当前有效文档的数量与长度总和，用于得到平均长度
+        size_t doc_count;
+        boost::uint64_t total_doc_len;
+        boost::uint64_t total_title_len;
+
+        // 排序模型，持有最近一次提交的集合统计；各段的打分器由它复制而来
+        boost::shared_ptr<const Scorer> scorer;
+        RankingConfig ranking;
+
+        // 索引版本：任何会改变查询结果的修改都会递增，缓存中版本不一致的结果即失效
+        boost::uint64_t epoch;
+
+        IndexSnapshot() : doc_count(0), total_doc_len(0), total_title_len(0), epoch(0) {}
+
+        // 由当前有效文档得到集合统计
+        CollectionStats collection_stats() const;
+
+        // 词项在所有段中的文档频率之和，不计已删除的文档
+        size_t document_frequency(const std::string& term) const;
+
+        // 列出所有段中与term编辑距离不超过max_edits的词项，按编辑距离升序、文档频率降序取前limit个
+        void fuzzy_terms(const std::string& term, size_t max_edits, size_t limit,
+                         std::vector<std::pair<std::string, size_t>>& out) const;
+
+        // 查找字符串ID当前有效的文档，返回段序号并输出局部编号，不存在时返回段数
+        size_t find_document(const std::string& id, DocId& doc) const;
+
+        // 把有效文档标记为已删除，其长度与词项不再计入集合统计
+        void remove_document(size_t segment, DocId doc, TextProcessor& processor);
+    };
+
+    typedef boost::shared_ptr<const IndexSnapshot> SnapshotPtr;
+
+    /**
+     * 一批查询共用的词项表
+     *
+     * 批量查询先解析并展开批内的所有查询，再对其中出现的每个词项只查一次各段的词典，
+     * 记下它在各段中的倒排列表与所有段的文档频率之和；批内各查询求值时都从这里读取。
+     */
+    struct TermTable {
+        const IndexSnapshot& snapshot;
+        std::unordered_map<std::string, std::vector<const PostingList*>> postings;  // 词项 -> 各段的倒排列表，不存在时为空指针
+        TermStatistics statistics;      // 快照的集合规模与表中各词项的文档频率
+
+        explicit TermTable(const IndexSnapshot& index);
+
+        // 查找词项在各段中的倒排列表并累计文档频率
+        void add(const std::string& term);
+
+        // 词项在第segment个段中的倒排列表；不在表中的词项直接查该段的词典
+        const PostingList* find(size_t segment, const std::string& term) const;
+    };
+
+    // 当前发布的快照，只能通过atomic_load/atomic_store访问
+    SnapshotPtr snapshot_;
+
+    // 串行化写入线程（包括后台合并的提交）；查询线程从不获取
+    boost::mutex write_mutex_;
+
+    // 标记删除时重新分析文档所用的文本处理器，只在持有写入锁时使用
+    boost::shared_ptr<TextProcessor> removal_processor_;
+
+    IndexOptions options_;
+
+    // 分片数，以及并行查询各分片的线程池（只有一个分片时为空）
+    size_t shards_;
+    boost::shared_ptr<ThreadPool> search_pool_;
+
+    // 查询结果缓存：规范化查询与结果窗口 -> 搜索结果
+    QueryCache<std::vector<SearchResult>> cache_;
+
+    // 后台线程（段合并与补全索引刷新）及其唤醒条件
+    boost::thread merge_thread_;
+    boost::mutex merge_mutex_;
+    boost::condition_variable merge_cv_;
+    bool merge_pending_;
+    bool stopping_;
+
+    // 当前发布的补全索引，只能通过atomic_load/atomic_store访问；由后台线程按快照版本重建
+    boost::shared_ptr<const Suggester> suggester_;
+
+    // 上次重建补全索引的时间，只由后台线程访问
+    boost::posix_time::ptime suggest_built_;
+
+    // 原子地取得当前快照
+    SnapshotPtr current_snapshot() const;
+
+    // 原子地发布新快照（调用方持有写入锁）
+    void publish(const boost::shared_ptr<IndexSnapshot>& next);
+
+    // 把一个已封存的段追加到索引末尾并发布，段内与已有的同ID文档按添加顺序取代
+    void install_segment(const boost::shared_ptr<IndexSegment>& segment);
+
+    // 按集合统计重新提交排序模型，并为每个段重新计算文档归一化因子
+    static void commit_statistics(IndexSnapshot& snapshot, const boost::shared_ptr<Scorer>& model,
+                                  const CollectionStats& stats);
+
+    // 查询在各段使用的打分器：global为空（或就是快照本身的集合规模）、或平均长度与之一致的段用已提交的打分器，
+    // 否则按全局统计现算归一化因子（只用于本次查询）
+    static std::vector<boost::shared_ptr<const Scorer>> query_scorers(const IndexSnapshot& snapshot,
+                                                                     const TermStatistics* global);
+
+    // 由排序模型复制出段的打分器，按模型的集合统计计算段内文档的归一化因子
+    static boost::shared_ptr<const Scorer> segment_scorer(const Scorer& model, const IndexSegment& segment);
+
+    // 汇总快照中各段的规模与内存占用（不含词汇量）
+    static IndexSizeStats measure_index(const IndexSnapshot& snapshot);
+
+    // 快照中默认字段的不同词项数，需要遍历并排序所有段的词项
+    static size_t count_vocabulary(const IndexSnapshot& snapshot);
+
+    // 输出索引规模、内存占用与排序模型
+    static void report_index(const IndexSnapshot& snapshot);
+
+    // 把语法树中的模糊查询词替换为它在词汇中匹配到的词项（SHOULD组合），词项权重按编辑距离降低；
+    // global不为空时按全局文档频率判断查询词是否存在
+    void expand_fuzzy(const IndexSnapshot& snapshot, QueryNode& node, const TermStatistics* global) const;
+
+    // 查询词的文档频率：global中有该词项时取全局值，否则为本地所有段之和
+    static size_t query_frequency(const IndexSnapshot& snapshot, const std::string& term, const TermStatistics* global);
+
+    // 合并重复的查询词，权重为出现次数乘以IDF
+    static std::map<std::string, double> query_weights(const IndexSnapshot& snapshot, const QueryNode& node,
+                                                       const CollectionStats& stats, const TermStatistics* global);
+
+    // 对解析后的查询求值（展开模糊查询词、在各段求前k名并合并）；with_snippets为false时结果只有文档ID与分数
+    std::vector<SearchResult> evaluate(const IndexSnapshot& snapshot, QueryNode& parsed, int max_results,
+                                       const TermStatistics* global, bool with_snippets) const;
+
+    // 对模糊查询词已展开的查询求值，keys为展开前的查询词；terms不为空时从批量查询的词项表读取倒排列表，
+    // 且各段组在当前线程上串行求值（批内的查询已经并行）
+    std::vector<SearchResult> evaluate_expanded(const IndexSnapshot& snapshot, const QueryNode& parsed,
+                                                const std::vector<std::string>& keys, int max_results,
+                                                const TermStatistics* global, const TermTable* terms,
+                                                bool with_snippets) const;
+
+    // 由段内文档生成搜索结果：标题与正文中查询词最集中的片段
+    static SearchResult make_result(const IndexSnapshot& snapshot, size_t segment, DocId doc, double score,
+                                    const std::map<std::string, double>& weights, const SnippetGenerator& snippets);
+
+    // 按查询词之间的邻近度给一个段内的候选文档加分
+    static void apply_proximity(const SegmentView& view, const std::vector<std::string>& keys,
+                                const std::vector<double>& key_idfs, double weight, std::vector<ScoredDoc>& docs);
 
-    // 文档存储：文档ID -> 文档信息
-    std::map<std::string, std::pair<std::string, std::string>> documents_;
+    // 按层级合并策略选出需要合并的相邻段，不小于shard_docs的段不参与合并；
+    // 没有时选出已删除文档比例过高、需要单独重写的段；都没有时返回false
+    static bool select_merge(const IndexSnapshot& snapshot, size_t shard_docs, size_t& first, size_t& count);
 
-    // 词频统计：文档ID -> (词项 -> 频率)
-    std::map<std::string, std::map<std::string, int>> term_frequency_;
+    // 执行合并并提交；full为true时把所有已封存的段合并为shards_个分片。没有可合并的段、也没有因冲突被放弃的组时返回false
+    bool merge_segments(bool full);
 
-    // 文档频率：词项 -> 包含该词项的文档数量
-    std::map<std::string, int> document_frequency_;
+    // 唤醒后台合并线程
+    void request_merge();
 
-    // 读写锁，支持并发读取
-    mutable boost::shared_mutex mutex_;
+    // 后台线程的主循环
+    void merge_loop();
 
-    // 计算TF-IDF分数
-    double calculate_tfidf(const std::string& term, const std::string& doc_id);
+    // 补全索引的版本是否落后于当前快照
+    bool suggester_stale() const;
 
-    // 计算文档相关性分数
-    double calculate_relevance_score(const std::string& doc_id, const std::vector<std::string>& query_terms);
+    // 补全索引过期且距上次重建已满SUGGEST_REFRESH_MS时重建
+    void refresh_suggester();
 };
 
 #endif // SEARCH_ENGINE_H
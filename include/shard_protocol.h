@@ -0,0 +1,59 @@
+#ifndef SHARD_PROTOCOL_H
+#define SHARD_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include "search_engine.h"
+#include "suggester.h"
+
+/**
+ * 分片服务器与协调节点之间的内部协议
+ *
+ * 请求是普通的HTTP GET，参数经URL编码放在查询字符串中；响应体是纯文本，每行一条记录，
+ * 字段之间用制表符分隔，字段内的反斜杠、制表符与换行符转义为\\、\t、\n、\r。
+ * 分数按17位有效数字输出，协调节点读回的分数与分片上计算的完全相同。
+ * 接口（都在分片服务器上）：
+ *   /internal/stats?q=             第一行为 文档数、长度总和、标题长度总和，之后每行为 词项、文档频率
+ *   /internal/search?q=&k=&stats=  每行为 文档ID、分数；stats为编码后的全局统计
+ *   /internal/fetch?q=&ids=&stats= 每行为 文档ID、标题、摘要、高亮区间（offset:length以逗号分隔）；ids每行一个
+ *   /internal/suggest?q=&k=        每行为 补全文本、文档频率
+ *   /internal/doc?id=              一行：标题、正文；文档不存在时响应体为空
+ * 解析失败时抛出std::runtime_error。
+ */
+class ShardProtocol
+{
+public:
+    // 转义单个字段
+    static std::string escape_field(const std::string& field);
+
+    // 把若干字段转义后连接为一行（包括行尾的换行符）
+    static std::string join_record(const std::vector<std::string>& fields);
+
+    // 把响应体按行切分，每行按制表符切分并反转义；忽略空行
+    static std::vector<std::vector<std::string>> parse_records(const std::string& body);
+
+    // URL编码（查询字符串参数）
+    static std::string url_encode(const std::string& value);
+
+    // 全局统计
+    static std::string encode_statistics(const TermStatistics& statistics);
+    static TermStatistics decode_statistics(const std::string& body);
+
+    // 求值结果：只有文档ID与分数
+    static std::string encode_hits(const std::vector<SearchResult>& hits);
+    static std::vector<SearchResult> decode_hits(const std::string& body);
+
+    // 取摘要结果：文档ID、标题、摘要与高亮区间
+    static std::string encode_results(const std::vector<SearchResult>& results);
+    static std::vector<SearchResult> decode_results(const std::string& body);
+
+    // 补全建议
+    static std::string encode_suggestions(const std::vector<Suggestion>& suggestions);
+    static std::vector<Suggestion> decode_suggestions(const std::string& body);
+
+private:
+    // 字段数不少于count，否则抛出std::runtime_error
+    static void expect_fields(const std::vector<std::string>& record, size_t count);
+};
+
+#endif // SHARD_PROTOCOL_H
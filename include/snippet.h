@@ -0,0 +1,86 @@
+#ifndef SNIPPET_H
+#define SNIPPET_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 摘要中需要高亮的一段文字，偏移与长度均为相对摘要文本的字节数
+ */
+struct Highlight {
+    size_t offset;      // 起始字节偏移
+    size_t length;      // 字节数
+
+    Highlight(size_t o, size_t l) : offset(o), length(l) {}
+};
+
+/**
+ * 与查询相关的摘要
+ */
+struct Snippet {
+    std::string text;                   // 摘要文本（UTF-8，片段之间以"..."连接）
+    std::vector<Highlight> highlights;  // 按偏移升序、互不重叠的高亮区间
+};
+
+/**
+ * 查询相关的摘要生成器
+ *
+ * 按与分词器相同的规则（英文单词、连续汉字的1~4元组合）在正文中查找查询词，
+ * 以滑动窗口选出查询词权重之和最高的片段：同一个词项在窗口内只计一次权重，
+ * 因此覆盖更多不同查询词的窗口优先。一个窗口覆盖不了全部命中的查询词时，
+ * 改为两个半长的片段，第二个片段优先覆盖第一个片段缺少的查询词。
+ * 扫描受每个结果固定的时间预算限制，超时后只使用已找到的命中；
+ * 已知正文中的命中总数时，全部找到即停止扫描。没有任何命中时退回正文开头。
+ */
+class SnippetGenerator
+{
+public:
+    // 摘要的目标长度（字节，不含省略号）
+    static const size_t SNIPPET_BYTES = 180;
+
+    // 每个结果的扫描时间预算（微秒）
+    static const long TIME_BUDGET_MICROS = 2000;
+
+    // weights为查询词项 -> 权重（通常为IDF）
+    explicit SnippetGenerator(const std::map<std::string, double>& weights);
+
+    // 生成摘要；expected_matches为查询词项在正文中出现的总次数，0表示未知
+    Snippet generate(const std::string& content, size_t expected_matches = 0) const;
+
+private:
+    /**
+     * 正文中的一次命中
+     */
+    struct Match {
+        size_t begin;       // 起始字节
+        size_t end;         // 结束字节（不含）
+        size_t term;        // 词项序号
+
+        Match(size_t b, size_t e, size_t t) : begin(b), end(e), term(t) {}
+    };
+
+    /**
+     * 选中的片段：matches中[first, last]范围内的命中
+     */
+    struct Window {
+        size_t first;
+        size_t last;
+        double score;
+
+        Window() : first(0), last(0), score(0.0) {}
+    };
+
+    std::unordered_map<std::string, size_t> terms_;    // 词项 -> 序号
+    std::vector<double> weights_;                       // 序号 -> 权重
+    size_t max_chinese_chars_;                          // 中文词项的最大字数
+
+    // 按正文顺序查找命中，超过时间预算或找到expected_matches个命中时停止
+    void find_matches(const std::string& content, size_t expected_matches, std::vector<Match>& matches) const;
+
+    // 在长度不超过length字节的窗口中选出得分最高的一个，covered中的词项不计分
+    Window best_window(const std::vector<Match>& matches, size_t length, const std::vector<bool>& covered) const;
+};
+
+#endif // SNIPPET_H
@@ -0,0 +1,78 @@
+#ifndef SUGGESTER_H
+#define SUGGESTER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "term_dictionary.h"
+
+/**
+ * 一条补全建议
+ */
+struct Suggestion {
+    std::string text;           // 补全后的文本
+    boost::uint32_t frequency;  // 补全词项的文档频率
+
+    Suggestion(const std::string& t, boost::uint32_t f) : text(t), frequency(f) {}
+};
+
+/**
+ * 输入补全索引
+ *
+ * 在索引词汇上建立按字节分支的前缀树，每个节点预先计算其子树中权重（文档频率）最高的TOP_K个词项，
+ * 查询只需沿前缀走到对应节点并直接返回预计算的结果。
+ * 子树中词项不超过TOP_K个的节点不再展开，查询到这里时用词典的前缀扫描列出这几个词项，
+ * 节点数因此与词汇量/TOP_K成正比，而不是与词汇的总字节数成正比。
+ * 构建完成后只读，可以被多个线程同时查询。
+ */
+class Suggester
+{
+public:
+    // 每个节点预计算的补全数
+    static const size_t TOP_K = 10;
+
+    // 空索引
+    Suggester();
+
+    // 由严格升序、不重复的(词项, 权重)构建；epoch为所依据的索引版本
+    Suggester(const std::vector<std::pair<std::string, boost::uint32_t>>& terms, boost::uint64_t epoch);
+
+    // 按权重降序输出以prefix开头的至多limit（不超过TOP_K）个词项及其权重
+    void complete(const std::string& prefix, size_t limit,
+                  std::vector<std::pair<std::string, boost::uint32_t>>& out) const;
+
+    // 构建时所依据的索引版本
+    boost::uint64_t epoch() const { return epoch_; }
+
+    // 词项数
+    size_t size() const { return dictionary_.size(); }
+
+    // 占用的内存字节数
+    size_t memory_usage() const;
+
+private:
+    /**
+     * 前缀树节点，一个节点的子节点在nodes_中连续存放并按label升序排列
+     */
+    struct Node {
+        boost::uint32_t first_child;    // 第一个子节点的序号
+        boost::uint32_t top_offset;     // 预计算的补全在top_中的起始位置
+        boost::uint16_t child_count;    // 子节点数，0表示未展开
+        boost::uint8_t label;           // 从父节点到该节点的字节
+        boost::uint8_t top_count;       // 预计算的补全数
+
+        Node() : first_child(0), top_offset(0), child_count(0), label(0), top_count(0) {}
+    };
+
+    TermDictionary dictionary_;             // 词汇
+    std::vector<boost::uint32_t> weights_;  // 词项编号 -> 权重
+    std::vector<Node> nodes_;               // 节点0为根
+    std::vector<TermId> top_;               // 各节点预计算的补全，按权重降序
+    boost::uint64_t epoch_;
+
+    // 权重降序、权重相同时词项编号升序
+    bool heavier(TermId a, TermId b) const;
+};
+
+#endif // SUGGESTER_H
@@ -0,0 +1,115 @@
+#ifndef TERM_DICTIONARY_H
+#define TERM_DICTIONARY_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+class IndexFileWriter;
+class IndexFileReader;
+
+typedef boost::uint32_t TermId;
+
+/**
+ * 不可变的词典：词项 -> 词项编号
+ *
+ * 词项按字节序排序后，每BLOCK_TERMS个分为一块做前缀压缩（front coding）：
+ * 块内第一个词项完整存放，其余词项只存与前一个词项的公共前缀长度和剩余后缀，
+ * 长度均为变长字节编码。每块只额外记录一个起始偏移。
+ * 词项编号就是词项在排序中的序号，调用方用它直接索引按编号排列的倒排列表。
+ * 精确查找先在块首词项上二分，再在块内顺序解码；前缀扫描与有序遍历都从某个位置起顺序解码。
+ * 从索引文件读取的词典直接引用映射内存；复制词典只复制指针。
+ */
+class TermDictionary
+{
+public:
+    // 每块的词项数
+    static const size_t BLOCK_TERMS = 16;
+
+    // 查找失败时返回的编号
+    static const TermId NOT_FOUND = 0xFFFFFFFFu;
+
+    /**
+     * 按字节序遍历词项
+     */
+    class Iterator
+    {
+    public:
+        bool at_end() const { return at_end_; }
+        void next();
+
+        TermId id() const { return id_; }
+        const std::string& term() const { return term_; }
+
+    private:
+        friend class TermDictionary;
+
+        const TermDictionary* dictionary_;
+        TermId id_;
+        const boost::uint8_t* pos_;     // 下一个词项的编码位置
+        std::string term_;
+        std::string prefix_;            // 只遍历以prefix_开头的词项
+        bool at_end_;
+
+        Iterator(const TermDictionary* dictionary, TermId id, const std::string& prefix);
+
+        // 解码编号为id_的词项（pos_指向其编码），并检查是否仍在前缀范围内
+        void load();
+    };
+
+    // 空词典
+    TermDictionary();
+
+    // 由严格升序、不重复的词项构建
+    explicit TermDictionary(const std::vector<std::string>& sorted_terms);
+
+    // 词项数
+    size_t size() const { return term_count_; }
+
+    // 精确查找，不存在时返回NOT_FOUND
+    TermId find(const std::string& term) const;
+
+    // 编号为id的词项
+    std::string term(TermId id) const;
+
+    // 从第一个词项开始遍历
+    Iterator iterator() const { return Iterator(this, 0, std::string()); }
+
+    // 遍历以prefix开头的所有词项
+    Iterator prefix_iterator(const std::string& prefix) const;
+
+    // 从第一个不小于key的词项开始遍历
+    Iterator seek(const std::string& key) const;
+
+    // 第一个不小于key的词项的编号，不存在时返回size()
+    TermId lower_bound(const std::string& key) const;
+
+    // 占用的内存字节数（映射的词典只计算映射区域的大小）
+    size_t memory_usage() const;
+
+    // 写入索引文件
+    void write(IndexFileWriter& writer) const;
+
+    // 从映射的索引文件读取并完整校验一遍，映射必须在词典销毁前保持有效；数据不一致时抛出std::runtime_error
+    void read(IndexFileReader& reader);
+
+private:
+    size_t term_count_;
+    const boost::uint8_t* data_;        // 各块的前缀压缩数据
+    size_t data_size_;
+    const boost::uint32_t* blocks_;     // 各块在data_中的起始偏移
+    size_t block_count_;
+
+    // 自己构建的词典的存储（映射的词典为空）
+    boost::shared_ptr<const std::vector<boost::uint8_t>> owned_data_;
+    boost::shared_ptr<const std::vector<boost::uint32_t>> owned_blocks_;
+
+    // 第block块第一个词项的起始地址与长度
+    const boost::uint8_t* block_term(size_t block, size_t& length) const;
+
+    // 最后一个首词项不大于key的块，key小于所有词项时返回0
+    size_t find_block(const std::string& key) const;
+};
+
+#endif // TERM_DICTIONARY_H
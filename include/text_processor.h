@@ -4,8 +4,19 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <boost/cstdint.hpp>
 #include <boost/regex.hpp>
 
+/**
+ * 带位置的词项：位置为词项起始处的词单元序号（每个英文单词或汉字占一个位置）
+ */
+struct PositionedToken {
+    std::string term;           // 词项
+    boost::uint32_t position;   // 起始位置
+
+    PositionedToken(const std::string& t, boost::uint32_t p) : term(t), position(p) {}
+};
+
 /**
  * 文本处理器类 - 负责文本预处理和分词
  */
@@ -20,6 +31,12 @@ public:
     
     // 分词处理
     std::vector<std::string> tokenize(const std::string& text);
+
+    // 分词并记录位置，得到的词项与tokenize()相同，按位置升序排列
+    std::vector<PositionedToken> tokenize_with_positions(const std::string& text);
+
+    // 是否为停用词
+    bool is_stop_word(const std::string& token) const;
     
     // 移除停用词
     std::vector<std::string> remove_stop_words(const std::vector<std::string>& tokens);
@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+ * 工作窃取线程池
+ *
+ * 每个工作线程有自己的任务队列：从池外提交的任务轮流放入各队列，
+ * 任务内部再提交的任务放入当前线程的队列。工作线程从自己队列的尾部取任务，
+ * 自己的队列为空时从其他队列的头部窃取，负载不均时空闲线程会自动分担。
+ */
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // 创建threads个工作线程，0表示使用硬件线程数
+    explicit ThreadPool(size_t threads = 0);
+
+    // 等待已提交的任务全部完成后结束工作线程
+    ~ThreadPool();
+
+    // 提交一个任务
+    void submit(const Task& task);
+
+    // 等待已提交的任务全部完成；有任务抛出异常时重新抛出第一个异常
+    void wait();
+
+    // 并行执行一组任务并只等待这组任务完成，调用线程也参与执行；有任务抛出异常时重新抛出第一个异常
+    void run_all(const std::vector<Task>& tasks);
+
+    // 工作线程数
+    size_t size() const { return queues_.size(); }
+
+private:
+    /**
+     * 一个工作线程的任务队列
+     */
+    struct WorkQueue {
+        boost::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<boost::shared_ptr<WorkQueue>> queues_;
+    boost::thread_group threads_;
+
+    // 保护以下计数与状态
+    boost::mutex mutex_;
+    boost::condition_variable work_cv_;     // 有新任务或需要退出
+    boost::condition_variable idle_cv_;     // 所有任务已完成
+    size_t queued_;                         // 已入队但尚未被取走的任务数
+    size_t unfinished_;                     // 已提交但尚未完成的任务数
+    size_t next_queue_;                     // 池外提交时轮流选择的队列
+    bool stopping_;
+    std::exception_ptr error_;              // 第一个任务异常
+
+    // 工作线程主循环
+    void run(size_t index);
+
+    // 从自己的队列尾部取任务，为空时从其他队列头部窃取
+    bool take(size_t index, Task& task);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,61 @@
+#ifndef TOP_K_EVALUATOR_H
+#define TOP_K_EVALUATOR_H
+
+#include <vector>
+#include <functional>
+#include "posting_list.h"
+#include "ranking.h"
+
+/**
+ * 打分后的文档
+ */
+struct ScoredDoc {
+    DocId doc;              // 内部文档编号
+    double score;           // 相关性分数
+
+    ScoredDoc(DocId d, double s) : doc(d), score(s) {}
+};
+
+/**
+ * 前k名查询求值器 - Block-Max WAND动态剪枝
+ *
+ * 按文档编号同步推进各查询词的倒排迭代器（DAAT），维护大小为k的最小堆。
+ * 每个词项有整个列表的分数上界，每个块有块级上界：
+ * 1. 按当前文档排序后累加词项上界，找到第一个可能超过堆门槛的枢轴文档；
+ * 2. 再用枢轴之前各词项所在块的块级上界复核，不足门槛时整块跳过；
+ * 3. 只有通过两级检查的文档才真正解码词频并打分。
+ * 因此查询代价随k和门槛增长，而不是随倒排列表长度增长。
+ * 分数与上界都由打分器给出，剪枝逻辑与具体的排序模型无关。
+ */
+class TopKEvaluator
+{
+public:
+    // 文档有效性判断，返回false的文档不会进入结果
+    typedef std::function<bool(DocId)> DocFilter;
+
+    TopKEvaluator(const Scorer& scorer, size_t k);
+
+    // 添加一个查询词，weight为该词在查询中的权重（出现次数乘以IDF）
+    void add_term(const PostingList* postings, double weight);
+
+    // 执行求值，返回按分数降序排列的前k个文档（分数均大于0）
+    std::vector<ScoredDoc> evaluate(const DocFilter& filter);
+
+private:
+    /**
+     * 查询词游标
+     */
+    struct TermCursor {
+        PostingList::Iterator it;   // 倒排迭代器
+        double weight;              // 词项权重
+        double max_score;           // 整个列表的分数上界
+
+        TermCursor(const PostingList* postings, double w) : it(postings->iterator()), weight(w), max_score(0.0) {}
+    };
+
+    const Scorer& scorer_;
+    size_t k_;
+    std::vector<TermCursor> cursors_;
+};
+
+#endif // TOP_K_EVALUATOR_H
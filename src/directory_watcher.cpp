@@ -0,0 +1,427 @@
+/**
+ * @file directory_watcher.cpp
+ * @brief 数据目录监视器的实现文件
+ *
+ * inotify只能监视单个目录，因此为每个子目录各建立一个监视，新建或移入的子目录在事件到达时补上。
+ * 事件本身只用来收集变化的路径，提交时再检查文件的当前状态：
+ * 存在且受支持的文件重新解析并替换，不存在的文件删除对应的文档。
+ * 这样同一个文件在一批中的多次写入、先删后建或改名都只按最终状态处理一次。
+ */
+
+#include "directory_watcher.h"
+#include "search_engine.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+const long DirectoryWatcher::MAX_WAIT_FACTOR;
+
+#ifdef __linux__
+
+namespace {
+
+// 目录监视关注的事件：文件写完、新建、移入移出、删除，以及目录自身被删除
+const uint32_t WATCH_MASK =
+    IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_ONLYDIR;
+
+// 没有待提交的路径时poll的超时，用于及时响应stop
+const int IDLE_POLL_MS = 200;
+
+// path是否为dir本身或位于dir之下
+bool under(const std::string& path, const std::string& dir) {
+    return path.compare(0, dir.size(), dir) == 0 &&
+           (path.size() == dir.size() || path[dir.size()] == fs::path::preferred_separator);
+}
+
+} // namespace
+
+/**
+ * @brief 构造监视器并立即监视整个数据目录
+ * @param data_dir 数据目录
+ * @param partition 只处理的分区序号
+ * @param partitions 分区总数
+ * @param debounce_ms 提交前的静默期（毫秒）
+ *
+ * 同时记录分区内每个受支持文件的当前状态，作为已编入索引的基准。
+ */
+DirectoryWatcher::DirectoryWatcher(const std::string& data_dir, size_t partition, size_t partitions,
+                                   long debounce_ms)
+    : data_dir_(data_dir), indexer_(partition, partitions), debounce_ms_(std::max(debounce_ms, 1L)), fd_(-1),
+      engine_(nullptr), stopping_(false) {
+    if (!fs::is_directory(data_dir_)) {
+        std::cerr << "Cannot watch data directory (not a directory): " << data_dir_ << std::endl;
+        return;
+    }
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "inotify_init1 failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    watch_tree(fs::path(data_dir_), false);
+}
+
+/**
+ * @brief 析构函数，停止监视线程并关闭inotify
+ */
+DirectoryWatcher::~DirectoryWatcher() {
+    stop();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+/**
+ * @brief 监视是否已建立
+ * @return inotify可用且数据目录已被监视时返回true
+ */
+bool DirectoryWatcher::valid() const {
+    return fd_ >= 0 && !watch_dirs_.empty();
+}
+
+/**
+ * @brief 启动监视线程
+ * @param engine 接收变化的搜索引擎，须在监视器停止之前一直有效
+ */
+void DirectoryWatcher::start(SearchEngine& engine) {
+    if (!valid() || thread_.joinable()) {
+        return;
+    }
+    engine_ = &engine;
+    stopping_ = false;
+    thread_ = boost::thread(&DirectoryWatcher::run, this);
+    std::cout << "Watching data directory: " << data_dir_ << " (" << watch_dirs_.size()
+              << " directories, debounce " << debounce_ms_ << " ms)" << std::endl;
+}
+
+/**
+ * @brief 停止监视线程，尚未提交的变化被丢弃
+ */
+void DirectoryWatcher::stop() {
+    stopping_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+/**
+ * @brief 检查文件是否应当被编入索引
+ * @param path 文件路径
+ * @param stamp 输出文件的当前状态
+ * @return 文件存在、是普通文件、扩展名受支持且属于本分区时返回true
+ */
+bool DirectoryWatcher::indexable(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || !indexer_.is_supported_file(path)) {
+        return false;
+    }
+    try {
+        if (!indexer_.in_partition(fs::path(path), data_dir_)) {
+            return false;
+        }
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    stamp.size = static_cast<boost::uint64_t>(st.st_size);
+    stamp.mtime_ns = static_cast<boost::int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.inode = static_cast<boost::uint64_t>(st.st_ino);
+    return true;
+}
+
+/**
+ * @brief 监视目录树
+ * @param dir 目录路径，由数据目录逐级拼接而成，与Indexer遍历时得到的路径形式相同
+ * @param enqueue 为true时把状态与已编入索引时不同的文件加入待提交路径，为false时只记录文件状态
+ *
+ * 先建立监视再遍历，遍历期间新建的文件要么被遍历到，要么产生事件，不会遗漏。
+ * 不进入符号链接指向的目录，与Indexer的遍历一致。
+ */
+void DirectoryWatcher::watch_tree(const fs::path& dir, bool enqueue) {
+    std::vector<fs::path> dirs(1, dir);
+    while (!dirs.empty()) {
+        fs::path current = dirs.back();
+        dirs.pop_back();
+
+        int wd = inotify_add_watch(fd_, current.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            // 目录可能在事件到达前已被删除；监视数达到上限时提示调整fs.inotify.max_user_watches
+            if (errno != ENOENT && errno != ENOTDIR) {
+                std::cerr << "Cannot watch directory " << current.string() << ": " << std::strerror(errno)
+                          << std::endl;
+            }
+            continue;
+        }
+        watch_dirs_[wd] = current;
+        dir_watches_[current.string()] = wd;
+
+        boost::system::error_code ec;
+        for (fs::directory_iterator iter(current, ec), end; !ec && iter != end; iter.increment(ec)) {
+            boost::system::error_code status_ec;
+            if (fs::is_directory(iter->symlink_status(status_ec))) {
+                dirs.push_back(iter->path());
+                continue;
+            }
+            std::string path = iter->path().string();
+            FileStamp stamp;
+            if (!indexable(path, stamp)) {
+                continue;
+            }
+            if (!enqueue) {
+                indexed_[path] = stamp;
+                continue;
+            }
+            std::map<std::string, FileStamp>::const_iterator known = indexed_.find(path);
+            if (known == indexed_.end() || !(known->second == stamp)) {
+                this->enqueue(path);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 停止监视一棵已删除或移出的目录树
+ * @param dir 目录路径
+ *
+ * 目录已不在原处，无法再遍历，只能按路径前缀找出其中的子目录监视与已编入索引的文件。
+ */
+void DirectoryWatcher::forget_tree(const std::string& dir) {
+    std::map<std::string, int>::iterator watch = dir_watches_.lower_bound(dir);
+    while (watch != dir_watches_.end() && watch->first.compare(0, dir.size(), dir) == 0) {
+        if (under(watch->first, dir)) {
+            inotify_rm_watch(fd_, watch->second);
+            watch_dirs_.erase(watch->second);
+            dir_watches_.erase(watch++);
+        } else {
+            ++watch;
+        }
+    }
+    std::map<std::string, FileStamp>::const_iterator file = indexed_.lower_bound(dir);
+    for (; file != indexed_.end() && file->first.compare(0, dir.size(), dir) == 0; ++file) {
+        if (under(file->first, dir)) {
+            enqueue(file->first);
+        }
+    }
+}
+
+/**
+ * @brief 事件队列溢出后的全量核对
+ *
+ * 溢出意味着丢失了事件：重新监视整个目录（已监视的目录返回原来的描述符），
+ * 并把所有已编入索引的文件与状态变化的文件加入待提交路径，提交时按当前状态处理。
+ */
+void DirectoryWatcher::resync() {
+    std::cerr << "inotify event queue overflowed, rescanning " << data_dir_ << std::endl;
+    for (const auto& pair : indexed_) {
+        FileStamp stamp;
+        if (!indexable(pair.first, stamp) || !(stamp == pair.second)) {
+            enqueue(pair.first);
+        }
+    }
+    watch_tree(fs::path(data_dir_), true);
+}
+
+/**
+ * @brief 记录一个待提交的路径并刷新静默期
+ * @param path 文件路径
+ */
+void DirectoryWatcher::enqueue(const std::string& path) {
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if (pending_.empty()) {
+        first_event_ = now;
+    }
+    last_event_ = now;
+    pending_.insert(path);
+}
+
+/**
+ * @brief 读取并处理inotify队列中当前的全部事件
+ */
+void DirectoryWatcher::read_events() {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = read(fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno != EAGAIN && errno != EINTR) {
+                std::cerr << "Failed to read inotify events: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                resync();
+                continue;
+            }
+            std::map<int, fs::path>::const_iterator dir = watch_dirs_.find(event->wd);
+            if (dir == watch_dirs_.end()) {
+                continue;
+            }
+
+            // 监视已被移除（目录删除后内核会发送IN_IGNORED）
+            if (event->mask & IN_IGNORED) {
+                std::map<std::string, int>::iterator watch = dir_watches_.find(dir->second.string());
+                if (watch != dir_watches_.end() && watch->second == event->wd) {
+                    dir_watches_.erase(watch);
+                }
+                watch_dirs_.erase(event->wd);
+                continue;
+            }
+            // 子目录的删除由父目录的IN_DELETE处理，只有数据目录本身需要在这里处理
+            if (event->mask & IN_DELETE_SELF) {
+                if (dir->second.string() == fs::path(data_dir_).string()) {
+                    std::cerr << "Data directory removed: " << data_dir_ << std::endl;
+                    forget_tree(dir->second.string());
+                }
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            fs::path path = dir->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_tree(path, true);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    forget_tree(path.string());
+                }
+            } else {
+                enqueue(path.string());
+            }
+        }
+    }
+}
+
+/**
+ * @brief 把待提交的路径整批提交到搜索引擎
+ *
+ * 仍然存在且受支持的文件重新解析，与删除一起通过apply_changes在同一个快照中发布；
+ * 内容为空的文件与删除同样处理，与初次建立索引时跳过空文件一致。
+ * 待提交集合与已索引文件的记录只在提交成功后更新；解析或提交抛出异常时它们保持原样，
+ * 这些路径在下一次提交时重试。
+ */
+void DirectoryWatcher::flush() {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    std::vector<Document> documents;
+    std::vector<std::string> deleted_ids;
+    std::map<std::string, FileStamp> stamps;
+    std::vector<std::string> forgotten;
+
+    for (const std::string& path : pending_) {
+        FileStamp stamp;
+        if (indexable(path, stamp)) {
+            Document document = indexer_.parse_file(path);
+            stamps[path] = stamp;
+            if (document.content.empty()) {
+                deleted_ids.push_back(document.id);
+            } else {
+                documents.push_back(document);
+            }
+        } else if (indexed_.count(path) > 0) {
+            forgotten.push_back(path);
+            deleted_ids.push_back(indexer_.generate_doc_id(path));
+        }
+    }
+
+    size_t changed_paths = pending_.size();
+    size_t removed = 0;
+    size_t replaced = 0;
+    if (!documents.empty() || !deleted_ids.empty()) {
+        replaced = engine_->apply_changes(documents, deleted_ids, removed);
+    }
+
+    for (const auto& entry : stamps) {
+        indexed_[entry.first] = entry.second;
+    }
+    for (const std::string& path : forgotten) {
+        indexed_.erase(path);
+    }
+    pending_.clear();
+    if (documents.empty() && deleted_ids.empty()) {
+        return;
+    }
+
+    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+    std::cout << "Watcher committed " << changed_paths << " changed paths: " << (documents.size() - replaced)
+              << " added, " << replaced << " updated, " << removed << " removed in "
+              << elapsed.total_milliseconds() << " ms" << std::endl;
+}
+
+/**
+ * @brief 监视线程主循环
+ *
+ * 有待提交的路径时，poll的超时取静默期结束与最长推迟时间中较早的一个；
+ * 到期后整批提交。提交失败时记录错误，待提交的路径在一个静默期之后重试，不影响后续的监视。
+ */
+void DirectoryWatcher::run() {
+    boost::posix_time::time_duration debounce = boost::posix_time::milliseconds(debounce_ms_);
+    boost::posix_time::time_duration max_wait = boost::posix_time::milliseconds(debounce_ms_ * MAX_WAIT_FACTOR);
+
+    while (!stopping_) {
+        int timeout = IDLE_POLL_MS;
+        if (!pending_.empty()) {
+            boost::posix_time::ptime due = std::min(last_event_ + debounce, first_event_ + max_wait);
+            boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+            if (now >= due) {
+                try {
+                    flush();
+                }
+                catch (const std::exception& e) {
+                    // 待提交的路径保留下来，一个静默期之后整批重试
+                    std::cerr << "Failed to apply watched changes: " << e.what() << std::endl;
+                    first_event_ = last_event_ = boost::posix_time::microsec_clock::universal_time();
+                }
+                continue;
+            }
+            timeout = static_cast<int>(std::min<long long>(timeout, (due - now).total_milliseconds() + 1));
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "poll on inotify failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (ready > 0) {
+            read_events();
+        }
+    }
+}
+
+#else // __linux__
+
+DirectoryWatcher::DirectoryWatcher(const std::string& data_dir, size_t partition, size_t partitions,
+                                   long debounce_ms)
+    : data_dir_(data_dir), indexer_(partition, partitions), debounce_ms_(debounce_ms), fd_(-1), engine_(nullptr),
+      stopping_(false) {
+    std::cerr << "Watching the data directory is only supported on Linux" << std::endl;
+}
+
+DirectoryWatcher::~DirectoryWatcher() {}
+
+bool DirectoryWatcher::valid() const {
+    return false;
+}
+
+void DirectoryWatcher::start(SearchEngine&) {}
+
+void DirectoryWatcher::stop() {}
+
+#endif // __linux__
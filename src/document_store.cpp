@@ -0,0 +1,293 @@
+/**
+ * @file document_store.cpp
+ * @brief 压缩文档存储的实现文件
+ *
+ * 块内每个文档依次存放ID、标题、正文三个字段的32位长度与内容，
+ * 文档在块内的偏移单独记录，解压后可以直接定位，不需要从块首顺序扫描。
+ */
+
+#include "document_store.h"
+#include "index_file.h"
+#include "lz_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace {
+
+// 每个文档的字段长度头
+const size_t DOCUMENT_HEADER_SIZE = 3 * sizeof(boost::uint32_t);
+
+/**
+ * @brief 把一个文档追加到块的原始数据
+ */
+void append_document(const StoredDocument& document, std::string& raw) {
+    boost::uint32_t lengths[3] = {
+        static_cast<boost::uint32_t>(document.id.size()),
+        static_cast<boost::uint32_t>(document.title.size()),
+        static_cast<boost::uint32_t>(document.content.size())
+    };
+    raw.append(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+    raw.append(document.id);
+    raw.append(document.title);
+    raw.append(document.content);
+}
+
+/**
+ * @brief 从解压后的块中读取offset处的文档
+ */
+boost::shared_ptr<const StoredDocument> parse_document(const std::string& raw, size_t offset) {
+    boost::uint32_t lengths[3];
+    if (offset + DOCUMENT_HEADER_SIZE > raw.size()) {
+        throw std::runtime_error("Document store is corrupted (bad document offset)");
+    }
+    std::memcpy(lengths, raw.data() + offset, sizeof(lengths));
+    size_t begin = offset + DOCUMENT_HEADER_SIZE;
+    if (static_cast<size_t>(lengths[0]) + lengths[1] + lengths[2] > raw.size() - begin) {
+        throw std::runtime_error("Document store is corrupted (bad document length)");
+    }
+    return boost::make_shared<const StoredDocument>(raw.substr(begin, lengths[0]),
+                                                    raw.substr(begin + lengths[0], lengths[1]),
+                                                    raw.substr(begin + lengths[0] + lengths[1], lengths[2]));
+}
+
+/**
+ * @brief 文档在块原始数据中占用的字节数
+ */
+size_t encoded_size(const StoredDocument& document) {
+    return DOCUMENT_HEADER_SIZE + document.id.size() + document.title.size() + document.content.size();
+}
+
+} // namespace
+
+const size_t DocumentStore::BLOCK_BYTES;
+const size_t DocumentStore::CACHE_BLOCKS;
+
+/**
+ * @brief DocumentStore的构造函数，创建空存储
+ */
+DocumentStore::DocumentStore() : tail_bytes_(0) {
+}
+
+/**
+ * @brief 复制存储：压缩块不可变，只复制指针；解压缓存从空开始
+ */
+DocumentStore::DocumentStore(const DocumentStore& other)
+    : blocks_(other.blocks_), owned_(other.owned_), doc_offsets_(other.doc_offsets_),
+      tail_(other.tail_), tail_bytes_(other.tail_bytes_) {
+}
+
+/**
+ * @brief 追加一个文档
+ * @param document 原始文档
+ * @return 文档编号（等于添加前的文档数）
+ *
+ * 尾部的原始数据达到BLOCK_BYTES时压缩为一个块。
+ */
+DocId DocumentStore::add(const boost::shared_ptr<const StoredDocument>& document) {
+    DocId doc = static_cast<DocId>(size());
+    tail_.push_back(document);
+    tail_bytes_ += encoded_size(*document);
+    if (tail_bytes_ >= BLOCK_BYTES) {
+        flush();
+    }
+    return doc;
+}
+
+/**
+ * @brief 把尾部文档压缩为一个块
+ */
+void DocumentStore::flush() {
+    if (tail_.empty()) {
+        return;
+    }
+    std::string raw;
+    raw.reserve(tail_bytes_);
+    Block block;
+    block.first_doc = static_cast<DocId>(doc_offsets_.size());
+    for (const auto& document : tail_) {
+        doc_offsets_.push_back(static_cast<boost::uint32_t>(raw.size()));
+        append_document(*document, raw);
+    }
+
+    boost::shared_ptr<std::string> compressed(new std::string());
+    lz::compress(raw.data(), raw.size(), *compressed);
+    block.data = compressed->data();
+    block.size = static_cast<boost::uint32_t>(compressed->size());
+    block.raw_size = static_cast<boost::uint32_t>(raw.size());
+    blocks_.push_back(block);
+    owned_.push_back(compressed);
+
+    tail_.clear();
+    tail_bytes_ = 0;
+}
+
+/**
+ * @brief 读取一个文档
+ * @param doc 文档编号，必须小于size()
+ * @return 文档内容
+ */
+boost::shared_ptr<const StoredDocument> DocumentStore::get(DocId doc) const {
+    if (doc >= doc_offsets_.size()) {
+        return tail_[doc - doc_offsets_.size()];
+    }
+    size_t block = std::upper_bound(blocks_.begin(), blocks_.end(), doc,
+                                    [](DocId value, const Block& b) { return value < b.first_doc; }) -
+                   blocks_.begin() - 1;
+    return parse_document(*block_data(block), doc_offsets_[doc]);
+}
+
+/**
+ * @brief 压缩块的总字节数
+ */
+size_t DocumentStore::compressed_bytes() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks_) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+/**
+ * @brief 压缩块的原始总字节数
+ */
+size_t DocumentStore::raw_bytes() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks_) {
+        bytes += block.raw_size;
+    }
+    return bytes;
+}
+
+/**
+ * @brief 写入索引文件
+ * @param writer 索引文件写入器
+ *
+ * 依次写入块表（首个文档编号、压缩字节数、原始字节数、数据偏移）、
+ * 文档偏移与压缩数据；尾部文档在这里临时压缩为最后一块，不修改存储本身。
+ */
+void DocumentStore::write(IndexFileWriter& writer) const {
+    std::vector<Block> blocks = blocks_;
+    std::vector<boost::uint32_t> doc_offsets = doc_offsets_;
+    std::string tail_block;
+    if (!tail_.empty()) {
+        std::string raw;
+        Block block;
+        block.first_doc = static_cast<DocId>(doc_offsets.size());
+        for (const auto& document : tail_) {
+            doc_offsets.push_back(static_cast<boost::uint32_t>(raw.size()));
+            append_document(*document, raw);
+        }
+        lz::compress(raw.data(), raw.size(), tail_block);
+        block.data = tail_block.data();
+        block.size = static_cast<boost::uint32_t>(tail_block.size());
+        block.raw_size = static_cast<boost::uint32_t>(raw.size());
+        blocks.push_back(block);
+    }
+
+    writer.write_u32(static_cast<boost::uint32_t>(doc_offsets.size()));
+    writer.write_u32(static_cast<boost::uint32_t>(blocks.size()));
+    boost::uint32_t data_offset = 0;
+    for (const Block& block : blocks) {
+        writer.write_u32(block.first_doc);
+        writer.write_u32(block.size);
+        writer.write_u32(block.raw_size);
+        writer.write_u32(data_offset);
+        data_offset += block.size;
+    }
+    writer.write(doc_offsets.data(), doc_offsets.size() * sizeof(boost::uint32_t));
+    writer.write_u32(data_offset);
+    for (const Block& block : blocks) {
+        writer.write(block.data, block.size);
+    }
+    writer.align(sizeof(boost::uint32_t));
+}
+
+/**
+ * @brief 从映射的索引文件读取
+ * @param reader 位于存储起始处的读取游标
+ *
+ * 压缩数据不做复制，块表与文档偏移在加载时重建；
+ * 块表与数据范围不一致时抛出std::runtime_error。
+ */
+void DocumentStore::read(IndexFileReader& reader) {
+    boost::uint32_t doc_count = reader.read_u32();
+    boost::uint32_t block_count = reader.read_u32();
+    std::vector<Block> blocks(block_count);
+    std::vector<boost::uint32_t> data_offsets(block_count);
+    for (boost::uint32_t i = 0; i < block_count; ++i) {
+        blocks[i].first_doc = reader.read_u32();
+        blocks[i].size = reader.read_u32();
+        blocks[i].raw_size = reader.read_u32();
+        data_offsets[i] = reader.read_u32();
+    }
+    std::vector<boost::uint32_t> doc_offsets(doc_count);
+    if (doc_count > 0) {
+        std::memcpy(&doc_offsets[0], reader.read(doc_count * sizeof(boost::uint32_t)),
+                    doc_count * sizeof(boost::uint32_t));
+    }
+    boost::uint32_t data_size = reader.read_u32();
+    const char* data = reinterpret_cast<const char*>(reader.read(data_size));
+    reader.align(sizeof(boost::uint32_t));
+
+    for (boost::uint32_t i = 0; i < block_count; ++i) {
+        bool ordered = i == 0 ? blocks[i].first_doc == 0 : blocks[i].first_doc > blocks[i - 1].first_doc;
+        if (!ordered || blocks[i].first_doc >= doc_count || data_offsets[i] > data_size ||
+            blocks[i].size > data_size - data_offsets[i]) {
+            throw std::runtime_error("Document store is corrupted (bad block table)");
+        }
+        blocks[i].data = data + data_offsets[i];
+    }
+    if (doc_count > 0 && block_count == 0) {
+        throw std::runtime_error("Document store is corrupted (missing blocks)");
+    }
+
+    blocks_.swap(blocks);
+    doc_offsets_.swap(doc_offsets);
+    owned_.clear();
+    tail_.clear();
+    tail_bytes_ = 0;
+    boost::lock_guard<boost::mutex> lock(cache_mutex_);
+    cache_.clear();
+}
+
+/**
+ * @brief 取得解压后的块
+ * @param block 块序号
+ * @return 解压数据
+ *
+ * 解压在锁外进行；两个线程同时解压同一块时结果相同，只保留其中一份。
+ */
+DocumentStore::BlockData DocumentStore::block_data(size_t block) const {
+    {
+        boost::lock_guard<boost::mutex> lock(cache_mutex_);
+        for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+            if (it->first == block) {
+                cache_.splice(cache_.begin(), cache_, it);
+                return it->second;
+            }
+        }
+    }
+
+    const Block& info = blocks_[block];
+    boost::shared_ptr<std::string> raw(new std::string());
+    if (!lz::decompress(info.data, info.size, info.raw_size, *raw)) {
+        throw std::runtime_error("Document store is corrupted (bad compressed block)");
+    }
+
+    boost::lock_guard<boost::mutex> lock(cache_mutex_);
+    cache_.push_front(std::make_pair(block, BlockData(raw)));
+    for (auto it = std::next(cache_.begin()); it != cache_.end(); ++it) {
+        if (it->first == block) {
+            cache_.erase(it);
+            break;
+        }
+    }
+    if (cache_.size() > CACHE_BLOCKS) {
+        cache_.pop_back();
+    }
+    return raw;
+}
@@ -7,20 +7,25 @@
  */
 
 #include "http_server.h"
+#include "metrics.h"
+#include "search_coordinator.h"
 #include "search_engine.h"
+#include "shard_protocol.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <vector>
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
-// 外部函数声明，用于获取全局的搜索引擎实例
+// 外部函数声明，用于获取全局的搜索引擎实例与协调节点（二者只有一个不为空）
 extern SearchEngine* get_search_engine();
+extern SearchCoordinator* get_search_coordinator();
 
 /**
  * @brief HttpConnection类的实现，处理单个HTTP连接
@@ -40,7 +45,22 @@ HttpConnection::pointer HttpConnection::create(boost::asio::io_context& io_conte
  * @param io_service Boost.Asio的io_service对象
  */
 HttpConnection::HttpConnection(boost::asio::io_context& io_context)
-    : socket_(io_context) {
+    : socket_(io_context), buffer_(max_header_length), batch_next_(0), batch_results_(0), batch_last_(0),
+      batch_started_(0), batch_completed_(0), open_(false), in_flight_(false) {
+}
+
+/**
+ * @brief HttpConnection的析构函数
+ *
+ * 最后一个异步操作结束后连接被释放；出错中断的请求在这里结束，不计入请求耗时。
+ */
+HttpConnection::~HttpConnection() {
+    if (in_flight_) {
+        Metrics::instance().request_finished();
+    }
+    if (open_) {
+        Metrics::instance().connection_closed();
+    }
 }
 
 /**
@@ -55,30 +75,122 @@ tcp::socket& HttpConnection::socket() {
  * @brief 启动异步读取操作，开始处理连接
  */
 void HttpConnection::start() {
-    // 异步从socket读取数据到缓冲区data_
-    socket_.async_read_some(boost::asio::buffer(data_, max_length),
-        boost::bind(&HttpConnection::handle_read, shared_from_this(),
+    open_ = true;
+    Metrics::instance().connection_opened();
+
+    // 异步读取到请求头结束的空行为止
+    boost::asio::async_read_until(socket_, buffer_, "\r\n\r\n",
+        boost::bind(&HttpConnection::handle_read_headers, shared_from_this(),
             boost::asio::placeholders::error,
             boost::asio::placeholders::bytes_transferred));
 }
 
 /**
- * @brief 异步读取完成后的回调函数
+ * @brief 请求头读取完成后的回调函数
+ * @param error 错误码
+ * @param bytes_transferred 请求头（含结尾空行）的字节数
+ *
+ * 缓冲区中请求头之后的字节是请求体的开头；按Content-Length读取剩余的请求体，
+ * 客户端要求时先回复100 Continue。
+ */
+void HttpConnection::handle_read_headers(const boost::system::error_code& error, size_t bytes_transferred) {
+    if (error == boost::asio::error::not_found) {
+        write_response(create_response("Request header too large", "text/plain",
+                                       "431 Request Header Fields Too Large"));
+        return;
+    }
+    if (error) {
+        return;
+    }
+    request_start_ = std::chrono::steady_clock::now();
+    StageTimer parse(Metrics::REQUEST_PARSE);
+
+    std::string buffered(boost::asio::buffers_begin(buffer_.data()), boost::asio::buffers_end(buffer_.data()));
+    buffer_.consume(buffer_.size());
+    headers_ = buffered.substr(0, bytes_transferred);
+
+    size_t content_length = 0;
+    try {
+        std::string length = header_value(headers_, "Content-Length");
+        content_length = length.empty() ? 0 : boost::lexical_cast<size_t>(length);
+    }
+    catch (const boost::bad_lexical_cast&) {
+        write_response(create_response("Invalid Content-Length", "text/plain", "400 Bad Request"));
+        return;
+    }
+    if (content_length > max_body_length) {
+        write_response(create_response("Request body too large", "text/plain", "413 Payload Too Large"));
+        return;
+    }
+
+    body_ = buffered.substr(bytes_transferred, content_length);
+    if (body_.size() == content_length) {
+        parse.stop();
+        dispatch();
+        return;
+    }
+    if (boost::iequals(header_value(headers_, "Expect"), "100-continue")) {
+        boost::system::error_code ignored;
+        boost::asio::write(socket_, boost::asio::buffer(std::string("HTTP/1.1 100 Continue\r\n\r\n")), ignored);
+    }
+    size_t received = body_.size();
+    body_.resize(content_length);
+    boost::asio::async_read(socket_, boost::asio::buffer(&body_[received], content_length - received),
+        boost::bind(&HttpConnection::handle_read_body, shared_from_this(),
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::bytes_transferred));
+}
+
+/**
+ * @brief 请求体读取完成后的回调函数
  * @param error 错误码
  * @param bytes_transferred 传输的字节数
  */
-void HttpConnection::handle_read(const boost::system::error_code& error, size_t bytes_transferred) {
+void HttpConnection::handle_read_body(const boost::system::error_code& error, size_t bytes_transferred) {
+    (void)bytes_transferred;
     if (!error) {
-        // 将读取到的数据转换为字符串请求
-        std::string request(data_, bytes_transferred);
-        // 处理请求并生成响应
-        std::string response = process_request(request);
+        dispatch();
+    }
+}
 
-        // 异步将响应写回socket
-        boost::asio::async_write(socket_, boost::asio::buffer(response),
-            boost::bind(&HttpConnection::handle_write, shared_from_this(),
-                boost::asio::placeholders::error));
+/**
+ * @brief 处理读取完整的请求
+ *
+ * 批量搜索的结果逐窗口流式写回，协调节点请求分片的接口在分片应答后写回，其他请求生成完整的响应后一次写回。
+ */
+void HttpConnection::dispatch() {
+    in_flight_ = true;
+    Metrics::instance().request_started();
+
+    std::istringstream iss(headers_);
+    std::string method, path;
+    iss >> method >> path;
+    if (path.substr(0, path.find('?')) == "/api/search/batch") {
+        std::cout << "收到请求: " << method << " " << path << std::endl;
+        if (method != "POST") {
+            write_response(create_response("{\"error\":\"Batch search requires POST\"}", "application/json",
+                                           "405 Method Not Allowed"));
+            return;
+        }
+        start_batch(path, body_);
+        return;
+    }
+    if (get_search_coordinator() && serve_coordinator(method, path)) {
+        return;
     }
+    write_response(process_request(headers_));
+}
+
+/**
+ * @brief 异步写回完整的响应
+ * @param response HTTP响应字符串
+ */
+void HttpConnection::write_response(const std::string& response) {
+    response_ = response;
+    write_start_ = std::chrono::steady_clock::now();
+    boost::asio::async_write(socket_, boost::asio::buffer(response_),
+        boost::bind(&HttpConnection::handle_write, shared_from_this(),
+            boost::asio::placeholders::error));
 }
 
 /**
@@ -89,6 +201,21 @@ void HttpConnection::handle_write(const boost::system::error_code& error) {
     if (!error) {
         // 写入成功，连接处理完成。可以根据需要关闭或保持连接。
         // 当前实现是短连接，在写入后由客户端或服务器自动关闭。
+        Metrics::instance().record(Metrics::SOCKET_WRITE, write_start_);
+        finish_request();
+    }
+}
+
+/**
+ * @brief 结束正在处理的请求
+ *
+ * 请求耗时从读完请求头开始，到响应的最后一个字节交给内核为止。
+ */
+void HttpConnection::finish_request() {
+    if (in_flight_) {
+        in_flight_ = false;
+        Metrics::instance().record(Metrics::REQUEST, request_start_);
+        Metrics::instance().request_finished();
     }
 }
 
@@ -120,34 +247,65 @@ std::string HttpConnection::process_request(const std::string& request) {
             query = url_decode(query);
             std::cout << "Decoded query: " << query << std::endl;
 
-            // 获取搜索引擎实例并执行搜索
+            // 获取搜索引擎实例并执行搜索（协调节点的查询由serve_coordinator分发到各分片）
             SearchEngine* engine = get_search_engine();
             if (engine) {
+                Metrics::instance().queries_served(1);
                 auto results = engine->search(query, 10); // 最多返回10条结果
-
-                // 构建JSON格式的响应
-                std::ostringstream json;
-                json << "{\"results\":[";
-                for (size_t i = 0; i < results.size(); ++i) {
-                    if (i > 0) json << ",";
-                    // 为每个文档构建一个可访问的URL
-                    std::string doc_url = "/doc/" + results[i].url;
-                    json << "{"
-                         << "\"title\":\"" << escape_json(results[i].title) << "\","
-                         << "\"content\":\"" << escape_json(results[i].content) << "\","
-                         << "\"url\":\"" << escape_json(doc_url) << "\","
-                         << "\"score\":" << results[i].score
-                         << "}";
-                }
-                json << "],\"total\":" << results.size() << "}";
-
-                return create_response(json.str(), "application/json");
+                return create_response(search_json(results, nullptr), "application/json");
             }
         }
         // 如果查询无效，返回错误信息
         return create_response("{\"error\":\"Invalid query\",\"total\":0}", "application/json");
     }
 
+    // 处理输入补全请求：补全查询的最后一个词，按文档频率降序
+    if (path.find("/api/suggest") == 0) {
+        size_t query_pos = path.find("?q=");
+        SearchEngine* engine = get_search_engine();
+        if (query_pos == std::string::npos || !engine) {
+            return create_response("{\"error\":\"Invalid query\",\"total\":0}", "application/json");
+        }
+        std::string query = url_decode(path.substr(query_pos + 3));
+        return create_response(suggestions_json(engine->suggest(query, 8)), "application/json");
+    }
+
+    // 处理统计信息请求：文档数、索引版本与查询缓存状态
+    if (path == "/api/stats") {
+        SearchEngine* engine = get_search_engine();
+        if (!engine) {
+            return create_response("{\"error\":\"Search engine unavailable\"}", "application/json");
+        }
+        CacheStats cache = engine->cache_stats();
+        std::ostringstream json;
+        json << "{"
+             << "\"documents\":" << engine->document_count() << ","
+             << "\"segments\":" << engine->segment_count() << ","
+             << "\"shards\":" << engine->shard_count() << ","
+             << "\"epoch\":" << engine->epoch() << ","
+             << "\"cache\":{"
+             << "\"hits\":" << cache.hits << ","
+             << "\"misses\":" << cache.misses << ","
+             << "\"hit_ratio\":" << cache.hit_ratio() << ","
+             << "\"evictions\":" << cache.evictions << ","
+             << "\"invalidations\":" << cache.invalidations << ","
+             << "\"entries\":" << cache.entries << ","
+             << "\"memory_bytes\":" << cache.memory_bytes << ","
+             << "\"capacity_bytes\":" << cache.capacity_bytes
+             << "}}";
+        return create_response(json.str(), "application/json");
+    }
+
+    // 处理分片服务器的内部接口
+    if (path.find("/internal/") == 0) {
+        return serve_internal(path);
+    }
+
+    // 处理监控系统的指标抓取
+    if (path == "/metrics") {
+        return serve_metrics();
+    }
+
     // 处理文档查看请求，路径以/doc/开头
     if (path.find("/doc/") == 0) {
         std::string doc_id = path.substr(5); // 提取文档ID
@@ -173,15 +331,78 @@ std::string HttpConnection::process_request(const std::string& request) {
     return create_response("<h1>404 Not Found</h1>", "text/html");
 }
 
+/**
+ * @brief 以协调节点角色处理需要请求分片的接口
+ * @param method 请求方法
+ * @param path 请求路径
+ * @return 已开始异步处理时返回true，响应在各分片应答（或截止时间到达）后写回；
+ *         其他请求（包括参数无效的请求）返回false，由process_request处理
+ *
+ * 等待分片应答期间io线程照常处理其他连接。
+ */
+bool HttpConnection::serve_coordinator(const std::string& method, const std::string& path) {
+    SearchCoordinator* coordinator = get_search_coordinator();
+    pointer self = shared_from_this();
+    size_t query_pos = path.find("?q=");
+
+    if (path.find("/api/search") == 0 && query_pos != std::string::npos) {
+        std::cout << "收到请求: " << method << " " << path << std::endl;
+        Metrics::instance().queries_served(1);
+        coordinator->async_search(url_decode(path.substr(query_pos + 3)), 10,
+            [self](const std::vector<SearchResult>& results, const std::vector<std::string>& failed_shards) {
+                self->write_response(self->create_response(self->search_json(results, &failed_shards),
+                                                           "application/json"));
+            });
+        return true;
+    }
+
+    if (path.find("/api/suggest") == 0 && query_pos != std::string::npos) {
+        std::cout << "收到请求: " << method << " " << path << std::endl;
+        coordinator->async_suggest(url_decode(path.substr(query_pos + 3)), 8,
+            [self](const std::vector<Suggestion>& suggestions, const std::vector<std::string>&) {
+                self->write_response(self->create_response(self->suggestions_json(suggestions), "application/json"));
+            });
+        return true;
+    }
+
+    // 协调节点没有本地索引，统计信息只报告各分片的文档数之和与不可用的分片
+    if (path == "/api/stats") {
+        std::cout << "收到请求: " << method << " " << path << std::endl;
+        coordinator->async_document_count(
+            [self, coordinator](size_t documents, const std::vector<std::string>& failed_shards) {
+                std::ostringstream json;
+                json << "{"
+                     << "\"role\":\"coordinator\","
+                     << "\"documents\":" << documents << ","
+                     << "\"shard_servers\":" << coordinator->shards().size() << ","
+                     << "\"failed_shards\":" << self->string_array_json(failed_shards)
+                     << "}";
+                self->write_response(self->create_response(json.str(), "application/json"));
+            });
+        return true;
+    }
+
+    if (path.find("/doc/") == 0) {
+        std::cout << "收到请求: " << method << " " << path << std::endl;
+        coordinator->async_get_document(path.substr(5), [self](const std::pair<std::string, std::string>& doc_info) {
+            self->write_response(self->document_page(doc_info));
+        });
+        return true;
+    }
+    return false;
+}
+
 /**
  * @brief 构建一个完整的HTTP响应
  * @param content 响应体内容
  * @param content_type 响应内容的MIME类型
+ * @param status 状态码与原因短语
  * @return 完整的HTTP响应字符串
  */
-std::string HttpConnection::create_response(const std::string& content, const std::string& content_type) {
+std::string HttpConnection::create_response(const std::string& content, const std::string& content_type,
+                                            const std::string& status) {
     std::ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n"
+    response << "HTTP/1.1 " << status << "\r\n"
              << "Content-Type: " << content_type << "; charset=utf-8\r\n"
              << "Content-Length: " << content.length() << "\r\n"
              << "Access-Control-Allow-Origin: *\r\n" // 允许跨域请求
@@ -277,6 +498,243 @@ std::string HttpConnection::escape_json(const std::string& str) {
     return escaped;
 }
 
+/**
+ * @brief 构建搜索结果列表的JSON数组
+ * @param results 搜索结果
+ * @return 每个结果包含标题、摘要、文档链接、分数与高亮区间
+ */
+std::string HttpConnection::results_json(const std::vector<SearchResult>& results) {
+    StageTimer serialize(Metrics::JSON_SERIALIZE);
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) json << ",";
+        // 为每个文档构建一个可访问的URL
+        std::string doc_url = "/doc/" + results[i].url;
+        json << "{"
+             << "\"title\":\"" << escape_json(results[i].title) << "\","
+             << "\"content\":\"" << escape_json(results[i].content) << "\","
+             << "\"url\":\"" << escape_json(doc_url) << "\","
+             << "\"score\":" << results[i].score << ","
+             << "\"highlights\":[";
+        // 高亮区间为[起始字节, 字节数]，相对content的UTF-8编码
+        for (size_t h = 0; h < results[i].highlights.size(); ++h) {
+            if (h > 0) json << ",";
+            json << "[" << results[i].highlights[h].offset << "," << results[i].highlights[h].length << "]";
+        }
+        json << "]}";
+    }
+    json << "]";
+    return json.str();
+}
+
+/**
+ * @brief 构建搜索接口的JSON对象
+ * @param results 搜索结果
+ * @param failed_shards 协调节点本次查询中超时或出错的分片，本地搜索引擎为空指针
+ * @return 包含结果与结果数；协调节点另外报告partial与failed_shards
+ */
+std::string HttpConnection::search_json(const std::vector<SearchResult>& results,
+                                        const std::vector<std::string>* failed_shards) {
+    std::ostringstream json;
+    json << "{\"results\":" << results_json(results) << ",\"total\":" << results.size();
+    if (failed_shards) {
+        // 有分片超时或出错时结果不完整
+        json << ",\"partial\":" << (failed_shards->empty() ? "false" : "true")
+             << ",\"failed_shards\":" << string_array_json(*failed_shards);
+    }
+    json << "}";
+    return json.str();
+}
+
+/**
+ * @brief 构建补全接口的JSON对象
+ * @param suggestions 补全建议
+ * @return 包含每个建议的文本与文档频率，以及建议数
+ */
+std::string HttpConnection::suggestions_json(const std::vector<Suggestion>& suggestions) {
+    std::ostringstream json;
+    json << "{\"suggestions\":[";
+    for (size_t i = 0; i < suggestions.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{"
+             << "\"text\":\"" << escape_json(suggestions[i].text) << "\","
+             << "\"frequency\":" << suggestions[i].frequency
+             << "}";
+    }
+    json << "],\"total\":" << suggestions.size() << "}";
+    return json.str();
+}
+
+/**
+ * @brief 构建字符串列表的JSON数组
+ * @param values 字符串列表
+ * @return 转义后的JSON数组
+ */
+std::string HttpConnection::string_array_json(const std::vector<std::string>& values) {
+    std::string json = "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) json += ",";
+        json += "\"" + escape_json(values[i]) + "\"";
+    }
+    json += "]";
+    return json;
+}
+
+/**
+ * @brief 开始处理批量搜索请求
+ * @param path 请求路径，可选参数k为每个查询的最大结果数（默认10）
+ * @param body 请求体，每行一个查询，空行被忽略
+ *
+ * 先写出响应头，之后每个窗口的查询一起交给搜索引擎求值（共用词典查找、并行求值），
+ * 结果作为一个分块写出，写完再求值下一个窗口；客户端无需等整批完成即可开始处理结果。
+ */
+void HttpConnection::start_batch(const std::string& path, const std::string& body) {
+    SearchEngine* engine = get_search_engine();
+    SearchCoordinator* coordinator = get_search_coordinator();
+    if (!engine && !coordinator) {
+        write_response(create_response("{\"error\":\"Search engine unavailable\"}", "application/json"));
+        return;
+    }
+
+    batch_results_ = 10;
+    std::string k = query_parameter(path, "k");
+    try {
+        if (!k.empty()) {
+            batch_results_ = boost::lexical_cast<int>(k);
+        }
+    }
+    catch (const boost::bad_lexical_cast&) {
+        batch_results_ = 0;
+    }
+    if (batch_results_ <= 0 || batch_results_ > max_batch_results) {
+        write_response(create_response("{\"error\":\"Invalid k\"}", "application/json", "400 Bad Request"));
+        return;
+    }
+
+    batch_queries_.clear();
+    std::istringstream lines(body);
+    std::string line;
+    while (std::getline(lines, line)) {
+        boost::trim(line);
+        if (!line.empty()) {
+            batch_queries_.push_back(line);
+        }
+    }
+    if (batch_queries_.empty() || batch_queries_.size() > max_batch_queries) {
+        write_response(create_response("{\"error\":\"Invalid batch\",\"total\":0}", "application/json",
+                                       batch_queries_.empty() ? "400 Bad Request" : "413 Payload Too Large"));
+        return;
+    }
+    std::cout << "Batch search request: " << batch_queries_.size() << " queries" << std::endl;
+
+    batch_next_ = 0;
+    write_start_ = std::chrono::steady_clock::now();
+    response_ = "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/x-ndjson; charset=utf-8\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                "Access-Control-Allow-Headers: Content-Type\r\n"
+                "Connection: close\r\n"
+                "\r\n";
+    boost::asio::async_write(socket_, boost::asio::buffer(response_),
+        boost::bind(&HttpConnection::write_batch_window, shared_from_this(),
+            boost::asio::placeholders::error));
+}
+
+/**
+ * @brief 求值下一个窗口并写出
+ * @param error 上一块的写入错误码；客户端断开后不再求值
+ *
+ * 本地搜索引擎一次求值整个窗口；协调节点同时把最多batch_parallelism个查询扇出到各分片，
+ * 一个查询完成后开始下一个，窗口中的查询全部完成后写出。
+ */
+void HttpConnection::write_batch_window(const boost::system::error_code& error) {
+    if (error) {
+        return;
+    }
+    Metrics::instance().record(Metrics::SOCKET_WRITE, write_start_);
+    if (batch_next_ >= batch_queries_.size()) {
+        finish_request();
+        return;
+    }
+
+    batch_last_ = std::min(batch_queries_.size(), batch_next_ + static_cast<size_t>(batch_window));
+    Metrics::instance().queries_served(batch_last_ - batch_next_);
+    if (get_search_coordinator()) {
+        batch_window_results_.assign(batch_last_ - batch_next_, std::vector<SearchResult>());
+        batch_failed_shards_.assign(batch_last_ - batch_next_, std::vector<std::string>());
+        batch_started_ = batch_next_;
+        batch_completed_ = 0;
+        for (size_t i = 0; i < batch_parallelism && batch_started_ < batch_last_; ++i) {
+            start_batch_search();
+        }
+        return;
+    }
+    std::vector<std::string> window(batch_queries_.begin() + batch_next_, batch_queries_.begin() + batch_last_);
+    batch_window_results_ = get_search_engine()->search_batch(window, batch_results_);
+    write_batch_chunk();
+}
+
+/**
+ * @brief 把窗口中下一个尚未开始的查询扇出到各分片
+ *
+ * 回调在io线程中执行，记录结果后开始窗口中的下一个查询，最后一个查询完成后写出整个窗口。
+ */
+void HttpConnection::start_batch_search() {
+    size_t index = batch_started_++;
+    pointer self = shared_from_this();
+    get_search_coordinator()->async_search(batch_queries_[index], batch_results_,
+        [self, index](const std::vector<SearchResult>& results, const std::vector<std::string>& failed_shards) {
+            self->batch_window_results_[index - self->batch_next_] = results;
+            self->batch_failed_shards_[index - self->batch_next_] = failed_shards;
+            if (++self->batch_completed_ == self->batch_window_results_.size()) {
+                self->write_batch_chunk();
+            } else if (self->batch_started_ < self->batch_last_) {
+                self->start_batch_search();
+            }
+        });
+}
+
+/**
+ * @brief 把当前窗口的结果作为一个分块写出
+ *
+ * 每个查询输出一行：{"index":批内序号,"query":查询,"results":[...],"total":结果数}，
+ * 协调节点另外报告"partial"与"failed_shards"。最后一个窗口之后写出结束分块。
+ */
+void HttpConnection::write_batch_chunk() {
+    bool distributed = get_search_coordinator() != nullptr;
+    std::ostringstream lines;
+    for (size_t i = batch_next_; i < batch_last_; ++i) {
+        const std::vector<SearchResult>& results = batch_window_results_[i - batch_next_];
+        lines << "{\"index\":" << i << ","
+              << "\"query\":\"" << escape_json(batch_queries_[i]) << "\","
+              << "\"results\":" << results_json(results) << ","
+              << "\"total\":" << results.size();
+        if (distributed) {
+            const std::vector<std::string>& failed_shards = batch_failed_shards_[i - batch_next_];
+            lines << ",\"partial\":" << (failed_shards.empty() ? "false" : "true")
+                  << ",\"failed_shards\":" << string_array_json(failed_shards);
+        }
+        lines << "}\n";
+    }
+    batch_next_ = batch_last_;
+
+    // 分块传输编码：十六进制长度、数据，最后以长度为0的分块结束
+    std::string chunk = lines.str();
+    std::ostringstream framed;
+    framed << std::hex << chunk.size() << "\r\n" << chunk << "\r\n";
+    if (batch_next_ >= batch_queries_.size()) {
+        framed << "0\r\n\r\n";
+    }
+    response_ = framed.str();
+    write_start_ = std::chrono::steady_clock::now();
+    boost::asio::async_write(socket_, boost::asio::buffer(response_),
+        boost::bind(&HttpConnection::write_batch_window, shared_from_this(),
+            boost::asio::placeholders::error));
+}
+
 /**
  * @brief 根据文档ID提供文档的HTML页面
  * @param doc_id 文档的唯一标识符
@@ -288,8 +746,16 @@ std::string HttpConnection::serve_document(const std::string& doc_id) {
         return create_response("<h1>服务器错误</h1><p>搜索引擎未初始化</p>", "text/html");
     }
 
-    // 从搜索引擎获取文档的标题和内容
-    auto doc_info = engine->get_document(doc_id);
+    // 从搜索引擎获取文档的标题和内容（协调节点由serve_coordinator向各分片查找）
+    return document_page(engine->get_document(doc_id));
+}
+
+/**
+ * @brief 构建显示文档的HTML页面
+ * @param doc_info 文档的(标题, 正文)，标题为空表示文档不存在
+ * @return 文档页面的HTTP响应，文档不存在时为404页面
+ */
+std::string HttpConnection::document_page(const std::pair<std::string, std::string>& doc_info) {
     if (doc_info.first.empty()) {
         return create_response("<h1>404 Not Found</h1><p>文档不存在</p>", "text/html");
     }
@@ -323,6 +789,154 @@ std::string HttpConnection::serve_document(const std::string& doc_id) {
     return create_response(html.str(), "text/html");
 }
 
+/**
+ * @brief 处理分片服务器的内部接口
+ * @param path 请求路径（含查询字符串），接口与响应格式见ShardProtocol
+ * @return 纯文本响应；参数错误时返回400，接口不存在或没有本地索引时返回404
+ */
+std::string HttpConnection::serve_internal(const std::string& path) {
+    SearchEngine* engine = get_search_engine();
+    std::string endpoint = path.substr(0, path.find('?'));
+    if (!engine) {
+        return create_response("No local index", "text/plain", "404 Not Found");
+    }
+
+    std::string body;
+    try {
+        std::string query = query_parameter(path, "q");
+        if (endpoint == "/internal/stats") {
+            body = ShardProtocol::encode_statistics(engine->term_statistics(query));
+        } else if (endpoint == "/internal/search") {
+            Metrics::instance().queries_served(1);
+            int max_results = boost::lexical_cast<int>(query_parameter(path, "k"));
+            TermStatistics global = ShardProtocol::decode_statistics(query_parameter(path, "stats"));
+            body = ShardProtocol::encode_hits(engine->search(query, max_results, global));
+        } else if (endpoint == "/internal/fetch") {
+            TermStatistics global = ShardProtocol::decode_statistics(query_parameter(path, "stats"));
+            std::vector<std::string> doc_ids;
+            std::istringstream ids(query_parameter(path, "ids"));
+            std::string id;
+            while (std::getline(ids, id)) {
+                if (!id.empty()) {
+                    doc_ids.push_back(id);
+                }
+            }
+            body = ShardProtocol::encode_results(engine->fetch(query, doc_ids, global));
+        } else if (endpoint == "/internal/suggest") {
+            size_t max_results = boost::lexical_cast<size_t>(query_parameter(path, "k"));
+            body = ShardProtocol::encode_suggestions(engine->suggest(query, max_results));
+        } else if (endpoint == "/internal/doc") {
+            std::pair<std::string, std::string> document = engine->get_document(query_parameter(path, "id"));
+            if (!document.first.empty()) {
+                std::vector<std::string> record;
+                record.push_back(document.first);
+                record.push_back(document.second);
+                body = ShardProtocol::join_record(record);
+            }
+        } else {
+            return create_response("Unknown endpoint", "text/plain", "404 Not Found");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid internal request " << endpoint << ": " << e.what() << std::endl;
+        return create_response(e.what(), "text/plain", "400 Bad Request");
+    }
+    return create_response(body, "text/plain");
+}
+
+/**
+ * @brief 提供Prometheus文本格式的服务指标
+ * @return 各处理阶段的延迟直方图、请求、连接与查询速率，以及本地索引的规模
+ *
+ * 协调节点没有本地索引，只导出进程级指标与分片服务器数，各分片服务器的索引指标由各自的/metrics导出。
+ */
+std::string HttpConnection::serve_metrics() {
+    std::ostringstream out;
+    Metrics::instance().write(out);
+
+    SearchEngine* engine = get_search_engine();
+    SearchCoordinator* coordinator = get_search_coordinator();
+    if (coordinator) {
+        out << "# HELP bse_coordinator_shard_servers Shard servers queried by this coordinator.\n"
+            << "# TYPE bse_coordinator_shard_servers gauge\n"
+            << "bse_coordinator_shard_servers " << coordinator->shards().size() << "\n";
+    }
+    if (engine) {
+        IndexSizeStats size = engine->index_size();
+        CacheStats cache = engine->cache_stats();
+        out << "# HELP bse_index_documents Live documents in the index.\n"
+            << "# TYPE bse_index_documents gauge\n"
+            << "bse_index_documents " << size.documents << "\n"
+            << "# HELP bse_index_segments Index segments, including the buffer segment.\n"
+            << "# TYPE bse_index_segments gauge\n"
+            << "bse_index_segments " << size.segments << "\n"
+            << "# HELP bse_index_vocabulary_terms Distinct terms in the default field.\n"
+            << "# TYPE bse_index_vocabulary_terms gauge\n"
+            << "bse_index_vocabulary_terms " << size.vocabulary << "\n"
+            << "# HELP bse_index_memory_bytes Memory used by each part of the index.\n"
+            << "# TYPE bse_index_memory_bytes gauge\n"
+            << "bse_index_memory_bytes{component=\"dictionary\"} " << size.dictionary_bytes << "\n"
+            << "bse_index_memory_bytes{component=\"postings\"} " << size.posting_bytes << "\n"
+            << "bse_index_memory_bytes{component=\"store\"} " << size.store_bytes << "\n"
+            << "# HELP bse_index_epoch Index version, incremented on every published change.\n"
+            << "# TYPE bse_index_epoch gauge\n"
+            << "bse_index_epoch " << size.epoch << "\n"
+            << "# HELP bse_index_shards Shards evaluated in parallel per query.\n"
+            << "# TYPE bse_index_shards gauge\n"
+            << "bse_index_shards " << engine->shard_count() << "\n"
+            << "# HELP bse_query_cache_hits_total Query cache hits.\n"
+            << "# TYPE bse_query_cache_hits_total counter\n"
+            << "bse_query_cache_hits_total " << cache.hits << "\n"
+            << "# HELP bse_query_cache_misses_total Query cache misses.\n"
+            << "# TYPE bse_query_cache_misses_total counter\n"
+            << "bse_query_cache_misses_total " << cache.misses << "\n"
+            << "# HELP bse_query_cache_memory_bytes Estimated memory used by cached results.\n"
+            << "# TYPE bse_query_cache_memory_bytes gauge\n"
+            << "bse_query_cache_memory_bytes " << cache.memory_bytes << "\n";
+    }
+    return create_response(out.str(), "text/plain; version=0.0.4");
+}
+
+/**
+ * @brief 取查询字符串中的参数
+ * @param path 请求路径（含查询字符串）
+ * @param name 参数名
+ * @return URL解码后的参数值，不存在时返回空字符串
+ */
+std::string HttpConnection::query_parameter(const std::string& path, const std::string& name) {
+    size_t query_start = path.find('?');
+    while (query_start != std::string::npos) {
+        size_t start = query_start + 1;
+        size_t end = path.find('&', start);
+        std::string pair = path.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == name) {
+            return eq == std::string::npos ? std::string() : url_decode(pair.substr(eq + 1));
+        }
+        query_start = end;
+    }
+    return std::string();
+}
+
+/**
+ * @brief 取请求头中的字段值
+ * @param headers 请求行与请求头
+ * @param name 字段名，不区分大小写
+ * @return 去掉首尾空白的字段值，不存在时返回空字符串
+ */
+std::string HttpConnection::header_value(const std::string& headers, const std::string& name) {
+    std::istringstream lines(headers);
+    std::string line;
+    std::getline(lines, line); // 跳过请求行
+    while (std::getline(lines, line)) {
+        size_t colon = line.find(':');
+        if (colon != std::string::npos && boost::iequals(boost::trim_copy(line.substr(0, colon)), name)) {
+            return boost::trim_copy(line.substr(colon + 1));
+        }
+    }
+    return std::string();
+}
+
 /**
  * @brief 转义字符串中的HTML特殊字符
  * @param str 待转义的原始字符串
@@ -524,7 +1138,7 @@ std::string HttpConnection::simple_gbk_to_utf8(const std::string& gbk_content) {
  * @param io_service Boost.Asio的io_service对象
  * @param port 服务器监听的端口号
  */
-HttpServer::HttpServer(boost::asio::io_context& io_context, short port)
+HttpServer::HttpServer(boost::asio::io_context& io_context, unsigned short port)
     : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)) {
     start_accept(); // 开始接受连接
 }
@@ -0,0 +1,324 @@
+/**
+ * @file index_file.cpp
+ * @brief 索引文件读写的实现文件
+ *
+ * 写入时正文顺序输出并边写边计算校验和，文件头最后回填；
+ * 读取时整个文件以只读方式映射，文件头（以及要求时的正文）校验通过后各模块直接引用映射内存中的数组。
+ */
+
+#include "index_file.h"
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/exceptions.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/**
+ * @brief 固定长度的文件头，按本机字节序原样写入
+ */
+struct FileHeader {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t flags;
+    boost::uint64_t fingerprint;
+    boost::uint64_t body_size;
+    boost::uint64_t checksum;
+    boost::uint64_t header_checksum;    // 以上各字段的校验和
+};
+
+// 校验和的初始值（FNV-1a偏移基数）
+const boost::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+/**
+ * @brief 计算文件头的校验和
+ */
+boost::uint64_t header_checksum(const FileHeader& header) {
+    return fnv1a64(&header, offsetof(FileHeader, header_checksum));
+}
+
+/**
+ * @brief 把文件内容落盘
+ * @param path 文件路径
+ * @return 成功时返回true
+ */
+bool sync_file(const std::string& path) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return synced;
+}
+
+/**
+ * @brief 把目录项的变化（改名）落盘
+ * @param path 目录路径
+ * @return 成功时返回true；Windows的改名由文件系统日志保证，不需要也无法对目录落盘
+ */
+bool sync_directory(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief 计算64位FNV-1a散列
+ * @param data 数据起始地址
+ * @param size 数据字节数
+ * @param seed 之前数据的散列值，可以分段连续计算
+ * @return 散列值
+ */
+boost::uint64_t fnv1a64(const void* data, size_t size, boost::uint64_t seed) {
+    const boost::uint8_t* bytes = static_cast<const boost::uint8_t*>(data);
+    boost::uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief IndexFileWriter的构造函数，创建临时文件并预留文件头
+ * @param path 目标索引文件路径
+ */
+IndexFileWriter::IndexFileWriter(const std::string& path)
+    : path_(path), temp_path_(path + ".tmp"), offset_(0), checksum_(FNV_OFFSET_BASIS), finished_(false) {
+    fs::path parent = fs::path(path).parent_path();
+    if (!parent.empty() && !fs::exists(parent)) {
+        fs::create_directories(parent);
+    }
+    out_.open(temp_path_.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Cannot create index file: " + temp_path_);
+    }
+    char header[index_file::HEADER_SIZE] = {0};
+    out_.write(header, sizeof(header));
+    offset_ = sizeof(header);
+}
+
+/**
+ * @brief IndexFileWriter的析构函数，未完成的临时文件会被删除
+ */
+IndexFileWriter::~IndexFileWriter() {
+    if (!finished_) {
+        out_.close();
+        boost::system::error_code ec;
+        fs::remove(temp_path_, ec);
+    }
+}
+
+/**
+ * @brief 写入一段正文数据
+ */
+void IndexFileWriter::write(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error("Failed to write index file: " + temp_path_);
+    }
+    checksum_ = fnv1a64(data, size, checksum_);
+    offset_ += size;
+}
+
+void IndexFileWriter::write_u8(boost::uint8_t value) {
+    write(&value, sizeof(value));
+}
+
+void IndexFileWriter::write_u32(boost::uint32_t value) {
+    write(&value, sizeof(value));
+}
+
+void IndexFileWriter::write_u64(boost::uint64_t value) {
+    write(&value, sizeof(value));
+}
+
+/**
+ * @brief 写入32位长度与字符串内容
+ */
+void IndexFileWriter::write_string(const std::string& value) {
+    write_u32(static_cast<boost::uint32_t>(value.size()));
+    write(value.data(), value.size());
+}
+
+/**
+ * @brief 填充0直到文件偏移是alignment的整数倍
+ */
+void IndexFileWriter::align(size_t alignment) {
+    static const char zeros[16] = {0};
+    size_t padding = (alignment - offset_ % alignment) % alignment;
+    write(zeros, padding);
+}
+
+/**
+ * @brief 回填文件头并把临时文件替换为目标文件
+ * @param info 文件头中的描述信息
+ *
+ * 临时文件落盘后才改名，改名后再把目录落盘：断电后目标路径要么是旧文件，要么是完整的新文件。
+ */
+void IndexFileWriter::finish(const IndexFileInfo& info) {
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, index_file::MAGIC, sizeof(header.magic));
+    header.version = index_file::VERSION;
+    header.flags = info.flags;
+    header.fingerprint = info.fingerprint;
+    header.body_size = offset_ - index_file::HEADER_SIZE;
+    header.checksum = checksum_;
+    header.header_checksum = header_checksum(header);
+
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Failed to write index file: " + temp_path_);
+    }
+    if (!sync_file(temp_path_)) {
+        throw std::runtime_error("Failed to sync index file: " + temp_path_);
+    }
+
+    fs::rename(temp_path_, path_);
+    finished_ = true;
+    fs::path parent = fs::path(path_).parent_path();
+    std::string directory = parent.empty() ? std::string(".") : parent.string();
+    if (!sync_directory(directory)) {
+        throw std::runtime_error("Failed to sync index directory: " + directory);
+    }
+}
+
+/**
+ * @brief 映射索引文件并校验文件头与正文
+ * @param path 索引文件路径
+ * @param verify_body 是否校验整个正文的校验和；不校验时打开的代价与文件大小无关，
+ *                    只有被访问到的页才会读入内存
+ */
+MappedIndexFile::MappedIndexFile(const std::string& path, bool verify_body) : body_size_(0) {
+    try {
+        file_ = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+        region_ = boost::interprocess::mapped_region(file_, boost::interprocess::read_only);
+    }
+    catch (const boost::interprocess::interprocess_exception& e) {
+        throw std::runtime_error("Cannot map index file " + path + ": " + e.what());
+    }
+
+    if (region_.get_size() < index_file::HEADER_SIZE) {
+        throw std::runtime_error("Index file is truncated: " + path);
+    }
+    FileHeader header;
+    std::memcpy(&header, region_.get_address(), sizeof(header));
+    if (std::memcmp(header.magic, index_file::MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not an index file: " + path);
+    }
+    if (header.version != index_file::VERSION) {
+        throw std::runtime_error("Unsupported index file version " + std::to_string(header.version) + ": " + path);
+    }
+    if (header.header_checksum != header_checksum(header)) {
+        throw std::runtime_error("Index file header checksum mismatch: " + path);
+    }
+    if (header.body_size != region_.get_size() - index_file::HEADER_SIZE) {
+        throw std::runtime_error("Index file is truncated: " + path);
+    }
+
+    body_size_ = static_cast<size_t>(header.body_size);
+    if (verify_body && fnv1a64(body(), body_size_) != header.checksum) {
+        throw std::runtime_error("Index file checksum mismatch: " + path);
+    }
+    info_.flags = header.flags;
+    info_.fingerprint = header.fingerprint;
+}
+
+/**
+ * @brief 正文的起始地址
+ */
+const boost::uint8_t* MappedIndexFile::body() const {
+    return static_cast<const boost::uint8_t*>(region_.get_address()) + index_file::HEADER_SIZE;
+}
+
+/**
+ * @brief IndexFileReader的构造函数
+ * @param body 正文起始地址
+ * @param size 正文字节数
+ */
+IndexFileReader::IndexFileReader(const boost::uint8_t* body, size_t size) : body_(body), size_(size), pos_(0) {
+}
+
+/**
+ * @brief 返回当前位置的size字节并向后移动
+ */
+const boost::uint8_t* IndexFileReader::read(size_t size) {
+    if (size > size_ - pos_) {
+        throw std::runtime_error("Index file is corrupted (unexpected end of data)");
+    }
+    const boost::uint8_t* data = body_ + pos_;
+    pos_ += size;
+    return data;
+}
+
+boost::uint8_t IndexFileReader::read_u8() {
+    return *read(sizeof(boost::uint8_t));
+}
+
+boost::uint32_t IndexFileReader::read_u32() {
+    boost::uint32_t value;
+    std::memcpy(&value, read(sizeof(value)), sizeof(value));
+    return value;
+}
+
+boost::uint64_t IndexFileReader::read_u64() {
+    boost::uint64_t value;
+    std::memcpy(&value, read(sizeof(value)), sizeof(value));
+    return value;
+}
+
+/**
+ * @brief 读取32位长度与字符串内容
+ */
+std::string IndexFileReader::read_string() {
+    boost::uint32_t size = read_u32();
+    const boost::uint8_t* data = read(size);
+    return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+/**
+ * @brief 跳过填充直到文件偏移是alignment的整数倍
+ *
+ * 正文从HEADER_SIZE开始，映射区域按页对齐，因此文件偏移对齐即内存地址对齐。
+ */
+void IndexFileReader::align(size_t alignment) {
+    size_t offset = index_file::HEADER_SIZE + pos_;
+    read((alignment - offset % alignment) % alignment);
+}
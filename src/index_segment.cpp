@@ -0,0 +1,475 @@
+/**
+ * @file index_segment.cpp
+ * @brief 索引段的实现文件
+ *
+ * 段是增量索引的基本单位：写入只追加到缓冲段，封存后的段不再修改，
+ * 合并时按段的先后顺序重新编号并丢弃已被取代的文档。
+ * 各字段的词典与倒排列表互相独立，封存、合并与读写时逐个字段处理。
+ */
+
+#include "index_segment.h"
+#include "index_file.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * @brief IndexSegment的构造函数，创建一个空的未封存段
+ */
+IndexSegment::IndexSegment() : sealed_(false) {
+}
+
+/**
+ * @brief 追加一个文档
+ * @param document 原始文档
+ * @param doc_len 文档长度（词项数）
+ * @param title_len 标题长度
+ * @return 文档在段内的局部编号
+ */
+DocId IndexSegment::add_document(const boost::shared_ptr<const StoredDocument>& document,
+                                 boost::uint32_t doc_len, boost::uint32_t title_len) {
+    DocId doc = store_.add(document);
+    doc_lengths_.push_back(doc_len);
+    title_lengths_.push_back(title_len);
+    ids_[document->id] = doc;
+    sealed_ = false;
+    return doc;
+}
+
+/**
+ * @brief 追加一条倒排记录
+ * @param term 索引词项
+ * @param doc 局部编号，必须是最近添加的文档
+ * @param tf 词频
+ * @param title_tf 标题中的词频
+ * @param positions 升序位置，不存储位置时为空指针
+ *
+ * 词项出现在标题中时，标题中的出现另外写入标题字段：标题在正文之前，
+ * 标题中的位置就是升序位置的前title_tf个，与默认字段中的位置一致，邻近度可以跨字段计算。
+ */
+void IndexSegment::add_posting(const std::string& term, DocId doc, boost::uint32_t tf, boost::uint32_t title_tf,
+                               const std::vector<boost::uint32_t>* positions) {
+    writable_postings(FIELD_DEFAULT, term).append(doc, tf, title_tf, doc_lengths_[doc], positions);
+    if (title_tf == 0) {
+        return;
+    }
+    std::vector<boost::uint32_t> title_positions;
+    if (positions) {
+        title_positions.assign(positions->begin(), positions->begin() + title_tf);
+    }
+    writable_postings(FIELD_TITLE, term).append(doc, title_tf, title_tf, doc_lengths_[doc],
+                                                positions ? &title_positions : nullptr);
+}
+
+/**
+ * @brief 封存段：压缩尾部文档，重建词典并压缩所有倒排列表
+ *
+ * 新词项与词典中的词项归并为新的词典，词项编号随之重新分配。
+ * 仍与已发布副本共享的列表会先被复制，已发布的段不受影响。
+ */
+void IndexSegment::seal() {
+    store_.flush();
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        FieldIndex& index = fields_[f];
+        if (!index.pending.empty()) {
+            std::vector<std::string> terms;
+            std::vector<PostingPtr> postings;
+            sorted_terms(static_cast<IndexField>(f), terms, postings);
+            index.dictionary = TermDictionary(terms);
+            index.postings.swap(postings);
+            index.pending.clear();
+        }
+        for (PostingPtr& postings : index.postings) {
+            if (postings.use_count() > 1) {
+                postings.reset(new PostingList(*postings));
+            }
+            postings->optimize();
+        }
+    }
+    sealed_ = true;
+    footprint_ = measure_footprint();
+}
+
+/**
+ * @brief 合并若干段
+ * @param segments 按添加顺序排列的源段
+ * @param deleted 各源段中需要丢弃的文档，可以为空指针
+ * @param remap 输出：各源段局部编号 -> 合并后的编号，被丢弃的文档为PostingList::END_DOC
+ * @return 已封存的合并段
+ *
+ * 文档按源段顺序重新编号，同一词项的记录因此仍按编号升序追加。
+ */
+boost::shared_ptr<IndexSegment> IndexSegment::merge(const std::vector<const IndexSegment*>& segments,
+                                                    const std::vector<const std::vector<bool>*>& deleted,
+                                                    std::vector<std::vector<DocId>>& remap) {
+    boost::shared_ptr<IndexSegment> merged(new IndexSegment());
+    remap.assign(segments.size(), std::vector<DocId>());
+
+    // 1. 按顺序复制仍然有效的文档
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const IndexSegment& source = *segments[i];
+        remap[i].assign(source.size(), PostingList::END_DOC);
+        for (DocId doc = 0; doc < source.size(); ++doc) {
+            if (deleted[i] && doc < deleted[i]->size() && (*deleted[i])[doc]) {
+                continue;
+            }
+            remap[i][doc] = merged->add_document(source.store_.get(doc), source.doc_lengths_[doc],
+                                                 source.title_lengths_[doc]);
+        }
+    }
+
+    // 2. 逐个字段按源段顺序追加倒排记录
+    std::vector<boost::uint32_t> positions;
+    std::vector<std::string> terms;
+    std::vector<PostingPtr> lists;
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        IndexField field = static_cast<IndexField>(f);
+        for (size_t i = 0; i < segments.size(); ++i) {
+            segments[i]->sorted_terms(field, terms, lists);
+            for (size_t t = 0; t < terms.size(); ++t) {
+                const PostingList& postings = *lists[t];
+                PostingList* target = nullptr;
+                for (PostingList::Iterator it = postings.iterator(); !it.at_end(); it.next()) {
+                    DocId doc = remap[i][it.doc()];
+                    if (doc == PostingList::END_DOC) {
+                        continue;
+                    }
+                    if (!target) {
+                        target = &merged->writable_postings(field, terms[t]);
+                    }
+                    positions.clear();
+                    if (postings.has_positions()) {
+                        it.positions(positions);
+                    }
+                    target->append(doc, it.tf(), it.title_tf(), merged->doc_lengths_[doc],
+                                   postings.has_positions() ? &positions : nullptr);
+                }
+            }
+        }
+    }
+
+    merged->seal();
+    return merged;
+}
+
+/**
+ * @brief 写入索引文件
+ * @param writer 索引文件写入器
+ *
+ * 依次写入文档长度数组、ID表、压缩文档存储，以及每个字段的词典与按词项编号排列的倒排列表。
+ * ID表单独保存，加载时无需解压文档即可重建；未封存段的新词项在写入时并入词典。
+ */
+void IndexSegment::write(IndexFileWriter& writer) const {
+    boost::uint32_t doc_count = static_cast<boost::uint32_t>(store_.size());
+    writer.write_u8(sealed_ ? 1 : 0);
+    writer.write_u32(doc_count);
+    writer.align(sizeof(boost::uint32_t));
+    writer.write(doc_lengths_.data(), doc_count * sizeof(boost::uint32_t));
+    writer.write(title_lengths_.data(), doc_count * sizeof(boost::uint32_t));
+    writer.write_u32(static_cast<boost::uint32_t>(ids_.size()));
+    for (const auto& pair : ids_) {
+        writer.write_string(pair.first);
+        writer.write_u32(pair.second);
+    }
+    writer.align(sizeof(boost::uint32_t));
+    store_.write(writer);
+
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        const FieldIndex& index = fields_[f];
+        if (index.pending.empty()) {
+            index.dictionary.write(writer);
+            for (const PostingPtr& postings : index.postings) {
+                postings->write(writer);
+            }
+            continue;
+        }
+        std::vector<std::string> terms;
+        std::vector<PostingPtr> postings;
+        sorted_terms(static_cast<IndexField>(f), terms, postings);
+        TermDictionary(terms).write(writer);
+        for (const PostingPtr& list : postings) {
+            list->write(writer);
+        }
+    }
+}
+
+/**
+ * @brief 从映射的索引文件读取一个段
+ * @param reader 位于段起始处的读取游标
+ * @param storage 索引文件映射，段持有其引用
+ * @return 读取的段，数据不一致时抛出std::runtime_error
+ *
+ * 词典、倒排列表与压缩文档不做复制；文档长度与ID表在加载时重建为内存结构。
+ */
+boost::shared_ptr<IndexSegment> IndexSegment::load(IndexFileReader& reader,
+                                                   const boost::shared_ptr<const MappedIndexFile>& storage) {
+    boost::shared_ptr<IndexSegment> segment(new IndexSegment());
+    segment->storage_ = storage;
+    bool sealed = reader.read_u8() != 0;
+    boost::uint32_t doc_count = reader.read_u32();
+    reader.align(sizeof(boost::uint32_t));
+    const boost::uint8_t* doc_lengths = reader.read(doc_count * sizeof(boost::uint32_t));
+    const boost::uint8_t* title_lengths = reader.read(doc_count * sizeof(boost::uint32_t));
+    segment->doc_lengths_.resize(doc_count);
+    segment->title_lengths_.resize(doc_count);
+    if (doc_count > 0) {
+        std::memcpy(&segment->doc_lengths_[0], doc_lengths, doc_count * sizeof(boost::uint32_t));
+        std::memcpy(&segment->title_lengths_[0], title_lengths, doc_count * sizeof(boost::uint32_t));
+    }
+
+    boost::uint32_t id_count = reader.read_u32();
+    segment->ids_.reserve(id_count);
+    for (boost::uint32_t i = 0; i < id_count; ++i) {
+        std::string id = reader.read_string();
+        DocId doc = reader.read_u32();
+        if (doc >= doc_count) {
+            throw std::runtime_error("Index segment is corrupted (bad document id)");
+        }
+        segment->ids_[id] = doc;
+    }
+    reader.align(sizeof(boost::uint32_t));
+    segment->store_.read(reader);
+    if (segment->store_.size() != doc_count) {
+        throw std::runtime_error("Index segment is corrupted (document count mismatch)");
+    }
+
+    for (FieldIndex& index : segment->fields_) {
+        index.dictionary.read(reader);
+        index.postings.resize(index.dictionary.size());
+        for (PostingPtr& postings : index.postings) {
+            postings.reset(new PostingList());
+            postings->read(reader);
+        }
+    }
+    segment->sealed_ = sealed;
+    if (sealed) {
+        segment->footprint_ = segment->measure_footprint();
+    }
+    return segment;
+}
+
+/**
+ * @brief 查找词项的倒排列表
+ * @param term 索引词项，或title:asio这样字段限定的词项
+ * @return 倒排列表，词项不在段内时返回空指针
+ */
+const PostingList* IndexSegment::find_postings(const std::string& term) const {
+    if (term.find(':') != std::string::npos) {
+        std::string bare;
+        IndexField field = split_field_term(term, bare);
+        if (field != FIELD_DEFAULT) {
+            return field_postings(field, bare);
+        }
+    }
+    return field_postings(FIELD_DEFAULT, term);
+}
+
+/**
+ * @brief 查找字段中词项的倒排列表
+ * @param field 字段
+ * @param term 不含字段名的索引词项
+ * @return 倒排列表，词项不在该字段中时返回空指针
+ */
+const PostingList* IndexSegment::field_postings(IndexField field, const std::string& term) const {
+    const FieldIndex& index = fields_[field];
+    TermId id = index.dictionary.find(term);
+    if (id != TermDictionary::NOT_FOUND) {
+        return index.postings[id].get();
+    }
+    if (index.pending.empty()) {
+        return nullptr;
+    }
+    const PostingPtr* postings = index.pending.find(term);
+    return postings ? postings->get() : nullptr;
+}
+
+/**
+ * @brief 查找字符串ID在段内最新的局部编号
+ * @param id 字符串ID
+ * @return 局部编号，不存在时返回PostingList::END_DOC
+ */
+DocId IndexSegment::find_document(const std::string& id) const {
+    auto it = ids_.find(id);
+    return it != ids_.end() ? it->second : PostingList::END_DOC;
+}
+
+/**
+ * @brief 按字节序列出段内以prefix开头的词项
+ * @param out 输出：追加段内的词项
+ * @param prefix 前缀，为空时列出全部词项
+ *
+ * 词典中的词项本身有序，只有封存前新出现的词项需要排序后归并。
+ */
+void IndexSegment::collect_terms(std::vector<std::string>& out, const std::string& prefix) const {
+    const FieldIndex& index = fields_[FIELD_DEFAULT];
+    std::vector<std::string> added;
+    index.pending.for_each([&added, &prefix](const std::string& term, const PostingPtr&) {
+        if (term.compare(0, prefix.size(), prefix) == 0) {
+            added.push_back(term);
+        }
+    });
+    std::sort(added.begin(), added.end());
+
+    size_t a = 0;
+    for (TermDictionary::Iterator it = index.dictionary.prefix_iterator(prefix); !it.at_end(); it.next()) {
+        while (a < added.size() && added[a] < it.term()) {
+            out.push_back(added[a++]);
+        }
+        out.push_back(it.term());
+    }
+    out.insert(out.end(), added.begin() + a, added.end());
+}
+
+/**
+ * @brief 列出与自动机目标词项编辑距离足够小的词项
+ * @param automaton Levenshtein自动机
+ * @param out 输出：追加(不含字段名的词项, 编辑距离)，顺序不定
+ * @param field 字段
+ *
+ * 词典部分用自动机与有序词项求交；尚未并入词典的新词项数量有限，逐个计算编辑距离。
+ */
+void IndexSegment::collect_fuzzy_terms(const LevenshteinAutomaton& automaton,
+                                       std::vector<std::pair<std::string, size_t>>& out, IndexField field) const {
+    const FieldIndex& index = fields_[field];
+    automaton.intersect(index.dictionary, out);
+    index.pending.for_each([&automaton, &out](const std::string& term, const PostingPtr&) {
+        size_t edits = automaton.distance(term);
+        if (edits <= automaton.max_edits()) {
+            out.push_back(std::make_pair(term, edits));
+        }
+    });
+}
+
+/**
+ * @brief 按字节序列出全部词项及其文档频率
+ * @param out 输出：追加(词项, 倒排列表中的文档数)
+ */
+void IndexSegment::collect_term_frequencies(std::vector<std::pair<std::string, boost::uint32_t>>& out) const {
+    std::vector<std::string> terms;
+    std::vector<PostingPtr> postings;
+    sorted_terms(FIELD_DEFAULT, terms, postings);
+    out.reserve(out.size() + terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        out.push_back(std::make_pair(std::move(terms[i]), static_cast<boost::uint32_t>(postings[i]->size())));
+    }
+}
+
+/**
+ * @brief 统计所有字段的词典占用的内存
+ * @return 字节数，包括按编号排列的倒排列表指针与尚未并入词典的新词项
+ */
+size_t IndexSegment::dictionary_memory() const {
+    size_t bytes = 0;
+    for (const FieldIndex& index : fields_) {
+        bytes += index.dictionary.memory_usage() + index.postings.capacity() * sizeof(PostingPtr);
+        index.pending.for_each([&bytes](const std::string& term, const PostingPtr& postings) {
+            bytes += sizeof(term) + sizeof(postings) + term.capacity();
+        });
+    }
+    return bytes;
+}
+
+/**
+ * @brief 统计所有字段的倒排列表占用的内存
+ * @param bitmap_terms 输出：使用位图表示的倒排列表数
+ * @return 字节数
+ */
+size_t IndexSegment::posting_memory(size_t& bitmap_terms) const {
+    size_t bytes = 0;
+    bitmap_terms = 0;
+    for (const FieldIndex& index : fields_) {
+        for (const PostingPtr& postings : index.postings) {
+            bytes += postings->memory_usage();
+            if (postings->representation() == PostingList::BITMAP) {
+                bitmap_terms++;
+            }
+        }
+        index.pending.for_each([&bytes, &bitmap_terms](const std::string&, const PostingPtr& postings) {
+            bytes += postings->memory_usage();
+            if (postings->representation() == PostingList::BITMAP) {
+                bitmap_terms++;
+            }
+        });
+    }
+    return bytes;
+}
+
+/**
+ * @brief 段的内存占用
+ * @return 已封存的段返回封存时的统计（封存后不再修改），未封存的缓冲段重新统计
+ */
+SegmentFootprint IndexSegment::footprint() const {
+    return sealed_ ? footprint_ : measure_footprint();
+}
+
+/**
+ * @brief 遍历词典、倒排列表与文档存储统计内存占用
+ */
+SegmentFootprint IndexSegment::measure_footprint() const {
+    SegmentFootprint footprint;
+    footprint.dictionary_bytes = dictionary_memory();
+    footprint.posting_bytes = posting_memory(footprint.bitmap_terms);
+    footprint.store_bytes = store_.compressed_bytes();
+    footprint.store_raw_bytes = store_.raw_bytes();
+    return footprint;
+}
+
+/**
+ * @brief 取得字段中可以修改的倒排列表
+ * @param field 字段
+ * @param term 不含字段名的索引词项
+ * @return 只属于本段的倒排列表，词项不存在时新建
+ *
+ * 引用计数为1说明没有其他段副本（也就没有查询线程）能看到该列表，可以原地修改。
+ * 词典中没有的词项记入字段的pending，封存时并入词典。
+ */
+PostingList& IndexSegment::writable_postings(IndexField field, const std::string& term) {
+    FieldIndex& index = fields_[field];
+    TermId id = index.dictionary.find(term);
+    PostingPtr& postings = id != TermDictionary::NOT_FOUND ? index.postings[id] : index.pending[term];
+    if (!postings) {
+        postings.reset(new PostingList());
+    } else if (postings.use_count() > 1) {
+        postings.reset(new PostingList(*postings));
+    }
+    return *postings;
+}
+
+/**
+ * @brief 按字节序列出字段的全部词项及其倒排列表
+ * @param field 字段
+ * @param terms 输出：升序排列的词项（覆盖原内容）
+ * @param postings 输出：与terms一一对应的倒排列表（覆盖原内容）
+ */
+void IndexSegment::sorted_terms(IndexField field, std::vector<std::string>& terms,
+                                std::vector<PostingPtr>& postings) const {
+    const FieldIndex& index = fields_[field];
+    std::vector<std::pair<std::string, PostingPtr>> added;
+    added.reserve(index.pending.size());
+    index.pending.for_each([&added](const std::string& term, const PostingPtr& postings) {
+        added.push_back(std::make_pair(term, postings));
+    });
+    std::sort(added.begin(), added.end(),
+              [](const std::pair<std::string, PostingPtr>& a, const std::pair<std::string, PostingPtr>& b) {
+                  return a.first < b.first;
+              });
+
+    terms.clear();
+    postings.clear();
+    terms.reserve(index.dictionary.size() + added.size());
+    postings.reserve(index.dictionary.size() + added.size());
+    size_t a = 0;
+    for (TermDictionary::Iterator it = index.dictionary.iterator(); !it.at_end(); it.next()) {
+        while (a < added.size() && added[a].first < it.term()) {
+            terms.push_back(added[a].first);
+            postings.push_back(added[a].second);
+            a++;
+        }
+        terms.push_back(it.term());
+        postings.push_back(index.postings[it.id()]);
+    }
+    for (; a < added.size(); ++a) {
+        terms.push_back(added[a].first);
+        postings.push_back(added[a].second);
+    }
+}
@@ -7,6 +7,8 @@
  */
 
 #include "indexer.h"
+#include "index_file.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -24,10 +26,13 @@ namespace fs = boost::filesystem;
 
 /**
  * @brief Indexer类的构造函数
+ * @param partition 只遍历的分区序号
+ * @param partitions 分区总数，1表示遍历整个目录
  *
  * 初始化支持的文件扩展名列表。
  */
-Indexer::Indexer() {
+Indexer::Indexer(size_t partition, size_t partitions)
+    : partition_(partition), partitions_(partitions > 0 ? partitions : 1) {
     // 添加支持的文本和代码文件扩展名
     supported_extensions_.push_back(".txt");
     supported_extensions_.push_back(".html");
@@ -57,16 +62,56 @@ Indexer::~Indexer() {
  */
 std::vector<Document> Indexer::scan_directory(const std::string& directory_path) {
     std::vector<Document> documents;
+    for (const std::string& file_path : list_files(directory_path)) {
+        try {
+            std::cout << "Processing file: " << file_path << std::endl;
+            Document doc = parse_file(file_path);
+            if (!doc.content.empty()) {
+                documents.push_back(doc);
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error processing file: " << file_path << " - " << e.what() << std::endl;
+            continue; // 继续处理下一个文件
+        }
+    }
 
+    std::cout << "Scan completed, found " << documents.size() << " documents" << std::endl;
+    return documents;
+}
+
+/**
+ * @brief 列出指定目录下所有受支持的文件，不读取文件内容
+ * @param directory_path 要扫描的目录路径
+ * @return 按遍历顺序排列的文件路径
+ */
+std::vector<std::string> Indexer::list_files(const std::string& directory_path) {
+    std::vector<std::string> files;
+    for_each_file(directory_path, [&files](const std::string& file_path) {
+        files.push_back(file_path);
+        return true;
+    });
+    return files;
+}
+
+/**
+ * @brief 遍历指定目录下所有受支持的文件，边遍历边交给调用方
+ * @param directory_path 要扫描的目录路径
+ * @param visit 对每个文件路径调用，返回false时停止遍历
+ *
+ * 不在内存中保存文件列表，流水线可以在遍历尚未结束时就开始处理文件。
+ */
+void Indexer::for_each_file(const std::string& directory_path,
+                            const std::function<bool(const std::string&)>& visit) {
     try {
         // 检查目录是否存在且是否为目录
         if (!fs::exists(directory_path)) {
             std::cout << "Directory does not exist: " << directory_path << std::endl;
-            return documents;
+            return;
         }
         if (!fs::is_directory(directory_path)) {
             std::cout << "Path is not a directory: " << directory_path << std::endl;
-            return documents;
+            return;
         }
 
         std::cout << "Scanning directory: " << directory_path << std::endl;
@@ -74,33 +119,81 @@ std::vector<Document> Indexer::scan_directory(const std::string& directory_path)
         // 使用递归迭代器遍历目录及其所有子目录
         fs::recursive_directory_iterator end_iter;
         for (fs::recursive_directory_iterator iter(directory_path); iter != end_iter; ++iter) {
+            std::string file_path;
             try {
-                // 只处理普通文件
-                if (fs::is_regular_file(iter->status())) {
-                    std::string file_path = iter->path().string();
-
-                    // 检查文件扩展名是否受支持
-                    if (is_supported_file(file_path)) {
-                        std::cout << "Processing file: " << file_path << std::endl;
-                        Document doc = parse_file(file_path);
-                        if (!doc.content.empty()) {
-                            documents.push_back(doc);
-                        }
-                    }
+                // 只处理扩展名受支持的普通文件
+                if (fs::is_regular_file(iter->status()) && is_supported_file(iter->path().string()) &&
+                    in_partition(iter->path(), directory_path)) {
+                    file_path = iter->path().string();
                 }
             }
             catch (const std::exception& e) {
                 std::cerr << "Error processing file: " << iter->path().string() << " - " << e.what() << std::endl;
                 continue; // 继续处理下一个文件
             }
+            if (!file_path.empty() && !visit(file_path)) {
+                return;
+            }
         }
     }
     catch (const std::exception& e) {
         std::cerr << "Error scanning directory: " << directory_path << " - " << e.what() << std::endl;
     }
+}
 
-    std::cout << "Scan completed, found " << documents.size() << " documents" << std::endl;
-    return documents;
+/**
+ * @brief 计算目录指纹，用于判断持久化的索引是否过期
+ * @param directory_path 数据目录路径
+ * @return 目录中所有受支持文件的路径、大小与修改时间的散列，目录不存在时为空目录的指纹
+ *
+ * 只读取文件元数据，不读取内容。文档ID由文件路径生成，因此目录路径本身也计入指纹；
+ * 条目按路径排序后再散列，与目录遍历顺序无关。分区时只计入本分区的文件，并计入分区设置。
+ */
+boost::uint64_t Indexer::fingerprint(const std::string& directory_path) {
+    std::vector<std::string> entries;
+    try {
+        if (fs::is_directory(directory_path)) {
+            fs::recursive_directory_iterator end_iter;
+            for (fs::recursive_directory_iterator iter(directory_path); iter != end_iter; ++iter) {
+                if (fs::is_regular_file(iter->status()) && is_supported_file(iter->path().string()) &&
+                    in_partition(iter->path(), directory_path)) {
+                    entries.push_back(fs::relative(iter->path(), directory_path).generic_string() + "|" +
+                                      std::to_string(fs::file_size(iter->path())) + "|" +
+                                      std::to_string(static_cast<long long>(fs::last_write_time(iter->path()))));
+                }
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error fingerprinting directory: " << directory_path << " - " << e.what() << std::endl;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    boost::uint64_t hash = fnv1a64(directory_path.data(), directory_path.size());
+    if (partitions_ > 1) {
+        std::string partition = std::to_string(partition_) + "/" + std::to_string(partitions_);
+        hash = fnv1a64(partition.data(), partition.size(), hash);
+    }
+    for (const std::string& entry : entries) {
+        hash = fnv1a64(entry.data(), entry.size() + 1, hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief 判断文件是否属于本分区
+ * @param file_path 文件路径
+ * @param directory_path 数据目录路径
+ * @return 不分区或相对路径的散列落在本分区时返回true
+ *
+ * 按相对路径散列，分区只取决于文件在数据目录中的位置，与数据目录所在的路径及遍历顺序无关。
+ */
+bool Indexer::in_partition(const fs::path& file_path, const std::string& directory_path) const {
+    if (partitions_ <= 1) {
+        return true;
+    }
+    std::string relative = fs::relative(file_path, directory_path).generic_string();
+    return fnv1a64(relative.data(), relative.size()) % partitions_ == partition_;
 }
 
 /**
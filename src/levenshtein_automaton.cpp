@@ -0,0 +1,210 @@
+/**
+ * @file levenshtein_automaton.cpp
+ * @brief Levenshtein自动机的实现文件
+ *
+ * 状态转移按编辑距离矩阵的行递推：读入字节c时，
+ *   new[0] = old[0] + 1
+ *   new[i + 1] = min(old[i] + (term[i] != c), new[i] + 1, old[i + 1] + 1)
+ * 只保留不超过max_edits的项；相邻两项至多相差1，因此缺失的项不会产生不超过max_edits的值。
+ */
+
+#include "levenshtein_automaton.h"
+#include <algorithm>
+
+const size_t LevenshteinAutomaton::MAX_EDITS;
+
+/**
+ * @brief LevenshteinAutomaton的构造函数
+ * @param term 目标词项
+ * @param max_edits 最大编辑距离
+ */
+LevenshteinAutomaton::LevenshteinAutomaton(const std::string& term, size_t max_edits)
+    : term_(term), max_edits_(std::min(max_edits, MAX_EDITS)) {
+}
+
+/**
+ * @brief 按词项长度选择默认的最大编辑距离
+ * @param term 索引词项
+ * @return 1~2字节为0，3~5字节为1，6字节以上为2；不是以英文字母开头的ASCII词项为0
+ *
+ * 中文词项按字节计算编辑距离没有意义，数字也不做模糊匹配。
+ */
+size_t LevenshteinAutomaton::default_edits(const std::string& term) {
+    if (!supports(term) || term.size() < 3) {
+        return 0;
+    }
+    return term.size() < 6 ? 1 : 2;
+}
+
+/**
+ * @brief 判断词项是否可以做模糊匹配
+ * @param term 索引词项
+ * @return 以英文字母开头且只含ASCII字符时返回true
+ */
+bool LevenshteinAutomaton::supports(const std::string& term) {
+    if (term.empty() || !((term[0] >= 'a' && term[0] <= 'z') || (term[0] >= 'A' && term[0] <= 'Z'))) {
+        return false;
+    }
+    for (char c : term) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 计算与candidate的编辑距离
+ * @param candidate 候选字符串
+ * @return 编辑距离，超过max_edits时返回max_edits + 1
+ */
+size_t LevenshteinAutomaton::distance(const std::string& candidate) const {
+    State state;
+    State next;
+    start(state);
+    for (size_t i = 0; i < candidate.size() && !state.empty(); ++i) {
+        step(state, static_cast<unsigned char>(candidate[i]), next);
+        state.swap(next);
+    }
+    return accepted(state);
+}
+
+/**
+ * @brief 与词典求交
+ * @param dictionary 词典
+ * @param out 输出：按字节序追加(词项, 编辑距离)
+ *
+ * states[d]是读入当前路径前d个字节后的状态，下一个词项与路径的公共前缀部分不需要重新计算。
+ * 读入某个字节后状态为空时，以该前缀开头的词项都不会被接受：
+ * 找到同一层中比它大、能使状态非空的最小字节（只可能是目标词项中的某个字节），
+ * 这一层没有时回退到上一层，然后在词典中跳转到新前缀的位置继续。
+ */
+void LevenshteinAutomaton::intersect(const TermDictionary& dictionary,
+                                     std::vector<std::pair<std::string, size_t>>& out) const {
+    std::vector<State> states(1);
+    start(states[0]);
+    std::string path;
+    std::string key;
+
+    TermDictionary::Iterator it = dictionary.iterator();
+    while (!it.at_end()) {
+        const std::string& term = it.term();
+        size_t depth = 0;
+        size_t limit = std::min(path.size(), term.size());
+        while (depth < limit && path[depth] == term[depth]) {
+            depth++;
+        }
+        path.resize(depth);
+
+        bool rejected = false;
+        for (; depth < term.size(); ++depth) {
+            if (states.size() < depth + 2) {
+                states.resize(depth + 2);
+            }
+            unsigned char c = static_cast<unsigned char>(term[depth]);
+            step(states[depth], c, states[depth + 1]);
+            if (!states[depth + 1].empty()) {
+                path.push_back(term[depth]);
+                continue;
+            }
+
+            key.assign(term, 0, depth);
+            int label = next_label(states[depth], c);
+            while (label < 0) {
+                if (depth == 0) {
+                    return;
+                }
+                depth--;
+                label = next_label(states[depth], static_cast<unsigned char>(key[depth]));
+                key.resize(depth);
+            }
+            key.push_back(static_cast<char>(label));
+            it = dictionary.seek(key);
+            rejected = true;
+            break;
+        }
+        if (rejected) {
+            continue;
+        }
+
+        size_t edits = accepted(states[depth]);
+        if (edits <= max_edits_) {
+            out.push_back(std::make_pair(term, edits));
+        }
+        it.next();
+    }
+}
+
+/**
+ * @brief 初始状态：删除目标词项的前i个字节，编辑数为i
+ */
+void LevenshteinAutomaton::start(State& state) const {
+    state.clear();
+    for (size_t i = 0; i <= max_edits_ && i <= term_.size(); ++i) {
+        state.push_back(Entry(static_cast<boost::uint32_t>(i), static_cast<boost::uint32_t>(i)));
+    }
+}
+
+/**
+ * @brief 状态转移
+ * @param state 当前状态
+ * @param c 读入的字节
+ * @param next 输出：新状态，为空表示不可能再被接受
+ */
+void LevenshteinAutomaton::step(const State& state, unsigned char c, State& next) const {
+    next.clear();
+    if (!state.empty() && state[0].index == 0 && state[0].edits < max_edits_) {
+        next.push_back(Entry(0, state[0].edits + 1));
+    }
+    for (size_t j = 0; j < state.size(); ++j) {
+        boost::uint32_t index = state[j].index;
+        if (index == term_.size()) {
+            break;
+        }
+        boost::uint32_t edits = state[j].edits + (static_cast<unsigned char>(term_[index]) == c ? 0 : 1);
+        if (!next.empty() && next.back().index == index) {
+            edits = std::min(edits, next.back().edits + 1);
+        }
+        if (j + 1 < state.size() && state[j + 1].index == index + 1) {
+            edits = std::min(edits, state[j + 1].edits + 1);
+        }
+        if (edits <= max_edits_) {
+            next.push_back(Entry(index + 1, edits));
+        }
+    }
+}
+
+/**
+ * @brief 读完时的编辑距离
+ * @return 状态包含目标词项末尾时返回其编辑数，否则返回max_edits_ + 1
+ */
+size_t LevenshteinAutomaton::accepted(const State& state) const {
+    if (!state.empty() && state.back().index == term_.size()) {
+        return state.back().edits;
+    }
+    return max_edits_ + 1;
+}
+
+/**
+ * @brief 查找读入后状态非空的下一个字节
+ * @param state 当前状态
+ * @param c 起点（不含）
+ * @return 比c大的最小可行字节，不存在时返回-1
+ *
+ * 还有编辑余量时任意字节都可行；否则只有与某一项的下一个目标字节相同才可行。
+ */
+int LevenshteinAutomaton::next_label(const State& state, unsigned char c) const {
+    int best = -1;
+    for (const Entry& entry : state) {
+        if (entry.edits < max_edits_) {
+            return c < 0xFF ? c + 1 : -1;
+        }
+        if (entry.index < term_.size()) {
+            int label = static_cast<unsigned char>(term_[entry.index]);
+            if (label > c && (best < 0 || label < best)) {
+                best = label;
+            }
+        }
+    }
+    return best;
+}
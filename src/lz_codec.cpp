@@ -0,0 +1,176 @@
+/**
+ * @file lz_codec.cpp
+ * @brief LZ压缩编解码器的实现文件
+ */
+
+#include "lz_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace {
+
+// 最短匹配长度
+const size_t MIN_MATCH = 4;
+
+// 匹配偏移的上限（16位）
+const size_t MAX_OFFSET = 65535;
+
+// 散列表大小（2的幂）
+const int HASH_BITS = 13;
+
+/**
+ * @brief 读取4个字节
+ */
+boost::uint32_t read32(const char* p) {
+    boost::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief 4字节序列的散列
+ */
+size_t hash32(boost::uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief 以255累加的字节写入扩展长度
+ */
+void write_length(size_t length, std::string& out) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+/**
+ * @brief 读取扩展长度，数据不足时返回false
+ */
+bool read_length(const unsigned char*& p, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (p >= end) {
+            return false;
+        }
+        byte = *p++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * @brief 输出一个序列：literal_size个字面量，随后是偏移为offset、长度为match_size的匹配
+ * match_size为0时表示最后一个只有字面量的序列
+ */
+void write_sequence(const char* literals, size_t literal_size, size_t offset, size_t match_size, std::string& out) {
+    size_t match_code = match_size > 0 ? match_size - MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>((std::min<size_t>(literal_size, 15) << 4) |
+                                                     std::min<size_t>(match_code, 15));
+    out.push_back(static_cast<char>(token));
+    if (literal_size >= 15) {
+        write_length(literal_size - 15, out);
+    }
+    out.append(literals, literal_size);
+    if (match_size == 0) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15) {
+        write_length(match_code - 15, out);
+    }
+}
+
+} // namespace
+
+namespace lz {
+
+/**
+ * @brief 压缩一段数据
+ * @param data 原始数据
+ * @param size 原始字节数
+ * @param out 输出：压缩数据追加到末尾
+ */
+void compress(const char* data, size_t size, std::string& out) {
+    std::vector<boost::int32_t> table(static_cast<size_t>(1) << HASH_BITS, -1);
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + MIN_MATCH <= size) {
+        boost::uint32_t sequence = read32(data + i);
+        size_t slot = hash32(sequence);
+        boost::int32_t candidate = table[slot];
+        table[slot] = static_cast<boost::int32_t>(i);
+        if (candidate < 0 || i - candidate > MAX_OFFSET || read32(data + candidate) != sequence) {
+            i++;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (i + length < size && data[candidate + length] == data[i + length]) {
+            length++;
+        }
+        write_sequence(data + anchor, i - anchor, i - candidate, length, out);
+        i += length;
+        anchor = i;
+    }
+    write_sequence(data + anchor, size - anchor, 0, 0, out);
+}
+
+/**
+ * @brief 解压一段数据
+ * @param data 压缩数据
+ * @param size 压缩字节数
+ * @param raw_size 原始字节数
+ * @param out 输出：解压后的数据
+ * @return 数据完整且长度与raw_size一致时返回true
+ */
+bool decompress(const char* data, size_t size, size_t raw_size, std::string& out) {
+    out.clear();
+    out.reserve(raw_size);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t literal_size = token >> 4;
+        if (literal_size == 15 && !read_length(p, end, literal_size)) {
+            return false;
+        }
+        if (literal_size > static_cast<size_t>(end - p) || out.size() + literal_size > raw_size) {
+            return false;
+        }
+        out.append(reinterpret_cast<const char*>(p), literal_size);
+        p += literal_size;
+        if (p == end) {
+            break;
+        }
+
+        if (end - p < 2) {
+            return false;
+        }
+        size_t offset = p[0] | (static_cast<size_t>(p[1]) << 8);
+        p += 2;
+        size_t match_size = token & 0x0F;
+        if (match_size == 15 && !read_length(p, end, match_size)) {
+            return false;
+        }
+        match_size += MIN_MATCH;
+        if (offset == 0 || offset > out.size() || out.size() + match_size > raw_size) {
+            return false;
+        }
+
+        // 匹配可以与自身重叠（offset < match_size），必须逐字节复制
+        size_t from = out.size() - offset;
+        for (size_t k = 0; k < match_size; ++k) {
+            char c = out[from + k];
+            out.push_back(c);
+        }
+    }
+    return out.size() == raw_size;
+}
+
+} // namespace lz
@@ -7,9 +7,15 @@
  */
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/thread.hpp>
+#include "directory_watcher.h"
 #include "http_server.h"
+#include "search_coordinator.h"
 #include "search_engine.h"
 #include "indexer.h"
 
@@ -21,25 +27,82 @@
  */
 SearchEngine* g_search_engine = nullptr;
 
+/**
+ * @brief 全局协调节点实例指针
+ *
+ * 只在以协调节点角色运行时创建，此时没有本地搜索引擎；其他模块通过`get_search_coordinator()`访问。
+ */
+SearchCoordinator* g_search_coordinator = nullptr;
+
+/**
+ * @brief 全局数据目录监视器实例指针
+ *
+ * 只在指定--watch时创建，须先于搜索引擎释放。
+ */
+DirectoryWatcher* g_directory_watcher = nullptr;
+
+/**
+ * @brief 命令行参数
+ */
+struct ProgramOptions {
+    RankingConfig ranking;      // 排序模型配置
+    IndexOptions index;         // 索引选项
+    std::string data_dir;       // 数据目录
+    std::string index_file;     // 持久化的索引文件，为空表示不持久化
+    bool rebuild;               // 忽略已有的索引文件，强制重新建立索引
+    std::string role;           // 运行角色："standalone"、"shard" 或 "coordinator"
+    unsigned short port;        // HTTP监听端口
+    std::vector<std::string> shard_servers;     // 协调节点：分片服务器的"主机:端口"列表
+    long shard_timeout_ms;      // 协调节点：一次请求（分布式查询的所有阶段）等待分片应答的最长时间
+    bool watch;                 // 监视数据目录，文件变化时增量更新索引
+    long watch_debounce_ms;     // 监视数据目录时提交前的静默期
+
+    ProgramOptions()
+        : data_dir("./data"), index_file("./index/search.idx"), rebuild(false), role("standalone"), port(9882),
+          shard_timeout_ms(1000), watch(false), watch_debounce_ms(500) {}
+};
+
 /**
  * @brief 初始化全局搜索引擎实例
  *
- * 该函数负责创建`SearchEngine`对象，加载数据文件，并构建索引。
+ * 该函数负责创建`SearchEngine`对象；索引文件与数据目录一致时直接映射该文件，
+ * 否则加载数据文件、构建索引并写回索引文件，供下次启动使用。
+ * @param options 命令行参数
  * @return 如果初始化成功返回`true`，否则返回`false`。
  */
-bool initialize_search_engine() {
+bool initialize_search_engine(const ProgramOptions& options) {
     try {
         std::cout << "Initializing search engine..." << std::endl;
 
-        // 1. 创建搜索引擎实例
-        g_search_engine = new SearchEngine();
+        // 1. 创建搜索引擎实例并选择排序模型
+        g_search_engine = new SearchEngine(options.index);
+        g_search_engine->set_ranking(options.ranking);
 
-        // 2. 从指定目录加载数据文件
-        g_search_engine->load_data_files("./data");
+        // 2. 索引文件未过期时直接映射，跳过分词与建索引
+        boost::uint64_t fingerprint =
+            Indexer(options.index.partition, options.index.partitions).fingerprint(options.data_dir);
+        bool persistent = !options.index_file.empty();
+        if (persistent && !options.rebuild && g_search_engine->load_index(options.index_file, fingerprint)) {
+            std::cout << "Search engine initialization completed!" << std::endl;
+            return true;
+        }
+
+        // 3. 从指定目录加载数据文件
+        g_search_engine->load_data_files(options.data_dir);
 
-        // 3. 根据加载的文档构建搜索引擎索引
+        // 4. 根据加载的文档构建搜索引擎索引
         g_search_engine->build_index();
 
+        // 5. 写回索引文件；失败只影响下次启动的速度
+        if (persistent) {
+            try {
+                g_search_engine->save_index(options.index_file, fingerprint);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Failed to save index file: " << e.what() << std::endl;
+            }
+        }
+
         std::cout << "Search engine initialization completed!" << std::endl;
         return true;
     }
@@ -52,38 +115,176 @@ bool initialize_search_engine() {
 /**
  * @brief 清理程序资源
  *
- * 在程序退出前，释放全局搜索引擎实例所占用的内存。
+ * 在程序退出前，先停止数据目录监视器，再释放全局搜索引擎实例所占用的内存。
  */
 void cleanup() {
+    if (g_directory_watcher) {
+        delete g_directory_watcher;
+        g_directory_watcher = nullptr;
+    }
     if (g_search_engine) {
         delete g_search_engine;
         g_search_engine = nullptr;
         std::cout << "Search engine resources cleaned up." << std::endl;
     }
+    if (g_search_coordinator) {
+        delete g_search_coordinator;
+        g_search_coordinator = nullptr;
+    }
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param options 输出的命令行参数
+ * @return 如果所有参数都合法返回`true`，否则返回`false`。
+ *
+ * 支持的参数：--ranking=tfidf|bm25|bm25f、--bm25-k1=、--bm25-b=、--title-boost=、--content-boost=（bm25f的字段权重）、
+ * --proximity-weight=、--no-positions、--cache-mb=（查询结果缓存容量，0表示关闭）、
+ * --build-threads=（加载数据文件的解析线程数，0表示使用硬件线程数）、
+ * --shards=（分片数，查询在各分片上并行求值，0表示使用硬件线程数）、--no-fuzzy（不对索引中不存在的查询词自动做模糊匹配，显式的word~不受影响）、
+ * --data-dir=、--index-file=（为空表示不持久化索引）、--rebuild（忽略已有的索引文件）、--verify-index（打开索引文件时校验整个正文）、--port=（HTTP监听端口）、
+ * --role=standalone|shard|coordinator、--partition=i/n（分片服务器只索引数据目录的第i个分区，共n个；
+ * 未指定--index-file时索引文件为./index/partition-i-of-n.idx）、
+ * --shard-servers=host:port,...（协调节点的分片服务器列表）、--shard-timeout-ms=（一次请求等待分片的最长时间，分布式查询的三个阶段共用）、
+ * --watch（用inotify监视数据目录并增量更新索引，仅Linux）、--watch-debounce-ms=（监视时提交前的静默期）
+ */
+bool parse_options(int argc, char* argv[], ProgramOptions& options) {
+    RankingConfig& ranking = options.ranking;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (name == "--ranking") {
+                ranking.model = value;
+            } else if (name == "--bm25-k1") {
+                ranking.k1 = boost::lexical_cast<double>(value);
+            } else if (name == "--bm25-b") {
+                ranking.b = boost::lexical_cast<double>(value);
+                ranking.content_b = ranking.b;
+            } else if (name == "--title-boost") {
+                ranking.title_weight = boost::lexical_cast<double>(value);
+            } else if (name == "--content-boost") {
+                ranking.content_weight = boost::lexical_cast<double>(value);
+            } else if (name == "--proximity-weight") {
+                ranking.proximity_weight = boost::lexical_cast<double>(value);
+            } else if (name == "--no-positions") {
+                options.index.store_positions = false;
+            } else if (name == "--cache-mb") {
+                options.index.cache_bytes = boost::lexical_cast<size_t>(value) * 1024 * 1024;
+            } else if (name == "--build-threads") {
+                options.index.build_threads = boost::lexical_cast<size_t>(value);
+            } else if (name == "--shards") {
+                options.index.shards = boost::lexical_cast<size_t>(value);
+            } else if (name == "--no-fuzzy") {
+                options.index.fuzzy_unknown_terms = false;
+            } else if (name == "--data-dir") {
+                options.data_dir = value;
+            } else if (name == "--index-file") {
+                options.index_file = value;
+            } else if (name == "--rebuild") {
+                options.rebuild = true;
+            } else if (name == "--verify-index") {
+                options.index.verify_index = true;
+            } else if (name == "--port") {
+                options.port = boost::lexical_cast<unsigned short>(value);
+            } else if (name == "--role") {
+                options.role = value;
+            } else if (name == "--partition") {
+                size_t slash = value.find('/');
+                if (slash == std::string::npos) {
+                    throw boost::bad_lexical_cast();
+                }
+                options.index.partition = boost::lexical_cast<size_t>(value.substr(0, slash));
+                options.index.partitions = boost::lexical_cast<size_t>(value.substr(slash + 1));
+            } else if (name == "--shard-servers") {
+                boost::split(options.shard_servers, value, boost::is_any_of(","), boost::token_compress_on);
+            } else if (name == "--shard-timeout-ms") {
+                options.shard_timeout_ms = boost::lexical_cast<long>(value);
+            } else if (name == "--watch") {
+                options.watch = true;
+            } else if (name == "--watch-debounce-ms") {
+                options.watch_debounce_ms = boost::lexical_cast<long>(value);
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const boost::bad_lexical_cast&) {
+            std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (options.role != "standalone" && options.role != "shard" && options.role != "coordinator") {
+        std::cerr << "Unknown role: " << options.role << std::endl;
+        return false;
+    }
+    if (options.index.partitions == 0 || options.index.partition >= options.index.partitions) {
+        std::cerr << "Invalid partition: " << options.index.partition << "/" << options.index.partitions << std::endl;
+        return false;
+    }
+    if (options.role == "coordinator" && options.watch) {
+        std::cerr << "--watch requires a local index (standalone or shard role)" << std::endl;
+        return false;
+    }
+    if (options.role == "coordinator" && options.shard_servers.empty()) {
+        std::cerr << "--role=coordinator requires --shard-servers" << std::endl;
+        return false;
+    }
+    // 同一台机器上的多个分片服务器各自使用自己的索引文件
+    if (options.index.partitions > 1 && options.index_file == ProgramOptions().index_file) {
+        options.index_file = "./index/partition-" + std::to_string(options.index.partition) + "-of-" +
+                             std::to_string(options.index.partitions) + ".idx";
+    }
+    return true;
 }
 
 /**
  * @brief 程序主函数
  *
+ * @param argc 参数个数
+ * @param argv 参数列表，见`parse_options`
  * @return 程序退出码，0表示成功，非0表示失败。
  */
-int main() {
+int main(int argc, char* argv[]) {
     try {
         std::cout << "=== Boost Search Engine Starting ===" << std::endl;
 
-        // 初始化搜索引擎，如果失败则退出程序
-        if (!initialize_search_engine()) {
+        ProgramOptions options;
+        if (!parse_options(argc, argv, options)) {
             return 1;
         }
 
+        // 监视先于加载建立，加载期间发生的变化在监视线程启动后补上
+        if (options.watch) {
+            g_directory_watcher = new DirectoryWatcher(options.data_dir, options.index.partition,
+                                                       options.index.partitions, options.watch_debounce_ms);
+        }
+
         // 创建Boost.Asio的I/O上下文，用于网络操作
         boost::asio::io_context io_context;
 
-        // 创建并启动HTTP服务器，监听指定端口（9882）
-        HttpServer server(io_context, 9882);
+        // 协调节点不持有索引，只把查询分发到各分片服务器（在io_context上异步请求）；
+        // 其他角色初始化本地搜索引擎，失败则退出程序
+        if (options.role == "coordinator") {
+            g_search_coordinator = new SearchCoordinator(io_context, options.shard_servers, options.shard_timeout_ms);
+        } else if (!initialize_search_engine(options)) {
+            return 1;
+        }
+
+        if (g_directory_watcher) {
+            g_directory_watcher->start(*g_search_engine);
+        }
+
+        // 创建并启动HTTP服务器，监听指定端口（默认9882）
+        HttpServer server(io_context, options.port);
 
-        std::cout << "HTTP server started, listening on port: 9882" << std::endl;
-        std::cout << "Please visit: http://localhost:9882" << std::endl;
+        std::cout << "HTTP server started (" << options.role << "), listening on port: " << options.port << std::endl;
+        std::cout << "Please visit: http://localhost:" << options.port << std::endl;
         std::cout << "Press Ctrl+C to exit" << std::endl;
 
         // 运行I/O上下文，开始处理异步事件（如HTTP请求）
@@ -111,3 +312,12 @@ int main() {
 SearchEngine* get_search_engine() {
     return g_search_engine;
 }
+
+/**
+ * @brief 获取全局协调节点实例的访问接口
+ *
+ * @return 以协调节点角色运行时指向全局`SearchCoordinator`实例的指针，否则为空。
+ */
+SearchCoordinator* get_search_coordinator() {
+    return g_search_coordinator;
+}
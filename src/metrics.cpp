@@ -0,0 +1,236 @@
+/**
+ * @file metrics.cpp
+ * @brief 服务指标的实现文件
+ *
+ * 实现延迟直方图的分位数计算与Prometheus文本格式导出、按秒计数的查询速率，
+ * 以及进程级指标的汇总输出。记录指标的热路径全部内联在头文件中。
+ */
+
+#include "metrics.h"
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief 构造空的直方图
+ */
+LatencyHistogram::LatencyHistogram() : sum_(0) {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts_[i].store(0, boost::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 计算子桶能容纳的最大取值
+ * @param index 子桶序号
+ * @return 子桶内的最大纳秒数；最后一个子桶为64位无符号数的最大值
+ */
+boost::uint64_t LatencyHistogram::bucket_max(size_t index) {
+    size_t shift = index < SUB_BUCKETS ? 0 : index / SUB_BUCKETS - 1;
+    boost::uint64_t sub = index - shift * SUB_BUCKETS;
+    // 最后一个子桶的上界溢出为0，减1后正好是最大值
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief 计算分位数
+ * @param q 分位数，0到1之间
+ * @return 第ceil(q*n)个最小样本所在子桶的最大取值（纳秒），与HDR直方图的约定相同；没有记录时为0
+ */
+boost::uint64_t LatencyHistogram::quantile(double q) const {
+    std::vector<boost::uint64_t> counts(BUCKET_COUNT);
+    boost::uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = counts_[i].load(boost::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    boost::uint64_t rank = static_cast<boost::uint64_t>(std::ceil(q * static_cast<double>(total)));
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+    boost::uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucket_max(i);
+        }
+    }
+    return bucket_max(BUCKET_COUNT - 1);
+}
+
+/**
+ * @brief 以Prometheus文本格式输出直方图样本
+ * @param out 输出流
+ * @param name 指标名，样本名为name_bucket、name_sum与name_count
+ * @param labels 附加的标签，不含花括号，可以为空
+ *
+ * 细分的子桶在导出时按2的幂纳秒累加为较粗的桶：2的幂正好是子桶的边界，累加不引入额外误差。
+ */
+void LatencyHistogram::write(std::ostream& out, const std::string& name, const std::string& labels) const {
+    std::vector<boost::uint64_t> counts(BUCKET_COUNT);
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = counts_[i].load(boost::memory_order_relaxed);
+    }
+    std::string prefix = labels.empty() ? std::string() : labels + ",";
+
+    boost::uint64_t cumulative = 0;
+    size_t next = 0;
+    for (int bit = MIN_EXPORT_BIT; bit <= MAX_EXPORT_BIT; ++bit) {
+        size_t end = bucket_index(static_cast<boost::uint64_t>(1) << bit);
+        for (; next < end; ++next) {
+            cumulative += counts[next];
+        }
+        out << name << "_bucket{" << prefix << "le=\""
+            << static_cast<double>(static_cast<boost::uint64_t>(1) << bit) / 1e9 << "\"} " << cumulative << "\n";
+    }
+    for (; next < BUCKET_COUNT; ++next) {
+        cumulative += counts[next];
+    }
+    out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << cumulative << "\n";
+
+    std::string braced = labels.empty() ? std::string() : "{" + labels + "}";
+    out << name << "_sum" << braced << " " << static_cast<double>(sum_.load(boost::memory_order_relaxed)) / 1e9
+        << "\n";
+    out << name << "_count" << braced << " " << cumulative << "\n";
+}
+
+/**
+ * @brief 构造空的速率计
+ */
+RateMeter::RateMeter() {
+    for (size_t i = 0; i < SLOTS; ++i) {
+        seconds_[i].store(0, boost::memory_order_relaxed);
+        counts_[i].store(0, boost::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 取单调时钟的当前秒数
+ * @return 从时钟纪元起的秒数，不受系统时间调整影响
+ */
+boost::uint64_t RateMeter::now_seconds() {
+    return static_cast<boost::uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief 记录事件
+ * @param count 事件数
+ */
+void RateMeter::mark(boost::uint64_t count) {
+    boost::uint64_t now = now_seconds();
+    size_t slot = static_cast<size_t>(now % SLOTS);
+    boost::uint64_t seen = seconds_[slot].load(boost::memory_order_relaxed);
+    if (seen != now && seconds_[slot].compare_exchange_strong(seen, now, boost::memory_order_relaxed)) {
+        // 这一格上次记录的是SLOTS秒以前，由抢到这一格的写入者清零
+        counts_[slot].store(0, boost::memory_order_relaxed);
+    }
+    counts_[slot].fetch_add(count, boost::memory_order_relaxed);
+}
+
+/**
+ * @brief 计算最近的平均速率
+ * @return 当前这一秒之前WINDOW_SECONDS个完整秒内的平均每秒事件数
+ */
+double RateMeter::rate() const {
+    boost::uint64_t now = now_seconds();
+    boost::uint64_t total = 0;
+    for (boost::uint64_t second = now - WINDOW_SECONDS; second < now; ++second) {
+        size_t slot = static_cast<size_t>(second % SLOTS);
+        if (seconds_[slot].load(boost::memory_order_relaxed) == second) {
+            total += counts_[slot].load(boost::memory_order_relaxed);
+        }
+    }
+    return static_cast<double>(total) / WINDOW_SECONDS;
+}
+
+/**
+ * @brief 构造所有计数为0的指标
+ */
+Metrics::Metrics()
+    : requests_total_(0), requests_in_flight_(0), connections_total_(0), connections_open_(0), queries_total_(0) {
+}
+
+/**
+ * @brief 取进程内唯一的实例
+ * @return 第一次调用时构造的实例，构造是线程安全的
+ */
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * @brief 取阶段的名字
+ * @param stage 处理阶段
+ * @return 导出时stage标签的取值
+ */
+const char* Metrics::stage_name(Stage stage) {
+    switch (stage) {
+        case REQUEST_PARSE: return "request_parse";
+        case TOKENIZE: return "tokenize";
+        case FUZZY_EXPAND: return "fuzzy_expand";
+        case CANDIDATE_GATHER: return "candidate_gather";
+        case SCORING: return "scoring";
+        case SORT: return "sort";
+        case SNIPPET: return "snippet";
+        case JSON_SERIALIZE: return "json_serialize";
+        case SOCKET_WRITE: return "socket_write";
+        case REQUEST: return "request";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief 以Prometheus文本格式输出所有指标
+ * @param out 输出流
+ *
+ * 各阶段的延迟以直方图导出，可以在Prometheus中跨实例聚合；另外直接给出由细分子桶算出的分位数，
+ * 便于不经过Prometheus查看（相对误差不超过1/16）。
+ */
+void Metrics::write(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision(9);
+
+    out << "# HELP bse_stage_duration_seconds Time spent in each request processing stage.\n"
+        << "# TYPE bse_stage_duration_seconds histogram\n";
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        stages_[stage].write(out, "bse_stage_duration_seconds",
+                             std::string("stage=\"") + stage_name(static_cast<Stage>(stage)) + "\"");
+    }
+
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    out << "# HELP bse_stage_duration_quantile_seconds Latency quantiles of each stage since startup.\n"
+        << "# TYPE bse_stage_duration_quantile_seconds gauge\n";
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        for (double q : quantiles) {
+            out << "bse_stage_duration_quantile_seconds{stage=\"" << stage_name(static_cast<Stage>(stage))
+                << "\",quantile=\"" << q << "\"} "
+                << static_cast<double>(stages_[stage].quantile(q)) / 1e9 << "\n";
+        }
+    }
+
+    out << "# HELP bse_http_requests_total HTTP requests received.\n"
+        << "# TYPE bse_http_requests_total counter\n"
+        << "bse_http_requests_total " << requests_total_.load(boost::memory_order_relaxed) << "\n"
+        << "# HELP bse_http_requests_in_flight HTTP requests being processed.\n"
+        << "# TYPE bse_http_requests_in_flight gauge\n"
+        << "bse_http_requests_in_flight " << requests_in_flight_.load(boost::memory_order_relaxed) << "\n"
+        << "# HELP bse_http_connections_total HTTP connections accepted.\n"
+        << "# TYPE bse_http_connections_total counter\n"
+        << "bse_http_connections_total " << connections_total_.load(boost::memory_order_relaxed) << "\n"
+        << "# HELP bse_http_connections_open HTTP connections currently open.\n"
+        << "# TYPE bse_http_connections_open gauge\n"
+        << "bse_http_connections_open " << connections_open_.load(boost::memory_order_relaxed) << "\n"
+        << "# HELP bse_search_queries_total Search queries served, counting each query of a batch.\n"
+        << "# TYPE bse_search_queries_total counter\n"
+        << "bse_search_queries_total " << queries_total_.load(boost::memory_order_relaxed) << "\n"
+        << "# HELP bse_search_queries_per_second Search queries per second over the last "
+        << RateMeter::WINDOW_SECONDS << " seconds.\n"
+        << "# TYPE bse_search_queries_per_second gauge\n"
+        << "bse_search_queries_per_second " << query_rate_.rate() << "\n";
+
+    out.precision(precision);
+    out.flags(flags);
+}
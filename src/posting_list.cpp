@@ -0,0 +1,1035 @@
+/**
+ * @file posting_list.cpp
+ * @brief 压缩倒排列表的实现文件
+ *
+ * 完整块采用SIMD-BP128式的纵向位打包：第i个整数放入第(i % 4)路，
+ * 每路32个整数按位宽b连续打包，四路的32位字交错存放。
+ * 这样SSE2一次128位的移位/掩码即可同时解出4个整数，
+ * 差值还原（前缀和）同样按4个整数一组进行；没有SSE2时使用等价的标量实现。
+ */
+
+#include "posting_list.h"
+#include "index_file.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSTING_LIST_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// 每路打包的整数个数
+const size_t LANE_VALUES = PostingList::BLOCK_SIZE / 4;
+
+// 块头：文档差值位宽 + 词频位宽 + 标题词频位宽
+const size_t BLOCK_HEADER_SIZE = 3;
+
+/**
+ * @brief 计算表示value所需的最少位数
+ */
+boost::uint8_t bits_needed(boost::uint32_t value) {
+    boost::uint8_t bits = 0;
+    while (value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+/**
+ * @brief 统计64位字中置位的个数
+ */
+size_t popcount64(boost::uint64_t word) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcountll(word));
+#else
+    size_t count = 0;
+    while (word != 0) {
+        word &= word - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+ * @brief 返回64位字最低置位的位置，word不能为0
+ */
+size_t lowest_bit64(boost::uint64_t word) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<size_t>(index);
+#else
+    size_t index = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/**
+ * @brief 以变长字节格式追加一个整数（每字节7位，最高位表示后续还有字节）
+ */
+void write_varbyte(std::vector<boost::uint8_t>& out, boost::uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<boost::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<boost::uint8_t>(value));
+}
+
+/**
+ * @brief 读取一个变长字节整数并前移指针
+ */
+boost::uint32_t read_varbyte(const boost::uint8_t*& in) {
+    boost::uint32_t value = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        value |= static_cast<boost::uint32_t>(*in & 0x7F) << shift;
+        shift += 7;
+        ++in;
+    }
+    value |= static_cast<boost::uint32_t>(*in) << shift;
+    ++in;
+    return value;
+}
+
+/**
+ * @brief 跳过一个变长字节整数
+ * @return 整数在end之前、且在5个字节之内结束时返回true
+ */
+bool skip_varbyte(const boost::uint8_t*& in, const boost::uint8_t* end) {
+    for (int i = 0; i < 5 && in < end; ++i) {
+        if ((*in++ & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 将128个整数按位宽bits打包为纵向布局，追加4*bits个32位字
+ */
+void pack_block(const boost::uint32_t* values, boost::uint8_t bits, std::vector<boost::uint8_t>& out) {
+    if (bits == 0) {
+        return;
+    }
+    std::vector<boost::uint32_t> words(4 * bits, 0);
+    for (size_t lane = 0; lane < 4; ++lane) {
+        size_t word = 0;
+        size_t shift = 0;
+        for (size_t i = 0; i < LANE_VALUES; ++i) {
+            boost::uint32_t value = values[i * 4 + lane];
+            words[word * 4 + lane] |= value << shift;
+            if (shift + bits >= 32) {
+                word++;
+                if (shift + bits > 32) {
+                    words[word * 4 + lane] |= value >> (32 - shift);
+                }
+                shift = shift + bits - 32;
+            } else {
+                shift += bits;
+            }
+        }
+    }
+    size_t offset = out.size();
+    out.resize(offset + words.size() * sizeof(boost::uint32_t));
+    std::memcpy(&out[offset], &words[0], words.size() * sizeof(boost::uint32_t));
+}
+
+/**
+ * @brief 按定宽bits顺序打包整数，多留一个字使任意位段都能用一次64位读取取出
+ */
+void pack_fixed(const std::vector<boost::uint32_t>& values, boost::uint8_t bits, std::vector<boost::uint8_t>& out) {
+    if (bits == 0) {
+        return;
+    }
+    std::vector<boost::uint32_t> words((values.size() * bits + 31) / 32 + 1, 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+        size_t bit = i * bits;
+        boost::uint64_t value = static_cast<boost::uint64_t>(values[i]) << (bit % 32);
+        words[bit / 32] |= static_cast<boost::uint32_t>(value);
+        words[bit / 32 + 1] |= static_cast<boost::uint32_t>(value >> 32);
+    }
+    size_t offset = out.size();
+    out.resize(offset + words.size() * sizeof(boost::uint32_t));
+    std::memcpy(&out[offset], &words[0], words.size() * sizeof(boost::uint32_t));
+}
+
+/**
+ * @brief 定宽打包数据的字节数
+ */
+size_t fixed_bytes(size_t count, boost::uint8_t bits) {
+    return bits == 0 ? 0 : ((count * bits + 31) / 32 + 1) * sizeof(boost::uint32_t);
+}
+
+#ifdef POSTING_LIST_USE_SSE2
+
+/**
+ * @brief SSE2解包：每次处理4路中的同一行，输出连续的4个整数
+ */
+void unpack_block(const boost::uint8_t* in, boost::uint8_t bits, boost::uint32_t* out) {
+    if (bits == 0) {
+        std::memset(out, 0, PostingList::BLOCK_SIZE * sizeof(boost::uint32_t));
+        return;
+    }
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? -1 : static_cast<int>((1u << bits) - 1));
+    __m128i current = _mm_loadu_si128(src++);
+    int shift = 0;
+    for (size_t i = 0; i < LANE_VALUES; ++i) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+        if (shift + bits > 32) {
+            current = _mm_loadu_si128(src++);
+            value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(32 - shift)));
+            shift = shift + bits - 32;
+        } else if (shift + bits == 32) {
+            if (i + 1 < LANE_VALUES) {
+                current = _mm_loadu_si128(src++);
+            }
+            shift = 0;
+        } else {
+            shift += bits;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_and_si128(value, mask));
+    }
+}
+
+/**
+ * @brief SSE2前缀和：docs[i] = base + sum(gaps[0..i] + 1)
+ */
+void restore_docs(boost::uint32_t* values, DocId base) {
+    const __m128i ones = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t i = 0; i < PostingList::BLOCK_SIZE; i += 4) {
+        __m128i* ptr = reinterpret_cast<__m128i*>(values + i);
+        __m128i v = _mm_add_epi32(_mm_loadu_si128(ptr), ones);
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128(ptr, v);
+        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+/**
+ * @brief SSE2词频还原：tfs[i] += 1
+ */
+void restore_tfs(boost::uint32_t* values) {
+    const __m128i ones = _mm_set1_epi32(1);
+    for (size_t i = 0; i < PostingList::BLOCK_SIZE; i += 4) {
+        __m128i* ptr = reinterpret_cast<__m128i*>(values + i);
+        _mm_storeu_si128(ptr, _mm_add_epi32(_mm_loadu_si128(ptr), ones));
+    }
+}
+
+#else
+
+/**
+ * @brief 标量解包：逐路解出32个整数，结果与SSE2版本一致
+ */
+void unpack_block(const boost::uint8_t* in, boost::uint8_t bits, boost::uint32_t* out) {
+    if (bits == 0) {
+        std::memset(out, 0, PostingList::BLOCK_SIZE * sizeof(boost::uint32_t));
+        return;
+    }
+    boost::uint32_t words[4 * 32];
+    std::memcpy(words, in, 4 * bits * sizeof(boost::uint32_t));
+    const boost::uint32_t mask = bits == 32 ? 0xFFFFFFFFu : ((1u << bits) - 1);
+    for (size_t lane = 0; lane < 4; ++lane) {
+        size_t word = 0;
+        size_t shift = 0;
+        for (size_t i = 0; i < LANE_VALUES; ++i) {
+            boost::uint32_t value = words[word * 4 + lane] >> shift;
+            if (shift + bits >= 32) {
+                word++;
+                if (shift + bits > 32) {
+                    value |= words[word * 4 + lane] << (32 - shift);
+                }
+                shift = shift + bits - 32;
+            } else {
+                shift += bits;
+            }
+            out[i * 4 + lane] = value & mask;
+        }
+    }
+}
+
+/**
+ * @brief 标量前缀和：docs[i] = base + sum(gaps[0..i] + 1)
+ */
+void restore_docs(boost::uint32_t* values, DocId base) {
+    DocId prev = base;
+    for (size_t i = 0; i < PostingList::BLOCK_SIZE; ++i) {
+        prev = prev + values[i] + 1;
+        values[i] = prev;
+    }
+}
+
+/**
+ * @brief 标量词频还原：tfs[i] += 1
+ */
+void restore_tfs(boost::uint32_t* values) {
+    for (size_t i = 0; i < PostingList::BLOCK_SIZE; ++i) {
+        values[i] += 1;
+    }
+}
+
+#endif
+
+} // namespace
+
+const size_t PostingList::BLOCK_SIZE;
+const DocId PostingList::END_DOC;
+
+/**
+ * @brief PostingList的构造函数，创建空的块模式列表
+ */
+PostingList::PostingList()
+    : representation_(BLOCKS), size_(0), last_doc_(END_DOC),
+      max_tf_(0), min_len_(0xFFFFFFFFu), tail_max_tf_(0), tail_min_len_(0xFFFFFFFFu),
+      tail_offset_(0), tf_bits_(0), title_bits_(0), tail_pos_offset_(0),
+      mapped_(false), mapped_blocks_(nullptr), mapped_block_count_(0), mapped_data_(nullptr), mapped_data_size_(0),
+      mapped_positions_(nullptr), mapped_positions_size_(0) {
+}
+
+/**
+ * @brief 追加一条倒排记录
+ * @param doc 文档编号，必须严格递增
+ * @param tf 词频，至少为1
+ * @param title_tf 其中出现在标题中的次数，不超过tf
+ * @param doc_len 文档的词项总数，用于维护分数上界
+ * @param positions 词项在文档中的tf个升序位置，不存储位置时为空指针
+ *
+ * 记录先以变长字节写入尾部，尾部满128条时重新编码为位打包块。
+ */
+void PostingList::append(DocId doc, boost::uint32_t tf, boost::uint32_t title_tf, boost::uint32_t doc_len,
+                         const std::vector<boost::uint32_t>* positions) {
+    detach();
+    if (representation_ == BITMAP) {
+        convert_to_blocks();
+    }
+
+    if (positions) {
+        if (size_ % BLOCK_SIZE == 0) {
+            tail_pos_offset_ = static_cast<boost::uint32_t>(positions_.size());
+        }
+        boost::uint32_t prev = 0;
+        for (boost::uint32_t position : *positions) {
+            write_varbyte(positions_, position - prev);
+            prev = position;
+        }
+    }
+
+    // 空列表时last_doc_为END_DOC，无符号回绕后差值恰好为doc本身
+    write_varbyte(data_, doc - last_doc_ - 1);
+    write_varbyte(data_, tf - 1);
+    write_varbyte(data_, title_tf);
+    size_++;
+    last_doc_ = doc;
+
+    max_tf_ = std::max(max_tf_, tf);
+    min_len_ = std::min(min_len_, doc_len);
+    tail_max_tf_ = std::max(tail_max_tf_, tf);
+    tail_min_len_ = std::min(tail_min_len_, doc_len);
+
+    if (size_ - blocks_.size() * BLOCK_SIZE == BLOCK_SIZE) {
+        seal_tail();
+    }
+}
+
+/**
+ * @brief 收缩存储，并在位图更紧凑时把高频词项切换为位图表示
+ */
+void PostingList::optimize() {
+    detach();
+    if (representation_ == BLOCKS && size_ >= BLOCK_SIZE) {
+        std::vector<Posting> postings = decode();
+
+        std::vector<boost::uint32_t> tfs;
+        std::vector<boost::uint32_t> title_tfs;
+        tfs.reserve(postings.size());
+        title_tfs.reserve(postings.size());
+        boost::uint32_t max_tf = 0;
+        boost::uint32_t max_title_tf = 0;
+        for (const Posting& posting : postings) {
+            tfs.push_back(posting.tf - 1);
+            title_tfs.push_back(posting.title_tf);
+            max_tf = std::max(max_tf, posting.tf - 1);
+            max_title_tf = std::max(max_title_tf, posting.title_tf);
+        }
+        boost::uint8_t tf_bits = bits_needed(max_tf);
+        boost::uint8_t title_bits = bits_needed(max_title_tf);
+
+        size_t bitmap_bytes = bitmap_words() * sizeof(boost::uint64_t);
+        size_t field_bytes = fixed_bytes(size_, tf_bits) + fixed_bytes(size_, title_bits);
+        if (has_positions()) {
+            field_bytes += position_samples() * sizeof(boost::uint32_t);
+        }
+        size_t block_bytes = data_.size() + blocks_.size() * sizeof(BlockInfo);
+
+        if (bitmap_bytes + field_bytes < block_bytes) {
+            std::vector<boost::uint64_t> bitmap(bitmap_words(), 0);
+            for (const Posting& posting : postings) {
+                bitmap[posting.doc / 64] |= static_cast<boost::uint64_t>(1) << (posting.doc % 64);
+            }
+
+            std::vector<boost::uint8_t> data(bitmap_bytes);
+            std::memcpy(&data[0], &bitmap[0], bitmap_bytes);
+            pack_fixed(tfs, tf_bits, data);
+            pack_fixed(title_tfs, title_bits, data);
+            if (has_positions()) {
+                for (size_t sample = 0; sample < position_samples(); ++sample) {
+                    boost::uint32_t offset = position_offset(sample);
+                    size_t at = data.size();
+                    data.resize(at + sizeof(offset));
+                    std::memcpy(&data[at], &offset, sizeof(offset));
+                }
+            }
+
+            std::vector<BlockInfo>().swap(blocks_);
+            data_.swap(data);
+            tail_offset_ = 0;
+            tf_bits_ = tf_bits;
+            title_bits_ = title_bits;
+            representation_ = BITMAP;
+        }
+    }
+
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    positions_.shrink_to_fit();
+}
+
+/**
+ * @brief 将整个列表解码为倒排记录数组
+ * @return 按文档编号升序排列的倒排记录
+ */
+std::vector<Posting> PostingList::decode() const {
+    std::vector<Posting> postings;
+    postings.reserve(size_);
+    for (Iterator it = iterator(); !it.at_end(); it.next()) {
+        postings.push_back(Posting(it.doc(), it.tf(), it.title_tf()));
+    }
+    return postings;
+}
+
+/**
+ * @brief 估算列表占用的内存
+ * @return 对象本身及其堆内存的字节数
+ */
+size_t PostingList::memory_usage() const {
+    if (mapped_) {
+        return sizeof(PostingList) + mapped_block_count_ * sizeof(BlockInfo) + mapped_data_size_ +
+               mapped_positions_size_;
+    }
+    return sizeof(PostingList) + blocks_.capacity() * sizeof(BlockInfo) + data_.capacity() +
+           positions_.capacity();
+}
+
+/**
+ * @brief 报告是否编译了SIMD解码内核
+ */
+bool PostingList::simd_enabled() {
+#ifdef POSTING_LIST_USE_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 写入索引文件
+ * @param writer 索引文件写入器
+ *
+ * 依次写入标量字段与三个数组的长度，随后是按4字节对齐的跳表、数据与位置数组，
+ * 读取时三个数组都可以直接引用映射内存。
+ */
+void PostingList::write(IndexFileWriter& writer) const {
+    writer.write_u8(static_cast<boost::uint8_t>(representation_));
+    writer.write_u8(tf_bits_);
+    writer.write_u8(title_bits_);
+    writer.write_u8(0);
+    writer.write_u32(size_);
+    writer.write_u32(last_doc_);
+    writer.write_u32(max_tf_);
+    writer.write_u32(min_len_);
+    writer.write_u32(tail_max_tf_);
+    writer.write_u32(tail_min_len_);
+    writer.write_u32(tail_offset_);
+    writer.write_u32(tail_pos_offset_);
+    writer.write_u32(static_cast<boost::uint32_t>(block_count()));
+    writer.write_u32(static_cast<boost::uint32_t>(byte_count()));
+    writer.write_u32(static_cast<boost::uint32_t>(position_bytes()));
+    writer.align(sizeof(boost::uint32_t));
+    writer.write(blocks(), block_count() * sizeof(BlockInfo));
+    writer.write(bytes(), byte_count());
+    writer.write(position_data(), position_bytes());
+    writer.align(sizeof(boost::uint32_t));
+}
+
+/**
+ * @brief 从映射的索引文件读取，三个数组直接引用映射内存
+ * @param reader 位于列表起始处的读取游标
+ *
+ * 读取后用validate()检查列表结构，正文损坏导致的不一致在加载时抛出std::runtime_error，
+ * 而不是在查询时越界读取；映射的数据本身只在校验整个正文时（verify_index）受校验和保护。
+ */
+void PostingList::read(IndexFileReader& reader) {
+    representation_ = reader.read_u8() == BITMAP ? BITMAP : BLOCKS;
+    tf_bits_ = reader.read_u8();
+    title_bits_ = reader.read_u8();
+    reader.read_u8();
+    size_ = reader.read_u32();
+    last_doc_ = reader.read_u32();
+    max_tf_ = reader.read_u32();
+    min_len_ = reader.read_u32();
+    tail_max_tf_ = reader.read_u32();
+    tail_min_len_ = reader.read_u32();
+    tail_offset_ = reader.read_u32();
+    tail_pos_offset_ = reader.read_u32();
+    mapped_block_count_ = reader.read_u32();
+    mapped_data_size_ = reader.read_u32();
+    mapped_positions_size_ = reader.read_u32();
+    reader.align(sizeof(boost::uint32_t));
+    mapped_blocks_ = reinterpret_cast<const BlockInfo*>(reader.read(mapped_block_count_ * sizeof(BlockInfo)));
+    mapped_data_ = reader.read(mapped_data_size_);
+    mapped_positions_ = reader.read(mapped_positions_size_);
+    reader.align(sizeof(boost::uint32_t));
+
+    std::vector<BlockInfo>().swap(blocks_);
+    std::vector<boost::uint8_t>().swap(data_);
+    std::vector<boost::uint8_t>().swap(positions_);
+    mapped_ = true;
+    validate();
+}
+
+/**
+ * @brief 检查从索引文件读取的列表结构，查询时按这些结构访问数据不会越界
+ *
+ * 块模式：完整块数与尾部记录数和列表长度一致；各块的数据按偏移依次排列，
+ * 块头的三个位宽都不超过32，位打包数据不越过下一块（最后一块不越过尾部）；
+ * 块的最后文档编号递增；尾部的变长整数都在数据末尾之前结束。
+ * 位图模式：位宽不超过32，位图、定宽字段与位置偏移表都在数据之内，位图的置位数等于记录数。
+ * 位置数据：各组的起始偏移递增且不越界，最后一个字节是变长整数的结尾，
+ * 迭代器逐条解码时只需在每个整数开始前检查数据末尾。只读取跳表、块头与尾部，不解码完整块。
+ */
+void PostingList::validate() const {
+    const boost::uint8_t* data = bytes();
+    size_t data_size = byte_count();
+    size_t position_size = position_bytes();
+    bool valid = true;
+
+    if (representation_ == BLOCKS) {
+        const BlockInfo* infos = blocks();
+        size_t count = block_count();
+        valid = count * BLOCK_SIZE <= size_ && size_ - count * BLOCK_SIZE < BLOCK_SIZE && tail_offset_ <= data_size &&
+                tail_pos_offset_ <= position_size;
+        for (size_t block = 0; valid && block < count; ++block) {
+            const BlockInfo& info = infos[block];
+            size_t end = block + 1 < count ? infos[block + 1].offset : tail_offset_;
+            valid = static_cast<size_t>(info.offset) + BLOCK_HEADER_SIZE <= end && end <= data_size &&
+                    info.pos_offset <= (block + 1 < count ? infos[block + 1].pos_offset : tail_pos_offset_) &&
+                    (block == 0 || info.last_doc > infos[block - 1].last_doc);
+            if (valid) {
+                const boost::uint8_t* header = data + info.offset;
+                valid = header[0] <= 32 && header[1] <= 32 && header[2] <= 32 &&
+                        info.offset + BLOCK_HEADER_SIZE + 16 * (header[0] + header[1] + header[2]) <= end;
+            }
+        }
+
+        // 尾部每条记录是三个变长整数
+        const boost::uint8_t* in = data + (valid ? tail_offset_ : 0);
+        for (size_t i = (size_ - count * BLOCK_SIZE) * 3; valid && i > 0; --i) {
+            valid = skip_varbyte(in, data + data_size);
+        }
+    } else {
+        valid = size_ > 0 && last_doc_ != END_DOC && tf_bits_ <= 32 && title_bits_ <= 32 &&
+                bitmap_positions_offset() + (has_positions() ? position_samples() * sizeof(boost::uint32_t) : 0) <=
+                    data_size;
+        size_t bits = 0;
+        for (size_t word = 0; valid && word < bitmap_words(); ++word) {
+            bits += popcount64(bitmap_word(word));
+        }
+        valid = valid && bits == size_;
+        boost::uint32_t previous = 0;
+        for (size_t sample = 0; valid && has_positions() && sample < position_samples(); ++sample) {
+            boost::uint32_t offset = position_offset(sample);
+            valid = offset >= previous && offset <= position_size;
+            previous = offset;
+        }
+    }
+
+    if (valid && position_size > 0) {
+        valid = (position_data()[position_size - 1] & 0x80) == 0;
+    }
+    if (!valid) {
+        throw std::runtime_error("Index file is corrupted (inconsistent posting list)");
+    }
+}
+
+/**
+ * @brief 把映射内存中的数组复制为自有存储
+ */
+void PostingList::detach() {
+    if (!mapped_) {
+        return;
+    }
+    blocks_.assign(mapped_blocks_, mapped_blocks_ + mapped_block_count_);
+    data_.assign(mapped_data_, mapped_data_ + mapped_data_size_);
+    positions_.assign(mapped_positions_, mapped_positions_ + mapped_positions_size_);
+    mapped_ = false;
+    mapped_blocks_ = nullptr;
+    mapped_block_count_ = 0;
+    mapped_data_ = nullptr;
+    mapped_data_size_ = 0;
+    mapped_positions_ = nullptr;
+    mapped_positions_size_ = 0;
+}
+
+/**
+ * @brief 把尾部的128条变长记录编码为一个位打包块
+ */
+void PostingList::seal_tail() {
+    boost::uint32_t docs[BLOCK_SIZE];
+    boost::uint32_t tfs[BLOCK_SIZE];
+    boost::uint32_t title_tfs[BLOCK_SIZE];
+    decode_tail(docs, tfs, title_tfs);
+
+    // 还原为差值形式，并计算三组数据各自需要的位宽
+    DocId prev = blocks_.empty() ? END_DOC : blocks_.back().last_doc;
+    boost::uint32_t max_gap = 0;
+    boost::uint32_t max_tf = 0;
+    boost::uint32_t max_title_tf = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        DocId doc = docs[i];
+        docs[i] = doc - prev - 1;
+        prev = doc;
+        tfs[i] -= 1;
+        max_gap = std::max(max_gap, docs[i]);
+        max_tf = std::max(max_tf, tfs[i]);
+        max_title_tf = std::max(max_title_tf, title_tfs[i]);
+    }
+
+    BlockInfo info;
+    info.last_doc = last_doc_;
+    info.offset = tail_offset_;
+    info.max_tf = tail_max_tf_;
+    info.min_len = tail_min_len_;
+    info.pos_offset = tail_pos_offset_;
+    tail_max_tf_ = 0;
+    tail_min_len_ = 0xFFFFFFFFu;
+
+    data_.resize(tail_offset_);
+    boost::uint8_t gap_bits = bits_needed(max_gap);
+    boost::uint8_t tf_bits = bits_needed(max_tf);
+    boost::uint8_t title_bits = bits_needed(max_title_tf);
+    data_.push_back(gap_bits);
+    data_.push_back(tf_bits);
+    data_.push_back(title_bits);
+    pack_block(docs, gap_bits, data_);
+    pack_block(tfs, tf_bits, data_);
+    pack_block(title_tfs, title_bits, data_);
+
+    blocks_.push_back(info);
+    tail_offset_ = static_cast<boost::uint32_t>(data_.size());
+}
+
+/**
+ * @brief 解码尾部的变长字节记录
+ * @return 尾部记录条数
+ */
+size_t PostingList::decode_tail(boost::uint32_t* docs, boost::uint32_t* tfs, boost::uint32_t* title_tfs) const {
+    size_t count = size_ - block_count() * BLOCK_SIZE;
+    if (count == 0) {
+        return 0;
+    }
+    const boost::uint8_t* in = bytes() + tail_offset_;
+    DocId prev = block_count() == 0 ? END_DOC : blocks()[block_count() - 1].last_doc;
+    for (size_t i = 0; i < count; ++i) {
+        prev = prev + read_varbyte(in) + 1;
+        docs[i] = prev;
+        tfs[i] = read_varbyte(in) + 1;
+        title_tfs[i] = read_varbyte(in);
+    }
+    return count;
+}
+
+/**
+ * @brief 解码一个完整块
+ */
+void PostingList::decode_block(size_t block, boost::uint32_t* docs, boost::uint32_t* tfs,
+                               boost::uint32_t* title_tfs) const {
+    const boost::uint8_t* in = bytes() + blocks()[block].offset;
+    boost::uint8_t gap_bits = in[0];
+    boost::uint8_t tf_bits = in[1];
+    boost::uint8_t title_bits = in[2];
+    in += BLOCK_HEADER_SIZE;
+
+    unpack_block(in, gap_bits, docs);
+    restore_docs(docs, block == 0 ? END_DOC : blocks()[block - 1].last_doc);
+    in += 16 * gap_bits;
+
+    unpack_block(in, tf_bits, tfs);
+    restore_tfs(tfs);
+    in += 16 * tf_bits;
+
+    unpack_block(in, title_bits, title_tfs);
+}
+
+/**
+ * @brief 把位图表示还原为块表示，以便继续追加记录
+ *
+ * 位图不保留逐条的文档长度，重建的块以整个列表的最短长度作为下界。
+ */
+void PostingList::convert_to_blocks() {
+    std::vector<Posting> postings = decode();
+    boost::uint32_t min_len = min_len_;
+    std::vector<boost::uint32_t> samples;
+    if (has_positions()) {
+        for (size_t sample = 0; sample < position_samples(); ++sample) {
+            samples.push_back(position_offset(sample));
+        }
+    }
+
+    data_.clear();
+    tail_offset_ = 0;
+    tf_bits_ = 0;
+    title_bits_ = 0;
+    representation_ = BLOCKS;
+    size_ = 0;
+    last_doc_ = END_DOC;
+
+    for (const Posting& posting : postings) {
+        append(posting.doc, posting.tf, posting.title_tf, min_len);
+    }
+
+    // 位置数据本身不变，只需把分组偏移写回跳表
+    for (size_t block = 0; block < blocks_.size() && block < samples.size(); ++block) {
+        blocks_[block].pos_offset = samples[block];
+    }
+    tail_pos_offset_ = blocks_.size() < samples.size() ? samples[blocks_.size()]
+                                                       : static_cast<boost::uint32_t>(positions_.size());
+}
+
+/**
+ * @brief 倍增查找第一个last_doc不小于target的完整块
+ * @param first 查找的起始块序号
+ * @param target 目标文档编号
+ * @return 块序号，所有完整块都小于target时返回块数
+ */
+size_t PostingList::find_block(size_t first, DocId target) const {
+    const BlockInfo* infos = blocks();
+    size_t count = block_count();
+    size_t lo = first;
+    size_t hi = lo;
+    size_t step = 1;
+    while (hi < count && infos[hi].last_doc < target) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    size_t end = std::min(hi + 1, count);
+    if (lo >= end) {
+        return lo;
+    }
+    return std::lower_bound(infos + lo, infos + end, target,
+                            [](const BlockInfo& info, DocId value) {
+                                return info.last_doc < value;
+                            }) - infos;
+}
+
+/**
+ * @brief 位图模式下读取第index个位图字
+ */
+boost::uint64_t PostingList::bitmap_word(size_t index) const {
+    boost::uint64_t word;
+    std::memcpy(&word, bytes() + index * sizeof(boost::uint64_t), sizeof(word));
+    return word;
+}
+
+/**
+ * @brief 位图模式下定宽标题词频的起始偏移
+ */
+size_t PostingList::bitmap_title_offset() const {
+    return bitmap_tf_offset() + fixed_bytes(size_, tf_bits_);
+}
+
+/**
+ * @brief 位图模式下位置偏移表的起始偏移
+ */
+size_t PostingList::bitmap_positions_offset() const {
+    return bitmap_title_offset() + fixed_bytes(size_, title_bits_);
+}
+
+/**
+ * @brief 读取第sample组记录的位置数据起始偏移
+ */
+boost::uint32_t PostingList::position_offset(size_t sample) const {
+    if (representation_ == BITMAP) {
+        boost::uint32_t offset;
+        std::memcpy(&offset, bytes() + bitmap_positions_offset() + sample * sizeof(offset), sizeof(offset));
+        return offset;
+    }
+    return sample < block_count() ? blocks()[sample].pos_offset : tail_pos_offset_;
+}
+
+/**
+ * @brief 位图模式下按秩读取定宽字段
+ * @param offset 字段数据在data_中的起始偏移
+ * @param bits 字段位宽，为0时所有值均为0
+ * @param rank 记录的秩
+ */
+boost::uint32_t PostingList::bitmap_field(size_t offset, boost::uint8_t bits, size_t rank) const {
+    if (bits == 0) {
+        return 0;
+    }
+    size_t bit = rank * bits;
+    boost::uint64_t word;
+    std::memcpy(&word, bytes() + offset + bit / 32 * sizeof(boost::uint32_t), sizeof(word));
+    boost::uint64_t mask = (static_cast<boost::uint64_t>(1) << bits) - 1;
+    return static_cast<boost::uint32_t>((word >> (bit % 32)) & mask);
+}
+
+/**
+ * @brief 迭代器构造函数，定位到列表的第一条记录
+ * @param list 被遍历的倒排列表，生命周期必须长于迭代器
+ */
+PostingList::Iterator::Iterator(const PostingList* list)
+    : list_(list), doc_(END_DOC), block_(0), pos_(0), count_(0), word_(0), word_rank_(0),
+      pos_rank_(0), pos_offset_(0) {
+    if (list_->empty()) {
+        return;
+    }
+    if (list_->representation_ == BITMAP) {
+        seek_bitmap(0);
+    } else {
+        load_block(0);
+    }
+}
+
+/**
+ * @brief 返回当前记录的词频
+ */
+boost::uint32_t PostingList::Iterator::tf() const {
+    if (list_->representation_ == BITMAP) {
+        return list_->bitmap_field(list_->bitmap_tf_offset(), list_->tf_bits_, bitmap_rank()) + 1;
+    }
+    return tfs_[pos_];
+}
+
+/**
+ * @brief 返回当前记录在标题中的词频
+ */
+boost::uint32_t PostingList::Iterator::title_tf() const {
+    if (list_->representation_ == BITMAP) {
+        return list_->bitmap_field(list_->bitmap_title_offset(), list_->title_bits_, bitmap_rank());
+    }
+    return title_tfs_[pos_];
+}
+
+/**
+ * @brief 解码当前记录的位置列表
+ * @param out 输出：升序的位置，列表未存储位置时为空
+ *
+ * 从所在采样区间的起点（或上次解码停下的位置）向后跳过前面记录的位置数据，
+ * 顺序访问时每条记录的位置数据只被读取一次。
+ */
+void PostingList::Iterator::positions(std::vector<boost::uint32_t>& out) {
+    out.clear();
+    if (at_end() || !list_->has_positions()) {
+        return;
+    }
+
+    size_t current = rank();
+    if (pos_rank_ > current || pos_rank_ / BLOCK_SIZE != current / BLOCK_SIZE) {
+        pos_rank_ = current / BLOCK_SIZE * BLOCK_SIZE;
+        pos_offset_ = list_->position_offset(current / BLOCK_SIZE);
+    }
+
+    const boost::uint8_t* base = list_->position_data();
+    const boost::uint8_t* end = base + list_->position_bytes();
+    const boost::uint8_t* in = base + pos_offset_;
+    for (; pos_rank_ < current; ++pos_rank_) {
+        for (boost::uint32_t i = tf_at(pos_rank_); i > 0 && in < end; --i) {
+            read_varbyte(in);
+        }
+    }
+    pos_offset_ = in - base;
+
+    // 最后一个字节是变长整数的结尾（加载时已检查），损坏的词频最多使解码停在数据末尾
+    boost::uint32_t position = 0;
+    for (boost::uint32_t i = tf(); i > 0 && in < end; --i) {
+        position += read_varbyte(in);
+        out.push_back(position);
+    }
+}
+
+/**
+ * @brief 移动到下一条记录
+ */
+void PostingList::Iterator::next() {
+    if (at_end()) {
+        return;
+    }
+    if (list_->representation_ == BITMAP) {
+        seek_bitmap(doc_ + 1);
+        return;
+    }
+    if (++pos_ < count_) {
+        doc_ = docs_[pos_];
+    } else {
+        load_block(block_ + 1);
+    }
+}
+
+/**
+ * @brief 跳转到第一个编号不小于target的记录
+ * @param target 目标文档编号
+ *
+ * 块模式下先在跳表上做倍增查找（galloping）定位目标块，
+ * 只解码该块，再在块内二分查找；位图模式下直接按字定位。
+ */
+void PostingList::Iterator::advance(DocId target) {
+    if (at_end() || target <= doc_) {
+        return;
+    }
+    if (list_->representation_ == BITMAP) {
+        seek_bitmap(target);
+        return;
+    }
+
+    if (target > docs_[count_ - 1]) {
+        if (block_ >= list_->block_count() || target > list_->last_doc_) {
+            doc_ = END_DOC;
+            return;
+        }
+        load_block(list_->find_block(block_ + 1, target));
+        if (at_end()) {
+            return;
+        }
+    }
+
+    pos_ = std::lower_bound(docs_ + pos_, docs_ + count_, target) - docs_;
+    doc_ = docs_[pos_];
+}
+
+/**
+ * @brief 查询包含target的块的分数上界统计，不解码块数据
+ * @param target 目标文档编号，不小于当前文档编号
+ * @param max_tf 输出：块内最大词频
+ * @param min_len 输出：块内最短文档长度
+ * @return 块内最后一个文档编号，target之后已无记录时返回END_DOC
+ *
+ * 位图模式与变长尾部没有逐块统计，分别使用整个列表和尾部的统计值。
+ */
+DocId PostingList::Iterator::block_bounds(DocId target, boost::uint32_t& max_tf, boost::uint32_t& min_len) const {
+    if (at_end() || target > list_->last_doc_) {
+        max_tf = 0;
+        min_len = 0xFFFFFFFFu;
+        return END_DOC;
+    }
+    if (list_->representation_ == BITMAP) {
+        max_tf = list_->max_tf_;
+        min_len = list_->min_len_;
+        return list_->last_doc_;
+    }
+
+    size_t block = block_;
+    if (block < list_->block_count() && target > list_->blocks()[block].last_doc) {
+        block = list_->find_block(block + 1, target);
+    }
+    if (block < list_->block_count()) {
+        const BlockInfo& info = list_->blocks()[block];
+        max_tf = info.max_tf;
+        min_len = info.min_len;
+        return info.last_doc;
+    }
+    max_tf = list_->tail_max_tf_;
+    min_len = list_->tail_min_len_;
+    return list_->last_doc_;
+}
+
+/**
+ * @brief 解码指定的块（块序号等于完整块数时为尾部）
+ */
+void PostingList::Iterator::load_block(size_t block) {
+    block_ = block;
+    pos_ = 0;
+    if (block < list_->block_count()) {
+        list_->decode_block(block, docs_, tfs_, title_tfs_);
+        count_ = BLOCK_SIZE;
+    } else if (block == list_->block_count()) {
+        count_ = list_->decode_tail(docs_, tfs_, title_tfs_);
+    } else {
+        count_ = 0;
+    }
+    doc_ = count_ > 0 ? docs_[0] : END_DOC;
+}
+
+/**
+ * @brief 位图模式下定位到第一个编号不小于from的记录
+ */
+void PostingList::Iterator::seek_bitmap(DocId from) {
+    size_t word_count = list_->bitmap_words();
+    size_t target_word = from / 64;
+    if (target_word >= word_count) {
+        doc_ = END_DOC;
+        return;
+    }
+    while (word_ < target_word) {
+        word_rank_ += popcount64(list_->bitmap_word(word_));
+        word_++;
+    }
+    boost::uint64_t word = list_->bitmap_word(word_) & (~static_cast<boost::uint64_t>(0) << (from % 64));
+    while (word == 0) {
+        word_rank_ += popcount64(list_->bitmap_word(word_));
+        word_++;
+        if (word_ >= word_count) {
+            doc_ = END_DOC;
+            return;
+        }
+        word = list_->bitmap_word(word_);
+    }
+    doc_ = static_cast<DocId>(word_ * 64 + lowest_bit64(word));
+}
+
+/**
+ * @brief 位图模式下当前记录的秩（之前的记录数）
+ */
+size_t PostingList::Iterator::bitmap_rank() const {
+    boost::uint64_t below = list_->bitmap_word(word_) & ((static_cast<boost::uint64_t>(1) << (doc_ % 64)) - 1);
+    return word_rank_ + popcount64(below);
+}
+
+/**
+ * @brief 当前记录的秩（之前的记录数）
+ */
+size_t PostingList::Iterator::rank() const {
+    if (list_->representation_ == BITMAP) {
+        return bitmap_rank();
+    }
+    return block_ * BLOCK_SIZE + pos_;
+}
+
+/**
+ * @brief 读取第rank条记录的词频，块模式下该记录必须位于当前已解码的块内
+ */
+boost::uint32_t PostingList::Iterator::tf_at(size_t rank) const {
+    if (list_->representation_ == BITMAP) {
+        return list_->bitmap_field(list_->bitmap_tf_offset(), list_->tf_bits_, rank) + 1;
+    }
+    return tfs_[rank - block_ * BLOCK_SIZE];
+}
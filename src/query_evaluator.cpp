@@ -0,0 +1,428 @@
+/**
+ * @file query_evaluator.cpp
+ * @brief 结构化查询求值器的实现文件
+ *
+ * 实现倒排列表上的交、并、差迭代器，以及把查询语法树规划为迭代器树的规划器。
+ * 求交采用领跑者算法：最稀有的列表给出候选文档，其余列表只向前跳转，
+ * 每次跳转在块跳表上做倍增查找，不会逐条扫描长列表。
+ * 短语在求交得到的候选文档上再解码位置列表，校验各词项的相对位置。
+ */
+
+#include "query_evaluator.h"
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <set>
+
+namespace {
+
+/**
+ * @brief 单个倒排列表的迭代器
+ */
+class TermIterator : public DocIterator
+{
+public:
+    explicit TermIterator(const PostingList* postings)
+        : it_(postings->iterator()), size_(postings->size()) {}
+
+    DocId doc() const { return it_.doc(); }
+    void next() { it_.next(); }
+    void advance(DocId target) { it_.advance(target); }
+    size_t cost() const { return size_; }
+
+    // 当前文档中的位置列表
+    void positions(std::vector<boost::uint32_t>& out) { it_.positions(out); }
+
+private:
+    PostingList::Iterator it_;
+    size_t size_;
+};
+
+typedef boost::shared_ptr<TermIterator> TermIteratorPtr;
+
+/**
+ * @brief 交集迭代器：子迭代器按代价升序排列，第一个为领跑者
+ */
+class ConjunctionIterator : public DocIterator
+{
+public:
+    explicit ConjunctionIterator(const std::vector<DocIteratorPtr>& children)
+        : children_(children) {
+        std::sort(children_.begin(), children_.end(), CostLess());
+        doc_ = align(children_[0]->doc());
+    }
+
+    DocId doc() const { return doc_; }
+
+    void next() {
+        if (doc_ == PostingList::END_DOC) {
+            return;
+        }
+        children_[0]->next();
+        doc_ = align(children_[0]->doc());
+    }
+
+    void advance(DocId target) {
+        if (doc_ == PostingList::END_DOC || target <= doc_) {
+            return;
+        }
+        children_[0]->advance(target);
+        doc_ = align(children_[0]->doc());
+    }
+
+    size_t cost() const { return children_[0]->cost(); }
+
+private:
+    struct CostLess {
+        bool operator()(const DocIteratorPtr& a, const DocIteratorPtr& b) const {
+            return a->cost() < b->cost();
+        }
+    };
+
+    std::vector<DocIteratorPtr> children_;
+    DocId doc_;
+
+    // 从候选文档开始，找到所有子迭代器共同包含的第一个文档
+    DocId align(DocId candidate) {
+        while (candidate != PostingList::END_DOC) {
+            size_t i = 1;
+            for (; i < children_.size(); ++i) {
+                children_[i]->advance(candidate);
+                if (children_[i]->doc() != candidate) {
+                    break;
+                }
+            }
+            if (i == children_.size()) {
+                return candidate;
+            }
+            // 其他列表越过了候选文档，领跑者跳到该位置继续
+            children_[0]->advance(children_[i]->doc());
+            candidate = children_[0]->doc();
+        }
+        return PostingList::END_DOC;
+    }
+};
+
+/**
+ * @brief 并集迭代器：子句数量很少，直接线性取最小编号
+ */
+class DisjunctionIterator : public DocIterator
+{
+public:
+    explicit DisjunctionIterator(const std::vector<DocIteratorPtr>& children)
+        : children_(children), cost_(0) {
+        for (const DocIteratorPtr& child : children_) {
+            cost_ += child->cost();
+        }
+        doc_ = min_doc();
+    }
+
+    DocId doc() const { return doc_; }
+
+    void next() {
+        if (doc_ == PostingList::END_DOC) {
+            return;
+        }
+        for (const DocIteratorPtr& child : children_) {
+            if (child->doc() == doc_) {
+                child->next();
+            }
+        }
+        doc_ = min_doc();
+    }
+
+    void advance(DocId target) {
+        if (doc_ == PostingList::END_DOC || target <= doc_) {
+            return;
+        }
+        for (const DocIteratorPtr& child : children_) {
+            child->advance(target);
+        }
+        doc_ = min_doc();
+    }
+
+    size_t cost() const { return cost_; }
+
+private:
+    std::vector<DocIteratorPtr> children_;
+    size_t cost_;
+    DocId doc_;
+
+    DocId min_doc() const {
+        DocId result = PostingList::END_DOC;
+        for (const DocIteratorPtr& child : children_) {
+            result = std::min(result, child->doc());
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief 差集迭代器：枚举包含于include但不包含于exclude的文档
+ */
+class ExclusionIterator : public DocIterator
+{
+public:
+    ExclusionIterator(const DocIteratorPtr& include, const DocIteratorPtr& exclude)
+        : include_(include), exclude_(exclude) {
+        skip_excluded();
+    }
+
+    DocId doc() const { return include_->doc(); }
+
+    void next() {
+        include_->next();
+        skip_excluded();
+    }
+
+    void advance(DocId target) {
+        include_->advance(target);
+        skip_excluded();
+    }
+
+    size_t cost() const { return include_->cost(); }
+
+private:
+    DocIteratorPtr include_;
+    DocIteratorPtr exclude_;
+
+    void skip_excluded() {
+        while (include_->doc() != PostingList::END_DOC) {
+            exclude_->advance(include_->doc());
+            if (exclude_->doc() != include_->doc()) {
+                return;
+            }
+            include_->next();
+        }
+    }
+};
+
+/**
+ * @brief 短语迭代器：在各词项的交集上校验位置，要求存在起点p使第i个词项出现在p + offsets[i]
+ */
+class PhraseIterator : public DocIterator
+{
+public:
+    PhraseIterator(const std::vector<TermIteratorPtr>& terms, const std::vector<boost::uint32_t>& offsets)
+        : terms_(terms), offsets_(offsets) {
+        std::vector<DocIteratorPtr> children(terms_.begin(), terms_.end());
+        conjunction_.reset(new ConjunctionIterator(children));
+        skip_mismatched();
+    }
+
+    DocId doc() const { return conjunction_->doc(); }
+
+    void next() {
+        conjunction_->next();
+        skip_mismatched();
+    }
+
+    void advance(DocId target) {
+        conjunction_->advance(target);
+        skip_mismatched();
+    }
+
+    size_t cost() const { return conjunction_->cost(); }
+
+private:
+    std::vector<TermIteratorPtr> terms_;
+    std::vector<boost::uint32_t> offsets_;
+    DocIteratorPtr conjunction_;
+    std::vector<boost::uint32_t> starts_;
+    std::vector<boost::uint32_t> positions_;
+
+    void skip_mismatched() {
+        while (conjunction_->doc() != PostingList::END_DOC && !matches()) {
+            conjunction_->next();
+        }
+    }
+
+    // 以第一个词项的位置为候选起点，依次用其余词项过滤
+    bool matches() {
+        terms_[0]->positions(starts_);
+        for (size_t i = 1; i < terms_.size() && !starts_.empty(); ++i) {
+            terms_[i]->positions(positions_);
+            size_t kept = 0;
+            for (size_t j = 0; j < starts_.size(); ++j) {
+                if (std::binary_search(positions_.begin(), positions_.end(), starts_[j] + offsets_[i])) {
+                    starts_[kept++] = starts_[j];
+                }
+            }
+            starts_.resize(kept);
+        }
+        return !starts_.empty();
+    }
+};
+
+/**
+ * @brief 把若干子迭代器合并为交集或并集，只有一个时直接返回
+ */
+DocIteratorPtr combine(const std::vector<DocIteratorPtr>& children, bool conjunction) {
+    if (children.empty()) {
+        return DocIteratorPtr();
+    }
+    if (children.size() == 1) {
+        return children[0];
+    }
+    if (conjunction) {
+        return DocIteratorPtr(new ConjunctionIterator(children));
+    }
+    return DocIteratorPtr(new DisjunctionIterator(children));
+}
+
+/**
+ * @brief 最小堆比较器：分数低的文档位于堆顶，分数相同时编号大的位于堆顶
+ *
+ * 分数相同的文档总是优先保留先添加的，结果与文档在索引中如何分段无关。
+ */
+struct ScoreGreater {
+    bool operator()(const ScoredDoc& a, const ScoredDoc& b) const {
+        return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+    }
+};
+
+} // namespace
+
+/**
+ * @brief QueryEvaluator的构造函数
+ * @param scorer 打分器，生命周期必须长于求值器
+ * @param lookup 词项到倒排列表的查找函数
+ * @param k 需要返回的结果数
+ */
+QueryEvaluator::QueryEvaluator(const Scorer& scorer, const PostingLookup& lookup, size_t k)
+    : scorer_(scorer), lookup_(lookup), k_(k), max_score_(0.0) {
+}
+
+/**
+ * @brief 添加一个参与打分的词项
+ * @param postings 词项的倒排列表，生命周期必须长于求值器
+ * @param weight 词项权重
+ */
+void QueryEvaluator::add_term(const PostingList* postings, double weight) {
+    if (postings->empty() || weight <= 0.0) {
+        return;
+    }
+    terms_.push_back(ScoringTerm(postings, weight));
+    max_score_ += scorer_.upper_bound(weight, postings->max_tf(), postings->min_len());
+}
+
+/**
+ * @brief 执行求值
+ * @param query 查询语法树
+ * @param filter 文档有效性判断
+ * @return 按分数降序排列的前k个匹配文档
+ */
+std::vector<ScoredDoc> QueryEvaluator::evaluate(const QueryNode& query, const TopKEvaluator::DocFilter& filter) {
+    DocIteratorPtr matcher = plan(query);
+    if (!matcher || k_ == 0) {
+        return std::vector<ScoredDoc>();
+    }
+
+    std::priority_queue<ScoredDoc, std::vector<ScoredDoc>, ScoreGreater> heap;
+    for (DocId doc = matcher->doc(); doc != PostingList::END_DOC; matcher->next(), doc = matcher->doc()) {
+        if (heap.size() == k_ && max_score_ <= heap.top().score) {
+            break; // 剩余文档的分数不可能超过当前第k名
+        }
+        if (!filter(doc)) {
+            continue;
+        }
+
+        double score = 0.0;
+        for (ScoringTerm& term : terms_) {
+            term.it.advance(doc);
+            if (term.it.doc() == doc) {
+                score += scorer_.score(term.weight, term.it.tf(), term.it.title_tf(), doc);
+            }
+        }
+
+        if (heap.size() < k_) {
+            heap.push(ScoredDoc(doc, score));
+        } else if (score > heap.top().score) {
+            heap.pop();
+            heap.push(ScoredDoc(doc, score));
+        }
+    }
+
+    std::vector<ScoredDoc> results;
+    results.reserve(heap.size());
+    while (!heap.empty()) {
+        results.push_back(heap.top());
+        heap.pop();
+    }
+    std::reverse(results.begin(), results.end());
+    return results;
+}
+
+/**
+ * @brief 把语法树节点规划为文档迭代器
+ * @param node 语法树节点
+ * @return 文档迭代器，不可能有匹配时返回空指针
+ */
+DocIteratorPtr QueryEvaluator::plan(const QueryNode& node) const {
+    if (node.type == QueryNode::PHRASE && node.terms.size() > 1) {
+        // 同一起点上的n-gram互相包含，每个相对位置只保留最长的词项
+        std::map<boost::uint32_t, std::string> longest;
+        for (size_t i = 0; i < node.terms.size(); ++i) {
+            std::string& term = longest[node.positions[i]];
+            if (node.terms[i].length() > term.length()) {
+                term = node.terms[i];
+            }
+        }
+
+        std::vector<TermIteratorPtr> terms;
+        std::vector<boost::uint32_t> offsets;
+        bool positional = true;
+        for (const auto& pair : longest) {
+            const PostingList* postings = lookup_(pair.second);
+            if (!postings || postings->empty()) {
+                return DocIteratorPtr();
+            }
+            positional = positional && postings->has_positions();
+            terms.push_back(TermIteratorPtr(new TermIterator(postings)));
+            offsets.push_back(pair.first);
+        }
+        if (terms.size() > 1 && positional) {
+            return DocIteratorPtr(new PhraseIterator(terms, offsets));
+        }
+        // 索引未存储位置时退化为词项交集
+    }
+
+    if (node.type != QueryNode::BOOLEAN) {
+        // 查询词与短语：所有索引词项的交集，任一词项不存在即无匹配
+        std::set<std::string> seen;
+        std::vector<DocIteratorPtr> children;
+        for (const std::string& term : node.terms) {
+            if (!seen.insert(term).second) {
+                continue;
+            }
+            const PostingList* postings = lookup_(term);
+            if (!postings || postings->empty()) {
+                return DocIteratorPtr();
+            }
+            children.push_back(DocIteratorPtr(new TermIterator(postings)));
+        }
+        return combine(children, true);
+    }
+
+    std::vector<DocIteratorPtr> required;
+    std::vector<DocIteratorPtr> optional;
+    std::vector<DocIteratorPtr> excluded;
+    for (const QueryClause& clause : node.clauses) {
+        DocIteratorPtr child = plan(*clause.node);
+        if (clause.occur == QueryClause::MUST) {
+            if (!child) {
+                return DocIteratorPtr(); // 必选子句无匹配，整体无匹配
+            }
+            required.push_back(child);
+        } else if (child) {
+            (clause.occur == QueryClause::SHOULD ? optional : excluded).push_back(child);
+        }
+    }
+
+    // 有必选子句时可选子句只影响分数，不参与匹配
+    DocIteratorPtr matcher = required.empty() ? combine(optional, false) : combine(required, true);
+    if (!matcher || excluded.empty()) {
+        return matcher;
+    }
+    return DocIteratorPtr(new ExclusionIterator(matcher, combine(excluded, false)));
+}
@@ -0,0 +1,354 @@
+/**
+ * @file query_parser.cpp
+ * @brief 查询解析器的实现文件
+ *
+ * 把用户输入的查询字符串解析为语法树。查询词与短语使用与建立索引时
+ * 相同的`TextProcessor`流程切分为索引词项，停用词在这里被去除，
+ * 因此只由停用词构成的子句会被整体丢弃。
+ */
+
+#include "query_parser.h"
+#include "levenshtein_automaton.h"
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @brief 统计参与打分的索引词项
+ * @param counts 输出：词项 -> 在查询中出现的次数，每次出现按所在节点的boost计
+ */
+void QueryNode::collect_terms(std::map<std::string, double>& counts) const {
+    if (type != BOOLEAN) {
+        for (const std::string& term : terms) {
+            counts[term] += boost;
+        }
+        return;
+    }
+    for (const QueryClause& clause : clauses) {
+        if (clause.occur != QueryClause::MUST_NOT) {
+            clause.node->collect_terms(counts);
+        }
+    }
+}
+
+/**
+ * @brief 列出每个查询词或短语的代表词项
+ * @param keys 输出：按查询顺序排列，取各查询词或短语中字节最长的索引词项
+ *
+ * 中文查询词会切分出多个n-gram，最长的那个最能代表整个词；
+ * 排除子句中的词项不参与邻近度计算。
+ */
+void QueryNode::collect_key_terms(std::vector<std::string>& keys) const {
+    if (type != BOOLEAN) {
+        size_t longest = 0;
+        for (size_t i = 1; i < terms.size(); ++i) {
+            if (terms[i].length() > terms[longest].length()) {
+                longest = i;
+            }
+        }
+        keys.push_back(terms[longest]);
+        return;
+    }
+    for (const QueryClause& clause : clauses) {
+        if (clause.occur != QueryClause::MUST_NOT) {
+            clause.node->collect_key_terms(keys);
+        }
+    }
+}
+
+/**
+ * @brief 判断查询是否只是若干可选查询词的并集
+ * @return 所有子句都是SHOULD且都是单个查询词时返回true
+ */
+bool QueryNode::is_disjunction() const {
+    if (type != BOOLEAN) {
+        return false;
+    }
+    for (const QueryClause& clause : clauses) {
+        if (clause.occur != QueryClause::SHOULD || clause.node->type != TERM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 生成规范化字符串，只依赖分词后的词项与结构
+ * @return 例如 (+"boost asio" -java [搜 索 搜索] serch~1)
+ */
+std::string QueryNode::to_string() const {
+    std::string result;
+    if (type == BOOLEAN) {
+        result = "(";
+        for (size_t i = 0; i < clauses.size(); ++i) {
+            if (i > 0) {
+                result += " ";
+            }
+            if (clauses[i].occur == QueryClause::MUST) {
+                result += "+";
+            } else if (clauses[i].occur == QueryClause::MUST_NOT) {
+                result += "-";
+            }
+            result += clauses[i].node->to_string();
+        }
+        return result + ")";
+    }
+
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (i > 0) {
+            result += " ";
+        }
+        result += terms[i];
+        // 短语中停用词留下的空位会改变匹配结果，也要体现在规范化字符串中
+        if (type == PHRASE && positions[i] != i) {
+            result += "@" + std::to_string(positions[i]);
+        }
+    }
+    if (type == PHRASE) {
+        return "\"" + result + "\"";
+    }
+    if (max_edits > 0) {
+        result += "~" + std::to_string(max_edits);
+    }
+    return terms.size() > 1 ? "[" + result + "]" : result;
+}
+
+/**
+ * @brief QueryParser的构造函数
+ */
+QueryParser::QueryParser() : pos_(0), field_(FIELD_DEFAULT) {
+}
+
+/**
+ * @brief 解析查询字符串
+ * @param query 用户输入的查询
+ * @return 语法树根节点（BOOLEAN），没有有效词项时子句为空
+ */
+QueryNodePtr QueryParser::parse(const std::string& query) {
+    lex(query);
+    pos_ = 0;
+    field_ = FIELD_DEFAULT;
+
+    QueryNodePtr root = parse_sequence();
+    while (pos_ < tokens_.size()) {
+        pos_++; // 跳过多余的右括号，继续解析后面的子句
+        QueryNodePtr rest = parse_sequence();
+        root->clauses.insert(root->clauses.end(), rest->clauses.begin(), rest->clauses.end());
+    }
+    return root;
+}
+
+/**
+ * @brief 把查询字符串切分为词法单元
+ * @param query 用户输入的查询
+ *
+ * 只有大写的AND/OR/NOT（以及&&、||）被当作运算符；
+ * 紧贴在词前的+/-是前缀，单独出现时按普通字符处理。
+ */
+void QueryParser::lex(const std::string& query) {
+    tokens_.clear();
+    size_t i = 0;
+    while (i < query.length()) {
+        unsigned char c = static_cast<unsigned char>(query[i]);
+        if (std::isspace(c)) {
+            i++;
+        } else if (c == '(') {
+            tokens_.push_back(Token(Token::LPAREN, "("));
+            i++;
+        } else if (c == ')') {
+            tokens_.push_back(Token(Token::RPAREN, ")"));
+            i++;
+        } else if (c == '"') {
+            size_t close = query.find('"', i + 1);
+            size_t end = close == std::string::npos ? query.length() : close;
+            tokens_.push_back(Token(Token::PHRASE, query.substr(i + 1, end - i - 1)));
+            i = end + 1;
+        } else if ((c == '+' || c == '-') && i + 1 < query.length() &&
+                   !std::isspace(static_cast<unsigned char>(query[i + 1])) && query[i + 1] != ')') {
+            tokens_.push_back(Token(c == '+' ? Token::PLUS : Token::MINUS, std::string(1, c)));
+            i++;
+        } else {
+            size_t start = i;
+            while (i < query.length()) {
+                unsigned char w = static_cast<unsigned char>(query[i]);
+                if (std::isspace(w) || w == '(' || w == ')' || w == '"') {
+                    break;
+                }
+                i++;
+            }
+            std::string word = query.substr(start, i - start);
+            if (word == "AND" || word == "&&") {
+                tokens_.push_back(Token(Token::AND, word));
+            } else if (word == "OR" || word == "||") {
+                tokens_.push_back(Token(Token::OR, word));
+            } else if (word == "NOT") {
+                tokens_.push_back(Token(Token::NOT, word));
+            } else {
+                tokens_.push_back(Token(Token::WORD, word));
+            }
+        }
+    }
+}
+
+/**
+ * @brief 解析一个子句序列，直到右括号或输入结束
+ * @return BOOLEAN节点
+ *
+ * 相邻子句默认是可选的（OR）；AND把两侧的可选子句都变为必选，
+ * 因此 a AND b c 表示必须同时包含a和b，c只影响分数。
+ */
+QueryNodePtr QueryParser::parse_sequence() {
+    QueryNodePtr node(new QueryNode(QueryNode::BOOLEAN));
+    bool conjunction = false; // 前一个运算符是AND
+
+    while (pos_ < tokens_.size() && tokens_[pos_].kind != Token::RPAREN) {
+        Token::Kind kind = tokens_[pos_].kind;
+        if (kind == Token::AND) {
+            conjunction = true;
+            if (!node->clauses.empty() && node->clauses.back().occur == QueryClause::SHOULD) {
+                node->clauses.back().occur = QueryClause::MUST;
+            }
+            pos_++;
+            continue;
+        }
+        if (kind == Token::OR) {
+            conjunction = false;
+            pos_++;
+            continue;
+        }
+
+        QueryClause::Occur occur = conjunction ? QueryClause::MUST : QueryClause::SHOULD;
+        conjunction = false;
+        if (kind == Token::PLUS) {
+            occur = QueryClause::MUST;
+            pos_++;
+        } else if (kind == Token::MINUS || kind == Token::NOT) {
+            occur = QueryClause::MUST_NOT;
+            pos_++;
+        }
+
+        // 前缀后面紧跟运算符时由下一轮循环处理该运算符
+        QueryNodePtr child = parse_primary();
+        if (child) {
+            node->clauses.push_back(QueryClause(occur, child));
+        }
+    }
+    return node;
+}
+
+/**
+ * @brief 解析一个基本单元
+ * @return 查询词、短语或分组节点；停用词、空分组或运算符处返回空指针
+ *
+ * 以"字段名:"开头的查询词限定字段：冒号后还有文字时限定该查询词本身，
+ * 否则限定紧随其后的短语、分组或查询词。不是已知字段名的冒号按普通字符处理。
+ */
+QueryNodePtr QueryParser::parse_primary() {
+    if (pos_ < tokens_.size() && tokens_[pos_].kind == Token::WORD) {
+        Token& token = tokens_[pos_];
+        size_t colon = token.text.find(':');
+        IndexField field = colon == std::string::npos ? FIELD_COUNT : find_field(token.text.substr(0, colon));
+        if (field != FIELD_COUNT) {
+            if (colon + 1 == token.text.size()) {
+                pos_++;
+            } else {
+                token.text.erase(0, colon + 1);
+            }
+            IndexField outer = field_;
+            field_ = field;
+            QueryNodePtr node = parse_unit();
+            field_ = outer;
+            return node;
+        }
+    }
+    return parse_unit();
+}
+
+/**
+ * @brief 解析查询词、短语或括号分组
+ * @return 语法树节点，词项按field_限定字段；停用词、空分组或运算符处返回空指针
+ */
+QueryNodePtr QueryParser::parse_unit() {
+    if (pos_ >= tokens_.size()) {
+        return QueryNodePtr();
+    }
+
+    const Token& token = tokens_[pos_];
+    if (token.kind == Token::WORD || token.kind == Token::PHRASE) {
+        pos_++;
+        QueryNodePtr node(new QueryNode(token.kind == Token::WORD ? QueryNode::TERM : QueryNode::PHRASE));
+        node->text = token.text;
+
+        // 词尾的~或~N表示模糊匹配，省略N时按词长选择
+        bool fuzzy = false;
+        int edits = -1;
+        size_t tilde = node->text.rfind('~');
+        if (node->type == QueryNode::TERM && tilde != std::string::npos && tilde > 0) {
+            if (tilde + 1 == node->text.size()) {
+                fuzzy = true;
+            } else if (tilde + 2 == node->text.size() && std::isdigit(static_cast<unsigned char>(node->text[tilde + 1]))) {
+                fuzzy = true;
+                edits = node->text[tilde + 1] - '0';
+            }
+            if (fuzzy) {
+                node->text.erase(tilde);
+            }
+        }
+
+        analyze(node->text, node->terms, node->positions);
+        if (node->terms.empty()) {
+            return QueryNodePtr();
+        }
+        if (node->type == QueryNode::TERM) {
+            node->positions.clear();
+            if (fuzzy && node->terms.size() == 1 && LevenshteinAutomaton::supports(node->terms[0])) {
+                node->max_edits = static_cast<boost::uint32_t>(edits < 0
+                    ? LevenshteinAutomaton::default_edits(node->terms[0])
+                    : std::min(static_cast<size_t>(edits), LevenshteinAutomaton::MAX_EDITS));
+            }
+        }
+        for (std::string& term : node->terms) {
+            term = field_term(field_, term);
+        }
+        return node;
+    }
+
+    if (token.kind == Token::LPAREN) {
+        pos_++;
+        QueryNodePtr group = parse_sequence();
+        if (pos_ < tokens_.size()) {
+            pos_++; // 右括号
+        }
+        if (group->clauses.empty()) {
+            return QueryNodePtr();
+        }
+        // 只有一个肯定子句的分组等价于该子句本身
+        if (group->clauses.size() == 1 && group->clauses[0].occur != QueryClause::MUST_NOT) {
+            return group->clauses[0].node;
+        }
+        return group;
+    }
+
+    return QueryNodePtr();
+}
+
+/**
+ * @brief 对查询词或短语做与索引相同的文本处理
+ * @param text 原始文本
+ * @param terms 输出：索引词项，按位置升序
+ * @param positions 输出：各词项相对于第一个词项的位置，停用词仍占据位置
+ */
+void QueryParser::analyze(const std::string& text, std::vector<std::string>& terms,
+                          std::vector<boost::uint32_t>& positions) {
+    std::vector<PositionedToken> tokens = processor_.tokenize_with_positions(processor_.preprocess_text(text));
+    boost::uint32_t base = 0;
+    for (const PositionedToken& token : tokens) {
+        if (processor_.is_stop_word(token.term)) {
+            continue;
+        }
+        if (terms.empty()) {
+            base = token.position;
+        }
+        terms.push_back(token.term);
+        positions.push_back(token.position - base);
+    }
+}
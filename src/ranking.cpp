@@ -0,0 +1,295 @@
+/**
+ * @file ranking.cpp
+ * @brief 排序模型的实现文件
+ *
+ * 实现TF-IDF、BM25与BM25F三种打分器。文档长度相关的归一化因子
+ * 在提交时按单精度预先计算；上界计算复用同样的单精度因子，
+ * 保证剪枝时上界不会因舍入而小于真实分数。
+ */
+
+#include "ranking.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+/**
+ * @brief 根据配置创建打分器
+ * @param config 排序模型配置
+ * @return 打分器实例
+ */
+boost::shared_ptr<Scorer> Scorer::create(const RankingConfig& config) {
+    if (config.model == "tfidf") {
+        return boost::shared_ptr<Scorer>(new TfIdfScorer());
+    }
+    if (config.model == "bm25") {
+        return boost::shared_ptr<Scorer>(new Bm25Scorer(config.k1, config.b));
+    }
+    if (config.model == "bm25f") {
+        return boost::shared_ptr<Scorer>(new Bm25fScorer(config));
+    }
+    throw std::invalid_argument("Unknown ranking model: " + config.model);
+}
+
+/**
+ * @brief Scorer的构造函数
+ * @param norm_width 每个文档占用的归一化因子个数
+ */
+Scorer::Scorer(size_t norm_width) : norm_width_(norm_width), doc_lengths_(nullptr), title_lengths_(nullptr) {
+}
+
+/**
+ * @brief Scorer的析构函数
+ */
+Scorer::~Scorer() {
+}
+
+/**
+ * @brief 按集合统计重新计算所有文档的归一化因子
+ * @param stats 集合统计
+ * @param doc_lengths 内部编号 -> 文档长度
+ * @param title_lengths 内部编号 -> 标题长度
+ */
+void Scorer::commit(const CollectionStats& stats,
+                    const std::vector<boost::uint32_t>& doc_lengths,
+                    const std::vector<boost::uint32_t>& title_lengths) {
+    stats_ = stats;
+    doc_lengths_ = nullptr;
+    title_lengths_ = nullptr;
+    norms_.assign(doc_lengths.size() * norm_width_, 0.0f);
+    for (size_t doc = 0; doc < doc_lengths.size(); ++doc) {
+        compute_norms(doc_lengths[doc], title_lengths[doc], &norms_[doc * norm_width_]);
+    }
+}
+
+/**
+ * @brief 为新文档追加归一化因子
+ * @param doc_len 文档长度
+ * @param title_len 标题长度
+ */
+void Scorer::add_document(boost::uint32_t doc_len, boost::uint32_t title_len) {
+    size_t offset = norms_.size();
+    norms_.resize(offset + norm_width_);
+    compute_norms(doc_len, title_len, &norms_[offset]);
+}
+
+/**
+ * @brief 按集合统计打分，归一化因子在打分时现算
+ * @param stats 集合统计
+ * @param doc_lengths 内部编号 -> 文档长度
+ * @param title_lengths 内部编号 -> 标题长度
+ *
+ * 不遍历文档，代价与文档数无关；每次打分多一次归一化因子的计算，结果与按同一统计提交时完全相同。
+ */
+void Scorer::bind(const CollectionStats& stats,
+                  const std::vector<boost::uint32_t>& doc_lengths,
+                  const std::vector<boost::uint32_t>& title_lengths) {
+    stats_ = stats;
+    norms_.clear();
+    doc_lengths_ = &doc_lengths;
+    title_lengths_ = &title_lengths;
+}
+
+/**
+ * @brief TfIdfScorer的构造函数
+ */
+TfIdfScorer::TfIdfScorer() : Scorer(1) {
+}
+
+boost::shared_ptr<Scorer> TfIdfScorer::clone() const {
+    return boost::shared_ptr<Scorer>(new TfIdfScorer(*this));
+}
+
+std::string TfIdfScorer::name() const {
+    return "tfidf";
+}
+
+/**
+ * @brief IDF = log(N / df)，出现在所有文档中的词项为0
+ */
+double TfIdfScorer::idf(size_t df, const CollectionStats& stats) const {
+    double total_docs = static_cast<double>(stats.doc_count);
+    return total_docs > df ? std::log(total_docs / df) : 0.0;
+}
+
+/**
+ * @brief 贡献 = 权重 * tf / 文档长度
+ */
+double TfIdfScorer::score(double weight, boost::uint32_t tf, boost::uint32_t, DocId doc) const {
+    float scratch[MAX_NORM_WIDTH];
+    return weight * tf * norms(doc, scratch)[0];
+}
+
+/**
+ * @brief 上界 = 权重 * 最大词频 / 最短文档长度
+ */
+double TfIdfScorer::upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const {
+    float norm = 0.0f;
+    compute_norms(min_len, 0, &norm);
+    return weight * max_tf * norm;
+}
+
+/**
+ * @brief 归一化因子为文档长度的倒数
+ */
+void TfIdfScorer::compute_norms(boost::uint32_t doc_len, boost::uint32_t, float* out) const {
+    out[0] = doc_len > 0 ? static_cast<float>(1.0 / doc_len) : 0.0f;
+}
+
+/**
+ * @brief Bm25Scorer的构造函数
+ * @param k1 词频饱和参数
+ * @param b 长度归一化参数
+ */
+Bm25Scorer::Bm25Scorer(double k1, double b) : Scorer(1), k1_(k1), b_(b) {
+}
+
+boost::shared_ptr<Scorer> Bm25Scorer::clone() const {
+    return boost::shared_ptr<Scorer>(new Bm25Scorer(*this));
+}
+
+std::string Bm25Scorer::name() const {
+    return "bm25";
+}
+
+/**
+ * @brief IDF = log(1 + (N - df + 0.5) / (df + 0.5))，始终为正
+ */
+double Bm25Scorer::idf(size_t df, const CollectionStats& stats) const {
+    double total_docs = static_cast<double>(stats.doc_count);
+    double freq = static_cast<double>(df);
+    return std::log(1.0 + std::max(total_docs - freq + 0.5, 0.0) / (freq + 0.5));
+}
+
+/**
+ * @brief 贡献 = 权重 * tf * (k1 + 1) / (tf + K)，K为预先计算的长度因子
+ */
+double Bm25Scorer::score(double weight, boost::uint32_t tf, boost::uint32_t, DocId doc) const {
+    float scratch[MAX_NORM_WIDTH];
+    return weight * tf * (k1_ + 1.0) / (tf + norms(doc, scratch)[0]);
+}
+
+/**
+ * @brief 上界：词频取最大值、长度因子取最短文档对应的值
+ */
+double Bm25Scorer::upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t min_len) const {
+    if (max_tf == 0) {
+        return 0.0;
+    }
+    float norm = 0.0f;
+    compute_norms(min_len, 0, &norm);
+    return weight * max_tf * (k1_ + 1.0) / (max_tf + norm);
+}
+
+/**
+ * @brief 长度因子 K = k1 * (1 - b + b * len / avg_len)
+ */
+void Bm25Scorer::compute_norms(boost::uint32_t doc_len, boost::uint32_t, float* out) const {
+    double avg_len = stats_.avg_doc_len > 0.0 ? stats_.avg_doc_len : 1.0;
+    out[0] = static_cast<float>(k1_ * (1.0 - b_ + b_ * doc_len / avg_len));
+}
+
+/**
+ * @brief Bm25fScorer的构造函数
+ * @param config 包含k1、字段权重与字段长度归一化参数的配置
+ */
+Bm25fScorer::Bm25fScorer(const RankingConfig& config)
+    : Scorer(2), k1_(config.k1),
+      title_weight_(config.title_weight), content_weight_(config.content_weight),
+      title_b_(config.title_b), content_b_(config.content_b) {
+}
+
+boost::shared_ptr<Scorer> Bm25fScorer::clone() const {
+    return boost::shared_ptr<Scorer>(new Bm25fScorer(*this));
+}
+
+std::string Bm25fScorer::name() const {
+    return "bm25f";
+}
+
+/**
+ * @brief 与BM25相同的IDF
+ */
+double Bm25fScorer::idf(size_t df, const CollectionStats& stats) const {
+    double total_docs = static_cast<double>(stats.doc_count);
+    double freq = static_cast<double>(df);
+    return std::log(1.0 + std::max(total_docs - freq + 0.5, 0.0) / (freq + 0.5));
+}
+
+/**
+ * @brief 伪词频 = 标题词频 * 标题因子 + 正文词频 * 正文因子，再做饱和
+ */
+double Bm25fScorer::score(double weight, boost::uint32_t tf, boost::uint32_t title_tf, DocId doc) const {
+    float scratch[MAX_NORM_WIDTH];
+    const float* field_norms = norms(doc, scratch);
+    double pseudo_tf = title_tf * static_cast<double>(field_norms[0]) +
+                       (tf - title_tf) * static_cast<double>(field_norms[1]);
+    return weight * saturate(pseudo_tf);
+}
+
+/**
+ * @brief 上界：字段长度取0时各字段因子最大，伪词频不超过 最大词频 * 最大字段因子
+ */
+double Bm25fScorer::upper_bound(double weight, boost::uint32_t max_tf, boost::uint32_t) const {
+    if (max_tf == 0) {
+        return 0.0;
+    }
+    float field_norms[2];
+    compute_norms(0, 0, field_norms);
+    float max_norm = std::max(field_norms[0], field_norms[1]);
+    return weight * saturate(max_tf * static_cast<double>(max_norm));
+}
+
+/**
+ * @brief 字段因子 = 字段权重 / (1 - b_f + b_f * 字段长度 / 平均字段长度)
+ */
+void Bm25fScorer::compute_norms(boost::uint32_t doc_len, boost::uint32_t title_len, float* out) const {
+    boost::uint32_t content_len = doc_len > title_len ? doc_len - title_len : 0;
+    double avg_title = stats_.avg_title_len > 0.0 ? stats_.avg_title_len : 1.0;
+    double avg_content = stats_.avg_content_len > 0.0 ? stats_.avg_content_len : 1.0;
+    double title_norm = 1.0 - title_b_ + title_b_ * title_len / avg_title;
+    double content_norm = 1.0 - content_b_ + content_b_ * content_len / avg_content;
+    out[0] = title_norm > 0.0 ? static_cast<float>(title_weight_ / title_norm) : std::numeric_limits<float>::max();
+    out[1] = content_norm > 0.0 ? static_cast<float>(content_weight_ / content_norm) : std::numeric_limits<float>::max();
+}
+
+/**
+ * @brief 饱和函数 x * (k1 + 1) / (x + k1)，x趋于无穷时趋于k1 + 1
+ */
+double Bm25fScorer::saturate(double pseudo_tf) const {
+    if (pseudo_tf >= std::numeric_limits<float>::max()) {
+        return k1_ + 1.0;
+    }
+    return pseudo_tf * (k1_ + 1.0) / (pseudo_tf + k1_);
+}
+
+/**
+ * @brief 计算两个查询词的邻近度
+ * @param a 第一个词项的升序位置
+ * @param b 第二个词项的升序位置
+ * @param window 计入加分的最大距离
+ * @return 最近距离d不超过window时为 1 / d^2，否则为0
+ *
+ * 两个位置列表做一次归并即可得到最近距离。
+ */
+double proximity_score(const std::vector<boost::uint32_t>& a, const std::vector<boost::uint32_t>& b,
+                       boost::uint32_t window) {
+    boost::uint32_t best = window + 1;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size() && best > 1) {
+        if (a[i] < b[j]) {
+            best = std::min(best, b[j] - a[i]);
+            i++;
+        } else if (a[i] > b[j]) {
+            best = std::min(best, a[i] - b[j]);
+            j++;
+        } else {
+            i++; // 同一位置上的不同n-gram不算邻近
+        }
+    }
+    if (best > window) {
+        return 0.0;
+    }
+    return 1.0 / (static_cast<double>(best) * best);
+}
@@ -0,0 +1,593 @@
+/**
+ * @file search_coordinator.cpp
+ * @brief 分布式查询协调节点的实现文件
+ *
+ * 对各分片的请求都在服务器的io_context上异步进行，一个定时器为每次扇出设定截止时间，
+ * 到期时关闭尚未完成的连接；分布式查询的三个阶段由回调串联，共用同一个截止时间。不需要额外的线程，
+ * 等待分片应答期间服务器照常处理其他连接。
+ */
+
+#include "search_coordinator.h"
+#include "shard_protocol.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+
+using boost::asio::ip::tcp;
+
+namespace {
+
+/**
+ * @brief 发往单个分片的一次HTTP请求：解析地址、连接、发送请求，然后读到对端关闭连接为止
+ *
+ * 所有回调都在服务器的io_context的线程中执行，不需要加锁。
+ * 完成、失败或被取消时只调用一次on_done。
+ */
+class ShardCall : public boost::enable_shared_from_this<ShardCall>
+{
+public:
+    ShardCall(boost::asio::io_context& io_context, ShardReply& reply, const std::function<void()>& on_done)
+        : resolver_(io_context), socket_(io_context), reply_(reply), on_done_(on_done), finished_(false) {}
+
+    /**
+     * @brief 开始请求
+     * @param host 主机
+     * @param port 端口
+     * @param path 请求路径（含查询字符串）
+     */
+    void start(const std::string& host, const std::string& port, const std::string& path) {
+        request_ = "GET " + path + " HTTP/1.1\r\nHost: " + host + ":" + port + "\r\nConnection: close\r\n\r\n";
+        resolver_.async_resolve(host, port,
+            boost::bind(&ShardCall::handle_resolve, shared_from_this(),
+                boost::asio::placeholders::error, boost::asio::placeholders::results));
+    }
+
+    /**
+     * @brief 截止时间已到：放弃尚未完成的请求
+     */
+    void cancel() {
+        if (finished_) {
+            return;
+        }
+        finish("timed out");
+        boost::system::error_code ignored;
+        resolver_.cancel();
+        socket_.close(ignored);
+    }
+
+private:
+    void handle_resolve(const boost::system::error_code& error, const tcp::resolver::results_type& results) {
+        if (finished_) {
+            return; // 已超时：async_connect会重新打开cancel()关闭的套接字，不能再发起连接
+        }
+        if (error) {
+            finish("resolve failed: " + error.message());
+            return;
+        }
+        boost::asio::async_connect(socket_, results,
+            boost::bind(&ShardCall::handle_connect, shared_from_this(), boost::asio::placeholders::error));
+    }
+
+    void handle_connect(const boost::system::error_code& error) {
+        if (finished_) {
+            return; // 连接完成的回调排队时截止时间已到
+        }
+        if (error) {
+            finish("connect failed: " + error.message());
+            return;
+        }
+        boost::asio::async_write(socket_, boost::asio::buffer(request_),
+            boost::bind(&ShardCall::handle_write, shared_from_this(), boost::asio::placeholders::error));
+    }
+
+    void handle_write(const boost::system::error_code& error) {
+        if (finished_) {
+            return;
+        }
+        if (error) {
+            finish("write failed: " + error.message());
+            return;
+        }
+        boost::asio::async_read(socket_, response_, boost::asio::transfer_all(),
+            boost::bind(&ShardCall::handle_read, shared_from_this(), boost::asio::placeholders::error));
+    }
+
+    /**
+     * @brief 读取结束：分片服务器发送完响应后关闭连接，因此eof表示响应完整
+     */
+    void handle_read(const boost::system::error_code& error) {
+        if (finished_) {
+            return; // 读取完成的回调排队时截止时间已到，应答已按超时交给了调用方
+        }
+        if (error && error != boost::asio::error::eof) {
+            finish("read failed: " + error.message());
+            return;
+        }
+        std::string response(boost::asio::buffers_begin(response_.data()), boost::asio::buffers_end(response_.data()));
+        size_t header_end = response.find("\r\n\r\n");
+        size_t status_start = response.find(' ');
+        if (header_end == std::string::npos || status_start == std::string::npos) {
+            finish("malformed response");
+            return;
+        }
+        std::string status = response.substr(status_start + 1, 3);
+        if (status != "200") {
+            finish("HTTP " + status + ": " + response.substr(header_end + 4));
+            return;
+        }
+        reply_.body = response.substr(header_end + 4);
+        reply_.ok = true;
+        finish(std::string());
+    }
+
+    /**
+     * @brief 记录结果并通知调用方，只生效一次
+     * @param error 失败原因，成功时为空
+     */
+    void finish(const std::string& error) {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        if (!error.empty()) {
+            reply_.ok = false;
+            reply_.error = error;
+        }
+        on_done_();
+    }
+
+    tcp::resolver resolver_;
+    tcp::socket socket_;
+    std::string request_;
+    boost::asio::streambuf response_;
+    ShardReply& reply_;
+    std::function<void()> on_done_;
+    bool finished_;
+};
+
+/**
+ * @brief 一次扇出：并发请求若干分片，全部应答或截止时间到达后把各分片的应答交给回调
+ *
+ * 每个请求与定时器都持有扇出对象，最后一个回调执行完后扇出对象被释放。
+ */
+class FanOut : public boost::enable_shared_from_this<FanOut>
+{
+public:
+    typedef std::function<void(const std::vector<ShardReply>&)> Handler;
+
+    FanOut(boost::asio::io_context& io_context, size_t shards, const Handler& handler)
+        : io_context_(io_context), deadline_(io_context), replies_(shards), pending_(0), handler_(handler) {}
+
+    /**
+     * @brief 发出请求
+     * @param endpoints 各分片的(主机, 端口)
+     * @param paths 各分片的请求路径，为空的分片不发送
+     * @param deadline 截止时间
+     */
+    void start(const std::vector<std::pair<std::string, std::string>>& endpoints,
+               const std::vector<std::string>& paths, boost::asio::steady_timer::time_point deadline) {
+        std::function<void()> on_done = boost::bind(&FanOut::call_done, shared_from_this());
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            if (paths[i].empty()) {
+                continue;
+            }
+            pending_++;
+            calls_.push_back(boost::make_shared<ShardCall>(boost::ref(io_context_), boost::ref(replies_[i]), on_done));
+            calls_.back()->start(endpoints[i].first, endpoints[i].second, paths[i]);
+        }
+        if (calls_.empty()) {
+            // 没有需要请求的分片：回调仍然异步执行，调用方不必处理重入
+            boost::asio::post(io_context_, boost::bind(&FanOut::complete, shared_from_this()));
+            return;
+        }
+        deadline_.expires_at(deadline);
+        deadline_.async_wait(boost::bind(&FanOut::handle_deadline, shared_from_this(),
+                                         boost::asio::placeholders::error));
+    }
+
+private:
+    void call_done() {
+        if (--pending_ == 0) {
+            deadline_.cancel();
+            complete();
+        }
+    }
+
+    /**
+     * @brief 截止时间已到：放弃尚未完成的请求，最后一个被放弃的请求触发回调
+     */
+    void handle_deadline(const boost::system::error_code& error) {
+        if (error) {
+            return;
+        }
+        std::vector<boost::shared_ptr<ShardCall>> calls(calls_);
+        for (const boost::shared_ptr<ShardCall>& call : calls) {
+            call->cancel();
+        }
+    }
+
+    void complete() {
+        calls_.clear(); // 请求持有扇出对象，清空后不再互相引用
+        handler_(replies_);
+    }
+
+    boost::asio::io_context& io_context_;
+    boost::asio::steady_timer deadline_;
+    std::vector<ShardReply> replies_;
+    std::vector<boost::shared_ptr<ShardCall>> calls_;
+    size_t pending_;
+    Handler handler_;
+};
+
+/**
+ * @brief 归并时的候选文档
+ */
+struct Candidate {
+    double score;           // 分片按全局统计计算的分数
+    size_t shard;           // 持有该文档的分片
+    size_t rank;            // 在该分片结果中的名次
+    std::string id;         // 文档ID
+
+    Candidate(double s, size_t sh, size_t r, const std::string& i) : score(s), shard(sh), rank(r), id(i) {}
+
+    // 按分数降序，分数相同时按分片序号与名次升序，结果与应答到达的顺序无关
+    bool operator<(const Candidate& other) const {
+        if (score != other.score) {
+            return score > other.score;
+        }
+        return shard != other.shard ? shard < other.shard : rank < other.rank;
+    }
+};
+
+
+} // namespace
+
+/**
+ * @brief 一次分布式查询在各阶段之间传递的状态
+ */
+struct SearchCoordinator::SearchState {
+    std::string encoded_query;              // URL编码后的查询
+    size_t k;                               // 最大返回结果数
+    Deadline deadline;                      // 整个查询的截止时间，各阶段在剩余时间内分配
+    SearchHandler handler;
+    std::string encoded_statistics;         // URL编码后的全局统计
+    std::vector<bool> alive;                // 仍参与后续阶段的分片
+    std::vector<Candidate> candidates;      // 全局前k名
+    std::vector<std::string> failed_shards;
+};
+
+/**
+ * @brief SearchCoordinator的构造函数
+ * @param io_context 服务器的io_context，对分片的请求与回调都在其中执行
+ * @param shards 分片服务器的"主机:端口"列表
+ * @param timeout_ms 一次请求等待分片应答的最长时间（毫秒），分布式查询的三个阶段共用
+ */
+SearchCoordinator::SearchCoordinator(boost::asio::io_context& io_context, const std::vector<std::string>& shards,
+                                     long timeout_ms)
+    : io_context_(io_context), shards_(shards), timeout_ms_(timeout_ms) {
+    if (shards_.empty()) {
+        throw std::invalid_argument("At least one shard server is required");
+    }
+    for (const std::string& shard : shards_) {
+        size_t colon = shard.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == shard.size()) {
+            throw std::invalid_argument("Invalid shard server address (expected host:port): " + shard);
+        }
+        endpoints_.push_back(std::make_pair(shard.substr(0, colon), shard.substr(colon + 1)));
+    }
+    std::cout << "Search coordinator initialized with " << shards_.size() << " shard servers (timeout "
+              << timeout_ms_ << " ms)" << std::endl;
+}
+
+/**
+ * @brief 分布式查询
+ * @param query 用户的查询字符串
+ * @param max_results 最大返回结果数
+ * @param handler 回调：全局前max_results名（带标题与摘要）与超时或出错的分片；
+ *                部分分片失败时只包含其余分片的文档
+ */
+void SearchCoordinator::async_search(const std::string& query, int max_results, const SearchHandler& handler) {
+    std::cout << "Distributing search: \"" << query << "\"" << std::endl;
+    SearchStatePtr state = boost::make_shared<SearchState>();
+    state->encoded_query = ShardProtocol::url_encode(query);
+    state->k = max_results > 0 ? static_cast<size_t>(max_results) : 0;
+    state->deadline = request_deadline();
+    state->handler = handler;
+    state->alive.assign(shards_.size(), false);
+
+    // 1. 统计：汇总各分片的集合规模与文档频率
+    broadcast("/internal/stats?q=" + state->encoded_query, phase_deadline(state->deadline, 3),
+              [this, state](const std::vector<ShardReply>& replies) { search_statistics(state, replies); });
+}
+
+/**
+ * @brief 统计阶段的应答：得到全局统计后请各分片按全局统计返回前k名
+ * @param state 查询状态
+ * @param replies 各分片的应答
+ */
+void SearchCoordinator::search_statistics(const SearchStatePtr& state, const std::vector<ShardReply>& replies) {
+    TermStatistics global;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!check_reply(i, replies[i], state->failed_shards)) {
+            continue;
+        }
+        try {
+            global.add(ShardProtocol::decode_statistics(replies[i].body));
+            state->alive[i] = true;
+        }
+        catch (const std::exception& e) {
+            mark_failed(i, e.what(), state->failed_shards);
+        }
+    }
+
+    // 2. 求值：各分片按全局统计返回前k名
+    state->encoded_statistics = ShardProtocol::url_encode(ShardProtocol::encode_statistics(global));
+    std::vector<std::string> paths(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (state->alive[i]) {
+            paths[i] = "/internal/search?q=" + state->encoded_query + "&k=" + std::to_string(state->k) +
+                       "&stats=" + state->encoded_statistics;
+        }
+    }
+    fan_out(paths, phase_deadline(state->deadline, 2),
+            [this, state](const std::vector<ShardReply>& replies) { search_hits(state, replies); });
+}
+
+/**
+ * @brief 求值阶段的应答：归并出全局前k名，只向持有这些文档的分片取摘要
+ * @param state 查询状态
+ * @param replies 各分片的应答
+ */
+void SearchCoordinator::search_hits(const SearchStatePtr& state, const std::vector<ShardReply>& replies) {
+    std::vector<Candidate>& candidates = state->candidates;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!state->alive[i]) {
+            continue;
+        }
+        state->alive[i] = false;
+        if (!check_reply(i, replies[i], state->failed_shards)) {
+            continue;
+        }
+        try {
+            std::vector<SearchResult> hits = ShardProtocol::decode_hits(replies[i].body);
+            for (size_t rank = 0; rank < hits.size(); ++rank) {
+                candidates.push_back(Candidate(hits[rank].score, i, rank, hits[rank].url));
+            }
+            state->alive[i] = true;
+        }
+        catch (const std::exception& e) {
+            mark_failed(i, e.what(), state->failed_shards);
+        }
+    }
+
+    // 3. 归并出全局前k名，只向持有这些文档的分片取摘要
+    size_t count = std::min(state->k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    candidates.erase(candidates.begin() + count, candidates.end());
+    std::vector<std::string> ids(shards_.size());
+    for (const Candidate& candidate : candidates) {
+        ids[candidate.shard] += candidate.id + "\n";
+    }
+    std::vector<std::string> paths(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!ids[i].empty()) {
+            paths[i] = "/internal/fetch?q=" + state->encoded_query + "&stats=" + state->encoded_statistics +
+                       "&ids=" + ShardProtocol::url_encode(ids[i]);
+        }
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        state->alive[i] = !paths[i].empty();
+    }
+    fan_out(paths, phase_deadline(state->deadline, 1),
+            [this, state](const std::vector<ShardReply>& replies) { search_fetched(state, replies); });
+}
+
+/**
+ * @brief 取摘要阶段的应答：按全局名次组装结果并调用回调
+ * @param state 查询状态
+ * @param replies 各分片的应答
+ */
+void SearchCoordinator::search_fetched(const SearchStatePtr& state, const std::vector<ShardReply>& replies) {
+    std::vector<std::map<std::string, SearchResult>> fetched(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!state->alive[i] || !check_reply(i, replies[i], state->failed_shards)) {
+            continue;
+        }
+        try {
+            for (const SearchResult& result : ShardProtocol::decode_results(replies[i].body)) {
+                fetched[i].insert(std::make_pair(result.url, result));
+            }
+        }
+        catch (const std::exception& e) {
+            mark_failed(i, e.what(), state->failed_shards);
+        }
+    }
+
+    // 取摘要失败（或文档已被删除）的文档不出现在结果中
+    std::vector<SearchResult> results;
+    for (const Candidate& candidate : state->candidates) {
+        std::map<std::string, SearchResult>::const_iterator it = fetched[candidate.shard].find(candidate.id);
+        if (it != fetched[candidate.shard].end()) {
+            results.push_back(it->second);
+            results.back().score = candidate.score;
+        }
+    }
+
+    std::cout << "Distributed search completed, found " << results.size() << " results ("
+              << state->failed_shards.size() << " shard failures)" << std::endl;
+    state->handler(results, state->failed_shards);
+}
+
+/**
+ * @brief 合并各分片的补全建议
+ * @param query 正在输入的查询
+ * @param max_results 最多返回的建议数
+ * @param handler 回调：文档频率相加后按频率降序、文本升序排列的建议，与超时或出错的分片
+ *
+ * 每个分片只返回本地的前max_results个，合并结果是全局前几名的近似。
+ */
+void SearchCoordinator::async_suggest(const std::string& query, size_t max_results, const SuggestHandler& handler) {
+    std::string path = "/internal/suggest?q=" + ShardProtocol::url_encode(query) + "&k=" + std::to_string(max_results);
+    broadcast(path, request_deadline(), [this, max_results, handler](const std::vector<ShardReply>& replies) {
+        std::vector<std::string> failed_shards;
+        std::map<std::string, boost::uint64_t> frequencies;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (!check_reply(i, replies[i], failed_shards)) {
+                continue;
+            }
+            try {
+                for (const Suggestion& suggestion : ShardProtocol::decode_suggestions(replies[i].body)) {
+                    frequencies[suggestion.text] += suggestion.frequency;
+                }
+            }
+            catch (const std::exception& e) {
+                mark_failed(i, e.what(), failed_shards);
+            }
+        }
+
+        std::vector<Suggestion> suggestions;
+        for (const auto& pair : frequencies) {
+            boost::uint64_t frequency = std::min<boost::uint64_t>(pair.second, 0xFFFFFFFFu);
+            suggestions.push_back(Suggestion(pair.first, static_cast<boost::uint32_t>(frequency)));
+        }
+        std::stable_sort(suggestions.begin(), suggestions.end(), [](const Suggestion& a, const Suggestion& b) {
+            return a.frequency > b.frequency;
+        });
+        if (suggestions.size() > max_results) {
+            suggestions.erase(suggestions.begin() + max_results, suggestions.end());
+        }
+        handler(suggestions, failed_shards);
+    });
+}
+
+/**
+ * @brief 向各分片查找文档
+ * @param doc_id 文档ID
+ * @param handler 回调：(标题, 正文)，没有分片持有该文档（或持有它的分片失败）时标题为空
+ */
+void SearchCoordinator::async_get_document(const std::string& doc_id, const DocumentHandler& handler) {
+    broadcast("/internal/doc?id=" + ShardProtocol::url_encode(doc_id), request_deadline(),
+              [this, handler](const std::vector<ShardReply>& replies) {
+        std::vector<std::string> failed_shards;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (!check_reply(i, replies[i], failed_shards)) {
+                continue;
+            }
+            try {
+                std::vector<std::vector<std::string>> records = ShardProtocol::parse_records(replies[i].body);
+                if (!records.empty() && records[0].size() >= 2) {
+                    handler(std::make_pair(records[0][0], records[0][1]));
+                    return;
+                }
+            }
+            catch (const std::exception& e) {
+                mark_failed(i, e.what(), failed_shards);
+            }
+        }
+        handler(std::make_pair(std::string(), std::string()));
+    });
+}
+
+/**
+ * @brief 统计所有分片的有效文档数
+ * @param handler 回调：成功应答的分片的文档数之和，与超时或出错的分片
+ */
+void SearchCoordinator::async_document_count(const CountHandler& handler) {
+    broadcast("/internal/stats?q=", request_deadline(), [this, handler](const std::vector<ShardReply>& replies) {
+        std::vector<std::string> failed_shards;
+        size_t documents = 0;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (!check_reply(i, replies[i], failed_shards)) {
+                continue;
+            }
+            try {
+                documents += ShardProtocol::decode_statistics(replies[i].body).doc_count;
+            }
+            catch (const std::exception& e) {
+                mark_failed(i, e.what(), failed_shards);
+            }
+        }
+        handler(documents, failed_shards);
+    });
+}
+
+/**
+ * @brief 一次请求的截止时间
+ * @return 从现在起timeout_ms毫秒后
+ */
+SearchCoordinator::Deadline SearchCoordinator::request_deadline() const {
+    return boost::asio::steady_timer::clock_type::now() + boost::asio::chrono::milliseconds(timeout_ms_);
+}
+
+/**
+ * @brief 一个阶段的截止时间
+ * @param deadline 整个请求的截止时间
+ * @param phases 包括本阶段在内尚未进行的阶段数
+ * @return 剩余时间在这些阶段之间平分，本阶段只用其中一份：慢分片在前面的阶段超时后，
+ *         其余分片仍有时间完成后面的阶段；最后一个阶段的截止时间就是整个请求的截止时间
+ */
+SearchCoordinator::Deadline SearchCoordinator::phase_deadline(Deadline deadline, int phases) {
+    Deadline now = boost::asio::steady_timer::clock_type::now();
+    if (deadline <= now || phases <= 1) {
+        return deadline;
+    }
+    return now + (deadline - now) / phases;
+}
+
+/**
+ * @brief 并发向各分片发送GET请求
+ * @param paths 各分片的请求路径，为空的分片不发送
+ * @param deadline 截止时间，到达时放弃尚未完成的请求
+ * @param handler 回调：各分片的应答；未发送的分片ok为false且error为空
+ *
+ * 全部应答后立即调用回调；回调总在io_context中异步执行，不会在本函数返回前被调用。
+ */
+void SearchCoordinator::fan_out(const std::vector<std::string>& paths, Deadline deadline,
+                                const ReplyHandler& handler) const {
+    boost::make_shared<FanOut>(boost::ref(io_context_), endpoints_.size(), handler)->start(endpoints_, paths, deadline);
+}
+
+/**
+ * @brief 向所有分片发送同一请求
+ * @param path 请求路径
+ * @param deadline 截止时间
+ * @param handler 回调：各分片的应答
+ */
+void SearchCoordinator::broadcast(const std::string& path, Deadline deadline, const ReplyHandler& handler) const {
+    fan_out(std::vector<std::string>(endpoints_.size(), path), deadline, handler);
+}
+
+/**
+ * @brief 检查分片的应答
+ * @param shard 分片序号
+ * @param reply 应答
+ * @param failed_shards 失败时追加分片地址
+ * @return 应答成功时返回true
+ */
+bool SearchCoordinator::check_reply(size_t shard, const ShardReply& reply,
+                                    std::vector<std::string>& failed_shards) const {
+    if (!reply.ok) {
+        mark_failed(shard, reply.error, failed_shards);
+    }
+    return reply.ok;
+}
+
+/**
+ * @brief 记录失败的分片
+ * @param shard 分片序号
+ * @param error 失败原因
+ * @param failed_shards 追加分片地址（同一分片只记录一次）
+ */
+void SearchCoordinator::mark_failed(size_t shard, const std::string& error,
+                                    std::vector<std::string>& failed_shards) const {
+    std::cerr << "Shard " << shards_[shard] << " failed: " << error << std::endl;
+    if (std::find(failed_shards.begin(), failed_shards.end(), shards_[shard]) == failed_shards.end()) {
+        failed_shards.push_back(shards_[shard]);
+    }
+}
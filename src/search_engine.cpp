@@ -3,29 +3,297 @@
  * @brief 搜索引擎核心功能的实现文件
  *
  * 该文件实现了`SearchEngine`类，包括构建倒排索引、执行搜索、
- * 计算TF-IDF相关性分数以及返回排序后的搜索结果等核心功能。
+ * 计算相关性分数以及返回排序后的搜索结果等核心功能。
+ * 搜索通过`TopKEvaluator`做前k名动态剪枝，而不是对全部候选文档打分排序。
+ * 打分委托给可插拔的`Scorer`（TF-IDF、BM25或BM25F），文档长度、平均长度
+ * 与词项IDF在构建索引时预先计算，打分循环内只做常数次运算。
+ * 查询支持AND/OR/NOT、+必选/-排除、短语与分组；普通的多词查询仍按并集处理。
+ * 开启位置索引时，短语按相对位置校验，查询词彼此靠近的文档获得邻近度加分。
+ * 索引内部使用稠密的32位文档编号，倒排记录以压缩倒排列表形式存储。
+ * 查询读取原子发布的不可变快照，写入在旁边构建下一个版本，二者互不阻塞。
+ * 索引按段增量构建：新文档进入缓冲段，封存后的段由后台线程按层级合并，
+ * 查询对各段分别求值后合并前k名。
+ * 加载数据目录时，扫描、分词与写入索引组成有界流水线，文档不在内存中整体堆积。
+ * 构建完成的索引可以写入索引文件，下次启动时映射该文件直接恢复，倒排列表不做复制。
  */
 
 #include "search_engine.h"
+#include "bounded_queue.h"
+#include "index_field.h"
+#include "index_file.h"
 #include "indexer.h"
+#include "metrics.h"
+#include "query_evaluator.h"
+#include "query_parser.h"
 #include "text_processor.h"
+#include "thread_pool.h"
+#include "top_k_evaluator.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace {
+
+/**
+ * @brief 对一个字段分词并去除停用词，位置整体偏移offset
+ */
+std::vector<PositionedToken> analyze_field(TextProcessor& processor, const std::string& text, boost::uint32_t offset) {
+    std::vector<PositionedToken> tokens;
+    for (PositionedToken& token : processor.tokenize_with_positions(processor.preprocess_text(text))) {
+        if (!processor.is_stop_word(token.term)) {
+            token.position += offset;
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+/**
+ * @brief 一个词项在单个文档中的统计
+ */
+struct TermOccurrences {
+    boost::uint32_t tf;                     // 词频
+    boost::uint32_t title_tf;               // 标题中的词频
+    std::vector<boost::uint32_t> positions; // 升序位置
+
+    TermOccurrences() : tf(0), title_tf(0) {}
+};
+
+/**
+ * @brief 分词完成、等待写入索引的文档
+ */
+struct AnalyzedDocument {
+    boost::uint32_t doc_len;    // 文档长度（词项数）
+    boost::uint32_t title_len;  // 标题长度
+    std::unordered_map<std::string, TermOccurrences> terms;
+
+    AnalyzedDocument() : doc_len(0), title_len(0) {}
+};
+
+/**
+ * @brief 对文档做文本预处理并统计词频（总词频与标题词频）与位置
+ *
+ * 标题与正文分别分词以便按字段加权；正文位置接在标题之后并空出一个位置，
+ * 短语不会跨越两个字段。
+ */
+AnalyzedDocument analyze_document(TextProcessor& processor, const Document& document, bool store_positions) {
+    std::vector<PositionedToken> title_tokens = analyze_field(processor, document.title, 0);
+    boost::uint32_t content_offset = title_tokens.empty() ? 0 : title_tokens.back().position + 2;
+    std::vector<PositionedToken> content_tokens = analyze_field(processor, document.content, content_offset);
+
+    AnalyzedDocument analyzed;
+    analyzed.title_len = static_cast<boost::uint32_t>(title_tokens.size());
+    analyzed.doc_len = analyzed.title_len + static_cast<boost::uint32_t>(content_tokens.size());
+    for (const PositionedToken& token : title_tokens) {
+        TermOccurrences& occurrences = analyzed.terms[token.term];
+        occurrences.tf++;
+        occurrences.title_tf++;
+        if (store_positions) {
+            occurrences.positions.push_back(token.position);
+        }
+    }
+    for (const PositionedToken& token : content_tokens) {
+        TermOccurrences& occurrences = analyzed.terms[token.term];
+        occurrences.tf++;
+        if (store_positions) {
+            occurrences.positions.push_back(token.position);
+        }
+    }
+    return analyzed;
+}
+
+/**
+ * @brief 扫描阶段输出的一段连续文件，由一个工作线程建成一个段
+ */
+struct ScannedRange {
+    size_t seq;                         // 范围在遍历顺序中的序号
+    std::vector<std::string> paths;     // 按遍历顺序排列的文件路径
+
+    ScannedRange() : seq(0) {}
+};
+
+/**
+ * @brief 某个段内的命中文档
+ */
+struct SegmentHit {
+    size_t segment;         // 段序号
+    DocId doc;              // 段内局部编号
+    double score;           // 相关性分数
+
+    SegmentHit(size_t s, DocId d, double sc) : segment(s), doc(d), score(sc) {}
+};
+
+/**
+ * @brief 按分数降序排列，分数相同时按添加顺序（段序号、局部编号）升序
+ */
+struct HitDescending {
+    bool operator()(const SegmentHit& a, const SegmentHit& b) const {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        return a.segment != b.segment ? a.segment < b.segment : a.doc < b.doc;
+    }
+};
+
+/**
+ * @brief 把一串按顺序排列的大小切分为至多parts组相邻的区间，各组大小尽量接近
+ * @param sizes 各元素的大小
+ * @param parts 组数上限
+ * @return 各组的(起始序号, 元素数)，单个元素超过平均大小时独占一组
+ */
+std::vector<std::pair<size_t, size_t>> partition_runs(const std::vector<size_t>& sizes, size_t parts) {
+    std::vector<std::pair<size_t, size_t>> runs;
+    size_t total = 0;
+    for (size_t size : sizes) {
+        total += size;
+    }
+    size_t begin = 0;
+    size_t accumulated = 0;
+    size_t boundary = 1; // 下一个分界点为 total * boundary / parts
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        accumulated += sizes[i];
+        if (i + 1 < sizes.size() && runs.size() + 1 < parts && accumulated * parts >= total * boundary) {
+            runs.push_back(std::make_pair(begin, i + 1 - begin));
+            begin = i + 1;
+            while (accumulated * parts >= total * boundary) {
+                boundary++;
+            }
+        }
+    }
+    if (begin < sizes.size()) {
+        runs.push_back(std::make_pair(begin, sizes.size() - begin));
+    }
+    return runs;
+}
+
+/**
+ * @brief 由有效文档的数量与长度总和得到集合统计
+ * @param doc_count 有效文档数
+ * @param total_doc_len 文档长度总和
+ * @param total_title_len 标题长度总和
+ * @return 文档数与各字段的平均长度
+ */
+CollectionStats make_collection_stats(size_t doc_count, boost::uint64_t total_doc_len, boost::uint64_t total_title_len) {
+    CollectionStats stats;
+    stats.doc_count = doc_count;
+    if (stats.doc_count > 0) {
+        double count = static_cast<double>(stats.doc_count);
+        stats.avg_doc_len = total_doc_len / count;
+        stats.avg_title_len = total_title_len / count;
+        stats.avg_content_len = (total_doc_len - total_title_len) / count;
+    }
+    return stats;
+}
+
+/**
+ * @brief 列出语法树中的所有词项，包括排除子句中的词项
+ * @param node 语法树节点
+ * @param terms 输出：词项集合
+ */
+void collect_all_terms(const QueryNode& node, std::set<std::string>& terms) {
+    terms.insert(node.terms.begin(), node.terms.end());
+    for (const QueryClause& clause : node.clauses) {
+        collect_all_terms(*clause.node, terms);
+    }
+}
+
+/**
+ * @brief 估算搜索结果在查询缓存中占用的字节数
+ * @param results 搜索结果
+ * @return 结构体与字符串、高亮区间的大小之和
+ */
+size_t result_bytes(const std::vector<SearchResult>& results) {
+    size_t bytes = 0;
+    for (const SearchResult& result : results) {
+        bytes += sizeof(SearchResult) + result.title.size() + result.content.size() + result.url.size() +
+                 result.highlights.size() * sizeof(Highlight);
+    }
+    return bytes;
+}
+
+/**
+ * 批量查询中需要求值的一个查询
+ */
+struct BatchQuery {
+    QueryNodePtr parsed;                // 解析后的语法树，模糊查询词被原地展开
+    std::vector<std::string> keys;      // 展开前用户输入的查询词，用于邻近度加分
+    std::string cache_key;              // 规范化查询与结果窗口
+    std::vector<size_t> positions;      // 该查询在批内出现的位置
+};
+
+} // namespace
+
+const long SearchEngine::SUGGEST_REFRESH_MS;
+const double SearchEngine::FUZZY_EDIT_PENALTY = 0.5;
+
+/**
+ * @brief 累加另一个分片的统计
+ * @param other 分片的本地统计
+ */
+void TermStatistics::add(const TermStatistics& other) {
+    doc_count += other.doc_count;
+    total_doc_len += other.total_doc_len;
+    total_title_len += other.total_title_len;
+    for (const auto& pair : other.document_frequencies) {
+        document_frequencies[pair.first] += pair.second;
+    }
+}
+
+/**
+ * @brief 由全局的文档数与长度总和得到集合统计
+ * @return 文档数与各字段的平均长度，与单机索引的计算方式相同
+ */
+CollectionStats TermStatistics::collection_stats() const {
+    return make_collection_stats(doc_count, total_doc_len, total_title_len);
+}
 
 /**
  * @brief SearchEngine类的构造函数
+ * @param options 索引选项
+ *
+ * 创建空索引与空的补全索引，启动查询线程池（多于一个分片时）与后台线程。
+ * 查询线程自己也求值一组分片，因此线程池比分片数少一个线程。
  */
-SearchEngine::SearchEngine() {
-    std::cout << "Search engine initializing..." << std::endl;
+SearchEngine::SearchEngine(const IndexOptions& options)
+    : options_(options), shards_(options.shards), cache_(options.cache_bytes), merge_pending_(false),
+      stopping_(false), suggester_(new Suggester()), suggest_built_(boost::posix_time::min_date_time) {
+    removal_processor_.reset(new TextProcessor());
+    if (shards_ == 0) {
+        shards_ = std::max<size_t>(1, boost::thread::hardware_concurrency());
+    }
+    std::cout << "Search engine initializing (" << shards_ << " shards)..." << std::endl;
+    if (shards_ > 1) {
+        search_pool_.reset(new ThreadPool(shards_ - 1));
+    }
+    boost::shared_ptr<IndexSnapshot> initial(new IndexSnapshot());
+    initial->scorer = Scorer::create(initial->ranking);
+    snapshot_ = initial;
+    merge_thread_ = boost::thread(boost::bind(&SearchEngine::merge_loop, this));
 }
 
 /**
  * @brief SearchEngine类的析构函数
+ *
+ * 通知后台合并线程退出并等待其结束；进行中的合并会被丢弃。
  */
 SearchEngine::~SearchEngine() {
     std::cout << "Search engine cleaning up resources..." << std::endl;
+    {
+        boost::lock_guard<boost::mutex> lock(merge_mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    merge_thread_.join();
 }
 
 /**
@@ -34,37 +302,162 @@ SearchEngine::~SearchEngine() {
  * @param title 文档的标题
  * @param content 文档的内容
  *
- * 此函数会处理文本、更新倒排索引和词频信息。
+ * 此函数会处理文本、更新倒排索引和词频信息，完成后发布新的索引快照。
  */
 void SearchEngine::add_document(const std::string& doc_id, const std::string& title, const std::string& content) {
-    // 使用写锁保护，因为要修改共享数据
-    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    add_documents(std::vector<Document>(1, Document(doc_id, title, content, "")));
+}
+
+/**
+ * @brief 批量添加文档
+ * @param documents 待添加的文档
+ * @return 被替换的已有文档数
+ */
+size_t SearchEngine::add_documents(const std::vector<Document>& documents) {
+    size_t removed = 0;
+    return apply_changes(documents, std::vector<std::string>(), removed);
+}
 
-    // 1. 存储原始文档信息
-    documents_[doc_id] = std::make_pair(title, content);
+/**
+ * @brief 在同一个新快照中删除并写入一批文档
+ * @param documents 待写入的文档，已存在的同ID文档被替换
+ * @param deleted_ids 待删除的文档ID，不存在的ID被忽略
+ * @param removed 输出实际删除的文档数
+ * @return 被替换的已有文档数
+ *
+ * 分词在任何锁之外完成；随后在写入锁内复制当前快照，先标记删除，再把整批文档追加到缓冲段
+ * （缓冲段写满时封存并另起一个），最后原子地发布。
+ * 查询线程始终读取完整的旧快照或新快照，不会等待写入，也不会看到只应用了一部分的批次。
+ */
+size_t SearchEngine::apply_changes(const std::vector<Document>& documents, const std::vector<std::string>& deleted_ids,
+                                   size_t& removed) {
+    removed = 0;
+    if (documents.empty() && deleted_ids.empty()) {
+        return 0;
+    }
 
-    // 2. 文本预处理
+    // 1. 文本预处理与分词，占写入的大部分时间，不持有任何锁
     TextProcessor processor;
-    std::string processed_text = processor.preprocess_text(title + " " + content);
-    std::vector<std::string> tokens = processor.tokenize(processed_text);
-    tokens = processor.remove_stop_words(tokens);
+    std::vector<AnalyzedDocument> analyzed;
+    analyzed.reserve(documents.size());
+    for (const Document& document : documents) {
+        analyzed.push_back(analyze_document(processor, document, options_.store_positions));
+    }
+
+    // 2. 以当前快照为基础构建下一个版本
+    boost::lock_guard<boost::mutex> lock(write_mutex_);
+    boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current_snapshot()));
+    boost::shared_ptr<IndexSegment> buffer;
+    boost::shared_ptr<Scorer> buffer_scorer;
+    bool sealed = false;
+    size_t replaced = 0;
 
-    // 3. 更新索引和词频统计
-    std::map<std::string, int> term_freq;
-    for (const std::string& term : tokens) {
-        term_freq[term]++;
-        inverted_index_[term].insert(doc_id); // 更新倒排索引
+    for (const std::string& id : deleted_ids) {
+        DocId doc = 0;
+        size_t segment = next->find_document(id, doc);
+        if (segment < next->segments.size()) {
+            next->remove_document(segment, doc, *removal_processor_);
+            removed++;
+            std::cout << "Deleted document: " << id << std::endl;
+        }
     }
 
-    // 存储该文档的词频信息
-    term_frequency_[doc_id] = term_freq;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const Document& document = documents[i];
+        const AnalyzedDocument& doc_terms = analyzed[i];
+
+        // 3. 重复添加时旧版本标记为已取代，其长度不再计入集合统计
+        DocId old_doc = 0;
+        size_t old_segment = next->find_document(document.id, old_doc);
+        if (old_segment < next->segments.size()) {
+            next->remove_document(old_segment, old_doc, *removal_processor_);
+            replaced++;
+        }
+
+        // 4. 取得缓冲段：复制已发布的缓冲段，或在最后一个段已封存时新建
+        if (!buffer) {
+            if (next->segments.empty() || next->segments.back().segment->sealed()) {
+                next->segments.push_back(SegmentView());
+                buffer.reset(new IndexSegment());
+                buffer_scorer = next->scorer->clone();
+            } else {
+                buffer.reset(new IndexSegment(*next->segments.back().segment));
+                buffer_scorer = next->segments.back().scorer->clone();
+            }
+            next->segments.back().segment = buffer;
+            next->segments.back().scorer = buffer_scorer;
+        }
+
+        // 5. 存储原始文档并分配段内编号，编号单调递增，追加到倒排列表末尾即可保持有序
+        DocId doc = buffer->add_document(
+            boost::make_shared<const StoredDocument>(document.id, document.title, document.content),
+            doc_terms.doc_len, doc_terms.title_len);
+        next->doc_count++;
+        next->total_doc_len += doc_terms.doc_len;
+        next->total_title_len += doc_terms.title_len;
+
+        // 6. 追加倒排记录；新文档在下次提交前沿用上次提交的归一化统计
+        for (const auto& pair : doc_terms.terms) {
+            buffer->add_posting(pair.first, doc, pair.second.tf, pair.second.title_tf,
+                                options_.store_positions ? &pair.second.positions : nullptr);
+        }
+        buffer_scorer->add_document(doc_terms.doc_len, doc_terms.title_len);
+
+        std::cout << "Added document: " << document.id << " (terms: " << doc_terms.terms.size() << ")" << std::endl;
+
+        // 7. 缓冲段写满时封存，下一个文档写入新的缓冲段
+        if (buffer->size() >= SEGMENT_BUFFER_DOCS) {
+            buffer->seal();
+            buffer.reset();
+            sealed = true;
+        }
+    }
 
-    // 更新每个词的文档频率
-    for (const auto& pair : term_freq) {
-        document_frequency_[pair.first]++;
+    if (documents.empty() && removed == 0) {
+        return 0;
     }
+    next->epoch++;
+    publish(next);
+    if (sealed || replaced > 0 || removed > 0) {
+        request_merge();
+    }
+    return replaced;
+}
+
+/**
+ * @brief 替换文档
+ * @param doc_id 文档的唯一ID
+ * @param title 新的标题
+ * @param content 新的内容
+ * @return 替换了已有文档时返回true，文档原本不存在（直接添加）时返回false
+ *
+ * 旧版本的标记与新版本的写入在同一个快照中发布，查询不会看到文档缺失或重复的中间状态。
+ */
+bool SearchEngine::update_document(const std::string& doc_id, const std::string& title, const std::string& content) {
+    return add_documents(std::vector<Document>(1, Document(doc_id, title, content, ""))) > 0;
+}
+
+/**
+ * @brief 删除文档
+ * @param doc_id 文档的唯一ID
+ * @return 文档存在并被删除时返回true
+ */
+bool SearchEngine::delete_document(const std::string& doc_id) {
+    return delete_documents(std::vector<std::string>(1, doc_id)) > 0;
+}
 
-    std::cout << "Added document: " << doc_id << " (terms: " << term_freq.size() << ")" << std::endl;
+/**
+ * @brief 批量删除文档
+ * @param doc_ids 文档ID列表，不存在的ID被忽略
+ * @return 实际删除的文档数
+ *
+ * 删除只在新快照中标记墓碑并从集合统计中扣除文档长度，不修改段本身；
+ * 后台线程在合并时丢弃这些文档，删除比例过高的段会被单独压缩重写。
+ */
+size_t SearchEngine::delete_documents(const std::vector<std::string>& doc_ids) {
+    size_t removed = 0;
+    apply_changes(std::vector<Document>(), doc_ids, removed);
+    return removed;
 }
 
 /**
@@ -74,181 +467,1607 @@ void SearchEngine::add_document(const std::string& doc_id, const std::string& ti
  * @return 排序后的搜索结果列表
  */
 std::vector<SearchResult> SearchEngine::search(const std::string& query, int max_results) {
-    // 使用读锁保护，因为只读取共享数据
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    // 取得当前快照，查询期间即使有新文档写入，读取的索引也保持不变
+    SnapshotPtr snapshot = current_snapshot();
+    const IndexSnapshot& index = *snapshot;
 
     std::cout << "Executing search: \"" << query << "\"" << std::endl;
 
-    // 1. 预处理查询字符串
-    TextProcessor processor;
-    std::string processed_query = processor.preprocess_text(query);
-    std::vector<std::string> query_terms = processor.tokenize(processed_query);
-    query_terms = processor.remove_stop_words(query_terms);
-
-    if (query_terms.empty()) {
+    // 1. 解析查询字符串，查询词使用与索引相同的文本处理
+    StageTimer tokenize(Metrics::TOKENIZE);
+    QueryParser parser;
+    QueryNodePtr parsed = parser.parse(query);
+    tokenize.stop();
+    if (parsed->clauses.empty()) {
         return std::vector<SearchResult>();
     }
 
-    // 2. 查找包含查询词的候选文档
-    std::set<std::string> candidate_docs;
-    for (const std::string& term : query_terms) {
-        auto it = inverted_index_.find(term);
-        if (it != inverted_index_.end()) {
-            if (candidate_docs.empty()) {
-                candidate_docs = it->second;
-            } else {
-                // 当前实现为OR查询，合并所有包含任一查询词的文档
-                std::set<std::string> temp;
-                std::set_union(candidate_docs.begin(), candidate_docs.end(),
-                              it->second.begin(), it->second.end(),
-                              std::inserter(temp, temp.begin()));
-                candidate_docs = temp;
-            }
+    // 规范化查询相同、结果窗口相同且索引版本未变时直接返回缓存的结果
+    std::string cache_key = parsed->to_string() + "#" + std::to_string(max_results);
+    std::vector<SearchResult> results;
+    bool cacheable = cache_.capacity_bytes() > 0;
+    if (cacheable && cache_.get(cache_key, index.epoch, results)) {
+        std::cout << "Search completed (cached), found " << results.size() << " results" << std::endl;
+        return results;
+    }
+
+    // 2. 求值并生成摘要
+    results = evaluate(index, *parsed, max_results, nullptr, true);
+    if (cacheable) {
+        cache_.put(cache_key, index.epoch, results, result_bytes(results));
+    }
+
+    std::cout << "Search completed, found " << results.size() << " results" << std::endl;
+    return results;
+}
+
+/**
+ * @brief 批量执行搜索
+ * @param queries 用户的查询字符串列表
+ * @param max_results 每个查询的最大返回结果数
+ * @return 与queries一一对应的搜索结果列表
+ *
+ * 整批使用同一个快照：
+ * 1. 解析所有查询，规范化查询相同的只求值一次，缓存命中的直接取缓存结果；
+ * 2. 展开模糊查询词，把剩余查询中出现的所有词项汇总为一个词项表，每个词项在每个段中只查一次词典，
+ *    文档频率也只累计一次；
+ * 3. 各查询在线程池上并行求值（每个查询的段组在同一线程上串行），结果写回缓存。
+ * 倒排列表按块惰性解码、动态剪枝会跳过大部分块，因此各查询的迭代器各自解码，不预先整体解码共享。
+ */
+std::vector<std::vector<SearchResult>> SearchEngine::search_batch(const std::vector<std::string>& queries,
+                                                                  int max_results) {
+    SnapshotPtr snapshot = current_snapshot();
+    const IndexSnapshot& index = *snapshot;
+
+    std::cout << "Executing batch search: " << queries.size() << " queries" << std::endl;
+
+    // 1. 解析查询，合并重复的查询并查找缓存
+    std::vector<std::vector<SearchResult>> results(queries.size());
+    std::vector<BatchQuery> pending;
+    std::unordered_map<std::string, size_t> pending_keys;
+    bool cacheable = cache_.capacity_bytes() > 0;
+    QueryParser parser;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        StageTimer tokenize(Metrics::TOKENIZE);
+        QueryNodePtr parsed = parser.parse(queries[i]);
+        tokenize.stop();
+        if (parsed->clauses.empty()) {
+            continue;
+        }
+        std::string cache_key = parsed->to_string() + "#" + std::to_string(max_results);
+        std::unordered_map<std::string, size_t>::const_iterator duplicate = pending_keys.find(cache_key);
+        if (duplicate != pending_keys.end()) {
+            pending[duplicate->second].positions.push_back(i);
+            continue;
+        }
+        if (cacheable && cache_.get(cache_key, index.epoch, results[i])) {
+            continue;
+        }
+        BatchQuery query;
+        query.parsed = parsed;
+        query.cache_key = cache_key;
+        query.positions.push_back(i);
+        pending_keys[cache_key] = pending.size();
+        pending.push_back(query);
+    }
+
+    // 2. 展开模糊查询词，汇总词项表
+    TermTable terms(index);
+    std::set<std::string> all_terms;
+    for (BatchQuery& query : pending) {
+        query.parsed->collect_key_terms(query.keys);
+        StageTimer expand(Metrics::FUZZY_EXPAND);
+        expand_fuzzy(index, *query.parsed, nullptr);
+        expand.stop();
+        collect_all_terms(*query.parsed, all_terms);
+        all_terms.insert(query.keys.begin(), query.keys.end());
+    }
+    for (const std::string& term : all_terms) {
+        terms.add(term);
+    }
+
+    // 3. 并行求值；词项表的集合规模取自同一快照，分数与逐个查询时相同
+    std::vector<std::vector<SearchResult>> evaluated(pending.size());
+    auto evaluate_query = [&](size_t q) {
+        const BatchQuery& query = pending[q];
+        evaluated[q] = evaluate_expanded(index, *query.parsed, query.keys, max_results, &terms.statistics, &terms,
+                                         true);
+    };
+    if (pending.size() > 1 && search_pool_) {
+        std::vector<ThreadPool::Task> tasks;
+        for (size_t q = 0; q < pending.size(); ++q) {
+            tasks.push_back([&evaluate_query, q]() { evaluate_query(q); });
+        }
+        search_pool_->run_all(tasks);
+    } else {
+        for (size_t q = 0; q < pending.size(); ++q) {
+            evaluate_query(q);
         }
     }
 
-    // 3. 为每个候选文档计算相关性分数
-    std::vector<std::pair<std::string, double>> scored_docs;
-    for (const std::string& doc_id : candidate_docs) {
-        double score = calculate_relevance_score(doc_id, query_terms);
-        if (score > 0) {
-            scored_docs.push_back(std::make_pair(doc_id, score));
+    for (size_t q = 0; q < pending.size(); ++q) {
+        for (size_t position : pending[q].positions) {
+            results[position] = evaluated[q];
+        }
+        if (cacheable) {
+            cache_.put(pending[q].cache_key, index.epoch, evaluated[q], result_bytes(evaluated[q]));
         }
     }
 
-    // 4. 按分数降序排序
-    std::sort(scored_docs.begin(), scored_docs.end(),
-              [](const std::pair<std::string, double>& a, const std::pair<std::string, double>& b) {
-                  return a.second > b.second;
-              });
+    std::cout << "Batch search completed: " << queries.size() << " queries, " << pending.size() << " evaluated, "
+              << all_terms.size() << " distinct terms" << std::endl;
+    return results;
+}
+
+/**
+ * @brief 分布式查询的统计阶段
+ * @param query 用户的查询字符串
+ * @return 本分片的有效文档数、长度总和，以及查询中各词项的本地文档频率
+ *
+ * 词项包括模糊展开前的查询词（协调节点据此判断查询词是否在整个集合中都不存在）
+ * 与按本分片词汇展开得到的词项。
+ */
+TermStatistics SearchEngine::term_statistics(const std::string& query) const {
+    SnapshotPtr snapshot = current_snapshot();
+    const IndexSnapshot& index = *snapshot;
+    TermStatistics statistics;
+    statistics.doc_count = index.doc_count;
+    statistics.total_doc_len = index.total_doc_len;
+    statistics.total_title_len = index.total_title_len;
+
+    QueryParser parser;
+    QueryNodePtr parsed = parser.parse(query);
+    std::set<std::string> terms;
+    collect_all_terms(*parsed, terms);
+    expand_fuzzy(index, *parsed, nullptr);
+    collect_all_terms(*parsed, terms);
+    for (const std::string& term : terms) {
+        statistics.document_frequencies[term] = index.document_frequency(term);
+    }
+    return statistics;
+}
+
+/**
+ * @brief 分布式查询的求值阶段
+ * @param query 用户的查询字符串
+ * @param max_results 最大返回结果数
+ * @param global 协调节点汇总的全局统计
+ * @return 按全局统计打分的前max_results名，只有文档ID（url）与分数
+ *
+ * 全局平均长度只用于本次查询的打分器（见query_scorers），索引、查询缓存与补全索引都不受影响。
+ */
+std::vector<SearchResult> SearchEngine::search(const std::string& query, int max_results,
+                                               const TermStatistics& global) const {
+    SnapshotPtr snapshot = current_snapshot();
+
+    StageTimer tokenize(Metrics::TOKENIZE);
+    QueryParser parser;
+    QueryNodePtr parsed = parser.parse(query);
+    tokenize.stop();
+    if (parsed->clauses.empty()) {
+        return std::vector<SearchResult>();
+    }
+    return evaluate(*snapshot, *parsed, max_results, &global, false);
+}
+
+/**
+ * @brief 分布式查询的取摘要阶段
+ * @param query 用户的查询字符串
+ * @param doc_ids 协调节点归并出的、由本分片持有的文档ID
+ * @param global 协调节点汇总的全局统计
+ * @return 各文档的标题与摘要，顺序与doc_ids相同；分数为0，由协调节点填入
+ */
+std::vector<SearchResult> SearchEngine::fetch(const std::string& query, const std::vector<std::string>& doc_ids,
+                                              const TermStatistics& global) const {
+    SnapshotPtr snapshot = current_snapshot();
+    const IndexSnapshot& index = *snapshot;
+
+    QueryParser parser;
+    QueryNodePtr parsed = parser.parse(query);
+    expand_fuzzy(index, *parsed, &global);
+    std::map<std::string, double> weights = query_weights(index, *parsed, global.collection_stats(), &global);
+    SnippetGenerator snippets(weights);
 
-    // 5. 构建并返回最终的搜索结果
+    StageTimer building(Metrics::SNIPPET);
     std::vector<SearchResult> results;
-    int count = 0;
-    for (const auto& pair : scored_docs) {
-        if (count >= max_results) break;
-
-        const std::string& doc_id = pair.first;
-        double score = pair.second;
-
-        auto doc_it = documents_.find(doc_id);
-        if (doc_it != documents_.end()) {
-            const std::string& title = doc_it->second.first;
-            std::string content = doc_it->second.second;
-
-            // 生成内容摘要，并确保不截断UTF-8字符
-            if (content.length() > 180) {
-                size_t cut_pos = 180;
-                while (cut_pos > 0 && (content[cut_pos] & 0x80) && !(content[cut_pos] & 0x40)) {
-                    cut_pos--;
+    for (const std::string& id : doc_ids) {
+        DocId doc = 0;
+        size_t segment = index.find_document(id, doc);
+        if (segment < index.segments.size()) {
+            results.push_back(make_result(index, segment, doc, 0.0, weights, snippets));
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief 对解析后的查询求值
+ * @param index 查询使用的快照
+ * @param parsed 解析后的语法树，模糊查询词被原地展开
+ * @param max_results 最大返回结果数
+ * @param global 全局统计，为空时按本地所有段计算IDF与平均长度
+ * @param with_snippets 是否生成标题与摘要
+ * @return 排序后的搜索结果列表
+ */
+std::vector<SearchResult> SearchEngine::evaluate(const IndexSnapshot& index, QueryNode& parsed, int max_results,
+                                                 const TermStatistics* global, bool with_snippets) const {
+    // 把模糊查询词展开为词汇中匹配到的词项；邻近度只按用户输入的查询词计算
+    std::vector<std::string> keys;
+    parsed.collect_key_terms(keys);
+    StageTimer expand(Metrics::FUZZY_EXPAND);
+    expand_fuzzy(index, parsed, global);
+    expand.stop();
+    return evaluate_expanded(index, parsed, keys, max_results, global, nullptr, with_snippets);
+}
+
+/**
+ * @brief 对模糊查询词已展开的查询求值
+ * @param index 查询使用的快照
+ * @param parsed 模糊查询词已展开的语法树
+ * @param keys 展开前用户输入的查询词，用于邻近度加分
+ * @param max_results 最大返回结果数
+ * @param global 全局统计，为空时按本地所有段计算IDF与平均长度
+ * @param terms 批量查询共用的词项表，为空时直接查各段的词典
+ * @param with_snippets 是否生成标题与摘要
+ * @return 排序后的搜索结果列表
+ */
+std::vector<SearchResult> SearchEngine::evaluate_expanded(const IndexSnapshot& index, const QueryNode& parsed,
+                                                          const std::vector<std::string>& keys, int max_results,
+                                                          const TermStatistics* global, const TermTable* terms,
+                                                          bool with_snippets) const {
+    // 1. 合并重复的查询词，权重为出现次数乘以按所有段（或全局统计）计算的IDF
+    StageTimer gather(Metrics::CANDIDATE_GATHER);
+    CollectionStats stats = global ? global->collection_stats() : index.collection_stats();
+    std::map<std::string, double> weights = query_weights(index, parsed, stats, global);
+
+    // 多个查询词且存储了位置时，先取更多候选，再按邻近度加分重排
+    bool proximity = options_.store_positions && index.ranking.proximity_weight > 0.0 && keys.size() > 1;
+    std::vector<double> key_idfs;
+    if (proximity) {
+        for (const std::string& key : keys) {
+            key_idfs.push_back(index.scorer->idf(query_frequency(index, key, global), stats));
+        }
+    }
+    size_t k = max_results > 0 ? static_cast<size_t>(max_results) : 0;
+    size_t depth = proximity ? k * PROXIMITY_RERANK_FACTOR : k;
+    gather.stop();
+
+    // 2. 在每个段内求值前k名，被同ID后续添加取代的旧版本不参与排名
+    //    纯并集查询使用Block-Max WAND跳过不可能进入结果的文档，
+    //    结构化查询先按文档频率规划求交顺序，只对匹配文档打分
+    //    段按有效文档数分为至多shards_组，各组在线程池上并行求值并各自保留前k名；
+    //    权重已按全局IDF算好，求值只读取快照，分组方式不影响分数
+    std::vector<size_t> sizes;
+    for (const SegmentView& view : index.segments) {
+        sizes.push_back(view.live_count());
+    }
+    std::vector<std::pair<size_t, size_t>> groups = partition_runs(sizes, shards_);
+    std::vector<std::vector<SegmentHit>> group_hits(groups.size());
+    std::vector<boost::shared_ptr<const Scorer>> scorers = query_scorers(index, global);
+    auto find_postings = [&index, terms](size_t s, const std::string& term) {
+        return terms ? terms->find(s, term) : index.segments[s].segment->find_postings(term);
+    };
+    auto evaluate_group = [&](size_t g) {
+        std::vector<SegmentHit>& group = group_hits[g];
+        for (size_t s = groups[g].first; s < groups[g].first + groups[g].second; ++s) {
+            const SegmentView& view = index.segments[s];
+            const Scorer& scorer = *scorers[s];
+            TopKEvaluator::DocFilter filter = [&view](DocId doc) { return view.is_live(doc); };
+            std::vector<ScoredDoc> scored_docs;
+            if (parsed.is_disjunction()) {
+                TopKEvaluator evaluator(scorer, depth);
+                for (const auto& pair : weights) {
+                    const PostingList* postings = find_postings(s, pair.first);
+                    if (postings) {
+                        evaluator.add_term(postings, pair.second);
+                    }
                 }
-                content = content.substr(0, cut_pos) + "...";
+                scored_docs = evaluator.evaluate(filter);
+            } else {
+                QueryEvaluator::PostingLookup lookup = [&find_postings, s](const std::string& term) {
+                    return find_postings(s, term);
+                };
+                QueryEvaluator evaluator(scorer, lookup, depth);
+                for (const auto& pair : weights) {
+                    const PostingList* postings = find_postings(s, pair.first);
+                    if (postings) {
+                        evaluator.add_term(postings, pair.second);
+                    }
+                }
+                scored_docs = evaluator.evaluate(parsed, filter);
             }
-
-            results.push_back(SearchResult(title, content, doc_id, score));
-            count++;
+            if (proximity) {
+                apply_proximity(view, keys, key_idfs, index.ranking.proximity_weight, scored_docs);
+            }
+            for (const ScoredDoc& scored : scored_docs) {
+                group.push_back(SegmentHit(s, scored.doc, scored.score));
+            }
+        }
+        size_t keep = std::min(k, group.size());
+        std::partial_sort(group.begin(), group.begin() + keep, group.end(), HitDescending());
+        group.erase(group.begin() + keep, group.end());
+    };
+    StageTimer scoring(Metrics::SCORING);
+    if (groups.size() > 1 && search_pool_ && !terms) {
+        std::vector<ThreadPool::Task> tasks;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            tasks.push_back([&evaluate_group, g]() { evaluate_group(g); });
+        }
+        search_pool_->run_all(tasks);
+    } else {
+        for (size_t g = 0; g < groups.size(); ++g) {
+            evaluate_group(g);
         }
     }
+    scoring.stop();
 
-    std::cout << "Search completed, found " << results.size() << " results" << std::endl;
+    // 3. 合并各组的候选，保留全局前k名
+    StageTimer sorting(Metrics::SORT);
+    std::vector<SegmentHit> hits;
+    for (const std::vector<SegmentHit>& group : group_hits) {
+        hits.insert(hits.end(), group.begin(), group.end());
+    }
+    size_t count = std::min(k, hits.size());
+    std::partial_sort(hits.begin(), hits.begin() + count, hits.end(), HitDescending());
+    hits.erase(hits.begin() + count, hits.end());
+    sorting.stop();
+
+    // 4. 构建最终的搜索结果，摘要取正文中查询词最集中的片段
+    std::chrono::steady_clock::time_point building = std::chrono::steady_clock::now();
+    std::vector<SearchResult> results;
+    SnippetGenerator snippets(weights);
+    for (const SegmentHit& hit : hits) {
+        if (with_snippets) {
+            results.push_back(make_result(index, hit.segment, hit.doc, hit.score, weights, snippets));
+        } else {
+            boost::shared_ptr<const StoredDocument> document = index.segments[hit.segment].segment->document(hit.doc);
+            results.push_back(SearchResult(std::string(), std::string(), document->id, hit.score));
+        }
+    }
+    if (with_snippets) {
+        // 分布式查询的求值阶段不生成摘要，只在生成摘要时计入摘要阶段
+        Metrics::instance().record(Metrics::SNIPPET, building);
+    }
     return results;
 }
 
 /**
- * @brief 构建索引（目前主要是一个状态报告函数）
+ * @brief 由段内文档生成搜索结果
+ * @param index 查询使用的快照
+ * @param segment 段序号
+ * @param doc 段内局部编号
+ * @param score 相关性分数
+ * @param weights 查询词权重
+ * @param snippets 按同一组权重构造的摘要生成器
+ * @return 标题、摘要与高亮区间
  *
- * 实际的索引构建过程在`add_document`中动态进行。
- * 此函数可以用于触发批量优化或报告索引状态。
+ * 倒排记录给出查询词在正文中的出现次数，摘要生成器找全这些命中即可停止扫描。
  */
-void SearchEngine::build_index() {
-    std::cout << "Starting to build index..." << std::endl;
-    // 索引构建是动态的，在add_document中完成
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
-    std::cout << "Index build completed:" << std::endl;
-    std::cout << "  Document count: " << documents_.size() << std::endl;
-    std::cout << "  Vocabulary size: " << inverted_index_.size() << std::endl;
+SearchResult SearchEngine::make_result(const IndexSnapshot& index, size_t segment, DocId doc, double score,
+                                       const std::map<std::string, double>& weights,
+                                       const SnippetGenerator& snippets) {
+    const IndexSegment& source = *index.segments[segment].segment;
+    boost::shared_ptr<const StoredDocument> document = source.document(doc);
+    size_t expected_matches = 0;
+    for (const auto& pair : weights) {
+        const PostingList* postings = source.find_postings(pair.first);
+        if (!postings) {
+            continue;
+        }
+        PostingList::Iterator it = postings->iterator();
+        it.advance(doc);
+        if (!it.at_end() && it.doc() == doc) {
+            expected_matches += it.tf() - it.title_tf();
+        }
+    }
+    Snippet snippet = snippets.generate(document->content, expected_matches);
+
+    SearchResult result(document->title, snippet.text, document->id, score);
+    result.highlights.swap(snippet.highlights);
+    return result;
 }
 
 /**
- * @brief 从指定目录加载数据文件并建立索引
- * @param data_dir 包含数据文件的目录路径
+ * @brief 查询词的文档频率
+ * @param index 查询使用的快照
+ * @param term 索引词项
+ * @param global 全局统计，可以为空
+ * @return global中有该词项时为全局文档频率，否则为本地所有段的文档频率之和
+ *
+ * 统计阶段之后才出现在本分片词汇中的词项（例如期间写入了新文档）按本地文档频率计算。
  */
-void SearchEngine::load_data_files(const std::string& data_dir) {
-    std::cout << "Loading data files from directory: " << data_dir << std::endl;
-
-    Indexer indexer;
-    std::vector<Document> documents = indexer.scan_directory(data_dir);
-    std::cout << "Found " << documents.size() << " documents" << std::endl;
+size_t SearchEngine::query_frequency(const IndexSnapshot& index, const std::string& term,
+                                     const TermStatistics* global) {
+    if (global) {
+        std::map<std::string, size_t>::const_iterator it = global->document_frequencies.find(term);
+        if (it != global->document_frequencies.end()) {
+            return it->second;
+        }
+    }
+    return index.document_frequency(term);
+}
 
-    for (const Document& doc : documents) {
-        add_document(doc.id, doc.title, doc.content);
+/**
+ * @brief 计算查询词权重
+ * @param index 查询使用的快照
+ * @param node 模糊查询词已展开的语法树
+ * @param stats 计算IDF使用的集合统计
+ * @param global 全局统计，可以为空
+ * @return 词项 -> 出现次数（按boost计）乘以IDF
+ */
+std::map<std::string, double> SearchEngine::query_weights(const IndexSnapshot& index, const QueryNode& node,
+                                                          const CollectionStats& stats, const TermStatistics* global) {
+    std::map<std::string, double> term_counts;
+    node.collect_terms(term_counts);
+    std::map<std::string, double> weights;
+    for (const auto& pair : term_counts) {
+        weights[pair.first] = pair.second * index.scorer->idf(query_frequency(index, pair.first, global), stats);
     }
+    return weights;
+}
 
-    // 如果目录为空，则添加一些示例数据以供演示
-    if (documents.empty()) {
-        std::cout << "No data files found, adding sample data..." << std::endl;
-        add_document("doc1", "C++编程入门", "C++是一种通用的编程语言...");
-        add_document("doc2", "Boost库详细介绍", "Boost库是为C++语言标准库提供扩展...");
-        add_document("doc3", "搜索引擎原理", "搜索引擎的核心是倒排索引...");
-        add_document("doc4", "网络编程基础", "网络编程涉及套接字编程...");
-        add_document("doc5", "多线程编程", "多线程编程可以提高程序的并发性能...");
+/**
+ * @brief 展开模糊查询词
+ * @param snapshot 查询使用的快照
+ * @param node 语法树节点（BOOLEAN），原地修改
+ * @param global 全局统计，可以为空
+ *
+ * 带~的查询词按其编辑距离展开；开启fuzzy_unknown_terms时，词汇中不存在的英文查询词也按词长展开。
+ * 展开得到的每个词项是一个TERM节点，boost为FUZZY_EDIT_PENALTY的编辑距离次方。
+ * SHOULD子句直接展开为并列的SHOULD子句（纯并集查询仍可使用动态剪枝），
+ * MUST与MUST_NOT子句展开为SHOULD子句组成的分组。没有匹配到任何词项时保持原样，不产生匹配。
+ * 分布式查询时每个分片按本地词汇展开，查询词是否存在则按全局文档频率判断。
+ */
+void SearchEngine::expand_fuzzy(const IndexSnapshot& snapshot, QueryNode& node, const TermStatistics* global) const {
+    std::vector<QueryClause> clauses;
+    for (const QueryClause& clause : node.clauses) {
+        QueryNode& child = *clause.node;
+        if (child.type == QueryNode::BOOLEAN) {
+            expand_fuzzy(snapshot, child, global);
+            clauses.push_back(clause);
+            continue;
+        }
+
+        std::string bare;
+        split_field_term(child.terms[0], bare);
+        size_t max_edits = child.max_edits;
+        if (max_edits == 0 && options_.fuzzy_unknown_terms && child.type == QueryNode::TERM &&
+            child.terms.size() == 1 && query_frequency(snapshot, child.terms[0], global) == 0) {
+            max_edits = LevenshteinAutomaton::default_edits(bare);
+        }
+        std::vector<std::pair<std::string, size_t>> expansions;
+        if (max_edits > 0) {
+            snapshot.fuzzy_terms(child.terms[0], max_edits, FUZZY_EXPANSIONS, expansions);
+        }
+        if (expansions.empty()) {
+            clauses.push_back(clause);
+            continue;
+        }
+
+        QueryNodePtr group(new QueryNode(QueryNode::BOOLEAN));
+        for (const auto& expansion : expansions) {
+            QueryNodePtr term(new QueryNode(QueryNode::TERM));
+            term->text = expansion.first;
+            term->terms.push_back(expansion.first);
+            term->boost = std::pow(FUZZY_EDIT_PENALTY, static_cast<double>(expansion.second));
+            group->clauses.push_back(QueryClause(QueryClause::SHOULD, term));
+        }
+        if (clause.occur == QueryClause::SHOULD) {
+            clauses.insert(clauses.end(), group->clauses.begin(), group->clauses.end());
+        } else {
+            clauses.push_back(QueryClause(clause.occur, group->clauses.size() == 1 ? group->clauses[0].node : group));
+        }
     }
+    node.clauses.swap(clauses);
 }
 
 /**
- * @brief 计算一个词在一个文档中的TF-IDF值
- * @param term 要计算的词
- * @param doc_id 文档ID
- * @return 计算出的TF-IDF分数
+ * @brief 构建索引：封存缓冲段、合并所有段、提交排序统计并报告索引状态
+ *
+ * 倒排记录在`add_document`中动态追加，此函数负责批量优化：
+ * 封存缓冲段（收缩存储，并为每个词项在压缩块与位图之间选择更紧凑的表示），
+ * 把所有段合并为shards_个大小均衡的分片并丢弃已被取代的文档；
+ * 随后按最终的集合统计重新计算文档归一化因子。
+ * 每一步都在新快照的副本上进行，期间查询继续使用旧快照。
  */
-double SearchEngine::calculate_tfidf(const std::string& term, const std::string& doc_id) {
-    // 计算TF (Term Frequency)
-    auto tf_it = term_frequency_.find(doc_id);
-    if (tf_it == term_frequency_.end()) return 0.0;
-    auto term_it = tf_it->second.find(term);
-    if (term_it == tf_it->second.end()) return 0.0;
-    double tf = static_cast<double>(term_it->second);
-    int total_terms = 0;
-    for (const auto& pair : tf_it->second) {
-        total_terms += pair.second;
+void SearchEngine::build_index() {
+    std::cout << "Starting to build index..." << std::endl;
+
+    // 1. 封存缓冲段
+    {
+        boost::lock_guard<boost::mutex> lock(write_mutex_);
+        SnapshotPtr current = current_snapshot();
+        if (!current->segments.empty() && !current->segments.back().segment->sealed()) {
+            boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current));
+            boost::shared_ptr<IndexSegment> buffer(new IndexSegment(*next->segments.back().segment));
+            buffer->seal();
+            next->segments.back().segment = buffer;
+            publish(next);
+        }
     }
-    tf = total_terms > 0 ? tf / total_terms : 0.0; // 归一化TF
 
-    // 计算IDF (Inverse Document Frequency)
-    auto df_it = document_frequency_.find(term);
-    if (df_it == document_frequency_.end()) return 0.0;
-    double df = static_cast<double>(df_it->second);
-    double total_docs = static_cast<double>(documents_.size());
-    double idf = total_docs > df ? std::log(total_docs / df) : 0.0;
+    // 2. 合并为分片；与后台合并冲突而被放弃的组按新的快照重新合并
+    while (merge_segments(true)) {
+    }
+
+    // 3. 按最终的集合统计提交排序模型
+    boost::lock_guard<boost::mutex> lock(write_mutex_);
+    boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current_snapshot()));
+    commit_statistics(*next, Scorer::create(next->ranking), next->collection_stats());
+    next->epoch++;
+    publish(next);
 
-    return tf * idf;
+    std::cout << "Index build completed:" << std::endl;
+    report_index(*next);
 }
 
 /**
- * @brief 计算一个文档相对于一个查询的相关性分数
- * @param doc_id 文档ID
- * @param query_terms 查询分词后的词列表
- * @return 相关性总分
+ * @brief 汇总快照的规模与内存占用
+ * @param snapshot 要统计的快照
+ * @return 文档数、段数以及词典、倒排列表与文档存储占用的字节数；词汇量为0，由调用方填写
+ *
+ * 已封存的段直接使用封存时的统计，只有未封存的缓冲段需要遍历。
  */
-double SearchEngine::calculate_relevance_score(const std::string& doc_id, const std::vector<std::string>& query_terms) {
-    double score = 0.0;
-    // 简单地将查询中每个词的TF-IDF值相加
-    for (const std::string& term : query_terms) {
-        score += calculate_tfidf(term, doc_id);
+IndexSizeStats SearchEngine::measure_index(const IndexSnapshot& snapshot) {
+    IndexSizeStats size;
+    size.epoch = snapshot.epoch;
+    size.documents = snapshot.doc_count;
+    size.segments = snapshot.segments.size();
+    for (const SegmentView& view : snapshot.segments) {
+        SegmentFootprint footprint = view.segment->footprint();
+        size.dictionary_bytes += footprint.dictionary_bytes;
+        size.posting_bytes += footprint.posting_bytes;
+        size.bitmap_terms += footprint.bitmap_terms;
+        size.store_bytes += footprint.store_bytes;
+        size.store_raw_bytes += footprint.store_raw_bytes;
     }
-    return score;
+    return size;
 }
 
 /**
- * @brief 根据文档ID获取文档的标题和内容
- * @param doc_id 文档ID
- * @return 一个包含标题和内容的pair，如果未找到则两者都为空
+ * @brief 统计快照的词汇量
+ * @param snapshot 要统计的快照
+ * @return 所有段中默认字段的不同词项数
+ */
+size_t SearchEngine::count_vocabulary(const IndexSnapshot& snapshot) {
+    std::vector<std::string> terms;
+    for (const SegmentView& view : snapshot.segments) {
+        view.segment->collect_terms(terms);
+    }
+    std::sort(terms.begin(), terms.end());
+    return std::unique(terms.begin(), terms.end()) - terms.begin();
+}
+
+/**
+ * @brief 输出索引规模、内存占用与排序模型
+ * @param snapshot 刚发布的快照
+ */
+void SearchEngine::report_index(const IndexSnapshot& snapshot) {
+    IndexSizeStats size = measure_index(snapshot);
+    size.vocabulary = count_vocabulary(snapshot);
+    std::cout << "  Document count: " << size.documents << std::endl;
+    std::cout << "  Segment count: " << size.segments << std::endl;
+    std::cout << "  Vocabulary size: " << size.vocabulary << std::endl;
+    std::cout << "  Term dictionary memory: " << size.dictionary_bytes << " bytes" << std::endl;
+    std::cout << "  Posting list memory: " << size.posting_bytes << " bytes ("
+              << size.bitmap_terms << " bitmap terms, SIMD decoding "
+              << (PostingList::simd_enabled() ? "enabled" : "disabled") << ")" << std::endl;
+    std::cout << "  Document store: " << size.store_bytes << " bytes compressed ("
+              << size.store_raw_bytes << " bytes raw)" << std::endl;
+    std::cout << "  Ranking model: " << snapshot.scorer->name()
+              << " (average document length: " << snapshot.scorer->stats().avg_doc_len << ")" << std::endl;
+}
+
+/**
+ * @brief 切换排序模型
+ * @param config 排序模型配置
+ *
+ * 新的打分器会立即按当前索引提交统计信息，之后的查询使用新模型。
+ */
+void SearchEngine::set_ranking(const RankingConfig& config) {
+    boost::shared_ptr<Scorer> model = Scorer::create(config);
+    boost::lock_guard<boost::mutex> lock(write_mutex_);
+    boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current_snapshot()));
+    next->ranking = config;
+    commit_statistics(*next, model, next->collection_stats());
+    next->epoch++;
+    publish(next);
+    std::cout << "Ranking model set to " << model->name() << std::endl;
+}
+
+/**
+ * @brief 从指定目录加载数据文件并建立索引
+ * @param data_dir 包含数据文件的目录路径
+ *
+ * 流式流水线，三个阶段由有界队列连接，任何时刻在途的段数都有上限：
+ * 1. 扫描线程遍历目录，每INGEST_RANGE_FILES个连续文件组成一个范围放入范围队列；
+ * 2. 线程池中的工作线程各自取一个范围，读取、解码、分词并写入自己的段，封存后带着范围序号放入重排队列，
+ *    领先最慢的范围太多的线程会被阻塞（反压）；
+ * 3. 调用线程按范围顺序取出已封存的段并发布，这是唯一串行的步骤。
+ * 文档正文从解析到存储一路移动，不做复制；段在工作线程中建好后直接成为索引的一部分。
+ * 段按文件顺序发布，同ID的文档以遍历顺序中靠后的为准，与逐个添加时相同，因此结果与线程数无关。
+ */
+void SearchEngine::load_data_files(const std::string& data_dir) {
+    std::cout << "Loading data files from directory: " << data_dir << std::endl;
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    Indexer indexer(options_.partition, options_.partitions);
+    ThreadPool pool(options_.build_threads);
+    BoundedQueue<ScannedRange> scanned(pool.size());
+    OrderedQueue<boost::shared_ptr<IndexSegment>> built(pool.size() * INGEST_WINDOW_PER_THREAD);
+
+    // 1. 扫描
+    size_t files = 0;
+    boost::thread scanner([&indexer, &data_dir, &scanned, &files]() {
+        ScannedRange range;
+        bool open = true;
+        indexer.for_each_file(data_dir, [&scanned, &files, &range, &open](const std::string& path) {
+            range.paths.push_back(path);
+            files++;
+            if (range.paths.size() < INGEST_RANGE_FILES) {
+                return true;
+            }
+            size_t seq = range.seq;
+            open = scanned.push(std::move(range));
+            range = ScannedRange();
+            range.seq = seq + 1;
+            return open;
+        });
+        if (open && !range.paths.empty()) {
+            scanned.push(std::move(range));
+        }
+        scanned.close();
+    });
+
+    // 2. 每个工作线程把一个范围的文件建成一个段；最后一个退出的工作线程关闭重排队列，
+    //    出错时关闭两个队列让其他阶段退出，异常由pool.wait()重新抛出
+    boost::atomic<size_t> active_workers(pool.size());
+    boost::atomic<size_t> documents(0);
+    for (size_t w = 0; w < pool.size(); ++w) {
+        pool.submit([this, &indexer, &scanned, &built, &active_workers, &documents]() {
+            try {
+                TextProcessor processor;
+                ScannedRange range;
+                while (scanned.pop(range)) {
+                    boost::shared_ptr<IndexSegment> segment(new IndexSegment());
+                    for (const std::string& path : range.paths) {
+                        boost::shared_ptr<const StoredDocument> stored;
+                        AnalyzedDocument analyzed;
+                        try {
+                            Document document = indexer.parse_file(path);
+                            if (document.content.empty()) {
+                                continue;
+                            }
+                            analyzed = analyze_document(processor, document, options_.store_positions);
+                            stored = boost::make_shared<const StoredDocument>(
+                                std::move(document.id), std::move(document.title), std::move(document.content));
+                        }
+                        catch (const std::exception& e) {
+                            std::cerr << "Error processing file: " << path << " - " << e.what() << std::endl;
+                            continue;
+                        }
+                        DocId doc = segment->add_document(stored, analyzed.doc_len, analyzed.title_len);
+                        for (const auto& pair : analyzed.terms) {
+                            segment->add_posting(pair.first, doc, pair.second.tf, pair.second.title_tf,
+                                                 options_.store_positions ? &pair.second.positions : nullptr);
+                        }
+                    }
+                    documents += segment->size();
+                    segment->seal();
+                    if (!built.push(range.seq, segment)) {
+                        break;
+                    }
+                }
+            }
+            catch (...) {
+                scanned.close();
+                built.close();
+                throw;
+            }
+            if (--active_workers == 0) {
+                built.close();
+            }
+        });
+    }
+
+    // 3. 按文件顺序发布各段；出错时关闭队列让其他阶段退出
+    try {
+        boost::shared_ptr<IndexSegment> segment;
+        while (built.pop(segment)) {
+            if (segment->size() > 0) {
+                install_segment(segment);
+            }
+        }
+    }
+    catch (...) {
+        scanned.close();
+        built.close();
+        scanner.join();
+        pool.wait();
+        throw;
+    }
+    scanner.join();
+    pool.wait();
+
+    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+    std::cout << "Indexed " << documents.load() << " documents from " << files << " files with " << pool.size()
+              << " threads in " << elapsed.total_milliseconds() << " ms" << std::endl;
+
+    // 如果目录为空，则添加一些示例数据以供演示；分区为空的分片服务器保持空索引
+    if (documents.load() == 0 && options_.partitions <= 1) {
+        std::cout << "No data files found, adding sample data..." << std::endl;
+        add_document("doc1", "C++编程入门", "C++是一种通用的编程语言...");
+        add_document("doc2", "Boost库详细介绍", "Boost库是为C++语言标准库提供扩展...");
+        add_document("doc3", "搜索引擎原理", "搜索引擎的核心是倒排索引...");
+        add_document("doc4", "网络编程基础", "网络编程涉及套接字编程...");
+        add_document("doc5", "多线程编程", "多线程编程可以提高程序的并发性能...");
+    }
+}
+
+/**
+ * @brief 把当前索引写入索引文件
+ * @param path 索引文件路径
+ * @param fingerprint 建立索引时数据目录的指纹
+ *
+ * 写入的是调用时的快照：依次为集合统计、各段及其已取代文档的标记与这些文档中各词项的文档数。
+ * 文件先写入临时文件再替换，写入期间查询与写入都不受影响。
+ */
+void SearchEngine::save_index(const std::string& path, boost::uint64_t fingerprint) {
+    SnapshotPtr snapshot = current_snapshot();
+
+    IndexFileWriter writer(path);
+    writer.write_u64(snapshot->doc_count);
+    writer.write_u64(snapshot->total_doc_len);
+    writer.write_u64(snapshot->total_title_len);
+    writer.write_u32(static_cast<boost::uint32_t>(snapshot->segments.size()));
+    for (const SegmentView& view : snapshot->segments) {
+        view.segment->write(writer);
+        writer.write_u32(static_cast<boost::uint32_t>(view.deleted_count));
+        if (view.deleted_count > 0) {
+            for (DocId doc = 0; doc < view.segment->size(); ++doc) {
+                writer.write_u8(view.is_live(doc) ? 0 : 1);
+            }
+            writer.write_u32(static_cast<boost::uint32_t>(view.deleted_frequencies.size()));
+            view.deleted_frequencies.for_each([&writer](const std::string& term, boost::uint32_t count) {
+                writer.write_string(term);
+                writer.write_u32(count);
+            });
+        }
+    }
+
+    IndexFileInfo info;
+    info.flags = options_.store_positions ? index_file::FLAG_POSITIONS : 0;
+    info.fingerprint = fingerprint;
+    writer.finish(info);
+
+    std::cout << "Index saved to " << path << " (" << snapshot->doc_count << " documents, "
+              << snapshot->segments.size() << " segments)" << std::endl;
+}
+
+/**
+ * @brief 映射索引文件并替换当前索引
+ * @param path 索引文件路径
+ * @param fingerprint 当前数据目录的指纹
+ * @return 成功加载时返回true；需要重新建立索引时返回false，当前索引保持不变
+ *
+ * 倒排列表直接引用映射内存，启动时间只取决于读取各段的结构与重建ID表，与倒排数据的大小无关；
+ * 指定verify_index时另外读取整个正文校验校验和。
+ * 排序模型沿用当前设置，并按文件中的集合统计重新提交。
+ */
+bool SearchEngine::load_index(const std::string& path, boost::uint64_t fingerprint) {
+    if (!boost::filesystem::exists(path)) {
+        std::cout << "Index file not found: " << path << std::endl;
+        return false;
+    }
+
+    try {
+        boost::shared_ptr<const MappedIndexFile> file(new MappedIndexFile(path, options_.verify_index));
+        boost::uint32_t flags = options_.store_positions ? index_file::FLAG_POSITIONS : 0;
+        if (file->info().fingerprint != fingerprint || file->info().flags != flags) {
+            std::cout << "Index file is stale, rebuilding: " << path << std::endl;
+            return false;
+        }
+
+        // 1. 读取集合统计与各段，不持有任何锁
+        boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot());
+        IndexFileReader reader(file->body(), file->body_size());
+        next->doc_count = static_cast<size_t>(reader.read_u64());
+        next->total_doc_len = reader.read_u64();
+        next->total_title_len = reader.read_u64();
+        boost::uint32_t segment_count = reader.read_u32();
+        for (boost::uint32_t s = 0; s < segment_count; ++s) {
+            SegmentView view;
+            view.segment = IndexSegment::load(reader, file);
+            boost::uint32_t deleted_count = reader.read_u32();
+            if (deleted_count > 0) {
+                for (DocId doc = 0; doc < view.segment->size(); ++doc) {
+                    if (reader.read_u8() != 0) {
+                        view.mark_deleted(doc);
+                    }
+                }
+                if (view.deleted_count != deleted_count) {
+                    throw std::runtime_error("Index file is corrupted (deleted document count)");
+                }
+                boost::uint32_t term_count = reader.read_u32();
+                for (boost::uint32_t t = 0; t < term_count; ++t) {
+                    std::string term = reader.read_string();
+                    view.deleted_frequencies[term] = reader.read_u32();
+                }
+                if (view.deleted_frequencies.size() != term_count) {
+                    throw std::runtime_error("Index file is corrupted (deleted term frequencies)");
+                }
+            }
+            next->segments.push_back(view);
+        }
+        if (!reader.at_end()) {
+            throw std::runtime_error("Index file is corrupted (trailing data)");
+        }
+
+        // 2. 按当前排序模型提交统计并发布
+        boost::lock_guard<boost::mutex> lock(write_mutex_);
+        SnapshotPtr current = current_snapshot();
+        next->ranking = current->ranking;
+        next->epoch = current->epoch + 1;
+        commit_statistics(*next, Scorer::create(next->ranking), next->collection_stats());
+        publish(next);
+
+        std::cout << "Index loaded from " << path << ":" << std::endl;
+        report_index(*next);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to load index file " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+/**
+ * @brief 把一个已封存的段追加到索引末尾并发布
+ * @param segment 已封存的段，发布后不再修改
+ *
+ * 未封存的缓冲段先被封存，使新段之后仍保持“最后一个未封存段即缓冲段”的约定。
+ * 段内同ID的文档只保留最后一个；已有的同ID文档被新段中的版本取代。
+ */
+void SearchEngine::install_segment(const boost::shared_ptr<IndexSegment>& segment) {
+    boost::lock_guard<boost::mutex> lock(write_mutex_);
+    boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current_snapshot()));
+    if (!next->segments.empty() && !next->segments.back().segment->sealed()) {
+        boost::shared_ptr<IndexSegment> buffer(new IndexSegment(*next->segments.back().segment));
+        buffer->seal();
+        next->segments.back().segment = buffer;
+    }
+
+    // 1. 取代已有段中的同ID文档
+    for (const auto& pair : segment->ids()) {
+        DocId old_doc = 0;
+        size_t old_segment = next->find_document(pair.first, old_doc);
+        if (old_segment < next->segments.size()) {
+            next->remove_document(old_segment, old_doc, *removal_processor_);
+        }
+    }
+
+    // 2. 追加新段，先计入全部文档，再取代段内较早的同ID文档
+    SegmentView view;
+    view.segment = segment;
+    view.scorer = segment_scorer(*next->scorer, *segment);
+    next->segments.push_back(view);
+    size_t position = next->segments.size() - 1;
+    for (DocId doc = 0; doc < segment->size(); ++doc) {
+        next->doc_count++;
+        next->total_doc_len += segment->doc_lengths()[doc];
+        next->total_title_len += segment->title_lengths()[doc];
+    }
+    std::vector<bool> latest(segment->size(), false);
+    for (const auto& pair : segment->ids()) {
+        latest[pair.second] = true;
+    }
+    for (DocId doc = 0; doc < segment->size(); ++doc) {
+        if (!latest[doc]) {
+            next->remove_document(position, doc, *removal_processor_);
+        }
+    }
+
+    next->epoch++;
+    publish(next);
+    request_merge();
+}
+
+/**
+ * @brief 原子地取得当前快照
+ * @return 当前快照的引用，持有期间快照不会被释放
+ */
+SearchEngine::SnapshotPtr SearchEngine::current_snapshot() const {
+    return boost::atomic_load(&snapshot_);
+}
+
+/**
+ * @brief 原子地发布新快照
+ * @param next 构建完成的下一个版本，发布后不再修改
+ *
+ * 调用方必须持有写入锁。旧快照在最后一个使用它的查询结束后释放。
+ * 发布后唤醒后台线程刷新补全索引；先获取一次merge_mutex_，
+ * 保证后台线程要么已经看到新版本，要么已在等待而能收到通知。
+ */
+void SearchEngine::publish(const boost::shared_ptr<IndexSnapshot>& next) {
+    boost::atomic_store(&snapshot_, SnapshotPtr(next));
+    {
+        boost::lock_guard<boost::mutex> lock(merge_mutex_);
+    }
+    merge_cv_.notify_one();
+}
+
+/**
+ * @brief 把有效文档标记为已删除
+ * @param doc 段内局部编号，必须是有效文档
+ *
+ * 标记仍与已发布的快照共享时先复制，其他快照中的标记保持不变；
+ * 同一快照内的后续标记直接修改这份副本。
+ */
+void SearchEngine::SegmentView::mark_deleted(DocId doc) {
+    if (deleted && deleted.use_count() == 1 && deleted_docs.use_count() == 1) {
+        // 标记只属于这个尚未发布的快照，可以原地修改
+        const_cast<std::vector<bool>&>(*deleted)[doc] = true;
+        std::vector<DocId>& docs = const_cast<std::vector<DocId>&>(*deleted_docs);
+        docs.insert(std::upper_bound(docs.begin(), docs.end(), doc), doc);
+    } else {
+        boost::shared_ptr<std::vector<bool>> bitmap(
+            deleted ? new std::vector<bool>(*deleted) : new std::vector<bool>());
+        bitmap->resize(segment->size());
+        (*bitmap)[doc] = true;
+        boost::shared_ptr<std::vector<DocId>> docs(
+            deleted_docs ? new std::vector<DocId>(*deleted_docs) : new std::vector<DocId>());
+        docs->insert(std::upper_bound(docs->begin(), docs->end(), doc), doc);
+        deleted = bitmap;
+        deleted_docs = docs;
+    }
+    deleted_count++;
+}
+
+/**
+ * @brief 重新分析已删除的文档，累计它含有的词项
+ * @param doc 段内局部编号，刚被标记为已删除
+ * @param processor 文本处理器
+ *
+ * 存储的原始文档与建立索引时分析的是同一份文本，得到的词项与写入倒排列表的词项相同；
+ * 标题中出现的词项同时计入标题字段。计数与已发布的快照共享，只复制修改路径上的节点。
+ */
+void SearchEngine::SegmentView::count_deleted_terms(DocId doc, TextProcessor& processor) {
+    boost::shared_ptr<const StoredDocument> stored = segment->document(doc);
+    AnalyzedDocument analyzed =
+        analyze_document(processor, Document(stored->id, stored->title, stored->content, ""), false);
+    for (const auto& pair : analyzed.terms) {
+        deleted_frequencies[pair.first]++;
+        if (pair.second.title_tf > 0) {
+            deleted_frequencies[field_term(FIELD_TITLE, pair.first)]++;
+        }
+    }
+}
+
+/**
+ * @brief 倒排列表中有效文档的数目
+ * @param term 倒排列表对应的索引词项，可以是字段限定的词项
+ * @param postings 本段的倒排列表
+ * @return 文档频率减去其中已删除的文档数，后者在标记删除时已经累计
+ */
+size_t SearchEngine::SegmentView::live_frequency(const std::string& term, const PostingList& postings) const {
+    const boost::uint32_t* dead = deleted_count > 0 ? deleted_frequencies.find(term) : nullptr;
+    return dead ? postings.size() - *dead : postings.size();
+}
+
+/**
+ * @brief 由当前有效文档得到集合统计
+ * @return 文档数与各字段的平均长度
+ */
+CollectionStats SearchEngine::IndexSnapshot::collection_stats() const {
+    return make_collection_stats(doc_count, total_doc_len, total_title_len);
+}
+
+/**
+ * @brief 统计词项在所有段中的文档频率
+ * @param term 索引词项
+ * @return 各段倒排列表的文档数之和
+ */
+size_t SearchEngine::IndexSnapshot::document_frequency(const std::string& term) const {
+    size_t df = 0;
+    for (const SegmentView& view : segments) {
+        const PostingList* postings = view.segment->find_postings(term);
+        if (postings) {
+            df += view.live_frequency(term, *postings);
+        }
+    }
+    return df;
+}
+
+/**
+ * @brief TermTable的构造函数
+ * @param index 整批查询使用的快照
+ */
+SearchEngine::TermTable::TermTable(const IndexSnapshot& index) : snapshot(index) {
+    statistics.doc_count = index.doc_count;
+    statistics.total_doc_len = index.total_doc_len;
+    statistics.total_title_len = index.total_title_len;
+}
+
+/**
+ * @brief 查找词项在各段中的倒排列表并累计文档频率
+ * @param term 索引词项
+ */
+void SearchEngine::TermTable::add(const std::string& term) {
+    std::vector<const PostingList*>& lists = postings[term];
+    size_t df = 0;
+    lists.reserve(snapshot.segments.size());
+    for (const SegmentView& view : snapshot.segments) {
+        const PostingList* list = view.segment->find_postings(term);
+        lists.push_back(list);
+        if (list) {
+            df += view.live_frequency(term, *list);
+        }
+    }
+    statistics.document_frequencies[term] = df;
+}
+
+/**
+ * @brief 词项在一个段中的倒排列表
+ * @param segment 段序号
+ * @param term 索引词项
+ * @return 倒排列表，不存在时为空指针
+ */
+const PostingList* SearchEngine::TermTable::find(size_t segment, const std::string& term) const {
+    std::unordered_map<std::string, std::vector<const PostingList*>>::const_iterator it = postings.find(term);
+    if (it != postings.end()) {
+        return it->second[segment];
+    }
+    return snapshot.segments[segment].segment->find_postings(term);
+}
+
+/**
+ * @brief 列出与词项编辑距离足够小的索引词项
+ * @param term 查询词项，可以是字段限定的词项
+ * @param max_edits 最大编辑距离
+ * @param limit 最多输出的词项数
+ * @param out 输出：(词项, 编辑距离)，按编辑距离升序、文档频率降序排列，与term限定相同的字段
+ *
+ * 每个段中同一字段的词典各自与同一个Levenshtein自动机求交，同一词项在多个段中出现时只保留一次。
+ */
+void SearchEngine::IndexSnapshot::fuzzy_terms(const std::string& term, size_t max_edits, size_t limit,
+                                              std::vector<std::pair<std::string, size_t>>& out) const {
+    std::string bare;
+    IndexField field = split_field_term(term, bare);
+    LevenshteinAutomaton automaton(bare, max_edits);
+    std::vector<std::pair<std::string, size_t>> found;
+    for (const SegmentView& view : segments) {
+        view.segment->collect_fuzzy_terms(automaton, found, field);
+    }
+    if (field != FIELD_DEFAULT) {
+        for (auto& pair : found) {
+            pair.first = field_term(field, pair.first);
+        }
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+
+    std::vector<std::pair<size_t, size_t>> order; // (文档频率, 在found中的序号)
+    for (size_t i = 0; i < found.size(); ++i) {
+        order.push_back(std::make_pair(document_frequency(found[i].first), i));
+    }
+    std::sort(order.begin(), order.end(), [&found](const std::pair<size_t, size_t>& a,
+                                                   const std::pair<size_t, size_t>& b) {
+        if (found[a.second].second != found[b.second].second) {
+            return found[a.second].second < found[b.second].second;
+        }
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    for (size_t i = 0; i < order.size() && i < limit; ++i) {
+        out.push_back(found[order[i].second]);
+    }
+}
+
+/**
+ * @brief 查找字符串ID当前有效的文档
+ * @param id 字符串ID
+ * @param doc 输出：段内局部编号
+ * @return 段序号，文档不存在时返回段数
+ *
+ * 同一ID最多只有一个有效版本，从最新的段开始查找。
+ */
+size_t SearchEngine::IndexSnapshot::find_document(const std::string& id, DocId& doc) const {
+    for (size_t s = segments.size(); s-- > 0;) {
+        DocId local = segments[s].segment->find_document(id);
+        if (local != PostingList::END_DOC && segments[s].is_live(local)) {
+            doc = local;
+            return s;
+        }
+    }
+    return segments.size();
+}
+
+/**
+ * @brief 把有效文档标记为已删除
+ * @param segment 段序号
+ * @param doc 段内局部编号，必须是有效文档
+ * @param processor 重新分析文档所用的文本处理器
+ */
+void SearchEngine::IndexSnapshot::remove_document(size_t segment, DocId doc, TextProcessor& processor) {
+    SegmentView& view = segments[segment];
+    view.mark_deleted(doc);
+    view.count_deleted_terms(doc, processor);
+    doc_count--;
+    total_doc_len -= view.segment->doc_lengths()[doc];
+    total_title_len -= view.segment->title_lengths()[doc];
+}
+
+/**
+ * @brief 按集合统计重新提交排序模型
+ * @param snapshot 尚未发布的快照
+ * @param model 尚未被任何快照使用的排序模型，提交后成为快照的排序模型
+ * @param stats 集合统计，通常为快照自身的统计，分布式查询时为全局统计
+ */
+void SearchEngine::commit_statistics(IndexSnapshot& snapshot, const boost::shared_ptr<Scorer>& model,
+                                     const CollectionStats& stats) {
+    model->commit(stats, std::vector<boost::uint32_t>(), std::vector<boost::uint32_t>());
+    snapshot.scorer = model;
+    for (SegmentView& view : snapshot.segments) {
+        view.scorer = segment_scorer(*model, *view.segment);
+    }
+}
+
+/**
+ * @brief 查询在各段使用的打分器
+ * @param snapshot 查询使用的快照
+ * @param global 全局统计，单机查询时为空
+ * @return 与snapshot.segments一一对应的打分器
+ *
+ * 文档归一化因子取决于平均长度，分布式查询必须按全局平均长度计算，同一文档在任何分片上的分数才与单机相同。
+ * 单机查询（批量查询的词项表的集合规模就是快照本身）、或全局平均长度与段最近一次提交的一致时，
+ * 直接使用已提交的打分器；否则由排序模型新建一个按全局统计现算归一化因子的打分器，
+ * 只供本次查询使用，代价与段的大小无关。查询从不修改索引，也不会使查询缓存或补全索引失效。
+ */
+std::vector<boost::shared_ptr<const Scorer>> SearchEngine::query_scorers(const IndexSnapshot& snapshot,
+                                                                         const TermStatistics* global) {
+    std::vector<boost::shared_ptr<const Scorer>> scorers;
+    scorers.reserve(snapshot.segments.size());
+    bool local = !global || (global->doc_count == snapshot.doc_count &&
+                             global->total_doc_len == snapshot.total_doc_len &&
+                             global->total_title_len == snapshot.total_title_len);
+    CollectionStats stats = global ? global->collection_stats() : CollectionStats();
+    for (const SegmentView& view : snapshot.segments) {
+        const CollectionStats& committed = view.scorer->stats();
+        if (local || (committed.avg_doc_len == stats.avg_doc_len && committed.avg_title_len == stats.avg_title_len &&
+                      committed.avg_content_len == stats.avg_content_len)) {
+            scorers.push_back(view.scorer);
+            continue;
+        }
+        boost::shared_ptr<Scorer> scorer = Scorer::create(snapshot.ranking);
+        scorer->bind(stats, view.segment->doc_lengths(), view.segment->title_lengths());
+        scorers.push_back(scorer);
+    }
+    return scorers;
+}
+
+/**
+ * @brief 为段创建打分器
+ * @param model 已提交集合统计的排序模型
+ * @param segment 索引段
+ * @return 持有段内所有文档归一化因子的打分器
+ */
+boost::shared_ptr<const Scorer> SearchEngine::segment_scorer(const Scorer& model, const IndexSegment& segment) {
+    boost::shared_ptr<Scorer> scorer = model.clone();
+    scorer->commit(model.stats(), segment.doc_lengths(), segment.title_lengths());
+    return scorer;
+}
+
+/**
+ * @brief 按查询词之间的邻近度给一个段内的候选文档加分
+ * @param view 候选文档所在的段
+ * @param keys 按查询顺序排列的代表词项
+ * @param key_idfs 各代表词项的IDF
+ * @param weight 邻近度权重
+ * @param docs 候选文档，分数原地更新
+ *
+ * 查询中相邻的两个查询词在文档中最近距离为d时，加分为
+ * 邻近度权重 * 两词IDF的较小者 / d^2（d超过窗口时不加分）。
+ * 候选按文档编号升序处理，每个词项的迭代器只向前移动。
+ */
+void SearchEngine::apply_proximity(const SegmentView& view, const std::vector<std::string>& keys,
+                                   const std::vector<double>& key_idfs, double weight, std::vector<ScoredDoc>& docs) {
+    PostingList empty_list;
+    std::vector<const PostingList*> lists;
+    std::vector<PostingList::Iterator> iterators;
+    for (const std::string& key : keys) {
+        const PostingList* postings = view.segment->find_postings(key);
+        lists.push_back(postings);
+        iterators.push_back(postings ? postings->iterator() : empty_list.iterator());
+    }
+
+    std::vector<size_t> order(docs.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&docs](size_t a, size_t b) { return docs[a].doc < docs[b].doc; });
+
+    std::vector<std::vector<boost::uint32_t>> positions(keys.size());
+    for (size_t index : order) {
+        DocId doc = docs[index].doc;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            positions[i].clear();
+            if (lists[i]) {
+                iterators[i].advance(doc);
+                if (iterators[i].doc() == doc) {
+                    iterators[i].positions(positions[i]);
+                }
+            }
+        }
+
+        double bonus = 0.0;
+        for (size_t i = 0; i + 1 < keys.size(); ++i) {
+            if (keys[i] != keys[i + 1] && !positions[i].empty() && !positions[i + 1].empty()) {
+                bonus += std::min(key_idfs[i], key_idfs[i + 1]) * proximity_score(positions[i], positions[i + 1]);
+            }
+        }
+        docs[index].score += weight * bonus;
+    }
+}
+
+/**
+ * @brief 按层级合并策略选出需要合并的相邻段
+ * @param snapshot 当前快照
+ * @param shard_docs 分片的目标大小，有效文档数达到该值的段视为完整的分片，不再参与合并
+ * @param first 输出：第一个待合并段的序号
+ * @param count 输出：待合并的段数
+ * @return 找到可合并的段时返回true
+ *
+ * 段按有效文档数分层：少于 SEGMENT_BUFFER_DOCS * MERGE_FACTOR 的为第0层，依此类推。
+ * 同一层级连续出现MERGE_FACTOR个已封存的段时合并它们，合并后的段进入更高一层，
+ * 因此每个文档被合并的次数只随索引规模对数增长。
+ * 合并会丢弃已删除的文档；删除集中在不再合并的段上时，已删除文档达到COMPACT_DELETED_PERCENT的段
+ * 被单独重写（压缩），回收其倒排记录与原始文档占用的空间。
+ */
+bool SearchEngine::select_merge(const IndexSnapshot& snapshot, size_t shard_docs, size_t& first, size_t& count) {
+    size_t run_start = 0;
+    size_t run_tier = 0;
+    bool in_run = false;
+    for (size_t s = 0; s < snapshot.segments.size(); ++s) {
+        const SegmentView& view = snapshot.segments[s];
+        if (!view.segment->sealed()) {
+            break;
+        }
+        if (view.live_count() >= shard_docs) {
+            in_run = false;
+            continue;
+        }
+        size_t tier = 0;
+        for (size_t limit = SEGMENT_BUFFER_DOCS * MERGE_FACTOR; view.live_count() >= limit; limit *= MERGE_FACTOR) {
+            tier++;
+        }
+        if (!in_run || tier != run_tier) {
+            run_start = s;
+            run_tier = tier;
+            in_run = true;
+        }
+        if (s - run_start + 1 == MERGE_FACTOR) {
+            first = run_start;
+            count = MERGE_FACTOR;
+            return true;
+        }
+    }
+
+    // 没有可合并的相邻段时，单独重写已删除文档过多的段（包括不再参与合并的完整分片）
+    for (size_t s = 0; s < snapshot.segments.size(); ++s) {
+        const SegmentView& view = snapshot.segments[s];
+        if (!view.segment->sealed()) {
+            break;
+        }
+        if (view.deleted_count > 0 && view.deleted_count * 100 >= view.segment->size() * COMPACT_DELETED_PERCENT) {
+            first = s;
+            count = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 执行段合并并提交
+ * @param full 为true时把所有已封存的段合并为至多shards_个大小均衡的分片
+ *             （只有一个段的分片也会丢弃其中已被取代的文档）；否则按层级策略合并一组相邻段
+ * @return 提交了合并结果，或有组被放弃而需要重试时返回true
+ *
+ * 合并读取的是开始时的快照，不持有任何锁，多个分片在线程池上并行合并；
+ * 提交时在写入锁内确认各组源段仍然相邻存在（其间另一次合并先提交了这些段时该组被放弃），
+ * 并把合并期间新被取代的文档标记到合并后的段中。所有组在同一个新快照中发布。
+ */
+bool SearchEngine::merge_segments(bool full) {
+    SnapshotPtr snapshot = current_snapshot();
+    std::vector<std::pair<size_t, size_t>> runs;
+    if (full) {
+        std::vector<size_t> sizes;
+        while (sizes.size() < snapshot->segments.size() && snapshot->segments[sizes.size()].segment->sealed()) {
+            sizes.push_back(snapshot->segments[sizes.size()].live_count());
+        }
+        for (const auto& run : partition_runs(sizes, shards_)) {
+            if (run.second > 1 || snapshot->segments[run.first].deleted_count > 0) {
+                runs.push_back(run);
+            }
+        }
+    } else {
+        size_t first = 0;
+        size_t count = 0;
+        size_t shard_docs = std::max<size_t>(1, (snapshot->doc_count + shards_ - 1) / shards_);
+        if (select_merge(*snapshot, shard_docs, first, count)) {
+            runs.push_back(std::make_pair(first, count));
+        }
+    }
+    if (runs.empty()) {
+        return false;
+    }
+
+    // 1. 在锁外合并
+    std::vector<std::vector<const IndexSegment*>> sources(runs.size());
+    std::vector<std::vector<std::vector<DocId>>> remaps(runs.size());
+    std::vector<boost::shared_ptr<IndexSegment>> merged(runs.size());
+    auto merge_run = [&](size_t r) {
+        std::vector<const std::vector<bool>*> deleted;
+        for (size_t s = runs[r].first; s < runs[r].first + runs[r].second; ++s) {
+            sources[r].push_back(snapshot->segments[s].segment.get());
+            deleted.push_back(snapshot->segments[s].deleted.get());
+        }
+        merged[r] = IndexSegment::merge(sources[r], deleted, remaps[r]);
+    };
+    if (runs.size() > 1 && search_pool_) {
+        std::vector<ThreadPool::Task> tasks;
+        for (size_t r = 0; r < runs.size(); ++r) {
+            tasks.push_back([&merge_run, r]() { merge_run(r); });
+        }
+        search_pool_->run_all(tasks);
+    } else {
+        for (size_t r = 0; r < runs.size(); ++r) {
+            merge_run(r);
+        }
+    }
+
+    boost::lock_guard<boost::mutex> lock(write_mutex_);
+    SnapshotPtr current = current_snapshot();
+    boost::shared_ptr<IndexSnapshot> next(new IndexSnapshot(*current));
+    size_t committed = 0;
+    size_t abandoned = 0;
+    for (size_t r = runs.size(); r-- > 0;) {
+        // 2. 提交：确认源段仍然相邻存在（从后往前提交，前面的组的位置不受影响）
+        size_t count = sources[r].size();
+        size_t position = 0;
+        while (position < next->segments.size() && next->segments[position].segment.get() != sources[r][0]) {
+            position++;
+        }
+        bool adjacent = position + count <= next->segments.size();
+        for (size_t i = 0; adjacent && i < count; ++i) {
+            adjacent = next->segments[position + i].segment.get() == sources[r][i];
+        }
+        if (!adjacent) {
+            abandoned++;
+            continue;
+        }
+
+        // 3. 合并期间被取代的文档同样标记到合并后的段中
+        SegmentView view;
+        view.segment = merged[r];
+        view.scorer = segment_scorer(*current->scorer, *merged[r]);
+        for (size_t i = 0; i < count; ++i) {
+            const SegmentView& source = next->segments[position + i];
+            if (source.deleted_count == 0) {
+                continue;
+            }
+            for (DocId doc : *source.deleted_docs) {
+                if (remaps[r][i][doc] != PostingList::END_DOC) {
+                    view.mark_deleted(remaps[r][i][doc]);
+                    view.count_deleted_terms(remaps[r][i][doc], *removal_processor_);
+                }
+            }
+        }
+
+        next->segments.erase(next->segments.begin() + position, next->segments.begin() + position + count);
+        next->segments.insert(next->segments.begin() + position, view);
+        committed++;
+        if (count == 1) {
+            std::cout << "Compacted segment (" << merged[r]->size() << " documents)" << std::endl;
+        } else {
+            std::cout << "Merged " << count << " segments into one (" << merged[r]->size() << " documents)" << std::endl;
+        }
+    }
+    if (committed > 0) {
+        next->epoch++;
+        publish(next);
+    }
+    return committed > 0 || abandoned > 0;
+}
+
+/**
+ * @brief 唤醒后台合并线程
+ */
+void SearchEngine::request_merge() {
+    {
+        boost::lock_guard<boost::mutex> lock(merge_mutex_);
+        merge_pending_ = true;
+    }
+    merge_cv_.notify_one();
+}
+
+/**
+ * @brief 后台线程：被唤醒后反复合并，直到没有满足策略的段；并在索引变化后刷新补全索引
+ *
+ * 补全索引过期时，等到距上次刷新满SUGGEST_REFRESH_MS再重建，
+ * 连续写入期间因此至多每个间隔重建一次，写入停止后最多延迟一个间隔即可看到新词项。
+ */
+void SearchEngine::merge_loop() {
+    for (;;) {
+        bool merge = false;
+        {
+            boost::unique_lock<boost::mutex> lock(merge_mutex_);
+            for (;;) {
+                if (stopping_) {
+                    return;
+                }
+                if (merge_pending_) {
+                    break;
+                }
+                if (!suggester_stale()) {
+                    merge_cv_.wait(lock);
+                    continue;
+                }
+                boost::posix_time::ptime due = suggest_built_ + boost::posix_time::milliseconds(SUGGEST_REFRESH_MS);
+                if (boost::posix_time::microsec_clock::universal_time() >= due) {
+                    break;
+                }
+                merge_cv_.timed_wait(lock, due);
+            }
+            merge = merge_pending_;
+            merge_pending_ = false;
+        }
+
+        try {
+            while (merge && merge_segments(false)) {
+                boost::lock_guard<boost::mutex> lock(merge_mutex_);
+                if (stopping_) {
+                    return;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Segment merge failed: " << e.what() << std::endl;
+        }
+
+        try {
+            refresh_suggester();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Suggestion index refresh failed: " << e.what() << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief 补全索引是否落后于当前快照
+ */
+bool SearchEngine::suggester_stale() const {
+    return boost::atomic_load(&suggester_)->epoch() != current_snapshot()->epoch;
+}
+
+/**
+ * @brief 按当前快照的词汇重建补全索引并原子地发布
+ *
+ * 距上次重建不足SUGGEST_REFRESH_MS时不重建，由后台线程到期后再次调用。
+ * 词项的权重为各段文档频率之和，与计算IDF时的口径相同。
+ */
+void SearchEngine::refresh_suggester() {
+    SnapshotPtr snapshot = current_snapshot();
+    if (boost::atomic_load(&suggester_)->epoch() == snapshot->epoch ||
+        boost::posix_time::microsec_clock::universal_time() <
+            suggest_built_ + boost::posix_time::milliseconds(SUGGEST_REFRESH_MS)) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, boost::uint32_t>> terms;
+    for (const SegmentView& view : snapshot->segments) {
+        view.segment->collect_term_frequencies(terms);
+    }
+    std::sort(terms.begin(), terms.end());
+    size_t unique = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (unique > 0 && terms[unique - 1].first == terms[i].first) {
+            terms[unique - 1].second += terms[i].second;
+        } else {
+            terms[unique++].swap(terms[i]);
+        }
+    }
+    terms.resize(unique);
+
+    boost::shared_ptr<const Suggester> next(new Suggester(terms, snapshot->epoch));
+    boost::atomic_store(&suggester_, next);
+    suggest_built_ = boost::posix_time::microsec_clock::universal_time();
+}
+
+/**
+ * @brief 输入补全
+ * @param query 正在输入的查询，只补全最后一个词，前面的部分原样保留
+ * @param max_results 最多返回的条数（不超过Suggester::TOP_K）
+ * @return 按文档频率降序排列的补全
+ *
+ * 只读取已发布的补全索引，不访问索引快照；最后一个词转为小写后与索引词项比较。
+ */
+std::vector<Suggestion> SearchEngine::suggest(const std::string& query, size_t max_results) const {
+    std::vector<Suggestion> suggestions;
+    size_t start = query.find_last_of(" \t");
+    start = start == std::string::npos ? 0 : start + 1;
+    std::string prefix = query.substr(start);
+    if (prefix.empty()) {
+        return suggestions;
+    }
+    boost::to_lower(prefix); // 与分词时的小写转换一致，UTF-8的多字节字符原样保留
+
+    std::vector<std::pair<std::string, boost::uint32_t>> completions;
+    boost::atomic_load(&suggester_)->complete(prefix, max_results, completions);
+    for (const auto& completion : completions) {
+        suggestions.push_back(Suggestion(query.substr(0, start) + completion.first, completion.second));
+    }
+    return suggestions;
+}
+
+/**
+ * @brief 根据文档ID获取文档的标题和内容
+ * @param doc_id 文档ID
+ * @return 一个包含标题和内容的pair，如果未找到则两者都为空
  */
 std::pair<std::string, std::string> SearchEngine::get_document(const std::string& doc_id) {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
-    auto it = documents_.find(doc_id);
-    if (it != documents_.end()) {
-        return it->second; // 返回 (title, content)
+    SnapshotPtr snapshot = current_snapshot();
+    DocId doc = 0;
+    size_t segment = snapshot->find_document(doc_id, doc);
+    if (segment < snapshot->segments.size()) {
+        boost::shared_ptr<const StoredDocument> document = snapshot->segments[segment].segment->document(doc);
+        return std::make_pair(document->title, document->content); // 返回 (title, content)
     }
     return std::make_pair("", ""); // 文档不存在
 }
+
+/**
+ * @brief 获取查询结果缓存的统计信息
+ * @return 命中、未命中、淘汰次数与内存占用
+ */
+CacheStats SearchEngine::cache_stats() const {
+    return cache_.stats();
+}
+
+/**
+ * @brief 获取当前索引版本
+ * @return 每次添加文档、构建索引、合并段或切换排序模型后递增的版本号
+ */
+boost::uint64_t SearchEngine::epoch() const {
+    return current_snapshot()->epoch;
+}
+
+/**
+ * @brief 获取当前有效的文档数
+ * @return 按字符串ID去重后的文档数
+ */
+size_t SearchEngine::document_count() const {
+    return current_snapshot()->doc_count;
+}
+
+/**
+ * @brief 获取当前的段数
+ * @return 包括未封存缓冲段在内的段数
+ */
+size_t SearchEngine::segment_count() const {
+    return current_snapshot()->segments.size();
+}
+
+/**
+ * @brief 获取当前索引的规模与内存占用
+ * @return 当前快照的统计
+ *
+ * 各段的内存占用在封存时统计，这里只按段求和；词汇量取自后台线程按快照重建的补全索引
+ * （其词汇就是各段词项去重后的结果），最多落后SUGGEST_REFRESH_MS。
+ * 监控系统抓取指标时因此不需要在请求线程上遍历或排序词汇。
+ */
+IndexSizeStats SearchEngine::index_size() const {
+    IndexSizeStats size = measure_index(*current_snapshot());
+    size.vocabulary = boost::atomic_load(&suggester_)->size();
+    return size;
+}
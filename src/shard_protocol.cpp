@@ -0,0 +1,302 @@
+/**
+ * @file shard_protocol.cpp
+ * @brief 分片服务器与协调节点之间内部协议的实现文件
+ */
+
+#include "shard_protocol.h"
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+
+namespace {
+
+/**
+ * @brief 把字段解析为数值
+ * @param field 字段文本
+ * @return 解析得到的数值，格式不对时抛出std::runtime_error
+ */
+template <typename T>
+T parse_number(const std::string& field) {
+    try {
+        return boost::lexical_cast<T>(field);
+    }
+    catch (const boost::bad_lexical_cast&) {
+        throw std::runtime_error("Malformed number in shard response: " + field);
+    }
+}
+
+/**
+ * @brief 按17位有效数字输出分数，读回时与原值完全相同
+ */
+std::string format_score(double score) {
+    std::ostringstream oss;
+    oss << std::setprecision(17) << score;
+    return oss.str();
+}
+
+} // namespace
+
+/**
+ * @brief 转义单个字段
+ * @param field 原始字段
+ * @return 不含制表符与换行符的字段
+ */
+std::string ShardProtocol::escape_field(const std::string& field) {
+    std::string escaped;
+    escaped.reserve(field.size());
+    for (char c : field) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * @brief 把若干字段转义后连接为一行
+ * @param fields 字段列表
+ * @return 以制表符分隔、以换行符结尾的一行
+ */
+std::string ShardProtocol::join_record(const std::vector<std::string>& fields) {
+    std::string line;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) {
+            line += '\t';
+        }
+        line += escape_field(fields[i]);
+    }
+    line += '\n';
+    return line;
+}
+
+/**
+ * @brief 解析响应体
+ * @param body 响应体
+ * @return 各行反转义后的字段，空行被忽略
+ *
+ * 转义后的字段不含制表符与换行符，因此边扫描边反转义，遇到的制表符与换行符就是字段与记录的边界。
+ */
+std::vector<std::vector<std::string>> ShardProtocol::parse_records(const std::string& body) {
+    std::vector<std::vector<std::string>> records;
+    std::vector<std::string> record;
+    std::string field;
+    bool escaping = false;
+    for (size_t i = 0; i <= body.size(); ++i) {
+        char c = i < body.size() ? body[i] : '\n';
+        if (escaping) {
+            switch (c) {
+                case 't': field += '\t'; break;
+                case 'n': field += '\n'; break;
+                case 'r': field += '\r'; break;
+                default: field += c; break;
+            }
+            escaping = false;
+        } else if (c == '\\') {
+            escaping = true;
+        } else if (c == '\t') {
+            record.push_back(field);
+            field.clear();
+        } else if (c == '\n') {
+            if (!record.empty() || !field.empty()) {
+                record.push_back(field);
+                records.push_back(record);
+            }
+            record.clear();
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    return records;
+}
+
+/**
+ * @brief URL编码
+ * @param value 原始字符串
+ * @return 除字母、数字与 -_.~ 之外的字节都编码为%XX
+ */
+std::string ShardProtocol::url_encode(const std::string& value) {
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(value.size() * 3);
+    for (char c : value) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if ((byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') ||
+            byte == '-' || byte == '_' || byte == '.' || byte == '~') {
+            encoded += c;
+        } else {
+            encoded += '%';
+            encoded += HEX[byte >> 4];
+            encoded += HEX[byte & 0x0F];
+        }
+    }
+    return encoded;
+}
+
+/**
+ * @brief 编码全局统计
+ * @param statistics 统计
+ * @return 第一行为文档数与长度总和，之后每行一个词项的文档频率
+ */
+std::string ShardProtocol::encode_statistics(const TermStatistics& statistics) {
+    std::vector<std::string> header;
+    header.push_back(std::to_string(statistics.doc_count));
+    header.push_back(std::to_string(statistics.total_doc_len));
+    header.push_back(std::to_string(statistics.total_title_len));
+    std::string body = join_record(header);
+    for (const auto& pair : statistics.document_frequencies) {
+        std::vector<std::string> record;
+        record.push_back(pair.first);
+        record.push_back(std::to_string(pair.second));
+        body += join_record(record);
+    }
+    return body;
+}
+
+/**
+ * @brief 解码全局统计
+ * @param body 由encode_statistics编码的文本
+ * @return 统计
+ */
+TermStatistics ShardProtocol::decode_statistics(const std::string& body) {
+    std::vector<std::vector<std::string>> records = parse_records(body);
+    if (records.empty()) {
+        throw std::runtime_error("Missing collection statistics in shard response");
+    }
+    expect_fields(records[0], 3);
+    TermStatistics statistics;
+    statistics.doc_count = parse_number<size_t>(records[0][0]);
+    statistics.total_doc_len = parse_number<boost::uint64_t>(records[0][1]);
+    statistics.total_title_len = parse_number<boost::uint64_t>(records[0][2]);
+    for (size_t i = 1; i < records.size(); ++i) {
+        expect_fields(records[i], 2);
+        statistics.document_frequencies[records[i][0]] = parse_number<size_t>(records[i][1]);
+    }
+    return statistics;
+}
+
+/**
+ * @brief 编码求值结果
+ * @param hits 求值结果（url为文档ID）
+ * @return 每行为文档ID与分数
+ */
+std::string ShardProtocol::encode_hits(const std::vector<SearchResult>& hits) {
+    std::string body;
+    for (const SearchResult& hit : hits) {
+        std::vector<std::string> record;
+        record.push_back(hit.url);
+        record.push_back(format_score(hit.score));
+        body += join_record(record);
+    }
+    return body;
+}
+
+/**
+ * @brief 解码求值结果
+ * @param body 由encode_hits编码的文本
+ * @return 只有文档ID（url）与分数的结果，顺序与分片返回的相同
+ */
+std::vector<SearchResult> ShardProtocol::decode_hits(const std::string& body) {
+    std::vector<SearchResult> hits;
+    for (const std::vector<std::string>& record : parse_records(body)) {
+        expect_fields(record, 2);
+        hits.push_back(SearchResult(std::string(), std::string(), record[0], parse_number<double>(record[1])));
+    }
+    return hits;
+}
+
+/**
+ * @brief 编码取摘要结果
+ * @param results 搜索结果
+ * @return 每行为文档ID、标题、摘要与高亮区间
+ */
+std::string ShardProtocol::encode_results(const std::vector<SearchResult>& results) {
+    std::string body;
+    for (const SearchResult& result : results) {
+        std::string highlights;
+        for (size_t h = 0; h < result.highlights.size(); ++h) {
+            if (h > 0) {
+                highlights += ',';
+            }
+            highlights += std::to_string(result.highlights[h].offset) + ":" +
+                          std::to_string(result.highlights[h].length);
+        }
+        std::vector<std::string> record;
+        record.push_back(result.url);
+        record.push_back(result.title);
+        record.push_back(result.content);
+        record.push_back(highlights);
+        body += join_record(record);
+    }
+    return body;
+}
+
+/**
+ * @brief 解码取摘要结果
+ * @param body 由encode_results编码的文本
+ * @return 搜索结果，分数为0
+ */
+std::vector<SearchResult> ShardProtocol::decode_results(const std::string& body) {
+    std::vector<SearchResult> results;
+    for (const std::vector<std::string>& record : parse_records(body)) {
+        expect_fields(record, 4);
+        results.push_back(SearchResult(record[1], record[2], record[0], 0.0));
+        std::istringstream highlights(record[3]);
+        std::string range;
+        while (std::getline(highlights, range, ',')) {
+            size_t colon = range.find(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("Malformed highlight in shard response: " + range);
+            }
+            results.back().highlights.push_back(Highlight(parse_number<size_t>(range.substr(0, colon)),
+                                                          parse_number<size_t>(range.substr(colon + 1))));
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief 编码补全建议
+ * @param suggestions 补全建议
+ * @return 每行为补全文本与文档频率
+ */
+std::string ShardProtocol::encode_suggestions(const std::vector<Suggestion>& suggestions) {
+    std::string body;
+    for (const Suggestion& suggestion : suggestions) {
+        std::vector<std::string> record;
+        record.push_back(suggestion.text);
+        record.push_back(std::to_string(suggestion.frequency));
+        body += join_record(record);
+    }
+    return body;
+}
+
+/**
+ * @brief 解码补全建议
+ * @param body 由encode_suggestions编码的文本
+ * @return 补全建议
+ */
+std::vector<Suggestion> ShardProtocol::decode_suggestions(const std::string& body) {
+    std::vector<Suggestion> suggestions;
+    for (const std::vector<std::string>& record : parse_records(body)) {
+        expect_fields(record, 2);
+        suggestions.push_back(Suggestion(record[0], parse_number<boost::uint32_t>(record[1])));
+    }
+    return suggestions;
+}
+
+/**
+ * @brief 检查字段数
+ * @param record 一条记录
+ * @param count 至少需要的字段数
+ */
+void ShardProtocol::expect_fields(const std::vector<std::string>& record, size_t count) {
+    if (record.size() < count) {
+        throw std::runtime_error("Malformed record in shard response");
+    }
+}
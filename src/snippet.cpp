@@ -0,0 +1,304 @@
+/**
+ * @file snippet.cpp
+ * @brief 查询相关摘要生成器的实现文件
+ */
+
+#include "snippet.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+namespace {
+
+// 窗口内同一词项的重复命中带来的少量加分，使命中更密集的窗口在不同词项数相同时胜出
+const double REPEAT_BONUS = 0.01;
+
+// 每扫描这么多个词单元检查一次时间预算
+const size_t CLOCK_CHECK_INTERVAL = 256;
+
+// 中文字符在UTF-8中的字节数（与分词器一致，三字节起始字节之后固定取3个字节）
+const size_t CHINESE_CHAR_BYTES = 3;
+
+bool is_letter(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+/**
+ * @brief 把覆盖[span_begin, span_end)的片段扩展到约length字节，命中尽量居中
+ * @return 片段的字节范围，两端都落在UTF-8字符边界上
+ */
+std::pair<size_t, size_t> fragment_range(const std::string& content, size_t span_begin, size_t span_end,
+                                         size_t length) {
+    size_t begin = span_begin;
+    size_t end = span_end;
+    if (end - begin < length) {
+        size_t extra = length - (end - begin);
+        begin = span_begin > extra / 2 ? span_begin - extra / 2 : 0;
+        end = std::min(content.size(), begin + length);
+        begin = std::min(begin, end > length ? end - length : 0);
+    }
+    // 命中本身位于字符边界，向命中方向收缩不会越过它
+    while (begin < span_begin && is_continuation(content[begin])) {
+        begin++;
+    }
+    while (end > span_end && end < content.size() && is_continuation(content[end])) {
+        end--;
+    }
+    return std::make_pair(begin, end);
+}
+
+/**
+ * @brief 正文开头的摘要，用于没有任何命中的情况（例如只有标题匹配）
+ */
+Snippet leading_snippet(const std::string& content, size_t length) {
+    Snippet snippet;
+    if (content.length() <= length) {
+        snippet.text = content;
+        return snippet;
+    }
+    size_t cut_pos = length;
+    while (cut_pos > 0 && is_continuation(content[cut_pos])) {
+        cut_pos--;
+    }
+    snippet.text = content.substr(0, cut_pos) + "...";
+    return snippet;
+}
+
+} // namespace
+
+const size_t SnippetGenerator::SNIPPET_BYTES;
+const long SnippetGenerator::TIME_BUDGET_MICROS;
+
+/**
+ * @brief SnippetGenerator的构造函数
+ * @param weights 查询词项 -> 权重，排除子句中的词项不应包含在内
+ */
+SnippetGenerator::SnippetGenerator(const std::map<std::string, double>& weights) : max_chinese_chars_(0) {
+    for (const auto& pair : weights) {
+        terms_[pair.first] = weights_.size();
+        weights_.push_back(std::max(pair.second, 0.0));
+        if (!pair.first.empty() && (static_cast<unsigned char>(pair.first[0]) & 0xE0) == 0xE0) {
+            max_chinese_chars_ = std::max(max_chinese_chars_, pair.first.size() / CHINESE_CHAR_BYTES);
+        }
+    }
+}
+
+/**
+ * @brief 生成摘要
+ * @param content 文档正文
+ * @param expected_matches 查询词项在正文中出现的总次数（来自倒排记录的词频），0表示未知
+ * @return 摘要文本与高亮区间
+ */
+Snippet SnippetGenerator::generate(const std::string& content, size_t expected_matches) const {
+    std::vector<Match> matches;
+    find_matches(content, expected_matches, matches);
+    if (matches.empty()) {
+        return leading_snippet(content, SNIPPET_BYTES);
+    }
+
+    // 1. 先尝试用一个完整长度的窗口覆盖所有命中的词项
+    std::vector<bool> covered(weights_.size(), false);
+    std::vector<bool> matched(weights_.size(), false);
+    for (const Match& match : matches) {
+        matched[match.term] = true;
+    }
+    Window window = best_window(matches, SNIPPET_BYTES, covered);
+    for (size_t i = window.first; i <= window.last; ++i) {
+        covered[matches[i].term] = true;
+    }
+
+    std::vector<std::pair<size_t, size_t>> fragments;
+    if (covered == matched) {
+        size_t span_end = 0;
+        for (size_t i = window.first; i <= window.last; ++i) {
+            span_end = std::max(span_end, matches[i].end);
+        }
+        fragments.push_back(fragment_range(content, matches[window.first].begin, span_end, SNIPPET_BYTES));
+    } else {
+        // 2. 否则取两个半长片段，第二个片段只为第一个片段缺少的词项计分
+        size_t half = SNIPPET_BYTES / 2;
+        std::fill(covered.begin(), covered.end(), false);
+        window = best_window(matches, half, covered);
+        size_t span_end = 0;
+        for (size_t i = window.first; i <= window.last; ++i) {
+            covered[matches[i].term] = true;
+            span_end = std::max(span_end, matches[i].end);
+        }
+        fragments.push_back(fragment_range(content, matches[window.first].begin, span_end, half));
+
+        std::vector<Match> rest;
+        for (const Match& match : matches) {
+            if (match.end <= fragments[0].first || match.begin >= fragments[0].second) {
+                rest.push_back(match);
+            }
+        }
+        Window second = best_window(rest, half, covered);
+        if (!rest.empty() && second.score > 0.0) {
+            span_end = 0;
+            for (size_t i = second.first; i <= second.last; ++i) {
+                span_end = std::max(span_end, rest[i].end);
+            }
+            fragments.push_back(fragment_range(content, rest[second.first].begin, span_end, half));
+            std::sort(fragments.begin(), fragments.end());
+            if (fragments[1].first <= fragments[0].second) {
+                fragments[0].second = std::max(fragments[0].second, fragments[1].second);
+                fragments.pop_back();
+            }
+        }
+    }
+
+    // 3. 拼接片段，并把片段内的命中换算为摘要内的偏移，重叠的命中合并为一个高亮区间
+    Snippet snippet;
+    for (size_t f = 0; f < fragments.size(); ++f) {
+        if (f > 0 || fragments[f].first > 0) {
+            snippet.text += "...";
+        }
+        size_t base = snippet.text.size();
+        snippet.text.append(content, fragments[f].first, fragments[f].second - fragments[f].first);
+        for (const Match& match : matches) {
+            if (match.begin < fragments[f].first || match.end > fragments[f].second) {
+                continue;
+            }
+            size_t offset = base + match.begin - fragments[f].first;
+            size_t length = match.end - match.begin;
+            if (!snippet.highlights.empty()) {
+                Highlight& last = snippet.highlights.back();
+                if (offset <= last.offset + last.length) {
+                    last.length = std::max(last.length, offset + length - last.offset);
+                    continue;
+                }
+            }
+            snippet.highlights.push_back(Highlight(offset, length));
+        }
+    }
+    if (fragments.back().second < content.size()) {
+        snippet.text += "...";
+    }
+    return snippet;
+}
+
+/**
+ * @brief 按正文顺序查找查询词项的命中
+ * @param content 文档正文
+ * @param expected_matches 命中总数，找到这么多个后停止，0表示扫描到结尾
+ * @param matches 输出：按起始字节升序排列的命中
+ *
+ * 英文单词与数字按分词器的规则切分并转为小写；中文词项与分词器一样由连续的汉字组成，
+ * 命中区间从第一个汉字开始到最后一个汉字结束。
+ */
+void SnippetGenerator::find_matches(const std::string& content, size_t expected_matches,
+                                    std::vector<Match>& matches) const {
+    // 单调时钟，系统时间被调整时预算不受影响
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(TIME_BUDGET_MICROS);
+    size_t recent[4];           // 最近的汉字起始字节，最新的在最后
+    size_t recent_count = 0;
+    size_t units = 0;
+    std::string word;
+    std::string gram;
+
+    size_t i = 0;
+    while (i < content.size()) {
+        if (expected_matches > 0 && matches.size() >= expected_matches) {
+            break;
+        }
+        if (++units % CLOCK_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() > deadline) {
+            break;
+        }
+
+        unsigned char c = static_cast<unsigned char>(content[i]);
+        if (is_letter(c) || is_digit(c)) {
+            // [a-zA-Z]+\d* 或 \d+
+            size_t start = i;
+            if (is_letter(c)) {
+                while (i < content.size() && is_letter(content[i])) {
+                    i++;
+                }
+            }
+            while (i < content.size() && is_digit(content[i])) {
+                i++;
+            }
+            if (i - start < 2) {
+                continue;
+            }
+            word.assign(content, start, i - start);
+            std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+            auto it = terms_.find(word);
+            if (it != terms_.end()) {
+                matches.push_back(Match(start, i, it->second));
+            }
+        } else if ((c & 0xE0) == 0xE0 && i + 2 < content.size()) {
+            if (recent_count == 4) {
+                std::copy(recent + 1, recent + 4, recent);
+                recent_count--;
+            }
+            recent[recent_count++] = i;
+            i += CHINESE_CHAR_BYTES;
+
+            // 以当前汉字结尾的1~max_chinese_chars_字组合
+            size_t longest = std::min(recent_count, max_chinese_chars_);
+            for (size_t n = 1; n <= longest; ++n) {
+                gram.clear();
+                for (size_t k = recent_count - n; k < recent_count; ++k) {
+                    gram.append(content, recent[k], CHINESE_CHAR_BYTES);
+                }
+                auto it = terms_.find(gram);
+                if (it != terms_.end()) {
+                    matches.push_back(Match(recent[recent_count - n], i, it->second));
+                }
+            }
+        } else {
+            i++;
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.begin != b.begin ? a.begin < b.begin : a.end < b.end;
+    });
+}
+
+/**
+ * @brief 选出得分最高的窗口
+ * @param matches 按起始字节升序排列的命中，不能为空
+ * @param length 窗口的最大字节数，单个命中超过该长度时窗口只包含它自己
+ * @param covered 已被其他片段覆盖、不再计分的词项
+ * @return 得分最高且最靠前的窗口
+ *
+ * 以每个命中为窗口起点，双指针维护窗口内各词项的命中次数：
+ * 每个未覆盖的不同词项得1加其权重，重复命中得REPEAT_BONUS。
+ */
+SnippetGenerator::Window SnippetGenerator::best_window(const std::vector<Match>& matches, size_t length,
+                                                       const std::vector<bool>& covered) const {
+    Window best;
+    std::vector<size_t> counts(weights_.size(), 0);
+    double score = 0.0;
+    size_t right = 0;
+    for (size_t left = 0; left < matches.size(); ++left) {
+        while (right < matches.size() &&
+               (right == left || matches[right].end <= matches[left].begin + length)) {
+            size_t term = matches[right].term;
+            if (!covered[term]) {
+                score += counts[term]++ == 0 ? 1.0 + weights_[term] : REPEAT_BONUS;
+            }
+            right++;
+        }
+        if (left == 0 || score > best.score + 1e-9) {
+            best.first = left;
+            best.last = right - 1;
+            best.score = score;
+        }
+        size_t term = matches[left].term;
+        if (!covered[term]) {
+            score -= --counts[term] == 0 ? 1.0 + weights_[term] : REPEAT_BONUS;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file suggester.cpp
+ * @brief 输入补全索引的实现文件
+ */
+
+#include "suggester.h"
+#include <algorithm>
+
+const size_t Suggester::TOP_K;
+
+/**
+ * @brief Suggester的构造函数，创建空索引
+ */
+Suggester::Suggester() : nodes_(1), epoch_(0) {
+}
+
+/**
+ * @brief 构建补全索引
+ * @param terms 严格升序、不重复的(词项, 权重)
+ * @param epoch 所依据的索引版本
+ *
+ * 先按层展开节点：每个节点对应排序后词项中的一段连续区间，区间内的词项共享该节点的前缀，
+ * 按下一个字节分组即得到子节点；区间不超过TOP_K的节点不再展开。
+ * 再从最后一个节点倒序计算各节点的前TOP_K，子节点总在父节点之后，因此先于父节点完成。
+ */
+Suggester::Suggester(const std::vector<std::pair<std::string, boost::uint32_t>>& terms, boost::uint64_t epoch)
+    : nodes_(1), epoch_(epoch) {
+    std::vector<std::string> words;
+    words.reserve(terms.size());
+    weights_.reserve(terms.size());
+    for (const auto& pair : terms) {
+        words.push_back(pair.first);
+        weights_.push_back(pair.second);
+    }
+    dictionary_ = TermDictionary(words);
+
+    // 1. 按层展开：ranges[n]为节点n对应的词项区间，depths[n]为其前缀长度
+    std::vector<std::pair<TermId, TermId>> ranges(1, std::make_pair(0, static_cast<TermId>(words.size())));
+    std::vector<size_t> depths(1, 0);
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+        TermId lo = ranges[n].first;
+        TermId hi = ranges[n].second;
+        size_t depth = depths[n];
+        if (hi - lo <= TOP_K) {
+            continue;
+        }
+        // 与前缀完全相同的词项若存在，必定排在区间最前面
+        TermId i = words[lo].size() == depth ? lo + 1 : lo;
+        size_t first_child = nodes_.size();
+        while (i < hi) {
+            unsigned char label = static_cast<unsigned char>(words[i][depth]);
+            TermId j = i + 1;
+            while (j < hi && static_cast<unsigned char>(words[j][depth]) == label) {
+                j++;
+            }
+            Node child;
+            child.label = label;
+            nodes_.push_back(child);
+            ranges.push_back(std::make_pair(i, j));
+            depths.push_back(depth + 1);
+            i = j;
+        }
+        nodes_[n].first_child = static_cast<boost::uint32_t>(first_child);
+        nodes_[n].child_count = static_cast<boost::uint16_t>(nodes_.size() - first_child);
+    }
+
+    // 2. 倒序计算已展开节点的前TOP_K：候选为与前缀相同的词项、已展开子节点的前TOP_K与未展开子节点的全部词项
+    std::vector<std::vector<TermId>> tops(nodes_.size());
+    std::vector<TermId> candidates;
+    for (size_t n = nodes_.size(); n-- > 0;) {
+        if (nodes_[n].child_count == 0) {
+            continue;
+        }
+        candidates.clear();
+        if (words[ranges[n].first].size() == depths[n]) {
+            candidates.push_back(ranges[n].first);
+        }
+        for (size_t c = nodes_[n].first_child; c < nodes_[n].first_child + nodes_[n].child_count; ++c) {
+            if (nodes_[c].child_count > 0) {
+                candidates.insert(candidates.end(), tops[c].begin(), tops[c].end());
+            } else {
+                for (TermId id = ranges[c].first; id < ranges[c].second; ++id) {
+                    candidates.push_back(id);
+                }
+            }
+        }
+        size_t count = std::min(candidates.size(), TOP_K);
+        std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                          [this](TermId a, TermId b) { return heavier(a, b); });
+        tops[n].assign(candidates.begin(), candidates.begin() + count);
+    }
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+        if (nodes_[n].child_count > 0) {
+            nodes_[n].top_offset = static_cast<boost::uint32_t>(top_.size());
+            nodes_[n].top_count = static_cast<boost::uint8_t>(tops[n].size());
+            top_.insert(top_.end(), tops[n].begin(), tops[n].end());
+        }
+    }
+    nodes_.shrink_to_fit();
+    top_.shrink_to_fit();
+}
+
+/**
+ * @brief 列出前缀的补全
+ * @param prefix 前缀（与索引词项一样应为小写）
+ * @param limit 最多输出的条数，超过TOP_K时按TOP_K处理
+ * @param out 输出：追加(词项, 权重)，按权重降序
+ */
+void Suggester::complete(const std::string& prefix, size_t limit,
+                         std::vector<std::pair<std::string, boost::uint32_t>>& out) const {
+    limit = std::min(limit, TOP_K);
+    if (limit == 0 || dictionary_.size() == 0) {
+        return;
+    }
+
+    // 沿前缀的字节走到对应节点，遇到未展开的节点时停下
+    size_t n = 0;
+    size_t depth = 0;
+    while (depth < prefix.size() && nodes_[n].child_count > 0) {
+        const Node* first = &nodes_[nodes_[n].first_child];
+        const Node* last = first + nodes_[n].child_count;
+        unsigned char label = static_cast<unsigned char>(prefix[depth]);
+        const Node* child = std::lower_bound(first, last, label,
+                                             [](const Node& node, unsigned char value) { return node.label < value; });
+        if (child == last || child->label != label) {
+            return;
+        }
+        n = child - &nodes_[0];
+        depth++;
+    }
+
+    if (nodes_[n].child_count > 0) {
+        size_t count = std::min<size_t>(limit, nodes_[n].top_count);
+        for (size_t i = 0; i < count; ++i) {
+            TermId id = top_[nodes_[n].top_offset + i];
+            out.push_back(std::make_pair(dictionary_.term(id), weights_[id]));
+        }
+        return;
+    }
+
+    // 未展开的节点下至多TOP_K个词项，直接用词典的前缀扫描列出后排序
+    std::vector<std::pair<TermId, std::string>> found;
+    for (TermDictionary::Iterator it = dictionary_.prefix_iterator(prefix); !it.at_end(); it.next()) {
+        found.push_back(std::make_pair(it.id(), it.term()));
+    }
+    std::sort(found.begin(), found.end(),
+              [this](const std::pair<TermId, std::string>& a, const std::pair<TermId, std::string>& b) {
+                  return heavier(a.first, b.first);
+              });
+    for (size_t i = 0; i < found.size() && i < limit; ++i) {
+        out.push_back(std::make_pair(found[i].second, weights_[found[i].first]));
+    }
+}
+
+/**
+ * @brief 统计内存占用
+ * @return 字节数
+ */
+size_t Suggester::memory_usage() const {
+    return sizeof(Suggester) + dictionary_.memory_usage() + weights_.capacity() * sizeof(boost::uint32_t) +
+           nodes_.capacity() * sizeof(Node) + top_.capacity() * sizeof(TermId);
+}
+
+/**
+ * @brief 比较两个词项的排序先后
+ * @return a的权重更高，或权重相同而a的字节序更小时返回true
+ */
+bool Suggester::heavier(TermId a, TermId b) const {
+    return weights_[a] != weights_[b] ? weights_[a] > weights_[b] : a < b;
+}
@@ -0,0 +1,360 @@
+/**
+ * @file term_dictionary.cpp
+ * @brief 前缀压缩词典的实现文件
+ *
+ * 块内编码：
+ *   第一个词项：长度（变长字节） + 全部字节
+ *   其余词项：与前一个词项的公共前缀长度 + 后缀长度（均为变长字节） + 后缀字节
+ * 变长字节编码每字节存7位，低位在前，最高位为1表示后面还有字节。
+ */
+
+#include "term_dictionary.h"
+#include "index_file.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief 追加一个变长字节编码的整数
+ */
+void write_varbyte(std::vector<boost::uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<boost::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<boost::uint8_t>(value));
+}
+
+/**
+ * @brief 读取一个变长字节编码的整数（数据已校验）
+ */
+size_t read_varbyte(const boost::uint8_t*& in) {
+    size_t value = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        value |= static_cast<size_t>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<size_t>(*in++) << shift;
+    return value;
+}
+
+/**
+ * @brief 读取一个变长字节编码的整数，越界或超过32位时返回false
+ */
+bool read_varbyte_checked(const boost::uint8_t*& in, const boost::uint8_t* end, size_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (in >= end) {
+            return false;
+        }
+        boost::uint8_t byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value <= 0xFFFFFFFFu;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 解码pos处的一个词项，first表示它是块内第一个词项；term中是前一个词项
+ */
+void decode_term(const boost::uint8_t*& pos, bool first, std::string& term) {
+    size_t shared = first ? 0 : read_varbyte(pos);
+    size_t length = read_varbyte(pos);
+    term.resize(shared);
+    term.append(reinterpret_cast<const char*>(pos), length);
+    pos += length;
+}
+
+/**
+ * @brief 按字节序比较[data, data + length)与key，与std::string的比较一致
+ */
+int compare_term(const boost::uint8_t* data, size_t length, const std::string& key) {
+    int result = std::memcmp(data, key.data(), std::min(length, key.size()));
+    if (result != 0) {
+        return result;
+    }
+    return length < key.size() ? -1 : (length > key.size() ? 1 : 0);
+}
+
+} // namespace
+
+const size_t TermDictionary::BLOCK_TERMS;
+const TermId TermDictionary::NOT_FOUND;
+
+/**
+ * @brief 创建迭代器并定位到编号为id的词项
+ * @param dictionary 词典
+ * @param id 起始编号，不小于词项数时迭代器直接结束
+ * @param prefix 只遍历以prefix开头的词项，为空表示不限
+ */
+TermDictionary::Iterator::Iterator(const TermDictionary* dictionary, TermId id, const std::string& prefix)
+    : dictionary_(dictionary), id_(id), pos_(nullptr), prefix_(prefix), at_end_(false) {
+    if (id_ >= dictionary_->size()) {
+        at_end_ = true;
+        return;
+    }
+    // 块内的词项依赖前一个词项，从块首解码到目标位置
+    TermId target = id_;
+    id_ -= id_ % BLOCK_TERMS;
+    pos_ = dictionary_->data_ + dictionary_->blocks_[id_ / BLOCK_TERMS];
+    while (id_ < target) {
+        decode_term(pos_, id_ % BLOCK_TERMS == 0, term_);
+        id_++;
+    }
+    load();
+}
+
+/**
+ * @brief 移动到下一个词项
+ */
+void TermDictionary::Iterator::next() {
+    if (at_end_) {
+        return;
+    }
+    if (++id_ >= dictionary_->size()) {
+        at_end_ = true;
+        return;
+    }
+    load();
+}
+
+/**
+ * @brief 解码当前词项，离开前缀范围时结束遍历
+ */
+void TermDictionary::Iterator::load() {
+    decode_term(pos_, id_ % BLOCK_TERMS == 0, term_);
+    if (term_.compare(0, prefix_.size(), prefix_) != 0) {
+        at_end_ = true;
+    }
+}
+
+/**
+ * @brief TermDictionary的构造函数，创建空词典
+ */
+TermDictionary::TermDictionary()
+    : term_count_(0), data_(nullptr), data_size_(0), blocks_(nullptr), block_count_(0) {
+}
+
+/**
+ * @brief 由排好序的词项构建词典
+ * @param sorted_terms 严格升序、不重复的词项
+ */
+TermDictionary::TermDictionary(const std::vector<std::string>& sorted_terms)
+    : term_count_(sorted_terms.size()), data_(nullptr), data_size_(0), blocks_(nullptr), block_count_(0) {
+    boost::shared_ptr<std::vector<boost::uint8_t>> data(new std::vector<boost::uint8_t>());
+    boost::shared_ptr<std::vector<boost::uint32_t>> blocks(new std::vector<boost::uint32_t>());
+    for (size_t i = 0; i < sorted_terms.size(); ++i) {
+        const std::string& term = sorted_terms[i];
+        size_t shared = 0;
+        if (i % BLOCK_TERMS == 0) {
+            blocks->push_back(static_cast<boost::uint32_t>(data->size()));
+        } else {
+            const std::string& previous = sorted_terms[i - 1];
+            size_t limit = std::min(previous.size(), term.size());
+            while (shared < limit && previous[shared] == term[shared]) {
+                shared++;
+            }
+            write_varbyte(*data, shared);
+        }
+        write_varbyte(*data, term.size() - shared);
+        data->insert(data->end(), term.begin() + shared, term.end());
+    }
+    data->shrink_to_fit();
+
+    data_ = data->empty() ? nullptr : &(*data)[0];
+    data_size_ = data->size();
+    blocks_ = blocks->empty() ? nullptr : &(*blocks)[0];
+    block_count_ = blocks->size();
+    owned_data_ = data;
+    owned_blocks_ = blocks;
+}
+
+/**
+ * @brief 精确查找词项
+ * @param term 词项
+ * @return 词项编号，不存在时返回NOT_FOUND
+ */
+TermId TermDictionary::find(const std::string& term) const {
+    if (term_count_ == 0) {
+        return NOT_FOUND;
+    }
+    size_t block = find_block(term);
+    const boost::uint8_t* pos = data_ + blocks_[block];
+    std::string current;
+    TermId end = static_cast<TermId>(std::min(term_count_, (block + 1) * BLOCK_TERMS));
+    for (TermId id = static_cast<TermId>(block * BLOCK_TERMS); id < end; ++id) {
+        decode_term(pos, id % BLOCK_TERMS == 0, current);
+        int result = current.compare(term);
+        if (result == 0) {
+            return id;
+        }
+        if (result > 0) {
+            break;
+        }
+    }
+    return NOT_FOUND;
+}
+
+/**
+ * @brief 取得编号为id的词项
+ * @param id 词项编号，必须小于size()
+ */
+std::string TermDictionary::term(TermId id) const {
+    return Iterator(this, id, std::string()).term();
+}
+
+/**
+ * @brief 遍历以prefix开头的词项
+ * @param prefix 前缀，为空时遍历全部词项
+ * @return 按字节序遍历的迭代器
+ */
+TermDictionary::Iterator TermDictionary::prefix_iterator(const std::string& prefix) const {
+    return Iterator(this, lower_bound(prefix), prefix);
+}
+
+/**
+ * @brief 从第一个不小于key的词项开始遍历
+ * @param key 起始键
+ * @return 按字节序遍历的迭代器，所有词项都小于key时直接结束
+ */
+TermDictionary::Iterator TermDictionary::seek(const std::string& key) const {
+    return Iterator(this, lower_bound(key), std::string());
+}
+
+/**
+ * @brief 查找第一个不小于key的词项
+ * @param key 查找的键
+ * @return 词项编号，所有词项都小于key时返回size()
+ */
+TermId TermDictionary::lower_bound(const std::string& key) const {
+    if (term_count_ == 0) {
+        return 0;
+    }
+    size_t block = find_block(key);
+    const boost::uint8_t* pos = data_ + blocks_[block];
+    std::string current;
+    TermId end = static_cast<TermId>(std::min(term_count_, (block + 1) * BLOCK_TERMS));
+    for (TermId id = static_cast<TermId>(block * BLOCK_TERMS); id < end; ++id) {
+        decode_term(pos, id % BLOCK_TERMS == 0, current);
+        if (current.compare(key) >= 0) {
+            return id;
+        }
+    }
+    return end;
+}
+
+/**
+ * @brief 统计内存占用
+ * @return 字节数
+ */
+size_t TermDictionary::memory_usage() const {
+    return sizeof(TermDictionary) + data_size_ + block_count_ * sizeof(boost::uint32_t);
+}
+
+/**
+ * @brief 写入索引文件
+ * @param writer 索引文件写入器
+ *
+ * 依次写入词项数、块数、压缩数据字节数、块偏移数组与压缩数据。
+ */
+void TermDictionary::write(IndexFileWriter& writer) const {
+    writer.write_u32(static_cast<boost::uint32_t>(term_count_));
+    writer.write_u32(static_cast<boost::uint32_t>(block_count_));
+    writer.write_u32(static_cast<boost::uint32_t>(data_size_));
+    writer.align(sizeof(boost::uint32_t));
+    writer.write(blocks_, block_count_ * sizeof(boost::uint32_t));
+    writer.write(data_, data_size_);
+    writer.align(sizeof(boost::uint32_t));
+}
+
+/**
+ * @brief 从映射的索引文件读取
+ * @param reader 位于词典起始处的读取游标
+ *
+ * 块偏移与压缩数据不做复制。读取时完整解码一遍，确认编码不越界、
+ * 块偏移与实际位置一致且词项严格升序，之后的查找无需再做边界检查。
+ */
+void TermDictionary::read(IndexFileReader& reader) {
+    size_t term_count = reader.read_u32();
+    size_t block_count = reader.read_u32();
+    size_t data_size = reader.read_u32();
+    reader.align(sizeof(boost::uint32_t));
+    const boost::uint32_t* blocks =
+        reinterpret_cast<const boost::uint32_t*>(reader.read(block_count * sizeof(boost::uint32_t)));
+    const boost::uint8_t* data = reader.read(data_size);
+    reader.align(sizeof(boost::uint32_t));
+
+    if (block_count != (term_count + BLOCK_TERMS - 1) / BLOCK_TERMS) {
+        throw std::runtime_error("Term dictionary is corrupted (bad block count)");
+    }
+    const boost::uint8_t* pos = data;
+    const boost::uint8_t* end = data + data_size;
+    std::string previous;
+    std::string current;
+    for (size_t id = 0; id < term_count; ++id) {
+        bool first = id % BLOCK_TERMS == 0;
+        size_t shared = 0;
+        size_t length = 0;
+        if ((first && blocks[id / BLOCK_TERMS] != static_cast<size_t>(pos - data)) ||
+            (!first && (!read_varbyte_checked(pos, end, shared) || shared > previous.size())) ||
+            !read_varbyte_checked(pos, end, length) || length > static_cast<size_t>(end - pos)) {
+            throw std::runtime_error("Term dictionary is corrupted (bad encoding)");
+        }
+        current.assign(previous, 0, shared);
+        current.append(reinterpret_cast<const char*>(pos), length);
+        pos += length;
+        if (id > 0 && current.compare(previous) <= 0) {
+            throw std::runtime_error("Term dictionary is corrupted (terms out of order)");
+        }
+        previous.swap(current);
+    }
+    if (pos != end) {
+        throw std::runtime_error("Term dictionary is corrupted (trailing data)");
+    }
+
+    term_count_ = term_count;
+    data_ = data;
+    data_size_ = data_size;
+    blocks_ = blocks;
+    block_count_ = block_count;
+    owned_data_.reset();
+    owned_blocks_.reset();
+}
+
+/**
+ * @brief 取得块内第一个词项
+ * @param block 块序号
+ * @param length 输出：词项长度
+ * @return 词项的起始地址
+ */
+const boost::uint8_t* TermDictionary::block_term(size_t block, size_t& length) const {
+    const boost::uint8_t* pos = data_ + blocks_[block];
+    length = read_varbyte(pos);
+    return pos;
+}
+
+/**
+ * @brief 在块首词项上二分查找
+ * @param key 查找的键
+ * @return 最后一个首词项不大于key的块，key小于第一个词项时返回0
+ */
+size_t TermDictionary::find_block(const std::string& key) const {
+    size_t low = 0;
+    size_t high = block_count_;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        size_t length = 0;
+        const boost::uint8_t* term = block_term(mid, length);
+        if (compare_term(term, length, key) <= 0) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
@@ -103,6 +103,59 @@ std::vector<std::string> TextProcessor::tokenize(const std::string& text) {
     return tokens;
 }
 
+std::vector<PositionedToken> TextProcessor::tokenize_with_positions(const std::string& text) {
+    // 词单元：英文单词（含长度不足2、不产生词项的单词）与单个汉字，按字节偏移排列
+    std::vector<std::pair<size_t, std::string>> english_words;
+    boost::regex english_pattern("[a-zA-Z]+\\d*|\\d+");
+    boost::sregex_iterator english_iter(text.begin(), text.end(), english_pattern);
+    boost::sregex_iterator end;
+    for (; english_iter != end; ++english_iter) {
+        english_words.push_back(std::make_pair(static_cast<size_t>(english_iter->position()), english_iter->str()));
+    }
+
+    // 与tokenize()相同的中文字符提取规则
+    std::vector<std::pair<size_t, std::string>> chinese_chars;
+    for (size_t i = 0; i < text.length(); ) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if ((c & 0xE0) == 0xE0 && i + 2 < text.length()) {
+            chinese_chars.push_back(std::make_pair(i, text.substr(i, 3)));
+            i += 3;
+        } else {
+            i++;
+        }
+    }
+
+    // 按字节偏移归并两类词单元，依次编号作为位置
+    std::vector<PositionedToken> tokens;
+    size_t e = 0;
+    size_t z = 0;
+    boost::uint32_t position = 0;
+    while (e < english_words.size() || z < chinese_chars.size()) {
+        if (z == chinese_chars.size() ||
+            (e < english_words.size() && english_words[e].first < chinese_chars[z].first)) {
+            if (english_words[e].second.length() >= 2) {
+                tokens.push_back(PositionedToken(to_lower(english_words[e].second), position));
+            }
+            e++;
+        } else {
+            // 以该汉字开头的1~4字组合都记在该汉字的位置上
+            std::string gram;
+            for (size_t n = 0; n < 4 && z + n < chinese_chars.size(); ++n) {
+                gram += chinese_chars[z + n].second;
+                tokens.push_back(PositionedToken(gram, position));
+            }
+            z++;
+        }
+        position++;
+    }
+
+    return tokens;
+}
+
+bool TextProcessor::is_stop_word(const std::string& token) const {
+    return stop_words_.find(token) != stop_words_.end();
+}
+
 std::vector<std::string> TextProcessor::remove_stop_words(const std::vector<std::string>& tokens) {
     std::vector<std::string> filtered_tokens;
 
@@ -0,0 +1,238 @@
+/**
+ * @file thread_pool.cpp
+ * @brief 工作窃取线程池的实现文件
+ *
+ * 入队计数由全局互斥锁保护，用于让空闲线程睡眠与唤醒；
+ * 任务本身存放在各线程的队列中，取任务只锁对应的队列，
+ * 各线程大多数时候只访问自己的队列，彼此很少竞争。
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <utility>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace {
+
+// 当前线程所属的线程池及其队列序号，不是工作线程时为空
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+/**
+ * @brief run_all提交的一组任务：参与者按序号领取任务，全部完成时唤醒调用线程
+ *
+ * 由调用线程与各工作线程共同持有，调用线程返回后仍在队列中的参与者领不到任务，直接结束。
+ */
+struct TaskBatch {
+    std::vector<ThreadPool::Task> tasks;
+    boost::atomic<size_t> next;
+    size_t finished;
+    std::exception_ptr error;
+    boost::mutex mutex;
+    boost::condition_variable done_cv;
+
+    explicit TaskBatch(const std::vector<ThreadPool::Task>& t) : tasks(t), next(0), finished(0) {}
+
+    // 领取并执行任务，直到没有剩余的任务
+    void work() {
+        for (size_t i = next++; i < tasks.size(); i = next++) {
+            std::exception_ptr failure;
+            try {
+                tasks[i]();
+            }
+            catch (...) {
+                failure = std::current_exception();
+            }
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if (failure && !error) {
+                error = failure;
+            }
+            if (++finished == tasks.size()) {
+                done_cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * @brief ThreadPool的构造函数，启动工作线程
+ * @param threads 工作线程数，0表示使用硬件线程数
+ */
+ThreadPool::ThreadPool(size_t threads)
+    : queued_(0), unfinished_(0), next_queue_(0), stopping_(false) {
+    if (threads == 0) {
+        threads = boost::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(boost::shared_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.create_thread(boost::bind(&ThreadPool::run, this, i));
+    }
+}
+
+/**
+ * @brief ThreadPool的析构函数，等待任务完成并结束工作线程
+ */
+ThreadPool::~ThreadPool() {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (unfinished_ > 0) {
+            idle_cv_.wait(lock);
+        }
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    threads_.join_all();
+}
+
+/**
+ * @brief 提交一个任务
+ * @param task 任务，在某个工作线程上执行
+ *
+ * 工作线程内提交的任务放入自己的队列（后进先出，缓存更友好），
+ * 池外提交的任务轮流放入各队列。
+ */
+void ThreadPool::submit(const Task& task) {
+    size_t index;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        index = current_pool == this ? current_queue : next_queue_++ % queues_.size();
+        unfinished_++;
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(task);
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        queued_++;
+    }
+    work_cv_.notify_one();
+}
+
+/**
+ * @brief 等待已提交的任务全部完成
+ *
+ * 有任务抛出异常时，在所有任务结束后重新抛出第一个异常。
+ * 不能在工作线程内调用。
+ */
+void ThreadPool::wait() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (unfinished_ > 0) {
+        idle_cv_.wait(lock);
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * @brief 并行执行一组任务
+ * @param tasks 任务列表
+ *
+ * 至多提交min(任务数 - 1, 线程数)个参与者，调用线程自己也领取任务，
+ * 工作线程都在忙时由调用线程独自完成，不会因排队而等待。
+ * 只等待这组任务，不受其他并发提交的任务影响，可以被多个线程同时调用；不能在工作线程内调用。
+ */
+void ThreadPool::run_all(const std::vector<Task>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    boost::shared_ptr<TaskBatch> batch = boost::make_shared<TaskBatch>(tasks);
+    size_t helpers = std::min(tasks.size() - 1, queues_.size());
+    for (size_t i = 0; i < helpers; ++i) {
+        submit([batch]() { batch->work(); });
+    }
+    batch->work();
+
+    boost::unique_lock<boost::mutex> lock(batch->mutex);
+    while (batch->finished < batch->tasks.size()) {
+        batch->done_cv.wait(lock);
+    }
+    if (batch->error) {
+        std::rethrow_exception(batch->error);
+    }
+}
+
+/**
+ * @brief 工作线程主循环
+ * @param index 线程自己的队列序号
+ *
+ * queued_大于0时保证某个队列中至少有一个尚未被取走的任务，
+ * 先扣减计数再去取，因此每次扣减都一定能取到任务。
+ */
+void ThreadPool::run(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    for (;;) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (queued_ == 0 && !stopping_) {
+                work_cv_.wait(lock);
+            }
+            if (queued_ == 0) {
+                return;
+            }
+            queued_--;
+        }
+
+        Task task;
+        while (!take(index, task)) {
+            boost::this_thread::yield();
+        }
+
+        try {
+            task();
+        }
+        catch (...) {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        if (--unfinished_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+}
+
+/**
+ * @brief 取一个任务
+ * @param index 线程自己的队列序号
+ * @param task 输出：取到的任务
+ * @return 取到任务时返回true
+ */
+bool ThreadPool::take(size_t index, Task& task) {
+    {
+        WorkQueue& own = *queues_[index];
+        boost::lock_guard<boost::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        WorkQueue& victim = *queues_[(index + i) % queues_.size()];
+        boost::lock_guard<boost::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
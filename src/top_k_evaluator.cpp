@@ -0,0 +1,153 @@
+/**
+ * @file top_k_evaluator.cpp
+ * @brief 前k名查询求值器的实现文件
+ *
+ * 实现Block-Max WAND算法：用词项级上界选出枢轴文档，
+ * 再用块级上界决定是打分、推进到枢轴，还是整体跳过当前块。
+ */
+
+#include "top_k_evaluator.h"
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+/**
+ * @brief 最小堆比较器：分数低的文档位于堆顶，分数相同时编号大的位于堆顶
+ *
+ * 分数相同的文档总是优先保留先添加的，结果与文档在索引中如何分段无关。
+ */
+struct ScoreGreater {
+    bool operator()(const ScoredDoc& a, const ScoredDoc& b) const {
+        return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+    }
+};
+
+} // namespace
+
+/**
+ * @brief TopKEvaluator的构造函数
+ * @param scorer 打分器，生命周期必须长于求值器
+ * @param k 需要返回的结果数
+ */
+TopKEvaluator::TopKEvaluator(const Scorer& scorer, size_t k)
+    : scorer_(scorer), k_(k) {
+}
+
+/**
+ * @brief 添加一个查询词
+ * @param postings 查询词的倒排列表，生命周期必须长于求值器
+ * @param weight 查询词权重
+ */
+void TopKEvaluator::add_term(const PostingList* postings, double weight) {
+    if (postings->empty() || weight <= 0.0) {
+        return; // 不可能贡献正分数的词项不参与求值
+    }
+    cursors_.push_back(TermCursor(postings, weight));
+    cursors_.back().max_score = scorer_.upper_bound(weight, postings->max_tf(), postings->min_len());
+}
+
+/**
+ * @brief 执行Block-Max WAND求值
+ * @param filter 文档有效性判断
+ * @return 按分数降序排列的前k个文档
+ */
+std::vector<ScoredDoc> TopKEvaluator::evaluate(const DocFilter& filter) {
+    std::priority_queue<ScoredDoc, std::vector<ScoredDoc>, ScoreGreater> heap;
+    if (k_ == 0) {
+        return std::vector<ScoredDoc>();
+    }
+
+    std::vector<TermCursor*> order;
+    for (size_t i = 0; i < cursors_.size(); ++i) {
+        order.push_back(&cursors_[i]);
+    }
+
+    double threshold = 0.0; // 堆未满时只要求分数为正
+    while (true) {
+        // 1. 按当前文档编号排序（查询词很少，插入排序足够）
+        for (size_t i = 1; i < order.size(); ++i) {
+            TermCursor* cursor = order[i];
+            size_t j = i;
+            while (j > 0 && order[j - 1]->it.doc() > cursor->it.doc()) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = cursor;
+        }
+
+        // 2. 累加词项上界，找到第一个可能超过门槛的枢轴
+        double upper_bound = 0.0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && !order[i]->it.at_end(); ++i) {
+            upper_bound += order[i]->max_score;
+            if (upper_bound > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break; // 剩余文档都不可能进入结果
+        }
+        DocId pivot_doc = order[pivot]->it.doc();
+        while (pivot + 1 < order.size() && order[pivot + 1]->it.doc() == pivot_doc) {
+            pivot++;
+        }
+
+        // 3. 用枢轴文档所在块的块级上界复核
+        double block_bound = 0.0;
+        DocId block_end = PostingList::END_DOC;
+        for (size_t i = 0; i <= pivot; ++i) {
+            boost::uint32_t max_tf = 0;
+            boost::uint32_t min_len = 0;
+            DocId last = order[i]->it.block_bounds(pivot_doc, max_tf, min_len);
+            block_bound += scorer_.upper_bound(order[i]->weight, max_tf, min_len);
+            block_end = std::min(block_end, last);
+        }
+
+        if (block_bound > threshold) {
+            if (order[0]->it.doc() == pivot_doc) {
+                // 所有指向枢轴的游标都在前面，完整打分
+                double score = 0.0;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    score += scorer_.score(order[i]->weight, order[i]->it.tf(), order[i]->it.title_tf(), pivot_doc);
+                }
+                if (score > threshold && filter(pivot_doc)) {
+                    heap.push(ScoredDoc(pivot_doc, score));
+                    if (heap.size() > k_) {
+                        heap.pop();
+                    }
+                    if (heap.size() == k_) {
+                        threshold = heap.top().score;
+                    }
+                }
+                for (size_t i = 0; i <= pivot; ++i) {
+                    order[i]->it.next();
+                }
+            } else {
+                // 枢轴之前的文档不可能超过门槛，直接推进到枢轴
+                for (size_t i = 0; i < pivot && order[i]->it.doc() < pivot_doc; ++i) {
+                    order[i]->it.advance(pivot_doc);
+                }
+            }
+        } else {
+            // 当前块组合内任何文档都无法超过门槛，跳到最早结束的块之后
+            DocId target = block_end == PostingList::END_DOC ? block_end : block_end + 1;
+            if (pivot + 1 < order.size()) {
+                target = std::min(target, order[pivot + 1]->it.doc());
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                order[i]->it.advance(target);
+            }
+        }
+    }
+
+    std::vector<ScoredDoc> results;
+    results.reserve(heap.size());
+    while (!heap.empty()) {
+        results.push_back(heap.top());
+        heap.pop();
+    }
+    std::reverse(results.begin(), results.end());
+    return results;
+}
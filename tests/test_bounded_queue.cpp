@@ -0,0 +1,195 @@
+/**
+ * @file test_bounded_queue.cpp
+ * @brief 有界队列与按序号重排队列的测试
+ *
+ * 队列满（或序号领先太多）时生产者阻塞，取走元素后继续；close()唤醒所有等待的线程，
+ * 被阻塞的生产者返回false，消费者取完剩余元素后返回false。OrderedQueue总是按序号顺序返回。
+ */
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "bounded_queue.h"
+
+namespace {
+
+// 判断线程仍在阻塞时等待的时长
+const std::chrono::milliseconds BLOCK_WAIT(50);
+
+/**
+ * @brief 检查异步操作仍在阻塞
+ */
+template <typename R>
+bool still_blocked(std::future<R>& result) {
+    return result.wait_for(BLOCK_WAIT) == std::future_status::timeout;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(bounded_queue)
+
+BOOST_AUTO_TEST_CASE(bounded_queue_is_fifo_and_moves_items) {
+    BoundedQueue<std::unique_ptr<int>> queue(3);
+    BOOST_CHECK_EQUAL(queue.capacity(), 3u);
+    BOOST_CHECK_EQUAL(BoundedQueue<int>(0).capacity(), 1u);
+
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK(queue.push(std::unique_ptr<int>(new int(i))));
+    }
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<int> value;
+        BOOST_REQUIRE(queue.pop(value));
+        BOOST_REQUIRE(value);
+        BOOST_CHECK_EQUAL(*value, i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_blocks_full_producer) {
+    BoundedQueue<int> queue(2);
+    BOOST_CHECK(queue.push(1));
+    BOOST_CHECK(queue.push(2));
+
+    // 队列满时第3个元素等到消费者取走一个元素后才放入
+    std::future<bool> pushed = std::async(std::launch::async, [&queue]() { return queue.push(3); });
+    BOOST_CHECK(still_blocked(pushed));
+    int value = 0;
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(pushed.get());
+
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 3);
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_close_wakes_waiters) {
+    // 被阻塞的生产者返回false，已放入的元素仍可取出
+    BoundedQueue<int> full(1);
+    BOOST_CHECK(full.push(1));
+    std::future<bool> pushed = std::async(std::launch::async, [&full]() { return full.push(2); });
+    BOOST_CHECK(still_blocked(pushed));
+    full.close();
+    BOOST_CHECK(!pushed.get());
+    BOOST_CHECK(!full.push(3));
+    int value = 0;
+    BOOST_REQUIRE(full.pop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(!full.pop(value));
+
+    // 等待中的消费者返回false
+    BoundedQueue<int> empty(4);
+    std::future<bool> popped = std::async(std::launch::async, [&empty]() {
+        int item = 0;
+        return empty.pop(item);
+    });
+    BOOST_CHECK(still_blocked(popped));
+    empty.close();
+    BOOST_CHECK(!popped.get());
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_passes_every_item_between_threads) {
+    const int count = 20000;
+    BoundedQueue<int> queue(8);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.push_back(std::thread([&queue, p]() {
+            for (int i = p; i < count; i += 4) {
+                queue.push(i);
+            }
+        }));
+    }
+    std::future<std::vector<int>> consumed = std::async(std::launch::async, [&queue]() {
+        std::vector<int> seen(count, 0);
+        int value = 0;
+        while (queue.pop(value)) {
+            seen[value]++;
+        }
+        return seen;
+    });
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    queue.close();
+    std::vector<int> seen = consumed.get();
+    for (int i = 0; i < count; ++i) {
+        BOOST_REQUIRE_EQUAL(seen[i], 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ordered_queue_returns_items_in_sequence) {
+    OrderedQueue<int> queue(4);
+    BOOST_CHECK(queue.push(2, 20));
+    BOOST_CHECK(queue.push(1, 10));
+    BOOST_CHECK(queue.push(3, 30));
+
+    // 序号0未到达时消费者等待，到达后依次取出
+    std::future<std::vector<int>> popped = std::async(std::launch::async, [&queue]() {
+        std::vector<int> values;
+        int value = 0;
+        for (int i = 0; i < 4 && queue.pop(value); ++i) {
+            values.push_back(value);
+        }
+        return values;
+    });
+    BOOST_CHECK(still_blocked(popped));
+    BOOST_CHECK(queue.push(0, 0));
+    std::vector<int> expected = {0, 10, 20, 30};
+    std::vector<int> values = popped.get();
+    BOOST_CHECK_EQUAL_COLLECTIONS(values.begin(), values.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ordered_queue_blocks_producers_too_far_ahead) {
+    OrderedQueue<int> queue(2);
+    BOOST_CHECK(queue.push(1, 1));
+
+    // 下一个待取序号为0，容量为2时序号2要等序号0被取走
+    std::future<bool> pushed = std::async(std::launch::async, [&queue]() { return queue.push(2, 2); });
+    BOOST_CHECK(still_blocked(pushed));
+    BOOST_CHECK(queue.push(0, 0));
+    BOOST_CHECK(still_blocked(pushed));
+    int value = -1;
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 0);
+    BOOST_CHECK(pushed.get());
+
+    // 关闭后，被阻塞的生产者返回false，消费者取到缺口之前的元素为止
+    std::future<bool> blocked = std::async(std::launch::async, [&queue]() { return queue.push(4, 4); });
+    BOOST_CHECK(still_blocked(blocked));
+    queue.close();
+    BOOST_CHECK(!blocked.get());
+    BOOST_CHECK(!queue.push(3, 3));
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_REQUIRE(queue.pop(value));
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_CHECK(!queue.pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(ordered_queue_reorders_concurrent_producers) {
+    const int count = 20000;
+    OrderedQueue<int> queue(16);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.push_back(std::thread([&queue, p]() {
+            for (int i = p; i < count; i += 4) {
+                queue.push(i, i * 3);
+            }
+        }));
+    }
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        BOOST_REQUIRE(queue.pop(value));
+        BOOST_REQUIRE_EQUAL(value, i * 3);
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    queue.close();
+    BOOST_CHECK(!queue.pop(value));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
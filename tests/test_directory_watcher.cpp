@@ -0,0 +1,220 @@
+/**
+ * @file test_directory_watcher.cpp
+ * @brief 数据目录监视器的测试
+ *
+ * 一批变化在静默期结束后只提交一次：同一文件的多次写入、先建后删与改名都按最终状态处理，
+ * 每个新事件都会重新开始静默期；持续不断的事件流最多推迟MAX_WAIT_FACTOR个静默期也会提交。
+ * 只在Linux上运行，其他平台不支持监视。
+ */
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "directory_watcher.h"
+#include "search_engine.h"
+#include "test_util.h"
+
+#ifdef __linux__
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// 提交前的静默期
+const long DEBOUNCE_MS = 200;
+
+// 等待提交的最长时间，只在出错时才会等满
+const std::chrono::milliseconds COMMIT_TIMEOUT(10000);
+
+/**
+ * @brief 不带缓存的单分片索引选项
+ */
+IndexOptions options() {
+    IndexOptions result;
+    result.cache_bytes = 0;
+    result.shards = 1;
+    return result;
+}
+
+/**
+ * @brief 写入（覆盖）文件
+ */
+void write_file(const std::string& path, const std::string& content) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+/**
+ * @brief 等待索引版本超过epoch，返回观察到新版本的时刻；超时时返回Clock::time_point()
+ */
+Clock::time_point wait_for_commit(SearchEngine& engine, boost::uint64_t epoch) {
+    Clock::time_point deadline = Clock::now() + COMMIT_TIMEOUT;
+    while (Clock::now() < deadline) {
+        if (engine.epoch() > epoch) {
+            return Clock::now();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return Clock::time_point();
+}
+
+/**
+ * @brief 等待几个静默期，之后不应再有新的提交
+ */
+void settle() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * DEBOUNCE_MS));
+}
+
+/**
+ * 监视临时目录并向一个空索引提交的测试环境
+ */
+class WatchedDirectory
+{
+public:
+    explicit WatchedDirectory(long debounce_ms = DEBOUNCE_MS) : engine_(options()), debounce_ms_(debounce_ms) {}
+
+    // 建立监视并启动；之前已存在的文件先编入索引，作为监视器的基准
+    void start() {
+        watcher_.reset(new DirectoryWatcher(directory_.path().string(), 0, 1, debounce_ms_));
+        BOOST_REQUIRE(watcher_->valid());
+        std::vector<Document> existing = indexer_.scan_directory(directory_.path().string());
+        if (!existing.empty()) {
+            engine_.add_documents(existing);
+        }
+        watcher_->start(engine_);
+    }
+
+    std::string file(const std::string& name) const { return directory_.file(name); }
+
+    SearchEngine& engine() { return engine_; }
+
+    // 文件对应文档的正文，文档不存在时为空
+    std::string content(const std::string& name) {
+        return engine_.get_document(indexer_.generate_doc_id(file(name))).second;
+    }
+
+private:
+    TempDirectory directory_;
+    Indexer indexer_;
+    SearchEngine engine_;
+    long debounce_ms_;
+    boost::shared_ptr<DirectoryWatcher> watcher_;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(directory_watcher)
+
+BOOST_AUTO_TEST_CASE(burst_of_changes_is_committed_once) {
+    WatchedDirectory watched;
+    watched.start();
+    boost::uint64_t epoch = watched.engine().epoch();
+
+    // 一次批量复制：多个文件、同一文件的多次写入、先建后删的临时文件与新建的子目录
+    for (int i = 0; i < 40; ++i) {
+        write_file(watched.file("file" + std::to_string(i) + ".txt"), "alpha " + std::to_string(i));
+    }
+    for (int i = 0; i < 3; ++i) {
+        write_file(watched.file("file0.txt"), "rewritten " + std::to_string(i));
+    }
+    write_file(watched.file("temporary.txt"), "short lived");
+    boost::filesystem::remove(watched.file("temporary.txt"));
+    boost::filesystem::create_directory(watched.file("sub"));
+    write_file(watched.file("sub/nested.txt"), "nested file");
+    Clock::time_point last_write = Clock::now();
+
+    // 静默期结束后才提交
+    Clock::time_point committed = wait_for_commit(watched.engine(), epoch);
+    BOOST_REQUIRE(committed != Clock::time_point());
+    BOOST_CHECK(committed - last_write >= std::chrono::milliseconds(DEBOUNCE_MS));
+
+    settle();
+    BOOST_CHECK_EQUAL(watched.engine().epoch(), epoch + 1);
+    BOOST_CHECK_EQUAL(watched.engine().document_count(), 41u);
+    BOOST_CHECK_EQUAL(watched.content("file0.txt"), "rewritten 2");
+    BOOST_CHECK_EQUAL(watched.content("file39.txt"), "alpha 39");
+    BOOST_CHECK_EQUAL(watched.content("sub/nested.txt"), "nested file");
+    BOOST_CHECK(watched.content("temporary.txt").empty());
+}
+
+BOOST_AUTO_TEST_CASE(each_event_restarts_the_quiet_period) {
+    WatchedDirectory watched;
+    watched.start();
+    boost::uint64_t epoch = watched.engine().epoch();
+
+    // 每次写入间隔不到静默期，最后一次写入之后才提交，且只提交最终内容
+    Clock::time_point last_write;
+    for (int i = 0; i < 5; ++i) {
+        write_file(watched.file("draft.txt"), "draft " + std::to_string(i));
+        last_write = Clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DEBOUNCE_MS / 4));
+    }
+    Clock::time_point committed = wait_for_commit(watched.engine(), epoch);
+    BOOST_REQUIRE(committed != Clock::time_point());
+    BOOST_CHECK(committed - last_write >= std::chrono::milliseconds(DEBOUNCE_MS));
+
+    settle();
+    BOOST_CHECK_EQUAL(watched.engine().epoch(), epoch + 1);
+    BOOST_CHECK_EQUAL(watched.content("draft.txt"), "draft 4");
+}
+
+BOOST_AUTO_TEST_CASE(continuous_events_commit_after_max_wait) {
+    const long debounce_ms = 50;
+    const std::chrono::milliseconds max_wait(debounce_ms * DirectoryWatcher::MAX_WAIT_FACTOR);
+    WatchedDirectory watched(debounce_ms);
+    watched.start();
+    boost::uint64_t epoch = watched.engine().epoch();
+
+    // 写入间隔远小于静默期，事件流不断；最长推迟时间到了仍然提交
+    Clock::time_point start = Clock::now();
+    Clock::time_point first_commit;
+    int written = 0;
+    while (Clock::now() - start < 3 * max_wait) {
+        write_file(watched.file("stream.txt"), "stream " + std::to_string(written++));
+        std::this_thread::sleep_for(std::chrono::milliseconds(debounce_ms / 5));
+        if (first_commit == Clock::time_point() && watched.engine().epoch() > epoch) {
+            first_commit = Clock::now();
+        }
+    }
+    BOOST_REQUIRE(first_commit != Clock::time_point());
+    BOOST_CHECK(first_commit - start < 2 * max_wait);
+
+    // 每次提交合并了大量写入；事件流停止后，最终内容在一个静默期之后提交
+    BOOST_CHECK_LT(watched.engine().epoch() - epoch, static_cast<boost::uint64_t>(written / 10));
+    settle();
+    BOOST_CHECK_EQUAL(watched.content("stream.txt"), "stream " + std::to_string(written - 1));
+}
+
+BOOST_AUTO_TEST_CASE(deletes_and_renames_follow_the_final_state) {
+    WatchedDirectory watched;
+    write_file(watched.file("keep.txt"), "kept");
+    write_file(watched.file("remove.txt"), "removed");
+    write_file(watched.file("old_name.txt"), "renamed");
+    boost::filesystem::create_directory(watched.file("folder"));
+    write_file(watched.file("folder/inside.txt"), "inside folder");
+    watched.start();
+    BOOST_REQUIRE_EQUAL(watched.engine().document_count(), 4u);
+    boost::uint64_t epoch = watched.engine().epoch();
+
+    // 删除文件、改名与删除整个子目录在同一批中提交
+    boost::filesystem::remove(watched.file("remove.txt"));
+    boost::filesystem::rename(watched.file("old_name.txt"), watched.file("new_name.txt"));
+    boost::filesystem::remove_all(watched.file("folder"));
+    BOOST_REQUIRE(wait_for_commit(watched.engine(), epoch) != Clock::time_point());
+
+    settle();
+    BOOST_CHECK_EQUAL(watched.engine().epoch(), epoch + 1);
+    BOOST_CHECK_EQUAL(watched.engine().document_count(), 2u);
+    BOOST_CHECK_EQUAL(watched.content("keep.txt"), "kept");
+    BOOST_CHECK(watched.content("remove.txt").empty());
+    BOOST_CHECK(watched.content("old_name.txt").empty());
+    BOOST_CHECK_EQUAL(watched.content("new_name.txt"), "renamed");
+    BOOST_CHECK(watched.content("folder/inside.txt").empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // __linux__
@@ -0,0 +1,222 @@
+/**
+ * @file test_document_store.cpp
+ * @brief 压缩文档存储的测试
+ *
+ * 按任意顺序读取的文档与写入的一致，不论文档位于压缩块、尾部还是从索引文件读取的块中；
+ * 解压后的块进入LRU缓存，缓存中的块不再读取压缩数据，被淘汰的块重新解压。
+ */
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+#include "document_store.h"
+#include "index_file.h"
+#include "test_util.h"
+
+namespace {
+
+// 每个测试文档编码后恰好1KB，一块正好容纳16个文档
+const size_t DOCS_PER_BLOCK = 16;
+const size_t CONTENT_SIZE = DocumentStore::BLOCK_BYTES / DOCS_PER_BLOCK - 3 * sizeof(boost::uint32_t) - 18;
+
+/**
+ * @brief 按固定种子生成count篇文档，ID与标题共18字节，正文为随机单词
+ */
+std::vector<boost::shared_ptr<const StoredDocument>> documents(size_t count, unsigned int seed) {
+    static const char* const WORDS[] = {"boost ", "asio ", "thread ", "socket ", "buffer ", "strand ", "timer "};
+    std::mt19937 random(seed);
+    std::vector<boost::shared_ptr<const StoredDocument>> result;
+    for (size_t i = 0; i < count; ++i) {
+        std::string id = "doc" + std::string(5 - std::to_string(i).size(), '0') + std::to_string(i);
+        std::string content;
+        while (content.size() < CONTENT_SIZE) {
+            content += WORDS[random() % 7];
+        }
+        content.resize(CONTENT_SIZE);
+        result.push_back(boost::make_shared<const StoredDocument>(id, "title" + id.substr(3), content));
+    }
+    return result;
+}
+
+/**
+ * @brief 检查存储中编号为doc的文档与expected一致
+ */
+void check_document(const DocumentStore& store, DocId doc, const StoredDocument& expected) {
+    boost::shared_ptr<const StoredDocument> got = store.get(doc);
+    BOOST_REQUIRE(got);
+    BOOST_REQUIRE_EQUAL(got->id, expected.id);
+    BOOST_REQUIRE_EQUAL(got->title, expected.title);
+    BOOST_REQUIRE(got->content == expected.content);
+}
+
+/**
+ * 写入索引文件的存储正文副本，读取出的存储直接引用其中的压缩数据
+ */
+class SerializedStore
+{
+public:
+    explicit SerializedStore(const DocumentStore& store) {
+        TempDirectory directory;
+        std::string path = directory.file("store.idx");
+        {
+            IndexFileWriter writer(path);
+            store.write(writer);
+            writer.finish(IndexFileInfo());
+        }
+        MappedIndexFile file(path);
+        size_ = file.body_size();
+        words_.resize(size_ / sizeof(boost::uint64_t) + 1);
+        std::memcpy(bytes(), file.body(), size_);
+    }
+
+    boost::uint8_t* bytes() { return reinterpret_cast<boost::uint8_t*>(&words_[0]); }
+
+    void read(DocumentStore& store) {
+        IndexFileReader reader(bytes(), size_);
+        store.read(reader);
+    }
+
+    // 覆盖全部压缩数据：块表（每块4个32位字段）与文档偏移之后是数据长度与数据
+    void corrupt_blocks() {
+        boost::uint32_t counts[2];
+        std::memcpy(counts, bytes(), sizeof(counts));
+        size_t data_size_at = sizeof(counts) + (counts[1] * 4 + counts[0]) * sizeof(boost::uint32_t);
+        boost::uint32_t data_size;
+        std::memcpy(&data_size, bytes() + data_size_at, sizeof(data_size));
+        std::memset(bytes() + data_size_at + sizeof(data_size), 0xFF, data_size);
+    }
+
+private:
+    std::vector<boost::uint64_t> words_;
+    size_t size_;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(document_store)
+
+BOOST_AUTO_TEST_CASE(random_access_across_blocks_and_tail) {
+    std::vector<boost::shared_ptr<const StoredDocument>> docs = documents(1000, 1);
+    DocumentStore store;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(store.add(docs[i]), i);
+    }
+    BOOST_CHECK_EQUAL(store.size(), docs.size());
+
+    // 1000 = 62 * 16 + 8：62个满块，8个文档在尾部
+    BOOST_CHECK_EQUAL(store.raw_bytes(), 62 * DocumentStore::BLOCK_BYTES);
+    BOOST_CHECK_LT(store.compressed_bytes(), store.raw_bytes() / 2);
+
+    std::mt19937 random(2);
+    for (int i = 0; i < 3000; ++i) {
+        DocId doc = random() % docs.size();
+        check_document(store, doc, *docs[doc]);
+    }
+
+    // 压缩尾部后仍然可以读取，之后添加的文档从新的尾部开始
+    store.flush();
+    BOOST_CHECK_EQUAL(store.raw_bytes(), 62 * DocumentStore::BLOCK_BYTES + 8 * DocumentStore::BLOCK_BYTES / 16);
+    std::vector<boost::shared_ptr<const StoredDocument>> more = documents(20, 3);
+    for (size_t i = 0; i < more.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(store.add(more[i]), docs.size() + i);
+    }
+    for (size_t doc = docs.size(); doc-- > 0;) {
+        check_document(store, static_cast<DocId>(doc), *docs[doc]);
+    }
+    for (size_t i = 0; i < more.size(); ++i) {
+        check_document(store, static_cast<DocId>(docs.size() + i), *more[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(copies_share_blocks) {
+    std::vector<boost::shared_ptr<const StoredDocument>> docs = documents(100, 4);
+    DocumentStore original;
+    for (size_t i = 0; i < 90; ++i) {
+        original.add(docs[i]);
+    }
+    DocumentStore copy(original);
+    for (size_t i = 90; i < docs.size(); ++i) {
+        copy.add(docs[i]);
+    }
+    BOOST_CHECK_EQUAL(original.size(), 90u);
+    BOOST_CHECK_EQUAL(copy.size(), docs.size());
+
+    // 90 = 5 * 16 + 10，复制品凑满第6块时压缩，原存储的尾部不受影响
+    BOOST_CHECK_EQUAL(original.raw_bytes(), 5 * DocumentStore::BLOCK_BYTES);
+    BOOST_CHECK_EQUAL(copy.raw_bytes(), 6 * DocumentStore::BLOCK_BYTES);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        check_document(copy, static_cast<DocId>(i), *docs[i]);
+        if (i < 90) {
+            check_document(original, static_cast<DocId>(i), *docs[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mapped_store_round_trip) {
+    std::vector<boost::shared_ptr<const StoredDocument>> docs = documents(300, 5);
+    DocumentStore store;
+    for (const auto& doc : docs) {
+        store.add(doc);
+    }
+
+    // 尾部文档写入时临时压缩为最后一块，存储本身不变
+    size_t raw_bytes = store.raw_bytes();
+    SerializedStore body(store);
+    BOOST_CHECK_EQUAL(store.raw_bytes(), raw_bytes);
+    DocumentStore loaded;
+    body.read(loaded);
+    BOOST_CHECK_EQUAL(loaded.size(), docs.size());
+    BOOST_CHECK_EQUAL(loaded.raw_bytes(), docs.size() * DocumentStore::BLOCK_BYTES / DOCS_PER_BLOCK);
+
+    std::mt19937 random(6);
+    for (int i = 0; i < 1000; ++i) {
+        DocId doc = random() % docs.size();
+        check_document(loaded, doc, *docs[doc]);
+    }
+
+    // 从文件读取的存储可以继续添加文档
+    std::vector<boost::shared_ptr<const StoredDocument>> more = documents(3, 7);
+    BOOST_CHECK_EQUAL(loaded.add(more[0]), docs.size());
+    check_document(loaded, static_cast<DocId>(docs.size()), *more[0]);
+    check_document(loaded, 0, *docs[0]);
+}
+
+BOOST_AUTO_TEST_CASE(decompressed_blocks_are_cached) {
+    const size_t blocks = DocumentStore::CACHE_BLOCKS + 2;
+    std::vector<boost::shared_ptr<const StoredDocument>> docs = documents(blocks * DOCS_PER_BLOCK, 8);
+    DocumentStore store;
+    for (const auto& doc : docs) {
+        store.add(doc);
+    }
+    SerializedStore body(store);
+    DocumentStore loaded;
+    body.read(loaded);
+
+    // 依次读取前CACHE_BLOCKS块，再读第0块使其成为最近使用的块，最后读取第CACHE_BLOCKS块时淘汰第1块
+    for (size_t block = 0; block < DocumentStore::CACHE_BLOCKS; ++block) {
+        check_document(loaded, static_cast<DocId>(block * DOCS_PER_BLOCK), *docs[block * DOCS_PER_BLOCK]);
+    }
+    check_document(loaded, 3, *docs[3]);
+    DocId last = static_cast<DocId>(DocumentStore::CACHE_BLOCKS * DOCS_PER_BLOCK);
+    check_document(loaded, last, *docs[last]);
+
+    // 压缩数据损坏后，缓存中的块仍然可读，不在缓存中的块解压失败
+    body.corrupt_blocks();
+    for (size_t block = 0; block <= DocumentStore::CACHE_BLOCKS; ++block) {
+        for (size_t i = 0; i < DOCS_PER_BLOCK; ++i) {
+            DocId doc = static_cast<DocId>(block * DOCS_PER_BLOCK + i);
+            if (block == 1) {
+                BOOST_CHECK_THROW(loaded.get(doc), std::runtime_error);
+            } else {
+                check_document(loaded, doc, *docs[doc]);
+            }
+        }
+    }
+    BOOST_CHECK_THROW(loaded.get(static_cast<DocId>((blocks - 1) * DOCS_PER_BLOCK)), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,229 @@
+/**
+ * @file test_index_file.cpp
+ * @brief 索引文件读写的测试
+ *
+ * 写入的正文按原样读回，文件头中的描述信息保持不变；文件头任何字段被篡改、文件被截断或
+ * 格式版本不符时打开失败，正文被篡改只在要求校验正文时被发现。读取游标越界时抛出异常。
+ */
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include "index_file.h"
+#include "test_util.h"
+
+namespace {
+
+// 文件头中各字段的偏移，与index_file.cpp中的FileHeader一致
+const size_t VERSION_OFFSET = 8;
+const size_t FINGERPRINT_OFFSET = 16;
+const size_t BODY_SIZE_OFFSET = 24;
+
+/**
+ * @brief 写入一个包含各种字段的索引文件
+ */
+void write_sample(const std::string& path, boost::uint64_t fingerprint) {
+    IndexFileWriter writer(path);
+    writer.write_u8(7);
+    writer.align(8);
+    writer.write_u64(0x0123456789ABCDEFULL);
+    writer.write_u32(42);
+    writer.write_string("hello");
+    writer.write_string(std::string());
+    writer.align(4);
+    const char raw[] = "raw bytes";
+    writer.write(raw, sizeof(raw));
+
+    IndexFileInfo info;
+    info.flags = index_file::FLAG_POSITIONS;
+    info.fingerprint = fingerprint;
+    writer.finish(info);
+}
+
+/**
+ * @brief 把文件中offset处的一个字节与mask异或
+ */
+void flip_byte(const std::string& path, size_t offset, char mask = 0x01) {
+    std::fstream file(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(offset));
+    char byte = 0;
+    file.read(&byte, 1);
+    byte ^= mask;
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(&byte, 1);
+}
+
+/**
+ * @brief 打开并校验索引文件，随即关闭
+ */
+void open_index(const std::string& path, bool verify_body = false) {
+    MappedIndexFile file(path, verify_body);
+}
+
+/**
+ * @brief 读取整个文件的内容
+ */
+std::string read_file(const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(index_file_format)
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 0xFEEDFACECAFEBEEFULL);
+
+    MappedIndexFile file(path, true);
+    BOOST_CHECK_EQUAL(file.info().flags, index_file::FLAG_POSITIONS);
+    BOOST_CHECK_EQUAL(file.info().fingerprint, 0xFEEDFACECAFEBEEFULL);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), index_file::HEADER_SIZE + file.body_size());
+
+    IndexFileReader reader(file.body(), file.body_size());
+    BOOST_CHECK_EQUAL(reader.read_u8(), 7);
+    reader.align(8);
+    BOOST_CHECK_EQUAL(reader.read_u64(), 0x0123456789ABCDEFULL);
+    BOOST_CHECK_EQUAL(reader.read_u32(), 42u);
+    BOOST_CHECK_EQUAL(reader.read_string(), "hello");
+    BOOST_CHECK_EQUAL(reader.read_string(), "");
+    reader.align(4);
+    BOOST_CHECK_EQUAL(std::strcmp(reinterpret_cast<const char*>(reader.read(10)), "raw bytes"), 0);
+    BOOST_CHECK(reader.at_end());
+    BOOST_CHECK_THROW(reader.read_u8(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(finish_replaces_existing_file) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 1);
+    write_sample(path, 2);
+    BOOST_CHECK_EQUAL(MappedIndexFile(path).info().fingerprint, 2u);
+    BOOST_CHECK(!boost::filesystem::exists(path + ".tmp"));
+
+    // 没有调用finish的写入器不影响已有的文件，也不留下临时文件
+    std::string before = read_file(path);
+    {
+        IndexFileWriter writer(path);
+        writer.write_u32(1);
+    }
+    BOOST_CHECK(read_file(path) == before);
+    BOOST_CHECK(!boost::filesystem::exists(path + ".tmp"));
+}
+
+BOOST_AUTO_TEST_CASE(writer_creates_parent_directories) {
+    TempDirectory directory;
+    std::string path = (directory.path() / "nested" / "index" / "sample.idx").string();
+    write_sample(path, 3);
+    BOOST_CHECK_EQUAL(MappedIndexFile(path).info().fingerprint, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_missing_and_short_files) {
+    TempDirectory directory;
+    BOOST_CHECK_THROW(open_index(directory.file("missing.idx")), std::runtime_error);
+
+    std::string path = directory.file("short.idx");
+    std::ofstream(path.c_str(), std::ios::binary) << "BSEINDEX";
+    BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_corrupted_header) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+
+    // 文件头的每个字节（包括魔数、版本与两个校验和）被篡改后都无法打开
+    for (size_t offset = 0; offset < index_file::HEADER_SIZE; ++offset) {
+        BOOST_TEST_CONTEXT("offset " << offset) {
+            write_sample(path, 4);
+            flip_byte(path, offset);
+            BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rejects_other_versions) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 5);
+    flip_byte(path, VERSION_OFFSET, 0x03);
+    try {
+        MappedIndexFile file(path);
+        BOOST_ERROR("an index file with another version was accepted");
+    }
+    catch (const std::runtime_error& e) {
+        BOOST_CHECK(std::string(e.what()).find("version") != std::string::npos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rejects_truncated_and_extended_body) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 6);
+    boost::uintmax_t size = boost::filesystem::file_size(path);
+
+    boost::filesystem::resize_file(path, size - 1);
+    BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+
+    write_sample(path, 6);
+    boost::filesystem::resize_file(path, size + 8);
+    BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(body_checksum_is_verified_on_request) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 7);
+    flip_byte(path, index_file::HEADER_SIZE + 9);
+
+    // 默认只校验文件头，打开的代价与正文大小无关
+    BOOST_CHECK_NO_THROW(open_index(path, false));
+    BOOST_CHECK_THROW(open_index(path, true), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(header_fields_are_covered_by_checksum) {
+    TempDirectory directory;
+    std::string path = directory.file("sample.idx");
+    write_sample(path, 8);
+    flip_byte(path, FINGERPRINT_OFFSET);
+    BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+
+    write_sample(path, 8);
+    flip_byte(path, BODY_SIZE_OFFSET);
+    BOOST_CHECK_THROW(open_index(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(reader_bounds) {
+    const boost::uint8_t body[6] = {1, 2, 3, 4, 5, 6};
+    IndexFileReader reader(body, sizeof(body));
+    BOOST_CHECK_THROW(reader.read(7), std::runtime_error);
+    BOOST_CHECK_EQUAL(reader.read_u32(), 0x04030201u);
+    BOOST_CHECK_THROW(reader.read_u32(), std::runtime_error);
+    BOOST_CHECK_THROW(reader.read_u64(), std::runtime_error);
+    BOOST_CHECK_THROW(reader.read(static_cast<size_t>(-1)), std::runtime_error);
+    BOOST_CHECK(!reader.at_end());
+    BOOST_CHECK_EQUAL(reader.read(2)[1], 6);
+    BOOST_CHECK(reader.at_end());
+
+    // 字符串长度超过剩余数据
+    const boost::uint8_t string_body[6] = {100, 0, 0, 0, 'a', 'b'};
+    IndexFileReader strings(string_body, sizeof(string_body));
+    BOOST_CHECK_THROW(strings.read_string(), std::runtime_error);
+
+    // 对齐所需的填充超过剩余数据：正文从文件偏移HEADER_SIZE开始，读过1个字节后对齐到8需要7个字节
+    IndexFileReader padding(body, sizeof(body));
+    padding.read_u8();
+    BOOST_CHECK_THROW(padding.align(8), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(fnv1a64_matches_reference_values) {
+    BOOST_CHECK_EQUAL(fnv1a64("", 0), 14695981039346656037ULL);
+    BOOST_CHECK_EQUAL(fnv1a64("a", 1), 0xAF63DC4C8601EC8CULL);
+    BOOST_CHECK_EQUAL(fnv1a64("foobar", 6), 0x85944171F73967E8ULL);
+    BOOST_CHECK_EQUAL(fnv1a64("bar", 3, fnv1a64("foo", 3)), fnv1a64("foobar", 6));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,223 @@
+/**
+ * @file test_index_segment.cpp
+ * @brief 索引段的测试
+ *
+ * 合并段时被标记删除（墓碑）的文档连同其倒排记录一起被丢弃，其余文档按顺序重新编号；
+ * 复制的段与原段互不影响；段写入索引文件再加载后内容不变。
+ */
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+#include "index_file.h"
+#include "index_segment.h"
+#include "test_util.h"
+
+namespace {
+
+/**
+ * 测试用的文档：ID与其正文词项（每个词项出现一次，位置为词项的序号）
+ */
+struct TestDocument {
+    std::string id;
+    std::vector<std::string> terms;
+    std::vector<std::string> title_terms;   // 同时出现在标题中的词项，必须是terms的前缀
+};
+
+/**
+ * @brief 把文档写入段
+ */
+DocId add(IndexSegment& segment, const TestDocument& document) {
+    std::string content;
+    for (const std::string& term : document.terms) {
+        content += term + " ";
+    }
+    DocId doc = segment.add_document(boost::make_shared<StoredDocument>(document.id, document.id, content),
+                                     static_cast<boost::uint32_t>(document.terms.size()),
+                                     static_cast<boost::uint32_t>(document.title_terms.size()));
+    for (size_t i = 0; i < document.terms.size(); ++i) {
+        std::vector<boost::uint32_t> positions(1, static_cast<boost::uint32_t>(i));
+        boost::uint32_t title_tf = i < document.title_terms.size() ? 1 : 0;
+        segment.add_posting(document.terms[i], doc, 1, title_tf, &positions);
+    }
+    return doc;
+}
+
+/**
+ * @brief 构造文档
+ */
+TestDocument document(const std::string& id, const std::string& terms, const std::string& title_terms = "") {
+    TestDocument result;
+    result.id = id;
+    std::string::size_type start = 0;
+    while (start < terms.size()) {
+        std::string::size_type end = terms.find(' ', start);
+        end = end == std::string::npos ? terms.size() : end;
+        result.terms.push_back(terms.substr(start, end - start));
+        start = end + 1;
+    }
+    std::string::size_type title_start = 0;
+    while (title_start < title_terms.size()) {
+        std::string::size_type end = title_terms.find(' ', title_start);
+        end = end == std::string::npos ? title_terms.size() : end;
+        result.title_terms.push_back(title_terms.substr(title_start, end - title_start));
+        title_start = end + 1;
+    }
+    return result;
+}
+
+/**
+ * @brief 词项的倒排列表中的文档编号，词项不存在时为空
+ */
+std::vector<DocId> docs_of(const IndexSegment& segment, const std::string& term) {
+    std::vector<DocId> docs;
+    const PostingList* postings = segment.find_postings(term);
+    if (postings) {
+        for (PostingList::Iterator it = postings->iterator(); !it.at_end(); it.next()) {
+            docs.push_back(it.doc());
+        }
+    }
+    return docs;
+}
+
+/**
+ * @brief 由若干文档编号构造数组
+ */
+std::vector<DocId> ids(std::initializer_list<DocId> values) {
+    return std::vector<DocId>(values);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(index_segment)
+
+BOOST_AUTO_TEST_CASE(merge_drops_tombstoned_documents) {
+    IndexSegment first;
+    add(first, document("a0", "shared alpha"));
+    add(first, document("a1", "shared doomed", "shared"));
+    add(first, document("a2", "shared alpha"));
+    first.seal();
+
+    IndexSegment second;
+    add(second, document("b0", "doomed shared", "doomed"));
+    add(second, document("b1", "shared beta", "shared"));
+    second.seal();
+
+    std::vector<bool> first_deleted(3, false);
+    first_deleted[1] = true;
+    std::vector<bool> second_deleted(1, true); // 比段内文档数短的标记数组，其后的文档视为有效
+
+    std::vector<const IndexSegment*> segments;
+    segments.push_back(&first);
+    segments.push_back(&second);
+    std::vector<const std::vector<bool>*> deleted;
+    deleted.push_back(&first_deleted);
+    deleted.push_back(&second_deleted);
+    std::vector<std::vector<DocId>> remap;
+    boost::shared_ptr<IndexSegment> merged = IndexSegment::merge(segments, deleted, remap);
+
+    BOOST_CHECK(merged->sealed());
+    BOOST_REQUIRE_EQUAL(merged->size(), 3u);
+    BOOST_CHECK(remap[0] == ids({0, PostingList::END_DOC, 1}));
+    BOOST_CHECK(remap[1] == ids({PostingList::END_DOC, 2}));
+
+    // 只出现在被删除文档中的词项（包括标题字段）完全消失
+    BOOST_CHECK(merged->find_postings("doomed") == nullptr);
+    BOOST_CHECK(merged->find_postings("title:doomed") == nullptr);
+    BOOST_CHECK(docs_of(*merged, "shared") == ids({0, 1, 2}));
+    BOOST_CHECK(docs_of(*merged, "alpha") == ids({0, 1}));
+    BOOST_CHECK(docs_of(*merged, "beta") == ids({2}));
+    BOOST_CHECK(docs_of(*merged, "title:shared") == ids({2}));
+    BOOST_CHECK_EQUAL(merged->term_count(), 3u);
+
+    BOOST_CHECK_EQUAL(merged->ids().size(), 3u);
+    BOOST_CHECK_EQUAL(merged->find_document("a1"), PostingList::END_DOC);
+    BOOST_CHECK_EQUAL(merged->find_document("b0"), PostingList::END_DOC);
+    BOOST_CHECK_EQUAL(merged->find_document("a2"), 1u);
+    BOOST_CHECK_EQUAL(merged->document(1)->id, "a2");
+    BOOST_CHECK_EQUAL(merged->document(2)->id, "b1");
+    BOOST_CHECK_EQUAL(merged->title_lengths()[2], 1u);
+
+    // 位置随记录一起保留
+    PostingList::Iterator it = merged->find_postings("beta")->iterator();
+    std::vector<boost::uint32_t> positions;
+    it.positions(positions);
+    BOOST_CHECK(positions == std::vector<boost::uint32_t>(1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(merge_of_fully_deleted_segment_is_empty) {
+    IndexSegment segment;
+    add(segment, document("x", "gone"));
+    segment.seal();
+
+    std::vector<bool> all(1, true);
+    std::vector<const IndexSegment*> segments(1, &segment);
+    std::vector<const std::vector<bool>*> deleted(1, &all);
+    std::vector<std::vector<DocId>> remap;
+    boost::shared_ptr<IndexSegment> merged = IndexSegment::merge(segments, deleted, remap);
+    BOOST_CHECK_EQUAL(merged->size(), 0u);
+    BOOST_CHECK_EQUAL(merged->term_count(), 0u);
+    BOOST_CHECK(merged->find_postings("gone") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(copies_do_not_share_writes) {
+    IndexSegment original;
+    add(original, document("d0", "common first"));
+
+    // 相当于已发布的快照持有original，写入线程在副本上继续添加文档
+    IndexSegment copy = original;
+    add(copy, document("d1", "common second"));
+
+    BOOST_CHECK_EQUAL(original.size(), 1u);
+    BOOST_CHECK(docs_of(original, "common") == ids({0}));
+    BOOST_CHECK(original.find_postings("second") == nullptr);
+    BOOST_CHECK_EQUAL(original.find_document("d1"), PostingList::END_DOC);
+    BOOST_CHECK(docs_of(copy, "common") == ids({0, 1}));
+
+    // 封存副本不影响未封存的原段
+    copy.seal();
+    BOOST_CHECK(!original.sealed());
+    add(original, document("d1", "common other"));
+    BOOST_CHECK(docs_of(original, "other") == ids({1}));
+    BOOST_CHECK(copy.find_postings("other") == nullptr);
+    BOOST_CHECK(docs_of(copy, "second") == ids({1}));
+}
+
+BOOST_AUTO_TEST_CASE(index_file_round_trip) {
+    TempDirectory directory;
+    std::string path = directory.file("segment.idx");
+
+    IndexSegment segment;
+    for (int i = 0; i < 300; ++i) {
+        add(segment, document("doc" + std::to_string(i), "all group" + std::to_string(i % 7), "all"));
+    }
+    segment.seal();
+    {
+        IndexFileWriter writer(path);
+        segment.write(writer);
+        writer.finish(IndexFileInfo());
+    }
+
+    boost::shared_ptr<const MappedIndexFile> file(new MappedIndexFile(path, true));
+    IndexFileReader reader(file->body(), file->body_size());
+    boost::shared_ptr<IndexSegment> loaded = IndexSegment::load(reader, file);
+    BOOST_CHECK(reader.at_end());
+
+    BOOST_CHECK(loaded->sealed());
+    BOOST_REQUIRE_EQUAL(loaded->size(), segment.size());
+    BOOST_CHECK_EQUAL(loaded->term_count(), segment.term_count());
+    BOOST_CHECK(loaded->doc_lengths() == segment.doc_lengths());
+    BOOST_CHECK(loaded->title_lengths() == segment.title_lengths());
+    BOOST_CHECK(loaded->ids() == segment.ids());
+    const char* const terms[] = {"all", "group0", "group6", "title:all"};
+    for (const char* term : terms) {
+        BOOST_CHECK(docs_of(*loaded, term) == docs_of(segment, term));
+    }
+    BOOST_CHECK_EQUAL(loaded->document(299)->content, segment.document(299)->content);
+    BOOST_CHECK_EQUAL(loaded->footprint().posting_bytes, segment.footprint().posting_bytes);
+    BOOST_CHECK_EQUAL(loaded->footprint().store_bytes, segment.footprint().store_bytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+/**
+ * @file test_levenshtein_automaton.cpp
+ * @brief Levenshtein自动机的测试
+ *
+ * 编辑距离与动态规划的参照结果一致；与词典求交得到的词项与逐个计算编辑距离的结果完全相同，
+ * 跳过不可能被接受的前缀不会漏掉任何词项。
+ */
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "levenshtein_automaton.h"
+#include "term_dictionary.h"
+
+namespace {
+
+/**
+ * @brief 按字节计算的编辑距离（插入、删除、替换），动态规划的参照实现
+ */
+size_t reference_distance(const std::string& a, const std::string& b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+        row[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); ++j) {
+            size_t above = row[j];
+            row[j] = std::min(std::min(row[j] + 1, row[j - 1] + 1), diagonal + (a[i - 1] == b[j - 1] ? 0 : 1));
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+/**
+ * @brief 按固定种子生成长度在[min_length, max_length]内、由alphabet中的字节组成的随机串
+ */
+std::string random_word(std::mt19937& random, const std::string& alphabet, size_t min_length, size_t max_length) {
+    std::string word(min_length + random() % (max_length - min_length + 1), ' ');
+    for (char& c : word) {
+        c = alphabet[random() % alphabet.size()];
+    }
+    return word;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(levenshtein_automaton)
+
+BOOST_AUTO_TEST_CASE(supported_terms_and_default_edits) {
+    BOOST_CHECK(LevenshteinAutomaton::supports("asio"));
+    BOOST_CHECK(LevenshteinAutomaton::supports("Boost2"));
+    BOOST_CHECK(!LevenshteinAutomaton::supports(""));
+    BOOST_CHECK(!LevenshteinAutomaton::supports("2048"));
+    BOOST_CHECK(!LevenshteinAutomaton::supports("caf\xc3\xa9"));
+    BOOST_CHECK(!LevenshteinAutomaton::supports("\xe4\xb8\xad\xe6\x96\x87"));
+
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton::default_edits("ab"), 0u);
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton::default_edits("abc"), 1u);
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton::default_edits("abcde"), 1u);
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton::default_edits("abcdef"), 2u);
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton::default_edits("2048abcdef"), 0u);
+
+    BOOST_CHECK_EQUAL(LevenshteinAutomaton("asio", 5).max_edits(), LevenshteinAutomaton::MAX_EDITS);
+}
+
+BOOST_AUTO_TEST_CASE(known_distances) {
+    LevenshteinAutomaton automaton("kitten", 2);
+    BOOST_CHECK_EQUAL(automaton.distance("kitten"), 0u);
+    BOOST_CHECK_EQUAL(automaton.distance("sitten"), 1u);
+    BOOST_CHECK_EQUAL(automaton.distance("kittens"), 1u);
+    BOOST_CHECK_EQUAL(automaton.distance("kiten"), 1u);
+    BOOST_CHECK_EQUAL(automaton.distance("sittin"), 2u);
+    BOOST_CHECK_EQUAL(automaton.distance("sitting"), 3u);
+    BOOST_CHECK_EQUAL(automaton.distance(""), 3u);
+    BOOST_CHECK_EQUAL(automaton.distance("ktiten"), 2u);
+
+    LevenshteinAutomaton exact("asio", 0);
+    BOOST_CHECK_EQUAL(exact.distance("asio"), 0u);
+    BOOST_CHECK_EQUAL(exact.distance("asi"), 1u);
+    BOOST_CHECK_EQUAL(exact.distance("asio\xff"), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(distance_matches_reference) {
+    std::mt19937 random(1);
+    for (int round = 0; round < 3000; ++round) {
+        std::string term = random_word(random, "abc", 0, 7);
+        std::string candidate = random_word(random, "abcd", 0, 9);
+        size_t max_edits = random() % (LevenshteinAutomaton::MAX_EDITS + 1);
+        LevenshteinAutomaton automaton(term, max_edits);
+        size_t expected = std::min(reference_distance(term, candidate), max_edits + 1);
+        BOOST_REQUIRE_MESSAGE(automaton.distance(candidate) == expected,
+                              "term \"" << term << "\", candidate \"" << candidate << "\", max_edits " << max_edits);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(intersect_matches_brute_force) {
+    std::mt19937 random(2);
+    for (int round = 0; round < 40; ++round) {
+        std::set<std::string> unique;
+        while (unique.size() < 500) {
+            unique.insert(random_word(random, "abcde\x7f\xe4", 1, 8));
+        }
+        std::vector<std::string> terms(unique.begin(), unique.end());
+        TermDictionary dictionary(terms);
+
+        std::string target = terms[random() % terms.size()];
+        if (round % 3 == 0) {
+            target = random_word(random, "abcde", 1, 6);
+        }
+        size_t max_edits = 1 + round % LevenshteinAutomaton::MAX_EDITS;
+        LevenshteinAutomaton automaton(target, max_edits);
+
+        std::vector<std::pair<std::string, size_t>> expected;
+        for (const std::string& term : terms) {
+            size_t distance = reference_distance(target, term);
+            if (distance <= max_edits) {
+                expected.push_back(std::make_pair(term, distance));
+            }
+        }
+        std::vector<std::pair<std::string, size_t>> matched;
+        automaton.intersect(dictionary, matched);
+        BOOST_REQUIRE_MESSAGE(matched == expected, "target \"" << target << "\", max_edits " << max_edits);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(intersect_appends_in_byte_order) {
+    std::vector<std::string> terms;
+    terms.push_back("asia");
+    terms.push_back("asio");
+    terms.push_back("asios");
+    terms.push_back("audio");
+    terms.push_back("basic");
+    terms.push_back("ratio");
+    TermDictionary dictionary(terms);
+
+    std::vector<std::pair<std::string, size_t>> matched(1, std::make_pair(std::string("kept"), 0));
+    LevenshteinAutomaton("asio", 1).intersect(dictionary, matched);
+    BOOST_REQUIRE_EQUAL(matched.size(), 4u);
+    BOOST_CHECK_EQUAL(matched[0].first, "kept");
+    BOOST_CHECK(matched[1] == std::make_pair(std::string("asia"), static_cast<size_t>(1)));
+    BOOST_CHECK(matched[2] == std::make_pair(std::string("asio"), static_cast<size_t>(0)));
+    BOOST_CHECK(matched[3] == std::make_pair(std::string("asios"), static_cast<size_t>(1)));
+
+    std::vector<std::pair<std::string, size_t>> none;
+    LevenshteinAutomaton("asio", 1).intersect(TermDictionary(), none);
+    BOOST_CHECK(none.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,185 @@
+/**
+ * @file test_lz_codec.cpp
+ * @brief LZ编解码器的测试
+ *
+ * 压缩后解压必须得到原数据；损坏或截断的压缩数据、与之不符的原始长度都必须被拒绝，
+ * 解压不能越过输入末尾读取，也不能写出超过原始长度的数据。
+ */
+
+#include <random>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include "lz_codec.h"
+
+namespace {
+
+/**
+ * @brief 压缩后解压，检查得到原数据，返回压缩数据
+ */
+std::string round_trip(const std::string& raw) {
+    std::string compressed;
+    lz::compress(raw.data(), raw.size(), compressed);
+    std::string restored("stale");
+    BOOST_REQUIRE(lz::decompress(compressed.data(), compressed.size(), raw.size(), restored));
+    BOOST_REQUIRE(restored == raw);
+    return compressed;
+}
+
+/**
+ * @brief 按固定种子生成size字节的随机数据，alphabet为0时取全部256个字节值
+ */
+std::string random_bytes(size_t size, unsigned int seed, unsigned int alphabet = 0) {
+    std::mt19937 random(seed);
+    std::string data(size, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(alphabet == 0 ? random() & 0xFF : 'a' + random() % alphabet);
+    }
+    return data;
+}
+
+/**
+ * @brief 一段有大量重复的文本
+ */
+std::string repetitive_text() {
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "Boost.Asio provides portable networking and low-level I/O. 第" + std::to_string(i) + "段中文内容。\n";
+    }
+    return text;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(lz_codec)
+
+BOOST_AUTO_TEST_CASE(round_trip_edge_sizes) {
+    round_trip(std::string());
+    round_trip("a");
+    round_trip("abc");
+    round_trip("abcd");
+    round_trip(std::string(5, 'x'));
+    round_trip(std::string(15, 'y'));
+    round_trip(std::string(16, 'y'));
+    round_trip(std::string(270, 'z'));
+    round_trip(std::string(100000, '\0'));
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_text_and_random_data) {
+    std::string text = repetitive_text();
+    std::string compressed = round_trip(text);
+    BOOST_CHECK_LT(compressed.size(), text.size() / 2);
+
+    // 不可压缩的数据只有字面量，长度扩展字节也要正确处理
+    round_trip(random_bytes(1, 1));
+    round_trip(random_bytes(300, 2));
+    round_trip(random_bytes(70000, 3));
+    round_trip(random_bytes(70000, 4, 4));
+
+    // 超过16位偏移范围的重复不能被当作匹配
+    std::string far = random_bytes(70000, 5);
+    round_trip(far + far);
+}
+
+BOOST_AUTO_TEST_CASE(compress_appends_to_output) {
+    std::string text = repetitive_text();
+    std::string out("prefix");
+    lz::compress(text.data(), text.size(), out);
+    BOOST_REQUIRE_EQUAL(out.compare(0, 6, "prefix"), 0);
+
+    std::string restored;
+    BOOST_REQUIRE(lz::decompress(out.data() + 6, out.size() - 6, text.size(), restored));
+    BOOST_CHECK(restored == text);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_wrong_raw_size) {
+    std::string text = repetitive_text();
+    std::string compressed;
+    lz::compress(text.data(), text.size(), compressed);
+
+    std::string restored;
+    BOOST_CHECK(!lz::decompress(compressed.data(), compressed.size(), text.size() - 1, restored));
+    BOOST_CHECK_LE(restored.size(), text.size() - 1);
+    BOOST_CHECK(!lz::decompress(compressed.data(), compressed.size(), text.size() + 1, restored));
+    BOOST_CHECK(!lz::decompress(compressed.data(), compressed.size(), 0, restored));
+}
+
+BOOST_AUTO_TEST_CASE(rejects_truncated_input) {
+    std::string text = repetitive_text();
+    std::string compressed;
+    lz::compress(text.data(), text.size(), compressed);
+
+    std::string restored;
+    size_t accepted = 0;
+    for (size_t size = 0; size < compressed.size(); ++size) {
+        // 截断后的数据在堆上单独分配，越界读取能被内存检查工具发现
+        std::string truncated(compressed, 0, size);
+        if (lz::decompress(truncated.data(), truncated.size(), text.size(), restored)) {
+            // 只有末尾空的字面量序列被截掉时，剩下的数据仍然完整
+            BOOST_REQUIRE(restored == text);
+            accepted++;
+        }
+        BOOST_REQUIRE_LE(restored.size(), text.size());
+    }
+    BOOST_CHECK_LE(accepted, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_bad_match_offsets) {
+    std::string restored;
+
+    // 字面量"ab"之后的匹配偏移为0
+    const char zero_offset[] = {0x20, 'a', 'b', 0x00, 0x00};
+    BOOST_CHECK(!lz::decompress(zero_offset, sizeof(zero_offset), 6, restored));
+
+    // 匹配偏移超过已输出的数据
+    const char far_offset[] = {0x20, 'a', 'b', 0x03, 0x00};
+    BOOST_CHECK(!lz::decompress(far_offset, sizeof(far_offset), 6, restored));
+
+    // 合法的重叠匹配：偏移1、长度4，把"b"重复4次
+    const char overlap[] = {0x20, 'a', 'b', 0x01, 0x00};
+    BOOST_REQUIRE(lz::decompress(overlap, sizeof(overlap), 6, restored));
+    BOOST_CHECK_EQUAL(restored, "abbbbb");
+
+    // 同样的匹配超过原始长度
+    BOOST_CHECK(!lz::decompress(overlap, sizeof(overlap), 5, restored));
+}
+
+BOOST_AUTO_TEST_CASE(rejects_overlong_lengths) {
+    std::string restored;
+
+    // 字面量长度扩展到15 + 255 + 10，但输入只有几个字节
+    const char literal[] = {static_cast<char>(0xF0), static_cast<char>(0xFF), 0x0A, 'a', 'b'};
+    BOOST_CHECK(!lz::decompress(literal, sizeof(literal), 280, restored));
+
+    // 长度扩展字节在输入末尾中断
+    const char unterminated[] = {static_cast<char>(0xF0), static_cast<char>(0xFF), static_cast<char>(0xFF)};
+    BOOST_CHECK(!lz::decompress(unterminated, sizeof(unterminated), 1000, restored));
+
+    // 匹配长度扩展后超过原始长度
+    const char match[] = {0x1F, 'a', 0x01, 0x00, static_cast<char>(0xFF), 0x00};
+    BOOST_CHECK(!lz::decompress(match, sizeof(match), 100, restored));
+    BOOST_REQUIRE(lz::decompress(match, sizeof(match), 1 + 15 + 255 + 4, restored));
+    BOOST_CHECK(restored == std::string(1 + 15 + 255 + 4, 'a'));
+}
+
+BOOST_AUTO_TEST_CASE(random_corruption_never_overruns) {
+    std::string text = repetitive_text();
+    std::string compressed;
+    lz::compress(text.data(), text.size(), compressed);
+
+    std::mt19937 random(6);
+    std::string restored;
+    for (int round = 0; round < 2000; ++round) {
+        std::string corrupted = compressed;
+        for (int k = 0; k < 3; ++k) {
+            corrupted[random() % corrupted.size()] = static_cast<char>(random() & 0xFF);
+        }
+        // 结果可能碰巧合法，但无论如何都不能写出超过原始长度的数据
+        if (lz::decompress(corrupted.data(), corrupted.size(), text.size(), restored)) {
+            BOOST_REQUIRE_EQUAL(restored.size(), text.size());
+        } else {
+            BOOST_REQUIRE_LE(restored.size(), text.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,24 @@
+/**
+ * @file test_main.cpp
+ * @brief 单元测试程序入口
+ *
+ * 使用Boost.Test的单头文件版本，不需要额外链接测试库；各模块的测试用例位于同目录下的test_*.cpp中。
+ * 构建与运行：cmake --build . --target tests，然后 ctest（或直接运行 ./tests --log_level=test_suite）
+ */
+
+#define BOOST_TEST_MODULE BoostSearchEngineTests
+#include <boost/test/included/unit_test.hpp>
+
+class SearchEngine;
+class SearchCoordinator;
+
+/**
+ * @brief HTTP服务器模块需要的全局实例访问函数；单元测试不经过HTTP服务器，不提供实例
+ */
+SearchEngine* get_search_engine() {
+    return nullptr;
+}
+
+SearchCoordinator* get_search_coordinator() {
+    return nullptr;
+}
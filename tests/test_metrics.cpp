@@ -0,0 +1,168 @@
+/**
+ * @file test_metrics.cpp
+ * @brief 延迟直方图的测试
+ *
+ * 分位数的相对误差不超过子桶宽度，小取值精确；导出的Prometheus桶是累计的，
+ * 以2的幂纳秒为边界，+Inf桶与_count等于样本总数，_sum为取值之和（秒）。
+ */
+
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include "metrics.h"
+
+namespace {
+
+/**
+ * @brief 解析导出的直方图：le标签 -> 累计样本数，另外输出_sum与_count
+ */
+std::map<std::string, boost::uint64_t> parse_buckets(const LatencyHistogram& histogram, double& sum,
+                                                     boost::uint64_t& count) {
+    std::ostringstream out;
+    histogram.write(out, "latency", "stage=\"test\"");
+    std::istringstream lines(out.str());
+    std::map<std::string, boost::uint64_t> buckets;
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::string::size_type space = line.rfind(' ');
+        std::string value = line.substr(space + 1);
+        if (line.compare(0, 15, "latency_bucket{") == 0) {
+            std::string::size_type le = line.find("le=\"");
+            BOOST_REQUIRE(le != std::string::npos);
+            BOOST_REQUIRE(line.compare(15, 13, "stage=\"test\",") == 0);
+            std::string bound = line.substr(le + 4, line.find('"', le + 4) - le - 4);
+            buckets[bound] = std::stoull(value);
+        } else if (line.compare(0, 25, "latency_sum{stage=\"test\"}") == 0) {
+            sum = std::stod(value);
+        } else if (line.compare(0, 27, "latency_count{stage=\"test\"}") == 0) {
+            count = std::stoull(value);
+        } else {
+            BOOST_ERROR("unexpected line: " << line);
+        }
+    }
+    return buckets;
+}
+
+/**
+ * @brief 导出的le标签的文本，与LatencyHistogram::write的格式一致
+ */
+std::string bound_label(int bit) {
+    std::ostringstream out;
+    out << static_cast<double>(static_cast<boost::uint64_t>(1) << bit) / 1e9;
+    return out.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(metrics)
+
+BOOST_AUTO_TEST_CASE(empty_histogram) {
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.quantile(0.5), 0u);
+
+    double sum = -1;
+    boost::uint64_t count = 1;
+    std::map<std::string, boost::uint64_t> buckets = parse_buckets(histogram, sum, count);
+    BOOST_CHECK_EQUAL(buckets.size(),
+                      static_cast<size_t>(LatencyHistogram::MAX_EXPORT_BIT - LatencyHistogram::MIN_EXPORT_BIT + 2));
+    for (const auto& bucket : buckets) {
+        BOOST_CHECK_EQUAL(bucket.second, 0u);
+    }
+    BOOST_CHECK_EQUAL(sum, 0.0);
+    BOOST_CHECK_EQUAL(count, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(small_values_are_exact) {
+    for (boost::uint64_t value = 0; value < 2 * LatencyHistogram::SUB_BUCKETS; ++value) {
+        LatencyHistogram histogram;
+        histogram.record(value);
+        BOOST_REQUIRE_EQUAL(histogram.quantile(1.0), value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(quantile_relative_error_is_bounded) {
+    const boost::uint64_t values[] = {33, 100, 1000, 1023, 1024, 1025, 123456, 999999999, 1ULL << 40,
+                                      (1ULL << 62) + 12345, 0xFFFFFFFFFFFFFFFFULL};
+    for (boost::uint64_t value : values) {
+        LatencyHistogram histogram;
+        histogram.record(value);
+        boost::uint64_t upper = histogram.quantile(0.5);
+        BOOST_TEST_CONTEXT("value " << value) {
+            // 子桶的最大取值不小于样本，且相对误差不超过1/SUB_BUCKETS
+            BOOST_CHECK_GE(upper, value);
+            BOOST_CHECK_LE(static_cast<double>(upper - value),
+                           static_cast<double>(value) / LatencyHistogram::SUB_BUCKETS);
+        }
+    }
+
+    // 2的幂是子桶的下边界，上一个取值属于前一个子桶
+    LatencyHistogram boundary;
+    boundary.record(1023);
+    BOOST_CHECK_EQUAL(boundary.quantile(1.0), 1023u);
+    boundary.record(1024);
+    BOOST_CHECK_EQUAL(boundary.quantile(1.0), 1024u + 1024u / LatencyHistogram::SUB_BUCKETS - 1);
+}
+
+BOOST_AUTO_TEST_CASE(quantile_ranks) {
+    LatencyHistogram histogram;
+    for (boost::uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value * 1000);
+    }
+    const double quantiles[] = {0.0, 0.01, 0.5, 0.9, 0.99, 1.0};
+    for (double q : quantiles) {
+        // 第ceil(q*n)个最小样本（至少为第1个）所在子桶的最大取值
+        double rank = std::max(1.0, std::ceil(q * 1000));
+        boost::uint64_t expected = static_cast<boost::uint64_t>(rank) * 1000;
+        boost::uint64_t upper = histogram.quantile(q);
+        BOOST_TEST_CONTEXT("q " << q) {
+            BOOST_CHECK_GE(upper, expected);
+            BOOST_CHECK_LE(static_cast<double>(upper - expected),
+                           static_cast<double>(expected) / LatencyHistogram::SUB_BUCKETS);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(prometheus_buckets_are_cumulative) {
+    LatencyHistogram histogram;
+    histogram.record(10);               // 低于最小的导出边界
+    histogram.record(1500);             // (2^10, 2^11]
+    histogram.record(1500);
+    histogram.record(3000000);          // (2^21, 2^22]
+    histogram.record(1ULL << 40);       // 超过最大的导出边界
+
+    double sum = 0;
+    boost::uint64_t count = 0;
+    std::map<std::string, boost::uint64_t> buckets = parse_buckets(histogram, sum, count);
+    BOOST_CHECK_EQUAL(count, 5u);
+    BOOST_CHECK_EQUAL(buckets["+Inf"], 5u);
+    // 导出的文本保留6位有效数字
+    BOOST_CHECK_CLOSE(sum, (10 + 1500 + 1500 + 3000000 + static_cast<double>(1ULL << 40)) / 1e9, 1e-3);
+
+    BOOST_CHECK_EQUAL(buckets[bound_label(LatencyHistogram::MIN_EXPORT_BIT)], 1u);
+    BOOST_CHECK_EQUAL(buckets[bound_label(11)], 3u);
+    BOOST_CHECK_EQUAL(buckets[bound_label(21)], 3u);
+    BOOST_CHECK_EQUAL(buckets[bound_label(22)], 4u);
+    BOOST_CHECK_EQUAL(buckets[bound_label(LatencyHistogram::MAX_EXPORT_BIT)], 4u);
+
+    boost::uint64_t previous = 0;
+    for (int bit = LatencyHistogram::MIN_EXPORT_BIT; bit <= LatencyHistogram::MAX_EXPORT_BIT; ++bit) {
+        boost::uint64_t cumulative = buckets[bound_label(bit)];
+        BOOST_CHECK_GE(cumulative, previous);
+        previous = cumulative;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(write_without_labels) {
+    LatencyHistogram histogram;
+    histogram.record(2000);
+    std::ostringstream out;
+    histogram.write(out, "plain", std::string());
+    std::string text = out.str();
+    BOOST_CHECK(text.find("plain_bucket{le=\"+Inf\"} 1\n") != std::string::npos);
+    BOOST_CHECK(text.find("plain_sum 2e-06\n") != std::string::npos);
+    BOOST_CHECK(text.find("plain_count 1\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
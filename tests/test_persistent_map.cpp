@@ -0,0 +1,111 @@
+/**
+ * @file test_persistent_map.cpp
+ * @brief 持久化映射的测试
+ *
+ * 与std::map对照检查插入、查找与遍历；副本之间互不影响：修改一个副本后，
+ * 其他副本（相当于已发布的快照）看到的内容保持不变。
+ */
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "persistent_map.h"
+
+namespace {
+
+/**
+ * @brief 检查映射与参照的std::map内容完全一致
+ */
+void check_equal(const PersistentMap<int>& map, const std::map<std::string, int>& expected) {
+    BOOST_REQUIRE_EQUAL(map.size(), expected.size());
+    BOOST_REQUIRE_EQUAL(map.empty(), expected.empty());
+    for (const auto& entry : expected) {
+        const int* value = map.find(entry.first);
+        BOOST_REQUIRE_MESSAGE(value != nullptr, "missing key " << entry.first);
+        BOOST_REQUIRE_EQUAL(*value, entry.second);
+    }
+
+    std::map<std::string, int> visited;
+    map.for_each([&visited](const std::string& key, int value) {
+        BOOST_REQUIRE(visited.insert(std::make_pair(key, value)).second);
+    });
+    BOOST_REQUIRE(visited == expected);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(persistent_map)
+
+BOOST_AUTO_TEST_CASE(insert_and_find) {
+    PersistentMap<int> map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find("missing") == nullptr);
+
+    std::map<std::string, int> expected;
+    std::mt19937 random(1);
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = "term" + std::to_string(random() % 5000);
+        map[key] += i;
+        expected[key] += i;
+    }
+    map[std::string()] = -1;
+    expected[std::string()] = -1;
+    check_equal(map, expected);
+    BOOST_CHECK(map.find("term5000") == nullptr);
+
+    map.clear();
+    check_equal(map, std::map<std::string, int>());
+}
+
+BOOST_AUTO_TEST_CASE(copies_are_isolated) {
+    PersistentMap<int> map;
+    std::map<std::string, int> expected;
+    for (int i = 0; i < 3000; ++i) {
+        std::string key = "k" + std::to_string(i);
+        map[key] = i;
+        expected[key] = i;
+    }
+
+    // 相当于一系列已发布的快照：每个副本之后继续修改原映射，已有的副本保持不变
+    std::vector<PersistentMap<int>> snapshots;
+    std::vector<std::map<std::string, int>> expected_snapshots;
+    std::mt19937 random(2);
+    for (int round = 0; round < 20; ++round) {
+        snapshots.push_back(map);
+        expected_snapshots.push_back(expected);
+        for (int i = 0; i < 200; ++i) {
+            std::string key = "k" + std::to_string(random() % 4000);
+            map[key] += 1000;
+            expected[key] += 1000;
+        }
+    }
+    check_equal(map, expected);
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        check_equal(snapshots[i], expected_snapshots[i]);
+    }
+
+    // 修改副本同样不影响原映射
+    PersistentMap<int> copy = map;
+    copy["k0"] = -5;
+    copy["new"] = 7;
+    check_equal(map, expected);
+    BOOST_CHECK_EQUAL(*copy.find("k0"), -5);
+    BOOST_CHECK_EQUAL(copy.size(), map.size() + 1);
+}
+
+BOOST_AUTO_TEST_CASE(shared_values_are_copied_on_write) {
+    PersistentMap<std::vector<int>> map;
+    map["list"].push_back(1);
+    PersistentMap<std::vector<int>> copy = map;
+    copy["list"].push_back(2);
+    map["list"].push_back(3);
+
+    BOOST_REQUIRE_EQUAL(map.find("list")->size(), 2u);
+    BOOST_CHECK_EQUAL((*map.find("list"))[1], 3);
+    BOOST_REQUIRE_EQUAL(copy.find("list")->size(), 2u);
+    BOOST_CHECK_EQUAL((*copy.find("list"))[1], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,495 @@
+/**
+ * @file test_posting_list.cpp
+ * @brief 压缩倒排列表的测试
+ *
+ * 块模式（位打包块与变长字节尾部）与位图模式各自做往返测试，覆盖块边界、极大的文档编号差值与词频、
+ * 跳转与块上界，以及位置信息和索引文件的读写；从索引文件读取时，会导致越界访问的结构损坏必须被拒绝。
+ * 参照结果由未压缩的记录数组直接得到。
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "index_file.h"
+#include "posting_list.h"
+#include "test_util.h"
+
+namespace {
+
+/**
+ * 未压缩的参照记录
+ */
+struct Expected {
+    DocId doc;
+    boost::uint32_t tf;
+    boost::uint32_t title_tf;
+    std::vector<boost::uint32_t> positions;
+};
+
+/**
+ * @brief 生成count条升序记录，文档编号差值在[1, max_gap]内，词频在[1, max_tf]内
+ */
+std::vector<Expected> generate(size_t count, boost::uint32_t max_gap, boost::uint32_t max_tf, unsigned int seed,
+                               bool with_positions = false) {
+    std::mt19937 random(seed);
+    std::vector<Expected> postings;
+    DocId doc = 0;
+    for (size_t i = 0; i < count; ++i) {
+        doc += i == 0 ? random() % max_gap : 1 + random() % max_gap;
+        Expected posting;
+        posting.doc = doc;
+        posting.tf = 1 + random() % max_tf;
+        posting.title_tf = random() % (posting.tf + 1);
+        if (with_positions) {
+            boost::uint32_t position = 0;
+            for (boost::uint32_t k = 0; k < posting.tf; ++k) {
+                position += random() % 20 + (k == 0 ? 0 : 1);
+                posting.positions.push_back(position);
+            }
+        }
+        postings.push_back(posting);
+    }
+    return postings;
+}
+
+/**
+ * @brief 参照记录所在文档的长度（词项数）
+ */
+boost::uint32_t doc_length(const Expected& posting) {
+    return 10 + posting.tf % 1000;
+}
+
+/**
+ * @brief 依次追加参照记录
+ */
+void fill(PostingList& list, const std::vector<Expected>& postings) {
+    for (const Expected& posting : postings) {
+        list.append(posting.doc, posting.tf, posting.title_tf, doc_length(posting),
+                    posting.positions.empty() ? nullptr : &posting.positions);
+    }
+}
+
+/**
+ * @brief 检查完整解码与顺序迭代的结果都与参照记录一致
+ */
+void check_equal(const PostingList& list, const std::vector<Expected>& postings) {
+    BOOST_REQUIRE_EQUAL(list.size(), postings.size());
+
+    std::vector<Posting> decoded = list.decode();
+    BOOST_REQUIRE_EQUAL(decoded.size(), postings.size());
+    for (size_t i = 0; i < postings.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(decoded[i].doc, postings[i].doc);
+        BOOST_REQUIRE_EQUAL(decoded[i].tf, postings[i].tf);
+        BOOST_REQUIRE_EQUAL(decoded[i].title_tf, postings[i].title_tf);
+    }
+
+    PostingList::Iterator it = list.iterator();
+    std::vector<boost::uint32_t> positions;
+    for (const Expected& posting : postings) {
+        BOOST_REQUIRE(!it.at_end());
+        BOOST_REQUIRE_EQUAL(it.doc(), posting.doc);
+        BOOST_REQUIRE_EQUAL(it.tf(), posting.tf);
+        BOOST_REQUIRE_EQUAL(it.title_tf(), posting.title_tf);
+        it.positions(positions);
+        BOOST_REQUIRE(positions == posting.positions);
+        it.next();
+    }
+    BOOST_CHECK(it.at_end());
+    BOOST_CHECK_EQUAL(it.doc(), PostingList::END_DOC);
+
+    boost::uint32_t max_tf = 0;
+    for (const Expected& posting : postings) {
+        max_tf = std::max(max_tf, posting.tf);
+    }
+    BOOST_CHECK_EQUAL(list.max_tf(), max_tf);
+}
+
+/**
+ * @brief 用递增的随机目标跳转，检查每次都停在第一个不小于目标的记录上，且块上界不小于该记录的词频
+ */
+void check_advance(const PostingList& list, const std::vector<Expected>& postings, unsigned int seed) {
+    std::mt19937 random(seed);
+    DocId last = postings.empty() ? 0 : postings.back().doc;
+    PostingList::Iterator it = list.iterator();
+    DocId target = 0;
+    while (true) {
+        size_t expected = std::lower_bound(postings.begin(), postings.end(), target,
+                                           [](const Expected& p, DocId d) { return p.doc < d; }) - postings.begin();
+
+        boost::uint32_t max_tf = 0;
+        boost::uint32_t min_len = 0;
+        DocId block_last = it.block_bounds(target, max_tf, min_len);
+        it.advance(target);
+        if (expected == postings.size()) {
+            BOOST_REQUIRE(it.at_end());
+            BOOST_CHECK_EQUAL(block_last, PostingList::END_DOC);
+            break;
+        }
+        BOOST_REQUIRE_EQUAL(it.doc(), postings[expected].doc);
+        BOOST_REQUIRE_EQUAL(it.tf(), postings[expected].tf);
+        BOOST_REQUIRE(block_last >= it.doc());
+        BOOST_REQUIRE(max_tf >= it.tf());
+        BOOST_REQUIRE(min_len <= doc_length(postings[expected]));
+
+        boost::uint64_t next = static_cast<boost::uint64_t>(it.doc()) + 1 + random() % 300;
+        target = static_cast<DocId>(std::min<boost::uint64_t>(next, static_cast<boost::uint64_t>(last) + 1));
+    }
+}
+
+/**
+ * 单个倒排列表写入索引文件后的正文副本，可以在读取前篡改
+ *
+ * 正文依次是4个单字节字段、11个32位字段（记录数、最后文档编号……完整块数、数据与位置的字节数），
+ * 随后是每块20字节的跳表（最后文档编号、数据偏移、最大词频、最短长度、位置偏移）、数据与位置数组。
+ */
+class SerializedList
+{
+public:
+    static const size_t TF_BITS = 1;
+    static const size_t SIZE = 4;
+    static const size_t LAST_DOC = 8;
+    static const size_t TAIL_OFFSET = 28;
+    static const size_t TAIL_POS_OFFSET = 32;
+    static const size_t BLOCK_COUNT = 36;
+    static const size_t DATA_SIZE = 40;
+    static const size_t POSITIONS_SIZE = 44;
+    static const size_t BLOCKS = 48;
+    static const size_t BLOCK_INFO_SIZE = 20;
+
+    explicit SerializedList(const PostingList& list) {
+        TempDirectory directory;
+        std::string path = directory.file("list.idx");
+        {
+            IndexFileWriter writer(path);
+            list.write(writer);
+            writer.finish(IndexFileInfo());
+        }
+        MappedIndexFile file(path);
+        size_ = file.body_size();
+        words_.resize(size_ / sizeof(boost::uint64_t) + 1);
+        std::memcpy(bytes(), file.body(), size_);
+    }
+
+    size_t size() const { return size_; }
+    boost::uint8_t* bytes() { return reinterpret_cast<boost::uint8_t*>(&words_[0]); }
+
+    boost::uint32_t u32(size_t offset) {
+        boost::uint32_t value;
+        std::memcpy(&value, bytes() + offset, sizeof(value));
+        return value;
+    }
+
+    void set_u32(size_t offset, boost::uint32_t value) { std::memcpy(bytes() + offset, &value, sizeof(value)); }
+
+    // 第block块跳表中第field个字段（0为最后文档编号，1为数据偏移，4为位置偏移）的偏移
+    static size_t block_field(size_t block, size_t field) { return BLOCKS + block * BLOCK_INFO_SIZE + field * 4; }
+
+    size_t data_offset() { return BLOCKS + u32(BLOCK_COUNT) * BLOCK_INFO_SIZE; }
+    size_t positions_offset() { return data_offset() + u32(DATA_SIZE); }
+
+    // 读取为列表，列表引用本对象中的数据
+    void read(PostingList& list) {
+        IndexFileReader reader(bytes(), size_);
+        list.read(reader);
+    }
+
+private:
+    std::vector<boost::uint64_t> words_;
+    size_t size_;
+};
+
+/**
+ * @brief 对副本做一处篡改，检查读取时被拒绝
+ */
+template <typename Mutation>
+void check_rejected(const SerializedList& original, Mutation mutate) {
+    SerializedList copy = original;
+    mutate(copy);
+    PostingList list;
+    BOOST_CHECK_THROW(copy.read(list), std::runtime_error);
+}
+
+/**
+ * @brief 读取后完整地遍历列表：解码、读取位置并跳转，只要求不越界访问
+ */
+void exercise(const PostingList& list, unsigned int seed) {
+    list.decode();
+    std::vector<boost::uint32_t> positions;
+    for (PostingList::Iterator it = list.iterator(); !it.at_end(); it.next()) {
+        it.positions(positions);
+    }
+    std::mt19937 random(seed);
+    PostingList::Iterator it = list.iterator();
+    boost::uint32_t max_tf = 0;
+    boost::uint32_t min_len = 0;
+    while (!it.at_end()) {
+        DocId target = it.doc() + 1 + random() % 500;
+        it.block_bounds(target, max_tf, min_len);
+        it.advance(target);
+        it.positions(positions);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(posting_list)
+
+BOOST_AUTO_TEST_CASE(empty_list) {
+    PostingList list;
+    BOOST_CHECK(list.empty());
+    BOOST_CHECK(list.decode().empty());
+    BOOST_CHECK(list.iterator().at_end());
+
+    list.optimize();
+    BOOST_CHECK(list.iterator().at_end());
+    BOOST_CHECK(!list.has_positions());
+}
+
+BOOST_AUTO_TEST_CASE(block_round_trip_at_block_boundaries) {
+    const size_t sizes[] = {1, 2, PostingList::BLOCK_SIZE - 1, PostingList::BLOCK_SIZE, PostingList::BLOCK_SIZE + 1,
+                            2 * PostingList::BLOCK_SIZE, 1000};
+    for (size_t size : sizes) {
+        BOOST_TEST_CONTEXT("size " << size) {
+            std::vector<Expected> postings = generate(size, 1000, 50, static_cast<unsigned int>(size));
+            PostingList list;
+            fill(list, postings);
+            check_equal(list, postings);
+            check_advance(list, postings, 1);
+
+            list.optimize();
+            BOOST_CHECK_EQUAL(list.representation(), PostingList::BLOCKS);
+            check_equal(list, postings);
+            check_advance(list, postings, 2);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(extreme_gaps_and_frequencies) {
+    std::vector<Expected> postings;
+    const DocId docs[] = {0, 1, 2, 1000, 70000, 0x7FFFFFFFu, 0xFFFFFFF0u, PostingList::END_DOC - 1};
+    const boost::uint32_t tfs[] = {1, 0xFFFFu, 2, 0x7FFFFFFFu, 1, 3, 0xFFFFFFFFu, 1};
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        Expected posting;
+        posting.doc = docs[i];
+        posting.tf = tfs[i];
+        posting.title_tf = tfs[i] / 2;
+        postings.push_back(posting);
+    }
+    // 足够多的记录使前面的记录被封存为位打包块
+    for (size_t i = 0; i < PostingList::BLOCK_SIZE; ++i) {
+        postings.insert(postings.begin() + 3 + i, postings[2]);
+        postings[3 + i].doc = static_cast<DocId>(3 + i);
+        postings[3 + i].tf = static_cast<boost::uint32_t>(i % 7 == 0 ? 0x10000u + i : 1 + i);
+    }
+
+    PostingList list;
+    fill(list, postings);
+    list.optimize();
+    BOOST_CHECK_EQUAL(list.representation(), PostingList::BLOCKS);
+    check_equal(list, postings);
+    check_advance(list, postings, 3);
+}
+
+BOOST_AUTO_TEST_CASE(dense_list_uses_bitmap) {
+    std::vector<Expected> postings = generate(5000, 2, 3, 7);
+    PostingList list;
+    fill(list, postings);
+    list.optimize();
+    BOOST_CHECK_EQUAL(list.representation(), PostingList::BITMAP);
+    check_equal(list, postings);
+    check_advance(list, postings, 4);
+
+    // 位图模式的列表可以继续追加，追加后与完整的参照记录一致
+    std::vector<Expected> more = generate(300, 2, 3, 8);
+    for (Expected& posting : more) {
+        posting.doc += postings.back().doc + 1;
+    }
+    fill(list, more);
+    postings.insert(postings.end(), more.begin(), more.end());
+    check_equal(list, postings);
+    list.optimize();
+    check_equal(list, postings);
+    check_advance(list, postings, 5);
+}
+
+BOOST_AUTO_TEST_CASE(sparse_list_stays_in_blocks) {
+    std::vector<Expected> postings = generate(600, 5000, 4, 9);
+    PostingList list;
+    fill(list, postings);
+    list.optimize();
+    BOOST_CHECK_EQUAL(list.representation(), PostingList::BLOCKS);
+    check_equal(list, postings);
+}
+
+BOOST_AUTO_TEST_CASE(positions_round_trip) {
+    std::vector<Expected> sparse = generate(700, 400, 6, 10, true);
+    PostingList blocks;
+    fill(blocks, sparse);
+    BOOST_CHECK(blocks.has_positions());
+    check_equal(blocks, sparse);
+    blocks.optimize();
+    BOOST_CHECK_EQUAL(blocks.representation(), PostingList::BLOCKS);
+    check_equal(blocks, sparse);
+
+    std::vector<Expected> dense = generate(3000, 2, 3, 11, true);
+    PostingList bitmap;
+    fill(bitmap, dense);
+    bitmap.optimize();
+    BOOST_CHECK_EQUAL(bitmap.representation(), PostingList::BITMAP);
+    check_equal(bitmap, dense);
+
+    // 跳转后读取的位置属于跳转到的记录
+    PostingList::Iterator it = bitmap.iterator();
+    std::vector<boost::uint32_t> positions;
+    for (size_t i = 0; i < dense.size(); i += 257) {
+        it.advance(dense[i].doc);
+        BOOST_REQUIRE_EQUAL(it.doc(), dense[i].doc);
+        it.positions(positions);
+        BOOST_REQUIRE(positions == dense[i].positions);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(index_file_round_trip) {
+    TempDirectory directory;
+    std::string path = directory.file("postings.idx");
+
+    std::vector<Expected> sparse = generate(900, 300, 20, 12, true);
+    std::vector<Expected> dense = generate(4000, 2, 2, 13);
+    std::vector<Expected> tail = generate(50, 10, 5, 14);
+    {
+        PostingList lists[3];
+        fill(lists[0], sparse);
+        fill(lists[1], dense);
+        fill(lists[2], tail);
+        lists[0].optimize();
+        lists[1].optimize();
+
+        IndexFileWriter writer(path);
+        for (const PostingList& list : lists) {
+            list.write(writer);
+        }
+        writer.finish(IndexFileInfo());
+    }
+
+    MappedIndexFile file(path, true);
+    IndexFileReader reader(file.body(), file.body_size());
+    PostingList lists[3];
+    for (PostingList& list : lists) {
+        list.read(reader);
+    }
+    BOOST_CHECK(reader.at_end());
+    BOOST_CHECK_EQUAL(lists[1].representation(), PostingList::BITMAP);
+    check_equal(lists[0], sparse);
+    check_equal(lists[1], dense);
+    check_equal(lists[2], tail);
+    check_advance(lists[0], sparse, 15);
+    check_advance(lists[1], dense, 16);
+
+    // 映射的列表被修改时先复制为自有存储，映射中的数据不受影响
+    std::vector<Expected> more = generate(200, 10, 5, 17);
+    for (Expected& posting : more) {
+        posting.doc += tail.back().doc + 1;
+    }
+    fill(lists[2], more);
+    std::vector<Expected> appended = tail;
+    appended.insert(appended.end(), more.begin(), more.end());
+    check_equal(lists[2], appended);
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_corrupted_blocks) {
+    // 5个完整块与60条尾部记录，带位置
+    std::vector<Expected> postings = generate(700, 400, 6, 20, true);
+    PostingList list;
+    fill(list, postings);
+    SerializedList body(list);
+    {
+        SerializedList copy = body;
+        PostingList read;
+        copy.read(read);
+        check_equal(read, postings);
+    }
+
+    typedef SerializedList L;
+    check_rejected(body, [](L& b) { b.set_u32(L::BLOCK_COUNT, 6); });
+    check_rejected(body, [](L& b) { b.set_u32(L::SIZE, 700 + PostingList::BLOCK_SIZE); });
+    check_rejected(body, [](L& b) { b.set_u32(L::TAIL_OFFSET, b.u32(L::DATA_SIZE) + 1); });
+    check_rejected(body, [](L& b) { b.set_u32(L::block_field(1, 1), b.u32(L::block_field(2, 1))); });
+    check_rejected(body, [](L& b) { b.set_u32(L::block_field(4, 1), 0xFFFFFFF0u); });
+    check_rejected(body, [](L& b) { b.set_u32(L::block_field(3, 0), b.u32(L::block_field(2, 0))); });
+    check_rejected(body, [](L& b) { b.set_u32(L::block_field(1, 4), b.u32(L::POSITIONS_SIZE) + 1); });
+    check_rejected(body, [](L& b) { b.set_u32(L::TAIL_POS_OFFSET, b.u32(L::POSITIONS_SIZE) + 1); });
+
+    // 块头的位宽超过32，或与块数据的长度不符
+    check_rejected(body, [](L& b) { b.bytes()[b.data_offset() + b.u32(L::block_field(0, 1))] = 33; });
+    check_rejected(body, [](L& b) { b.bytes()[b.data_offset() + b.u32(L::block_field(2, 1)) + 1] = 31; });
+
+    // 尾部的变长整数越过数据末尾，位置数据的最后一个字节不是整数的结尾
+    check_rejected(body, [](L& b) {
+        size_t tail = b.data_offset() + b.u32(L::TAIL_OFFSET);
+        std::memset(b.bytes() + tail, 0xFF, b.positions_offset() - tail);
+    });
+    check_rejected(body, [](L& b) { b.bytes()[b.positions_offset() + b.u32(L::POSITIONS_SIZE) - 1] |= 0x80; });
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_corrupted_bitmap) {
+    std::vector<Expected> postings = generate(3000, 2, 3, 21, true);
+    PostingList list;
+    fill(list, postings);
+    list.optimize();
+    BOOST_REQUIRE_EQUAL(list.representation(), PostingList::BITMAP);
+    SerializedList body(list);
+    {
+        SerializedList copy = body;
+        PostingList read;
+        copy.read(read);
+        check_equal(read, postings);
+    }
+
+    typedef SerializedList L;
+    check_rejected(body, [](L& b) { b.set_u32(L::LAST_DOC, 0xFFFFFF00u); });
+    check_rejected(body, [](L& b) { b.set_u32(L::LAST_DOC, PostingList::END_DOC); });
+    check_rejected(body, [](L& b) { b.bytes()[L::TF_BITS] = 33; });
+    check_rejected(body, [](L& b) { b.set_u32(L::SIZE, b.u32(L::SIZE) + 1); });
+
+    // 位图的置位数与记录数不符
+    check_rejected(body, [](L& b) {
+        boost::uint8_t& first = b.bytes()[b.data_offset()];
+        first = first == 0 ? 1 : first & (first - 1);
+    });
+
+    // 位置偏移表在数据末尾，每组一个32位偏移
+    check_rejected(body, [](L& b) {
+        size_t table = b.positions_offset() - (3000 + PostingList::BLOCK_SIZE - 1) / PostingList::BLOCK_SIZE * 4;
+        b.set_u32(table + 4, b.u32(L::POSITIONS_SIZE) + 1);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(random_corruption_is_rejected_or_harmless) {
+    PostingList lists[2];
+    fill(lists[0], generate(700, 400, 6, 22, true));
+    fill(lists[1], generate(3000, 2, 3, 23, true));
+    lists[1].optimize();
+
+    std::mt19937 random(24);
+    for (const PostingList& original : lists) {
+        SerializedList body(original);
+        for (int round = 0; round < 3000; ++round) {
+            SerializedList copy = body;
+            size_t offset = random() % copy.size();
+            copy.bytes()[offset] = static_cast<boost::uint8_t>(random());
+            PostingList list;
+            try {
+                copy.read(list);
+            }
+            catch (const std::runtime_error&) {
+                continue;
+            }
+            exercise(list, round);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+/**
+ * @file test_query_cache.cpp
+ * @brief 查询结果缓存的测试
+ *
+ * 版本号不一致的条目在读取时失效并被丢弃；同一分片内按字节数限容，超出时淘汰最久未使用的条目，
+ * 超过分片容量的条目不缓存；统计信息与估算的内存占用与实际条目一致。
+ */
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "query_cache.h"
+
+namespace {
+
+typedef QueryCache<std::string> StringCache;
+
+// 测试条目的估算字节数：值的字节数加上键的两份拷贝与条目开销（与QueryCache::put的估算一致）
+const size_t ENTRY_BYTES = 200;
+const size_t KEY_LENGTH = 5;
+const size_t VALUE_BYTES = ENTRY_BYTES - KEY_LENGTH * 2 - 96;
+
+/**
+ * @brief 选出count个落在同一分片上的等长键，使淘汰顺序只取决于LRU
+ */
+std::vector<std::string> same_shard_keys(size_t count) {
+    std::vector<std::string> keys;
+    size_t shard = StringCache::SHARD_COUNT;
+    for (int i = 0; keys.size() < count; ++i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "q%04d", i);
+        size_t key_shard = std::hash<std::string>()(key) % StringCache::SHARD_COUNT;
+        if (shard == StringCache::SHARD_COUNT) {
+            shard = key_shard;
+        }
+        if (key_shard == shard) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+/**
+ * @brief 每个分片恰好容纳entries个测试条目的缓存容量
+ */
+size_t capacity_for(size_t entries) {
+    return entries * ENTRY_BYTES * StringCache::SHARD_COUNT;
+}
+
+/**
+ * @brief 读取键，命中时返回值，未命中时返回空串
+ */
+std::string lookup(StringCache& cache, const std::string& key, boost::uint64_t epoch) {
+    std::string value;
+    return cache.get(key, epoch, value) ? value : std::string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(query_cache)
+
+BOOST_AUTO_TEST_CASE(hits_and_misses) {
+    StringCache cache(capacity_for(4));
+    std::vector<std::string> keys = same_shard_keys(2);
+    std::string value;
+    BOOST_CHECK(!cache.get(keys[0], 1, value));
+
+    cache.put(keys[0], 1, "first", VALUE_BYTES);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "first");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[1], 1), "");
+
+    CacheStats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+    BOOST_CHECK_EQUAL(stats.misses, 2u);
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK_EQUAL(stats.memory_bytes, ENTRY_BYTES);
+    BOOST_CHECK_EQUAL(stats.capacity_bytes, capacity_for(4));
+    BOOST_CHECK_CLOSE(stats.hit_ratio(), 1.0 / 3, 1e-9);
+
+    // 同一个键再次写入时替换旧值，占用不重复计算
+    cache.put(keys[0], 1, "second", VALUE_BYTES);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "second");
+    BOOST_CHECK_EQUAL(cache.stats().entries, 1u);
+    BOOST_CHECK_EQUAL(cache.stats().memory_bytes, ENTRY_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(epoch_change_invalidates_entries) {
+    StringCache cache(capacity_for(4));
+    std::vector<std::string> keys = same_shard_keys(2);
+    cache.put(keys[0], 1, "old", VALUE_BYTES);
+    cache.put(keys[1], 1, "kept", VALUE_BYTES);
+
+    // 版本不一致的条目视为未命中并被丢弃，回到旧版本也不会再命中
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 2), "");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "");
+    CacheStats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.invalidations, 1u);
+    BOOST_CHECK_EQUAL(stats.misses, 2u);
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK_EQUAL(stats.memory_bytes, ENTRY_BYTES);
+
+    // 按新版本写入后正常命中
+    cache.put(keys[0], 2, "new", VALUE_BYTES);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 2), "new");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[1], 1), "kept");
+}
+
+BOOST_AUTO_TEST_CASE(least_recently_used_entry_is_evicted) {
+    StringCache cache(capacity_for(3));
+    std::vector<std::string> keys = same_shard_keys(5);
+    cache.put(keys[0], 1, "v0", VALUE_BYTES);
+    cache.put(keys[1], 1, "v1", VALUE_BYTES);
+    cache.put(keys[2], 1, "v2", VALUE_BYTES);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 0u);
+
+    // 读取使keys[0]成为最近使用的条目，写入第4个条目时淘汰keys[1]
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "v0");
+    cache.put(keys[3], 1, "v3", VALUE_BYTES);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 1u);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[1], 1), "");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "v0");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[2], 1), "v2");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[3], 1), "v3");
+
+    // 较大的条目淘汰足够多的旧条目
+    cache.put(keys[4], 1, "big", VALUE_BYTES + ENTRY_BYTES);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 3u);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[4], 1), "big");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[3], 1), "v3");
+    BOOST_CHECK_EQUAL(cache.stats().entries, 2u);
+    BOOST_CHECK_EQUAL(cache.stats().memory_bytes, 3 * ENTRY_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(oversized_entries_are_not_cached) {
+    StringCache cache(capacity_for(2));
+    std::vector<std::string> keys = same_shard_keys(2);
+    cache.put(keys[0], 1, "small", VALUE_BYTES);
+
+    // 超过分片容量的条目不缓存，也不淘汰已有条目；同键的旧值被移除
+    cache.put(keys[1], 1, "huge", 3 * ENTRY_BYTES);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[1], 1), "");
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "small");
+    cache.put(keys[0], 1, "huge", 3 * ENTRY_BYTES);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "");
+    BOOST_CHECK_EQUAL(cache.stats().entries, 0u);
+    BOOST_CHECK_EQUAL(cache.stats().memory_bytes, 0u);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 0u);
+
+    // 容量为0时什么都不缓存
+    StringCache disabled(0);
+    disabled.put(keys[0], 1, "value", 0);
+    BOOST_CHECK_EQUAL(lookup(disabled, keys[0], 1), "");
+}
+
+BOOST_AUTO_TEST_CASE(clear_drops_entries_and_keeps_counters) {
+    StringCache cache(capacity_for(4));
+    std::vector<std::string> keys = same_shard_keys(3);
+    for (const std::string& key : keys) {
+        cache.put(key, 1, key, VALUE_BYTES);
+    }
+    BOOST_CHECK_EQUAL(lookup(cache, keys[2], 1), keys[2]);
+    BOOST_CHECK_EQUAL(cache.stats().memory_bytes, 3 * ENTRY_BYTES);
+
+    cache.clear();
+    CacheStats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.entries, 0u);
+    BOOST_CHECK_EQUAL(stats.memory_bytes, 0u);
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+    BOOST_CHECK_EQUAL(lookup(cache, keys[0], 1), "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+/**
+ * @file test_query_parser.cpp
+ * @brief 查询解析器的测试
+ *
+ * 通过规范化字符串检查布尔运算符、+/-前缀、短语、模糊匹配与字段限定的解析结果，
+ * 并检查宽松解析对不完整输入的处理，以及打分用的词项统计。
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "query_parser.h"
+
+namespace {
+
+/**
+ * @brief 解析查询并返回规范化字符串
+ */
+std::string parse(const std::string& query) {
+    QueryParser parser;
+    return parser.parse(query)->to_string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(query_parser)
+
+BOOST_AUTO_TEST_CASE(boolean_operators) {
+    BOOST_CHECK_EQUAL(parse("boost asio"), "(boost asio)");
+    BOOST_CHECK_EQUAL(parse("Boost AND Asio"), "(+boost +asio)");
+    BOOST_CHECK_EQUAL(parse("boost AND asio thread"), "(+boost +asio thread)");
+    BOOST_CHECK_EQUAL(parse("boost OR asio"), "(boost asio)");
+    BOOST_CHECK_EQUAL(parse("boost && asio || thread"), "(+boost +asio thread)");
+    BOOST_CHECK_EQUAL(parse("+boost -asio"), "(+boost -asio)");
+    BOOST_CHECK_EQUAL(parse("NOT boost asio"), "(-boost asio)");
+    BOOST_CHECK_EQUAL(parse("+(boost asio)"), "(+(boost asio))");
+    BOOST_CHECK_EQUAL(parse("-(boost asio)"), "(-(boost asio))");
+
+    // 小写的and/or/not是普通查询词（and、or、not是停用词，被丢弃）
+    BOOST_CHECK_EQUAL(parse("boost and asio"), "(boost asio)");
+
+    // 与正文之间有空格的+/-按普通字符处理
+    BOOST_CHECK_EQUAL(parse("+ boost"), "(boost)");
+}
+
+BOOST_AUTO_TEST_CASE(boolean_tree_structure) {
+    QueryParser parser;
+    QueryNodePtr root = parser.parse("boost AND (asio OR thread) -regex");
+    BOOST_REQUIRE_EQUAL(root->type, QueryNode::BOOLEAN);
+    BOOST_REQUIRE_EQUAL(root->clauses.size(), 3u);
+    BOOST_CHECK_EQUAL(root->clauses[0].occur, QueryClause::MUST);
+    BOOST_CHECK_EQUAL(root->clauses[0].node->type, QueryNode::TERM);
+    BOOST_CHECK_EQUAL(root->clauses[1].occur, QueryClause::MUST);
+    BOOST_REQUIRE_EQUAL(root->clauses[1].node->type, QueryNode::BOOLEAN);
+    BOOST_CHECK_EQUAL(root->clauses[1].node->clauses.size(), 2u);
+    BOOST_CHECK_EQUAL(root->clauses[2].occur, QueryClause::MUST_NOT);
+    BOOST_CHECK(!root->is_disjunction());
+
+    BOOST_CHECK(parser.parse("boost asio thread")->is_disjunction());
+
+    // 排除的词项不参与打分，重复的词项累计次数
+    std::map<std::string, double> counts;
+    parser.parse("boost boost asio -regex")->collect_terms(counts);
+    BOOST_CHECK_EQUAL(counts.size(), 2u);
+    BOOST_CHECK_EQUAL(counts["boost"], 2.0);
+    BOOST_CHECK_EQUAL(counts["asio"], 1.0);
+    BOOST_CHECK(counts.find("regex") == counts.end());
+}
+
+BOOST_AUTO_TEST_CASE(phrases) {
+    QueryParser parser;
+    QueryNodePtr root = parser.parse("\"boost asio\"");
+    BOOST_REQUIRE_EQUAL(root->clauses.size(), 1u);
+    const QueryNode& phrase = *root->clauses[0].node;
+    BOOST_CHECK_EQUAL(phrase.type, QueryNode::PHRASE);
+    BOOST_REQUIRE_EQUAL(phrase.terms.size(), 2u);
+    BOOST_CHECK_EQUAL(phrase.terms[0], "boost");
+    BOOST_CHECK_EQUAL(phrase.terms[1], "asio");
+    BOOST_CHECK_EQUAL(phrase.positions[0], 0u);
+    BOOST_CHECK_EQUAL(phrase.positions[1], 1u);
+
+    // 停用词仍然占据位置，首尾的停用词不计入相对位置
+    BOOST_CHECK_EQUAL(parse("\"the boost of asio\""), "(\"boost asio@2\")");
+
+    // 未闭合的引号延伸到查询末尾；短语内的~不表示模糊匹配
+    BOOST_CHECK_EQUAL(parse("\"unclosed phrase"), "(\"unclosed phrase\")");
+    BOOST_CHECK_EQUAL(parse("\"asio~\""), "(\"asio\")");
+
+    // 只有停用词的短语被丢弃
+    BOOST_CHECK_EQUAL(parse("\"the of\" boost"), "(boost)");
+}
+
+BOOST_AUTO_TEST_CASE(fuzzy_terms) {
+    QueryParser parser;
+    QueryNodePtr root = parser.parse("asio~1");
+    BOOST_REQUIRE_EQUAL(root->clauses.size(), 1u);
+    BOOST_CHECK_EQUAL(root->clauses[0].node->max_edits, 1u);
+    BOOST_CHECK_EQUAL(root->clauses[0].node->terms[0], "asio");
+
+    // 省略编辑距离时按词长选择，超过上限时取上限
+    BOOST_CHECK_EQUAL(parse("asio~"), "(asio~1)");
+    BOOST_CHECK_EQUAL(parse("networking~"), "(networking~2)");
+    BOOST_CHECK_EQUAL(parse("asio~5"), "(asio~2)");
+    BOOST_CHECK_EQUAL(parse("BOOST~2"), "(boost~2)");
+
+    // 过短的词不做模糊匹配；~0表示精确匹配
+    BOOST_CHECK_EQUAL(parse("ab~"), "(ab)");
+    BOOST_CHECK_EQUAL(parse("asio~0"), "(asio)");
+
+    // 不以英文字母开头的词项不支持模糊匹配
+    BOOST_CHECK_EQUAL(parse("2048~"), "(2048)");
+    BOOST_CHECK_EQUAL(root->clauses[0].node->boost, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(field_prefixes) {
+    BOOST_CHECK_EQUAL(parse("title:boost"), "(title:boost)");
+    BOOST_CHECK_EQUAL(parse("title: boost"), "(title:boost)");
+    BOOST_CHECK_EQUAL(parse("title:\"boost asio\""), "(\"title:boost title:asio\")");
+    BOOST_CHECK_EQUAL(parse("title:(boost asio) thread"), "((title:boost title:asio) thread)");
+    BOOST_CHECK_EQUAL(parse("title:asio~"), "(title:asio~1)");
+
+    // 不是已知字段名的冒号按普通字符处理
+    BOOST_CHECK_EQUAL(parse("foo:bar"), "([foo bar])");
+}
+
+BOOST_AUTO_TEST_CASE(lenient_parsing) {
+    BOOST_CHECK_EQUAL(parse(""), "()");
+    BOOST_CHECK_EQUAL(parse("the"), "()");
+    BOOST_CHECK_EQUAL(parse("(the)"), "()");
+    BOOST_CHECK_EQUAL(parse("AND"), "()");
+    BOOST_CHECK_EQUAL(parse("-"), "()");
+    BOOST_CHECK_EQUAL(parse("boost AND"), "(+boost)");
+    BOOST_CHECK_EQUAL(parse("(boost (asio)) )) thread ("), "((boost asio) thread)");
+    BOOST_CHECK_EQUAL(parse(")))"), "()");
+    BOOST_CHECK_EQUAL(parse("((((boost"), "(boost)");
+}
+
+BOOST_AUTO_TEST_CASE(chinese_terms) {
+    // 中文按与索引相同的方式切分为n元组，同一个查询词的全部词项都必须命中
+    BOOST_CHECK_EQUAL(parse("中文搜索"), "([中文 中文搜 中文搜索 文 文搜 文搜索 搜 搜索 索])");
+
+    std::vector<std::string> keys;
+    QueryParser parser;
+    parser.parse("中文搜索 boost")->collect_key_terms(keys);
+    BOOST_REQUIRE_EQUAL(keys.size(), 2u);
+    BOOST_CHECK_EQUAL(keys[0], "中文搜索");
+    BOOST_CHECK_EQUAL(keys[1], "boost");
+}
+
+BOOST_AUTO_TEST_CASE(equivalent_queries_share_canonical_form) {
+    BOOST_CHECK_EQUAL(parse("Boost   ASIO"), parse("boost asio"));
+    BOOST_CHECK_EQUAL(parse("boost OR asio"), parse("boost asio"));
+    BOOST_CHECK_EQUAL(parse("(boost)"), parse("boost"));
+    BOOST_CHECK(parse("boost AND asio") != parse("boost asio"));
+    BOOST_CHECK(parse("\"boost asio\"") != parse("\"asio boost\""));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
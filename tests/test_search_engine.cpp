@@ -0,0 +1,328 @@
+/**
+ * @file test_search_engine.cpp
+ * @brief 搜索引擎的测试
+ *
+ * 覆盖快照与段合并的一致性：分段方式与分片数不影响查询结果，建立索引后分数也与一次写入的结果一致，
+ * 批量查询与逐个查询的结果相同；删除与更新的墓碑语义，墓碑不影响文档频率，合并时丢弃墓碑回收空间；
+ * 以及索引文件的保存与加载。语料按固定种子生成，结果可以重现。
+ */
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "search_engine.h"
+#include "test_util.h"
+
+namespace {
+
+// 合成语料的词汇，按序号越小出现越频繁
+const char* const WORDS[] = {"boost",   "asio",    "thread",  "socket", "buffer",  "strand",  "timer",   "signal",
+                             "regex",   "spirit",  "fusion",  "graph",  "python",  "filesystem", "locale", "format",
+                             "variant", "optional", "any",    "tuple",  "bimap",   "heap",    "intrusive", "mpl",
+                             "hana",    "beast",   "json",    "url",    "process", "stacktrace", "chrono", "atomic"};
+const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+// 覆盖单词、多词、必选/排除、短语、字段与模糊匹配的查询
+const char* const QUERIES[] = {"boost",         "asio socket",      "timer AND strand", "+regex -spirit",
+                               "\"boost asio\"", "title:thread",     "graph OR heap",    "beast~",
+                               "unique7",        "json url process", "filesystm~"};
+
+/**
+ * @brief 按固定种子生成count篇文档，ID为doc<序号>，每篇含有一个只属于它的词unique<序号>
+ */
+std::vector<Document> corpus(size_t count, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::vector<Document> documents;
+    for (size_t i = 0; i < count; ++i) {
+        std::string title = std::string(WORDS[random() % 8]) + " " + WORDS[random() % WORD_COUNT];
+        std::string content;
+        size_t words = 5 + random() % 40;
+        for (size_t w = 0; w < words; ++w) {
+            // 两个均匀数取小，使靠前的词更常见
+            size_t index = std::min(random() % WORD_COUNT, random() % WORD_COUNT);
+            content += WORDS[index];
+            content += ' ';
+        }
+        content += "unique" + std::to_string(i);
+        std::string id = "doc" + std::to_string(i);
+        documents.push_back(Document(id, title, content, id + ".txt"));
+    }
+    return documents;
+}
+
+/**
+ * @brief 不带缓存的索引选项，shards为分片数
+ *
+ * 关闭未知词项的模糊展开：被删除文档独有的词项在合并后从词典中消失，展开会匹配到相邻的编号。
+ */
+IndexOptions options(size_t shards) {
+    IndexOptions result;
+    result.cache_bytes = 0;
+    result.fuzzy_unknown_terms = false;
+    result.shards = shards;
+    result.build_threads = 2;
+    return result;
+}
+
+/**
+ * @brief 查询的全部命中：文档ID -> 分数
+ */
+std::map<std::string, double> hits(SearchEngine& engine, const std::string& query) {
+    std::map<std::string, double> result;
+    std::vector<SearchResult> results = engine.search(query, 100000);
+    for (const SearchResult& hit : results) {
+        BOOST_REQUIRE_MESSAGE(result.insert(std::make_pair(hit.url, hit.score)).second,
+                              "duplicate hit " << hit.url << " for " << query);
+    }
+    return result;
+}
+
+/**
+ * @brief 检查两个引擎对每个查询的命中集合相同；with_scores为true时分数也必须一致
+ */
+void check_same_results(SearchEngine& expected, SearchEngine& actual, bool with_scores) {
+    for (const char* query : QUERIES) {
+        BOOST_TEST_CONTEXT("query " << query) {
+            std::map<std::string, double> want = hits(expected, query);
+            std::map<std::string, double> got = hits(actual, query);
+            BOOST_REQUIRE_EQUAL(got.size(), want.size());
+            for (const auto& hit : want) {
+                auto found = got.find(hit.first);
+                BOOST_REQUIRE_MESSAGE(found != got.end(), "missing hit " << hit.first);
+                if (with_scores) {
+                    BOOST_REQUIRE_CLOSE(found->second, hit.second, 1e-6);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(search_engine)
+
+BOOST_AUTO_TEST_CASE(segmentation_does_not_change_results) {
+    std::vector<Document> documents = corpus(1500, 1);
+
+    // 一次写入后建立索引
+    SearchEngine bulk(options(1));
+    bulk.add_documents(documents);
+    bulk.build_index();
+    BOOST_CHECK_EQUAL(bulk.segment_count(), 1u);
+    BOOST_CHECK_EQUAL(bulk.document_count(), documents.size());
+    BOOST_CHECK(!hits(bulk, "boost").empty());
+    BOOST_CHECK_EQUAL(hits(bulk, "unique7").size(), 1u);
+
+    // 分小批写入：缓冲段多次封存，后台按层级合并，查询看到的始终是完整发布的快照
+    SearchEngine incremental(options(1));
+    for (size_t start = 0; start < documents.size(); start += 97) {
+        size_t end = std::min(start + 97, documents.size());
+        incremental.add_documents(std::vector<Document>(documents.begin() + start, documents.begin() + end));
+        BOOST_REQUIRE_EQUAL(incremental.document_count(), end);
+        BOOST_REQUIRE_EQUAL(hits(incremental, "unique" + std::to_string(end - 1)).size(), 1u);
+    }
+    BOOST_CHECK_GT(incremental.segment_count(), 1u);
+    check_same_results(bulk, incremental, false);
+
+    // 建立索引后按同样的集合统计打分，分数与一次写入的结果一致
+    incremental.build_index();
+    BOOST_CHECK_EQUAL(incremental.segment_count(), 1u);
+    check_same_results(bulk, incremental, true);
+
+    // 多个分片并行求值，合并后的结果与单个分片相同
+    SearchEngine sharded(options(3));
+    sharded.add_documents(documents);
+    sharded.build_index();
+    // 段不会被拆分，后台先合并了较多的段时分片数可能少于3
+    BOOST_CHECK_GT(sharded.segment_count(), 1u);
+    BOOST_CHECK_LE(sharded.segment_count(), 3u);
+    check_same_results(bulk, sharded, true);
+
+    // 批量查询与逐个查询的结果相同
+    std::vector<std::string> queries(QUERIES, QUERIES + sizeof(QUERIES) / sizeof(QUERIES[0]));
+    std::vector<std::vector<SearchResult>> batch = sharded.search_batch(queries, 20);
+    BOOST_REQUIRE_EQUAL(batch.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        std::vector<SearchResult> single = sharded.search(queries[i], 20);
+        BOOST_REQUIRE_EQUAL(batch[i].size(), single.size());
+        for (size_t k = 0; k < single.size(); ++k) {
+            BOOST_CHECK_EQUAL(batch[i][k].url, single[k].url);
+            BOOST_CHECK_CLOSE(batch[i][k].score, single[k].score, 1e-9);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(deletes_and_updates_hide_old_versions) {
+    std::vector<Document> documents = corpus(600, 2);
+    SearchEngine engine(options(1));
+    engine.add_documents(documents);
+    boost::uint64_t epoch = engine.epoch();
+
+    std::vector<std::string> doomed;
+    for (size_t i = 0; i < documents.size(); i += 3) {
+        doomed.push_back(documents[i].id);
+    }
+    doomed.push_back("missing");
+    BOOST_CHECK_EQUAL(engine.delete_documents(doomed), 200u);
+    BOOST_CHECK_GT(engine.epoch(), epoch);
+    BOOST_CHECK_EQUAL(engine.document_count(), 400u);
+    BOOST_CHECK(hits(engine, "unique0").empty());
+    BOOST_CHECK_EQUAL(hits(engine, "unique1").size(), 1u);
+    BOOST_CHECK(engine.get_document("doc3").first.empty());
+    BOOST_CHECK(!engine.delete_document("doc3"));
+
+    // 更新替换同ID的文档，旧版本不再出现在结果中
+    BOOST_CHECK(engine.update_document("doc1", "replacement title", "replacement body"));
+    BOOST_CHECK_EQUAL(engine.document_count(), 400u);
+    BOOST_CHECK(hits(engine, "unique1").empty());
+    std::map<std::string, double> replaced = hits(engine, "replacement");
+    BOOST_REQUIRE_EQUAL(replaced.size(), 1u);
+    BOOST_CHECK_EQUAL(replaced.begin()->first, "doc1");
+    BOOST_CHECK_EQUAL(engine.get_document("doc1").second, "replacement body");
+
+    // 删除后重新添加的文档重新出现
+    BOOST_CHECK(!engine.update_document("doc0", "back", "returned unique0"));
+    BOOST_CHECK_EQUAL(hits(engine, "unique0").size(), 1u);
+    BOOST_CHECK_EQUAL(engine.document_count(), 401u);
+
+    // 同一个快照中删除与写入
+    size_t removed = 0;
+    std::vector<Document> changes(1, Document("doc2", "changed", "changed body", "doc2.txt"));
+    std::vector<std::string> deletions(1, "doc4");
+    BOOST_CHECK_EQUAL(engine.apply_changes(changes, deletions, removed), 1u);
+    BOOST_CHECK_EQUAL(removed, 1u);
+    BOOST_CHECK_EQUAL(engine.document_count(), 400u);
+    BOOST_CHECK(hits(engine, "unique4").empty());
+    BOOST_CHECK(hits(engine, "unique2").empty());
+    BOOST_CHECK_EQUAL(hits(engine, "changed").size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(deleted_documents_leave_statistics_exact) {
+    std::vector<Document> documents = corpus(800, 5);
+    SearchEngine engine(options(1));
+    for (size_t start = 0; start < documents.size(); start += 113) {
+        size_t end = std::min(start + 113, documents.size());
+        engine.add_documents(std::vector<Document>(documents.begin() + start, documents.begin() + end));
+    }
+
+    // 删除与更新分散在已封存的段与缓冲段中，只标记不合并
+    std::vector<std::string> doomed;
+    std::vector<Document> updates;
+    std::vector<Document> survivors;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (i % 5 == 0) {
+            doomed.push_back(documents[i].id);
+            continue;
+        }
+        if (i % 7 == 0) {
+            updates.push_back(Document(documents[i].id, "thread " + documents[i].title, "heap timer", ""));
+            survivors.push_back(updates.back());
+        } else {
+            survivors.push_back(documents[i]);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(engine.delete_documents(doomed), doomed.size());
+    for (const Document& document : updates) {
+        BOOST_REQUIRE(engine.update_document(document.id, document.title, document.content));
+    }
+
+    SearchEngine expected(options(1));
+    expected.add_documents(survivors);
+
+    // 各词项（含标题字段）的文档频率与只写入有效文档的索引完全相同
+    std::string query;
+    for (const char* word : WORDS) {
+        query += std::string(word) + " title:" + word + " ";
+    }
+    query += "unique0 unique1 unique7 unique10";
+    TermStatistics want = expected.term_statistics(query);
+    TermStatistics got = engine.term_statistics(query);
+    BOOST_CHECK_EQUAL(got.doc_count, want.doc_count);
+    BOOST_CHECK_EQUAL(got.total_doc_len, want.total_doc_len);
+    BOOST_CHECK_EQUAL(got.total_title_len, want.total_title_len);
+    BOOST_CHECK(got.document_frequencies == want.document_frequencies);
+    BOOST_CHECK_EQUAL(got.document_frequencies["unique0"], 0u);
+    BOOST_CHECK_EQUAL(got.document_frequencies["unique7"], 0u);
+
+    // 保存后加载的索引仍带着墓碑，统计同样准确
+    TempDirectory directory;
+    std::string path = directory.file("index.bin");
+    engine.save_index(path, 1);
+    SearchEngine loaded(options(1));
+    BOOST_REQUIRE(loaded.load_index(path, 1));
+    BOOST_CHECK(loaded.term_statistics(query).document_frequencies == want.document_frequencies);
+
+    // 合并丢弃墓碑之后仍然一致
+    engine.build_index();
+    BOOST_CHECK(engine.term_statistics(query).document_frequencies == want.document_frequencies);
+}
+
+BOOST_AUTO_TEST_CASE(merge_reclaims_tombstones) {
+    std::vector<Document> documents = corpus(900, 3);
+    SearchEngine engine(options(1));
+    engine.add_documents(documents);
+    engine.build_index();
+    IndexSizeStats before = engine.index_size();
+
+    std::vector<std::string> doomed;
+    for (size_t i = 0; i < documents.size(); i += 2) {
+        doomed.push_back(documents[i].id);
+    }
+    BOOST_CHECK_EQUAL(engine.delete_documents(doomed), 450u);
+    std::map<std::string, double> expected = hits(engine, "boost");
+
+    // 合并重写段时真正丢弃被删除的文档，文档存储随之变小，查询结果与分数不变
+    engine.build_index();
+    IndexSizeStats after = engine.index_size();
+    BOOST_CHECK_EQUAL(after.documents, 450u);
+    BOOST_CHECK_EQUAL(after.segments, 1u);
+    BOOST_CHECK_LT(after.store_raw_bytes, before.store_raw_bytes * 6 / 10);
+    BOOST_CHECK_LT(after.posting_bytes, before.posting_bytes);
+
+    std::map<std::string, double> actual = hits(engine, "boost");
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    for (const auto& hit : expected) {
+        BOOST_REQUIRE(actual.count(hit.first) == 1);
+    }
+    for (size_t i = 0; i < documents.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(hits(engine, "unique" + std::to_string(i)).size(), i % 2 == 0 ? 0u : 1u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(saved_index_round_trip) {
+    TempDirectory directory;
+    std::string path = directory.file("index.bin");
+    std::vector<Document> documents = corpus(700, 4);
+
+    SearchEngine original(options(2));
+    original.add_documents(documents);
+    original.delete_document("doc5");
+    original.build_index();
+    original.save_index(path, 0x1234);
+
+    SearchEngine loaded(options(2));
+    BOOST_REQUIRE(loaded.load_index(path, 0x1234));
+    BOOST_CHECK_EQUAL(loaded.document_count(), original.document_count());
+    BOOST_CHECK_EQUAL(loaded.segment_count(), original.segment_count());
+    check_same_results(original, loaded, true);
+    BOOST_CHECK(hits(loaded, "unique5").empty());
+    BOOST_CHECK_EQUAL(loaded.get_document("doc9").second, original.get_document("doc9").second);
+
+    // 从文件加载的索引可以继续写入
+    loaded.add_document("fresh", "fresh title", "fresh body unique700");
+    BOOST_CHECK_EQUAL(hits(loaded, "unique700").size(), 1u);
+
+    // 数据目录指纹或索引选项不一致的文件被视为过期
+    SearchEngine stale(options(2));
+    BOOST_CHECK(!stale.load_index(path, 0x4321));
+    IndexOptions without_positions = options(2);
+    without_positions.store_positions = false;
+    SearchEngine other(without_positions);
+    BOOST_CHECK(!other.load_index(path, 0x1234));
+    BOOST_CHECK(!other.load_index(directory.file("missing.bin"), 0x1234));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
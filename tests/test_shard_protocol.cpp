@@ -0,0 +1,152 @@
+/**
+ * @file test_shard_protocol.cpp
+ * @brief 分片内部协议的测试
+ *
+ * 各种响应编码后再解码得到原值：含制表符、换行符与反斜杠的字段原样恢复，分数逐位相同；
+ * 字段数不足、数值或高亮区间格式不对的响应被拒绝。
+ */
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "shard_protocol.h"
+
+namespace {
+
+// 需要转义的各种字段
+const char* const AWKWARD_FIELDS[] = {"", "plain", "tab\there", "line\nbreak", "cr\r\n", "back\\slash", "\\t",
+                                      "trailing\\", "\t\n\\", "中文\t标题"};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(shard_protocol)
+
+BOOST_AUTO_TEST_CASE(records_round_trip) {
+    std::vector<std::vector<std::string>> records;
+    for (const char* field : AWKWARD_FIELDS) {
+        records.push_back(std::vector<std::string>{"first", field, field});
+    }
+    records.push_back(std::vector<std::string>{"", ""});
+    records.push_back(std::vector<std::string>(AWKWARD_FIELDS, AWKWARD_FIELDS + 10));
+
+    std::string body;
+    for (const std::vector<std::string>& record : records) {
+        std::string line = ShardProtocol::join_record(record);
+        BOOST_CHECK_EQUAL(line.find('\n'), line.size() - 1);
+        body += line;
+    }
+    BOOST_CHECK(ShardProtocol::parse_records(body) == records);
+
+    // 空行被忽略，最后一行可以没有换行符
+    std::vector<std::vector<std::string>> parsed = ShardProtocol::parse_records("\na\tb\n\n\nc");
+    std::vector<std::vector<std::string>> expected = {{"a", "b"}, {"c"}};
+    BOOST_CHECK(parsed == expected);
+    BOOST_CHECK(ShardProtocol::parse_records("").empty());
+}
+
+BOOST_AUTO_TEST_CASE(statistics_round_trip) {
+    TermStatistics statistics;
+    statistics.doc_count = 123456;
+    statistics.total_doc_len = 0x123456789ABCull;
+    statistics.total_title_len = 4242;
+    statistics.document_frequencies["boost"] = 17;
+    statistics.document_frequencies["搜索"] = 3;
+    statistics.document_frequencies["odd\tterm\n"] = 1;
+
+    TermStatistics decoded = ShardProtocol::decode_statistics(ShardProtocol::encode_statistics(statistics));
+    BOOST_CHECK_EQUAL(decoded.doc_count, statistics.doc_count);
+    BOOST_CHECK_EQUAL(decoded.total_doc_len, statistics.total_doc_len);
+    BOOST_CHECK_EQUAL(decoded.total_title_len, statistics.total_title_len);
+    BOOST_CHECK(decoded.document_frequencies == statistics.document_frequencies);
+
+    // 没有词项时只有第一行
+    TermStatistics empty = ShardProtocol::decode_statistics(ShardProtocol::encode_statistics(TermStatistics()));
+    BOOST_CHECK_EQUAL(empty.doc_count, 0u);
+    BOOST_CHECK(empty.document_frequencies.empty());
+}
+
+BOOST_AUTO_TEST_CASE(hits_keep_exact_scores) {
+    const double SCORES[] = {0.0, 0.1, 1.0 / 3, -2.5, 12345.678901234567, 1e-300, std::nextafter(1.0, 2.0),
+                             std::numeric_limits<double>::max()};
+    std::vector<SearchResult> hits;
+    for (size_t i = 0; i < sizeof(SCORES) / sizeof(SCORES[0]); ++i) {
+        hits.push_back(SearchResult("ignored", "ignored", "doc\t" + std::to_string(i), SCORES[i]));
+    }
+
+    std::vector<SearchResult> decoded = ShardProtocol::decode_hits(ShardProtocol::encode_hits(hits));
+    BOOST_REQUIRE_EQUAL(decoded.size(), hits.size());
+    for (size_t i = 0; i < hits.size(); ++i) {
+        BOOST_CHECK_EQUAL(decoded[i].url, hits[i].url);
+        BOOST_CHECK(decoded[i].score == hits[i].score);
+        BOOST_CHECK(decoded[i].title.empty());
+        BOOST_CHECK(decoded[i].content.empty());
+    }
+    BOOST_CHECK(ShardProtocol::decode_hits(ShardProtocol::encode_hits(std::vector<SearchResult>())).empty());
+}
+
+BOOST_AUTO_TEST_CASE(results_keep_text_and_highlights) {
+    std::vector<SearchResult> results;
+    results.push_back(SearchResult("Title\twith tab", "...snippet\nline two\\...", "doc1", 3.5));
+    results.back().highlights.push_back(Highlight(3, 7));
+    results.back().highlights.push_back(Highlight(15, 4));
+    results.push_back(SearchResult("", "", "doc2", 1.0));
+    results.push_back(SearchResult("中文标题", "搜索引擎", "文档3", 0.5));
+    results.back().highlights.push_back(Highlight(0, 12));
+
+    std::vector<SearchResult> decoded = ShardProtocol::decode_results(ShardProtocol::encode_results(results));
+    BOOST_REQUIRE_EQUAL(decoded.size(), results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL(decoded[i].url, results[i].url);
+        BOOST_CHECK_EQUAL(decoded[i].title, results[i].title);
+        BOOST_CHECK_EQUAL(decoded[i].content, results[i].content);
+        BOOST_CHECK_EQUAL(decoded[i].score, 0.0);
+        BOOST_REQUIRE_EQUAL(decoded[i].highlights.size(), results[i].highlights.size());
+        for (size_t h = 0; h < results[i].highlights.size(); ++h) {
+            BOOST_CHECK_EQUAL(decoded[i].highlights[h].offset, results[i].highlights[h].offset);
+            BOOST_CHECK_EQUAL(decoded[i].highlights[h].length, results[i].highlights[h].length);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(suggestions_round_trip) {
+    std::vector<Suggestion> suggestions;
+    suggestions.push_back(Suggestion("boost", 4000000000u));
+    suggestions.push_back(Suggestion("搜索", 2));
+    suggestions.push_back(Suggestion("a\\b", 1));
+
+    std::vector<Suggestion> decoded =
+        ShardProtocol::decode_suggestions(ShardProtocol::encode_suggestions(suggestions));
+    BOOST_REQUIRE_EQUAL(decoded.size(), suggestions.size());
+    for (size_t i = 0; i < suggestions.size(); ++i) {
+        BOOST_CHECK_EQUAL(decoded[i].text, suggestions[i].text);
+        BOOST_CHECK_EQUAL(decoded[i].frequency, suggestions[i].frequency);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(malformed_responses_are_rejected) {
+    BOOST_CHECK_THROW(ShardProtocol::decode_statistics(""), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_statistics("1\t2\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_statistics("1\t2\t3\nterm\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_statistics("x\t2\t3\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_statistics("1\t2\t3\nterm\t-\n"), std::runtime_error);
+
+    BOOST_CHECK_THROW(ShardProtocol::decode_hits("doc1\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_hits("doc1\tnot-a-score\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_results("doc1\ttitle\tsnippet\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_results("doc1\ttitle\tsnippet\t3-4\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_results("doc1\ttitle\tsnippet\t3:x\n"), std::runtime_error);
+    BOOST_CHECK_THROW(ShardProtocol::decode_suggestions("boost\t99999999999\n"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(url_encoding) {
+    BOOST_CHECK_EQUAL(ShardProtocol::url_encode("Az09-_.~"), "Az09-_.~");
+    BOOST_CHECK_EQUAL(ShardProtocol::url_encode("a b&c=d"), "a%20b%26c%3Dd");
+    BOOST_CHECK_EQUAL(ShardProtocol::url_encode("\"x\"+\n"), "%22x%22%2B%0A");
+    BOOST_CHECK_EQUAL(ShardProtocol::url_encode("搜"), "%E6%90%9C");
+    BOOST_CHECK_EQUAL(ShardProtocol::url_encode(""), "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,225 @@
+/**
+ * @file test_snippet.cpp
+ * @brief 查询相关摘要生成器的测试
+ *
+ * 覆盖窗口的选择（单个窗口、相距较远时的两个半长片段、没有命中时的正文开头），
+ * 以及高亮区间：偏移相对摘要文本、按偏移升序且互不重叠，重叠的命中合并为一个区间。
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "snippet.h"
+
+namespace {
+
+/**
+ * @brief 权重均为1的查询词项
+ */
+std::map<std::string, double> weights(const std::vector<std::string>& terms) {
+    std::map<std::string, double> result;
+    for (const std::string& term : terms) {
+        result[term] = 1.0;
+    }
+    return result;
+}
+
+/**
+ * @brief count个不含查询词的填充单词
+ */
+std::string filler(size_t count) {
+    static const char* const WORDS[] = {"lorem ", "ipsum ", "dolor ", "amet ", "sed ", "tempor "};
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        text += WORDS[i % 6];
+    }
+    return text;
+}
+
+/**
+ * @brief 高亮区间对应的文本，转为小写
+ */
+std::vector<std::string> highlighted(const Snippet& snippet) {
+    std::vector<std::string> result;
+    for (const Highlight& highlight : snippet.highlights) {
+        std::string text = snippet.text.substr(highlight.offset, highlight.length);
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        result.push_back(text);
+    }
+    return result;
+}
+
+/**
+ * @brief 检查高亮区间位于摘要之内、按偏移升序且互不相接，两端都落在UTF-8字符边界上
+ */
+void check_highlights(const Snippet& snippet) {
+    size_t previous_end = 0;
+    for (size_t i = 0; i < snippet.highlights.size(); ++i) {
+        const Highlight& highlight = snippet.highlights[i];
+        BOOST_REQUIRE_GT(highlight.length, 0u);
+        BOOST_REQUIRE_LE(highlight.offset + highlight.length, snippet.text.size());
+        if (i > 0) {
+            BOOST_REQUIRE_GT(highlight.offset, previous_end);
+        }
+        previous_end = highlight.offset + highlight.length;
+        BOOST_REQUIRE((snippet.text[highlight.offset] & 0xC0) != 0x80);
+        BOOST_REQUIRE(previous_end == snippet.text.size() || (snippet.text[previous_end] & 0xC0) != 0x80);
+    }
+}
+
+/**
+ * @brief 以"..."分隔的片段
+ */
+std::vector<std::string> fragments(const std::string& text) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    for (;;) {
+        size_t dots = text.find("...", start);
+        std::string part = text.substr(start, dots == std::string::npos ? std::string::npos : dots - start);
+        if (!part.empty()) {
+            result.push_back(part);
+        }
+        if (dots == std::string::npos) {
+            return result;
+        }
+        start = dots + 3;
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(snippet)
+
+BOOST_AUTO_TEST_CASE(without_matches_uses_leading_text) {
+    SnippetGenerator generator(weights({"missing"}));
+    Snippet short_snippet = generator.generate("short text");
+    BOOST_CHECK_EQUAL(short_snippet.text, "short text");
+    BOOST_CHECK(short_snippet.highlights.empty());
+
+    // 截断位置退回到字符边界
+    std::string chinese;
+    for (int i = 0; i < 100; ++i) {
+        chinese += "中文";
+    }
+    Snippet long_snippet = generator.generate(chinese);
+    BOOST_CHECK(long_snippet.highlights.empty());
+    BOOST_CHECK_EQUAL(long_snippet.text, chinese.substr(0, SnippetGenerator::SNIPPET_BYTES) + "...");
+    std::string ascii = "x " + filler(100);
+    BOOST_CHECK_EQUAL(generator.generate(ascii).text, ascii.substr(0, SnippetGenerator::SNIPPET_BYTES) + "...");
+}
+
+BOOST_AUTO_TEST_CASE(single_window_is_centered_on_the_matches) {
+    SnippetGenerator generator(weights({"boost", "asio"}));
+    std::string content = filler(200) + "Boost.Asio is a BOOST library " + filler(200);
+    size_t at = content.find("Boost.Asio");
+    Snippet snippet = generator.generate(content);
+
+    // 一个完整长度的片段，两端都有省略号，命中位于片段中部
+    std::vector<std::string> parts = fragments(snippet.text);
+    BOOST_REQUIRE_EQUAL(parts.size(), 1u);
+    BOOST_CHECK_EQUAL(snippet.text.substr(0, 3), "...");
+    BOOST_CHECK_EQUAL(snippet.text.substr(snippet.text.size() - 3), "...");
+    BOOST_CHECK_LE(parts[0].size(), SnippetGenerator::SNIPPET_BYTES);
+    BOOST_CHECK_GE(parts[0].size(), SnippetGenerator::SNIPPET_BYTES - 10);
+    size_t start = content.find(parts[0]);
+    BOOST_REQUIRE(start != std::string::npos);
+    BOOST_CHECK_GT(at - start, 40u);
+
+    check_highlights(snippet);
+    std::vector<std::string> expected = {"boost", "asio", "boost"};
+    std::vector<std::string> got = highlighted(snippet);
+    BOOST_CHECK_EQUAL_COLLECTIONS(got.begin(), got.end(), expected.begin(), expected.end());
+    for (const Highlight& highlight : snippet.highlights) {
+        // 偏移相对摘要文本，换算回正文后仍指向同一个词
+        BOOST_CHECK_EQUAL(content.substr(start + highlight.offset - 3, highlight.length),
+                          snippet.text.substr(highlight.offset, highlight.length));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(distant_terms_use_two_fragments) {
+    SnippetGenerator generator(weights({"alpha", "omega"}));
+    std::string content = "alpha " + filler(400) + "omega " + filler(100);
+    Snippet snippet = generator.generate(content);
+
+    // 第一个片段从正文开头开始，没有前导省略号；两个片段各自不超过半长
+    std::vector<std::string> parts = fragments(snippet.text);
+    BOOST_REQUIRE_EQUAL(parts.size(), 2u);
+    BOOST_CHECK_EQUAL(snippet.text.substr(0, 5), "alpha");
+    for (const std::string& part : parts) {
+        BOOST_CHECK_LE(part.size(), SnippetGenerator::SNIPPET_BYTES / 2);
+    }
+    BOOST_CHECK(parts[1].find("omega") != std::string::npos);
+
+    check_highlights(snippet);
+    std::vector<std::string> expected = {"alpha", "omega"};
+    std::vector<std::string> got = highlighted(snippet);
+    BOOST_CHECK_EQUAL_COLLECTIONS(got.begin(), got.end(), expected.begin(), expected.end());
+    BOOST_CHECK_EQUAL(snippet.highlights[0].offset, 0u);
+    BOOST_CHECK_GT(snippet.highlights[1].offset, parts[0].size() + 3);
+}
+
+BOOST_AUTO_TEST_CASE(window_with_more_distinct_terms_wins) {
+    SnippetGenerator generator(weights({"alpha", "omega"}));
+
+    // 前面重复的单个词项不如后面同时包含两个词项的窗口
+    std::string content = filler(20) + "alpha alpha alpha alpha " + filler(200) + "alpha omega " + filler(200);
+    Snippet snippet = generator.generate(content);
+    BOOST_REQUIRE_EQUAL(fragments(snippet.text).size(), 1u);
+    std::vector<std::string> got = highlighted(snippet);
+    BOOST_REQUIRE_EQUAL(got.size(), 2u);
+    BOOST_CHECK_EQUAL(got[0], "alpha");
+    BOOST_CHECK_EQUAL(got[1], "omega");
+    BOOST_CHECK(snippet.text.find("alpha alpha") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(words_match_whole_tokens_only) {
+    SnippetGenerator generator(weights({"boost", "v2"}));
+    Snippet snippet = generator.generate("boosting boosts reboost boost v2 v22 av2");
+    std::vector<std::string> got = highlighted(snippet);
+    std::vector<std::string> expected = {"boost", "v2"};
+    BOOST_CHECK_EQUAL_COLLECTIONS(got.begin(), got.end(), expected.begin(), expected.end());
+    check_highlights(snippet);
+}
+
+BOOST_AUTO_TEST_CASE(overlapping_chinese_matches_merge) {
+    SnippetGenerator generator(weights({"搜索", "索引", "引擎"}));
+    std::string content = "基于搜索引擎的全文检索";
+    Snippet snippet = generator.generate(content);
+    BOOST_CHECK_EQUAL(snippet.text, content);
+
+    // 三个相互重叠的命中合并为一个高亮区间
+    check_highlights(snippet);
+    BOOST_REQUIRE_EQUAL(snippet.highlights.size(), 1u);
+    BOOST_CHECK_EQUAL(snippet.text.substr(snippet.highlights[0].offset, snippet.highlights[0].length), "搜索引擎");
+
+    // 片段两端落在字符边界上
+    std::string padding;
+    for (int i = 0; i < 200; ++i) {
+        padding += "文";
+    }
+    snippet = generator.generate(padding + content + padding);
+    check_highlights(snippet);
+    for (const std::string& part : fragments(snippet.text)) {
+        BOOST_CHECK((part[0] & 0xC0) != 0x80);
+        BOOST_CHECK((part[part.size() - 1] & 0xC0) != 0xC0);
+    }
+    BOOST_REQUIRE_EQUAL(snippet.highlights.size(), 1u);
+    BOOST_CHECK_EQUAL(snippet.text.substr(snippet.highlights[0].offset, snippet.highlights[0].length), "搜索引擎");
+}
+
+BOOST_AUTO_TEST_CASE(expected_matches_stop_the_scan) {
+    SnippetGenerator generator(weights({"alpha", "omega"}));
+    std::string content = "alpha " + filler(400) + "omega";
+
+    // 已知正文只有一次命中时，找到第一个命中后即停止，后面的词项不出现在摘要中
+    Snippet snippet = generator.generate(content, 1);
+    BOOST_REQUIRE_EQUAL(snippet.highlights.size(), 1u);
+    BOOST_CHECK_EQUAL(highlighted(snippet)[0], "alpha");
+    BOOST_CHECK_EQUAL(fragments(snippet.text).size(), 1u);
+    BOOST_CHECK_EQUAL(generator.generate(content, 2).highlights.size(), 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/**
+ * @file test_suggester.cpp
+ * @brief 输入补全索引的测试
+ *
+ * complete()的结果与对排序词汇的直接筛选一致：以前缀开头的词项按权重降序、权重相同时按字节序，
+ * 取前min(limit, TOP_K)个。覆盖已展开与未展开的节点、与前缀相同的词项以及非ASCII字节。
+ */
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "suggester.h"
+
+namespace {
+
+typedef std::vector<std::pair<std::string, boost::uint32_t>> Terms;
+
+/**
+ * @brief 直接筛选得到的补全结果
+ */
+Terms brute_force(const Terms& terms, const std::string& prefix, size_t limit) {
+    Terms result;
+    for (const auto& term : terms) {
+        if (term.first.compare(0, prefix.size(), prefix) == 0) {
+            result.push_back(term);
+        }
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const std::pair<std::string, boost::uint32_t>& a,
+                        const std::pair<std::string, boost::uint32_t>& b) { return a.second > b.second; });
+    result.resize(std::min(result.size(), std::min(limit, Suggester::TOP_K)));
+    return result;
+}
+
+/**
+ * @brief 检查补全结果与直接筛选一致
+ */
+void check_complete(const Suggester& suggester, const Terms& terms, const std::string& prefix, size_t limit) {
+    Terms got;
+    suggester.complete(prefix, limit, got);
+    Terms expected = brute_force(terms, prefix, limit);
+    BOOST_TEST_CONTEXT("prefix '" << prefix << "' limit " << limit) {
+        BOOST_REQUIRE_EQUAL(got.size(), expected.size());
+        for (size_t i = 0; i < got.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(got[i].first, expected[i].first);
+            BOOST_REQUIRE_EQUAL(got[i].second, expected[i].second);
+        }
+    }
+}
+
+/**
+ * @brief 按固定种子生成count个不重复的升序词项，字母表较小使前缀大量共享，权重有大量并列
+ */
+Terms vocabulary(size_t count, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::set<std::string> words;
+    while (words.size() < count) {
+        std::string word;
+        size_t length = 1 + random() % 7;
+        for (size_t i = 0; i < length; ++i) {
+            word += static_cast<char>('a' + random() % 5);
+        }
+        words.insert(word);
+    }
+    Terms terms;
+    for (const std::string& word : words) {
+        terms.push_back(std::make_pair(word, static_cast<boost::uint32_t>(1 + random() % 50)));
+    }
+    return terms;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(suggester)
+
+BOOST_AUTO_TEST_CASE(empty_index) {
+    Suggester empty;
+    Terms out;
+    empty.complete("", 10, out);
+    empty.complete("a", 10, out);
+    BOOST_CHECK(out.empty());
+    BOOST_CHECK_EQUAL(empty.size(), 0u);
+    BOOST_CHECK_EQUAL(empty.epoch(), 0u);
+
+    Suggester none(Terms(), 7);
+    none.complete("", 10, out);
+    BOOST_CHECK(out.empty());
+    BOOST_CHECK_EQUAL(none.epoch(), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(small_vocabulary_is_ranked_by_weight) {
+    Terms terms = {{"search", 5}, {"sea", 9}, {"seal", 2}, {"season", 9}, {"seat", 1}, {"select", 7}, {"zebra", 3}};
+    std::sort(terms.begin(), terms.end());
+    Suggester suggester(terms, 3);
+    BOOST_CHECK_EQUAL(suggester.size(), terms.size());
+    BOOST_CHECK_EQUAL(suggester.epoch(), 3u);
+
+    // 权重相同时按字节序，与前缀相同的词项本身也是补全
+    Terms out;
+    suggester.complete("sea", 3, out);
+    Terms expected = {{"sea", 9}, {"season", 9}, {"search", 5}};
+    BOOST_CHECK(out == expected);
+
+    // 结果追加到out之后；limit为0或前缀不存在时不输出
+    suggester.complete("z", 10, out);
+    BOOST_REQUIRE_EQUAL(out.size(), 4u);
+    BOOST_CHECK_EQUAL(out[3].first, "zebra");
+    suggester.complete("se", 0, out);
+    suggester.complete("x", 10, out);
+    suggester.complete("zebras", 10, out);
+    BOOST_CHECK_EQUAL(out.size(), 4u);
+
+    for (size_t limit : {1, 5, 100}) {
+        check_complete(suggester, terms, "", limit);
+        check_complete(suggester, terms, "se", limit);
+        check_complete(suggester, terms, "seal", limit);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(large_vocabulary_matches_brute_force) {
+    Terms terms = vocabulary(4000, 1);
+    Suggester suggester(terms, 1);
+    BOOST_CHECK_GT(suggester.memory_usage(), 0u);
+
+    // 每个词项的每个前缀，既经过已展开的节点，也经过词项不超过TOP_K个的未展开节点
+    std::set<std::string> prefixes = {"", "f", "eeeeeeee"};
+    for (const auto& term : terms) {
+        for (size_t length = 0; length <= term.first.size(); ++length) {
+            prefixes.insert(term.first.substr(0, length));
+        }
+    }
+    for (const std::string& prefix : prefixes) {
+        check_complete(suggester, terms, prefix, Suggester::TOP_K);
+    }
+    std::mt19937 random(2);
+    std::vector<std::string> sample(prefixes.begin(), prefixes.end());
+    for (int i = 0; i < 500; ++i) {
+        check_complete(suggester, terms, sample[random() % sample.size()], random() % 15);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(non_ascii_terms) {
+    Terms terms;
+    const char* const WORDS[] = {"搜索", "搜索引擎", "搜狗", "索引", "引擎", "search", "\xff\xfe", "\xff"};
+    boost::uint32_t weight = 1;
+    for (const char* word : WORDS) {
+        terms.push_back(std::make_pair(std::string(word), weight++));
+    }
+    for (int i = 0; i < 30; ++i) {
+        terms.push_back(std::make_pair("搜" + std::to_string(i), static_cast<boost::uint32_t>(i % 4)));
+    }
+    std::sort(terms.begin(), terms.end());
+    Suggester suggester(terms, 1);
+
+    for (const char* prefix : {"", "搜", "搜索", "\xe6", "索", "\xff", "\xff\xfe", "s"}) {
+        for (size_t limit : {1, 4, 10}) {
+            check_complete(suggester, terms, prefix, limit);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
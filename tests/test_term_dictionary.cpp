@@ -0,0 +1,300 @@
+/**
+ * @file test_term_dictionary.cpp
+ * @brief 前缀压缩词典的测试
+ *
+ * 查找、前缀遍历与有序定位的结果与排序后的词项数组一致，写入索引文件再读回后保持不变；
+ * 读取时的校验能发现块数、块偏移、变长编码、词项顺序与多余数据等各种不一致。
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "index_file.h"
+#include "term_dictionary.h"
+#include "test_util.h"
+
+namespace {
+
+/**
+ * @brief 按固定种子生成count个不重复的升序词项，含有大量公共前缀与多字节字符
+ */
+std::vector<std::string> sample_terms(size_t count, unsigned int seed) {
+    static const char* const parts[] = {"a", "b", "ab", "asio", "boost", "z", "\xe4\xb8\xad", "\xe6\x96\x87", "0"};
+    std::mt19937 random(seed);
+    std::set<std::string> terms;
+    while (terms.size() < count) {
+        std::string term;
+        size_t length = 1 + random() % 5;
+        for (size_t i = 0; i < length; ++i) {
+            term += parts[random() % (sizeof(parts) / sizeof(parts[0]))];
+        }
+        terms.insert(term);
+    }
+    return std::vector<std::string>(terms.begin(), terms.end());
+}
+
+/**
+ * @brief 检查词典与排序后的词项数组一致
+ */
+void check_dictionary(const TermDictionary& dictionary, const std::vector<std::string>& terms) {
+    BOOST_REQUIRE_EQUAL(dictionary.size(), terms.size());
+    for (size_t id = 0; id < terms.size(); ++id) {
+        BOOST_REQUIRE_EQUAL(dictionary.find(terms[id]), id);
+        BOOST_REQUIRE_EQUAL(dictionary.term(static_cast<TermId>(id)), terms[id]);
+    }
+
+    size_t id = 0;
+    for (TermDictionary::Iterator it = dictionary.iterator(); !it.at_end(); it.next(), ++id) {
+        BOOST_REQUIRE_EQUAL(it.id(), id);
+        BOOST_REQUIRE_EQUAL(it.term(), terms[id]);
+    }
+    BOOST_CHECK_EQUAL(id, terms.size());
+
+    // 不存在的键：空串、比所有词项都小或都大、两个词项之间、已有词项加上后缀
+    std::vector<std::string> keys;
+    keys.push_back(std::string());
+    keys.push_back(std::string(1, '\x01'));
+    keys.push_back("\xff\xff");
+    keys.push_back("ab");
+    keys.push_back("boos");
+    keys.push_back("\xe4\xb8");
+    for (size_t i = 0; i < terms.size(); i += 7) {
+        keys.push_back(terms[i] + "~");
+        keys.push_back(terms[i].substr(0, terms[i].size() / 2));
+    }
+    for (const std::string& key : keys) {
+        std::vector<std::string>::const_iterator lower = std::lower_bound(terms.begin(), terms.end(), key);
+        TermId expected = static_cast<TermId>(lower - terms.begin());
+        BOOST_REQUIRE_EQUAL(dictionary.lower_bound(key), expected);
+        BOOST_REQUIRE_EQUAL(dictionary.find(key),
+                            lower != terms.end() && *lower == key ? expected : TermDictionary::NOT_FOUND);
+
+        TermDictionary::Iterator seek = dictionary.seek(key);
+        BOOST_REQUIRE_EQUAL(seek.at_end(), lower == terms.end());
+        if (!seek.at_end()) {
+            BOOST_REQUIRE_EQUAL(seek.id(), expected);
+            BOOST_REQUIRE_EQUAL(seek.term(), *lower);
+        }
+
+        std::vector<std::string> matched;
+        for (TermDictionary::Iterator it = dictionary.prefix_iterator(key); !it.at_end(); it.next()) {
+            matched.push_back(it.term());
+        }
+        std::vector<std::string> expected_matches;
+        for (std::vector<std::string>::const_iterator it = lower;
+             it != terms.end() && it->compare(0, key.size(), key) == 0; ++it) {
+            expected_matches.push_back(*it);
+        }
+        BOOST_REQUIRE(matched == expected_matches);
+    }
+}
+
+/**
+ * 手工构造的词典正文：三个32位字段、块偏移数组与前缀压缩数据，末尾按4字节对齐
+ */
+class DictionaryBody
+{
+public:
+    DictionaryBody(size_t term_count, const std::vector<boost::uint32_t>& blocks, const std::string& data) {
+        append_u32(static_cast<boost::uint32_t>(term_count));
+        append_u32(static_cast<boost::uint32_t>(blocks.size()));
+        append_u32(static_cast<boost::uint32_t>(data.size()));
+        for (boost::uint32_t offset : blocks) {
+            append_u32(offset);
+        }
+        bytes_ += data;
+        bytes_.resize((bytes_.size() + 3) / 4 * 4, '\0');
+    }
+
+    // 修改记录的压缩数据长度，不改变实际的数据
+    void set_data_size(boost::uint32_t size) { std::memcpy(&bytes_[8], &size, sizeof(size)); }
+
+    // 把正文截断为size字节
+    void truncate(size_t size) { bytes_.resize(size); }
+
+    // 按8字节对齐复制正文后读取词典，正文从文件偏移HEADER_SIZE开始，对齐规则与映射的文件相同；
+    // 词典引用复制出的正文，本对象必须比词典存在得更久
+    void read(TermDictionary& dictionary) {
+        aligned_.assign((bytes_.size() + 7) / 8, 0);
+        std::memcpy(aligned_.data(), bytes_.data(), bytes_.size());
+        IndexFileReader reader(reinterpret_cast<const boost::uint8_t*>(aligned_.data()), bytes_.size());
+        dictionary.read(reader);
+        BOOST_CHECK(reader.at_end());
+    }
+
+private:
+    std::string bytes_;
+    std::vector<boost::uint64_t> aligned_;
+
+    void append_u32(boost::uint32_t value) { bytes_.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+};
+
+/**
+ * @brief 由若干字节构造字符串（可以含有0字节）
+ */
+std::string bytes(std::initializer_list<int> values) {
+    std::string out;
+    for (int value : values) {
+        out.push_back(static_cast<char>(value));
+    }
+    return out;
+}
+
+// "apple"、"apply"、"banana"的合法编码
+const std::string VALID_DATA =
+    bytes({5}) + "apple" + bytes({4, 1}) + "y" + bytes({0, 6}) + "banana";
+
+/**
+ * @brief 检查读取手工构造的正文时抛出std::runtime_error，且词典保持原样
+ */
+void check_rejected(DictionaryBody body) {
+    TermDictionary dictionary(std::vector<std::string>(1, "kept"));
+    BOOST_CHECK_THROW(body.read(dictionary), std::runtime_error);
+    BOOST_CHECK_EQUAL(dictionary.size(), 1u);
+    BOOST_CHECK_EQUAL(dictionary.find("kept"), 0u);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(term_dictionary)
+
+BOOST_AUTO_TEST_CASE(empty_dictionary) {
+    TermDictionary dictionary;
+    BOOST_CHECK_EQUAL(dictionary.size(), 0u);
+    BOOST_CHECK_EQUAL(dictionary.find("a"), TermDictionary::NOT_FOUND);
+    BOOST_CHECK_EQUAL(dictionary.lower_bound("a"), 0u);
+    BOOST_CHECK(dictionary.iterator().at_end());
+    BOOST_CHECK(dictionary.prefix_iterator("").at_end());
+    check_dictionary(TermDictionary(std::vector<std::string>()), std::vector<std::string>());
+}
+
+BOOST_AUTO_TEST_CASE(lookups_match_sorted_terms) {
+    const size_t sizes[] = {1, TermDictionary::BLOCK_TERMS - 1, TermDictionary::BLOCK_TERMS,
+                            TermDictionary::BLOCK_TERMS + 1, 1000};
+    for (size_t size : sizes) {
+        BOOST_TEST_CONTEXT("size " << size) {
+            std::vector<std::string> terms = sample_terms(size, static_cast<unsigned int>(size));
+            check_dictionary(TermDictionary(terms), terms);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(long_terms_and_shared_prefixes) {
+    std::vector<std::string> terms;
+    for (size_t i = 0; i < 40; ++i) {
+        terms.push_back(std::string(200, 'p') + std::string(i, 'q'));
+    }
+    terms.push_back(std::string(300, 'r'));
+    check_dictionary(TermDictionary(terms), terms);
+}
+
+BOOST_AUTO_TEST_CASE(index_file_round_trip) {
+    TempDirectory directory;
+    std::string path = directory.file("dictionary.idx");
+    std::vector<std::string> terms = sample_terms(777, 1);
+    {
+        IndexFileWriter writer(path);
+        writer.write_u8(1); // 使词典从未对齐的位置开始
+        TermDictionary(terms).write(writer);
+        TermDictionary().write(writer);
+        writer.finish(IndexFileInfo());
+    }
+
+    MappedIndexFile file(path);
+    IndexFileReader reader(file.body(), file.body_size());
+    reader.read_u8();
+    TermDictionary dictionary;
+    dictionary.read(reader);
+    // 读取会替换词典原有的内容
+    TermDictionary reused(terms);
+    reused.read(reader);
+    BOOST_CHECK(reader.at_end());
+    check_dictionary(dictionary, terms);
+    check_dictionary(reused, std::vector<std::string>());
+
+    // 复制映射的词典只复制指针
+    TermDictionary copy = dictionary;
+    check_dictionary(copy, terms);
+}
+
+BOOST_AUTO_TEST_CASE(read_accepts_valid_encoding) {
+    DictionaryBody body(3, std::vector<boost::uint32_t>(1, 0), VALID_DATA);
+    TermDictionary dictionary;
+    body.read(dictionary);
+    std::vector<std::string> terms;
+    terms.push_back("apple");
+    terms.push_back("apply");
+    terms.push_back("banana");
+    check_dictionary(dictionary, terms);
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_bad_block_count) {
+    check_rejected(DictionaryBody(3, std::vector<boost::uint32_t>(), VALID_DATA));
+    check_rejected(DictionaryBody(3, std::vector<boost::uint32_t>(2, 0), VALID_DATA));
+    check_rejected(DictionaryBody(17, std::vector<boost::uint32_t>(1, 0), VALID_DATA));
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_bad_block_offset) {
+    check_rejected(DictionaryBody(3, std::vector<boost::uint32_t>(1, 1), VALID_DATA));
+    check_rejected(DictionaryBody(3, std::vector<boost::uint32_t>(1, 0xFFFFFFFFu), VALID_DATA));
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_bad_encoding) {
+    std::vector<boost::uint32_t> block(1, 0);
+
+    // 公共前缀长于前一个词项
+    check_rejected(DictionaryBody(2, block, bytes({5}) + "apple" + bytes({6, 1}) + "y"));
+    // 后缀长度超过剩余数据
+    check_rejected(DictionaryBody(2, block, bytes({5}) + "apple" + bytes({4, 100}) + "y"));
+    check_rejected(DictionaryBody(1, block, bytes({6}) + "apple"));
+    // 变长整数在数据末尾中断，或超过32位
+    check_rejected(DictionaryBody(2, block, bytes({5}) + "apple" + bytes({0x84})));
+    check_rejected(DictionaryBody(1, block, bytes({0x80, 0x80, 0x80, 0x80, 0x80, 0x01}) + "a"));
+    check_rejected(DictionaryBody(1, block, bytes({0xFF, 0xFF, 0xFF, 0xFF, 0x7F}) + "a"));
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_unsorted_terms) {
+    std::vector<boost::uint32_t> block(1, 0);
+
+    // 重复的词项
+    check_rejected(DictionaryBody(2, block, bytes({5}) + "apple" + bytes({5, 0})));
+    // 降序的词项
+    check_rejected(DictionaryBody(2, block, bytes({6}) + "banana" + bytes({0, 5}) + "apple"));
+    // 块首词项不大于前一块的最后一个词项
+    std::string data;
+    std::vector<boost::uint32_t> blocks;
+    for (size_t i = 0; i < TermDictionary::BLOCK_TERMS; ++i) {
+        data += i == 0 ? bytes({2}) + "ma" : bytes({1, 1}) + std::string(1, static_cast<char>('a' + i));
+    }
+    blocks.push_back(0);
+    blocks.push_back(static_cast<boost::uint32_t>(data.size()));
+    DictionaryBody valid(TermDictionary::BLOCK_TERMS + 1, blocks, data + bytes({2}) + "mz");
+    TermDictionary sorted;
+    valid.read(sorted);
+    BOOST_CHECK_EQUAL(sorted.find("mz"), TermDictionary::BLOCK_TERMS);
+    check_rejected(DictionaryBody(TermDictionary::BLOCK_TERMS + 1, blocks, data + bytes({2}) + "mb"));
+}
+
+BOOST_AUTO_TEST_CASE(read_rejects_trailing_and_missing_data) {
+    std::vector<boost::uint32_t> block(1, 0);
+    check_rejected(DictionaryBody(3, block, VALID_DATA + "x"));
+    check_rejected(DictionaryBody(2, block, VALID_DATA));
+
+    // 记录的数据长度超过正文
+    DictionaryBody oversized(3, block, VALID_DATA);
+    oversized.set_data_size(static_cast<boost::uint32_t>(VALID_DATA.size() + 64));
+    check_rejected(oversized);
+
+    // 正文在块偏移数组中间被截断
+    DictionaryBody truncated(3, block, VALID_DATA);
+    truncated.truncate(14);
+    check_rejected(truncated);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,162 @@
+/**
+ * @file test_thread_pool.cpp
+ * @brief 工作窃取线程池的测试
+ *
+ * run_all执行每个任务恰好一次，只等待自己提交的一组任务，工作线程都在忙时由调用线程独自完成；
+ * 任务抛出的异常在整组结束后重新抛出。多个线程可以同时调用run_all。
+ */
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "thread_pool.h"
+
+namespace {
+
+/**
+ * @brief count个任务，第i个任务把hits[i]加一
+ */
+std::vector<ThreadPool::Task> counting_tasks(std::vector<std::atomic<int>>& hits) {
+    std::vector<ThreadPool::Task> tasks;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        std::atomic<int>* hit = &hits[i];
+        tasks.push_back([hit]() { ++*hit; });
+    }
+    return tasks;
+}
+
+/**
+ * @brief 检查每个任务都恰好执行了一次
+ */
+void check_each_once(const std::vector<std::atomic<int>>& hits) {
+    for (size_t i = 0; i < hits.size(); ++i) {
+        BOOST_REQUIRE_MESSAGE(hits[i] == 1, "task " << i << " ran " << hits[i] << " times");
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(thread_pool)
+
+BOOST_AUTO_TEST_CASE(run_all_runs_every_task_once) {
+    ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4u);
+    pool.run_all(std::vector<ThreadPool::Task>());
+
+    for (size_t count : {1, 2, 5, 1000}) {
+        std::vector<std::atomic<int>> hits(count);
+        pool.run_all(counting_tasks(hits));
+        check_each_once(hits);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(run_all_uses_calling_thread_when_workers_are_busy) {
+    ThreadPool pool(2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> blocked(0);
+    for (size_t i = 0; i < pool.size(); ++i) {
+        pool.submit([&blocked, released]() {
+            ++blocked;
+            released.wait();
+        });
+    }
+    while (blocked < static_cast<int>(pool.size())) {
+        std::this_thread::yield();
+    }
+
+    // 两个工作线程都被占住，这组任务只能由调用线程完成，且不等待无关的任务
+    std::thread::id caller = std::this_thread::get_id();
+    std::vector<std::atomic<int>> hits(50);
+    std::atomic<int> on_caller(0);
+    std::vector<ThreadPool::Task> tasks;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        std::atomic<int>* hit = &hits[i];
+        tasks.push_back([hit, &on_caller, caller]() {
+            ++*hit;
+            if (std::this_thread::get_id() == caller) {
+                ++on_caller;
+            }
+        });
+    }
+    pool.run_all(tasks);
+    check_each_once(hits);
+    BOOST_CHECK_EQUAL(on_caller, 50);
+
+    // 之后排到的参与者领不到任务，直接结束
+    release.set_value();
+    pool.wait();
+}
+
+BOOST_AUTO_TEST_CASE(run_all_rethrows_after_the_batch_finishes) {
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> hits(200);
+    std::vector<ThreadPool::Task> tasks = counting_tasks(hits);
+    for (size_t i = 0; i < tasks.size(); i += 50) {
+        ThreadPool::Task count = tasks[i];
+        tasks[i] = [count]() {
+            count();
+            throw std::runtime_error("task failed");
+        };
+    }
+    BOOST_CHECK_THROW(pool.run_all(tasks), std::runtime_error);
+    check_each_once(hits);
+
+    // 异常只属于这组任务，不影响线程池的后续使用
+    pool.wait();
+    for (std::atomic<int>& hit : hits) {
+        hit = 0;
+    }
+    pool.run_all(counting_tasks(hits));
+    check_each_once(hits);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_run_all_calls) {
+    ThreadPool pool(3);
+    const size_t callers = 4;
+    std::vector<std::vector<std::atomic<int>>> hits;
+    for (size_t c = 0; c < callers; ++c) {
+        hits.push_back(std::vector<std::atomic<int>>(300));
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < callers; ++c) {
+        std::vector<std::atomic<int>>* own = &hits[c];
+        threads.push_back(std::thread([&pool, own]() {
+            for (int round = 0; round < 20; ++round) {
+                pool.run_all(counting_tasks(*own));
+            }
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::vector<std::atomic<int>>& own : hits) {
+        for (const std::atomic<int>& hit : own) {
+            BOOST_REQUIRE_EQUAL(hit, 20);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(wait_rethrows_submitted_task_errors) {
+    ThreadPool pool(2);
+    std::atomic<int> done(0);
+    for (int i = 0; i < 100; ++i) {
+        pool.submit([&done, i]() {
+            ++done;
+            if (i == 37) {
+                throw std::logic_error("submitted task failed");
+            }
+        });
+    }
+    BOOST_CHECK_THROW(pool.wait(), std::logic_error);
+    BOOST_CHECK_EQUAL(done, 100);
+
+    // 异常只重新抛出一次
+    pool.wait();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,35 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <string>
+#include <boost/filesystem.hpp>
+
+/**
+ * 测试用的临时目录：构造时在系统临时目录下创建唯一的空目录，析构时连同内容一起删除
+ */
+class TempDirectory
+{
+public:
+    TempDirectory()
+        : path_(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bse-test-%%%%-%%%%")) {
+        boost::filesystem::create_directories(path_);
+    }
+
+    ~TempDirectory() {
+        boost::system::error_code ignored;
+        boost::filesystem::remove_all(path_, ignored);
+    }
+
+    const boost::filesystem::path& path() const { return path_; }
+
+    // 目录下名为name的文件的路径
+    std::string file(const std::string& name) const { return (path_ / name).string(); }
+
+private:
+    boost::filesystem::path path_;
+
+    TempDirectory(const TempDirectory&);
+    TempDirectory& operator=(const TempDirectory&);
+};
+
+#endif // TEST_UTIL_H
@@ -18,6 +18,8 @@ class SearchEngine {
         this.searchTime = document.getElementById('searchTime');
         this.loading = document.getElementById('loading');
         this.suggestions = document.getElementById('suggestions');
+        this.currentSuggestions = [];
+        this.suggestRequest = null;
 
         this.initEventListeners();
     }
@@ -131,7 +133,7 @@ class SearchEngine {
      */
     createResultHTML(result) {
         const title = this.escapeHtml(result.title);
-        const content = this.escapeHtml(result.content);
+        const content = this.highlightContent(result.content, result.highlights || []);
         const url = this.escapeHtml(result.url);
         const score = result.score.toFixed(3);
 
@@ -147,42 +149,73 @@ class SearchEngine {
         `;
     }
 
+    /**
+     * 高亮摘要中命中的查询词
+     * 高亮区间是UTF-8字节偏移，先编码为字节再按区间切分
+     */
+    highlightContent(content, highlights) {
+        const bytes = new TextEncoder().encode(content);
+        const decoder = new TextDecoder();
+        let html = '';
+        let pos = 0;
+        for (const [offset, length] of highlights) {
+            html += this.escapeHtml(decoder.decode(bytes.subarray(pos, offset)));
+            html += `<mark>${this.escapeHtml(decoder.decode(bytes.subarray(offset, offset + length)))}</mark>`;
+            pos = offset + length;
+        }
+        return html + this.escapeHtml(decoder.decode(bytes.subarray(pos)));
+    }
+
     /**
      * 处理输入变化（搜索建议）
+     *
+     * 每次输入都向服务器请求最后一个词的补全，并取消尚未返回的上一次请求，
+     * 避免较慢的旧响应覆盖新输入的建议。
      */
-    handleInputChange(value) {
-        if (value.length < 2) {
+    async handleInputChange(value) {
+        if (this.suggestRequest) {
+            this.suggestRequest.abort();
+            this.suggestRequest = null;
+        }
+        if (!value.trim() || /\s$/.test(value)) {
             this.hideSuggestions();
             return;
         }
 
-        // 这里可以实现搜索建议功能
-        // 暂时显示一些示例建议
-        const suggestions = this.generateSuggestions(value);
-        this.showSuggestions(suggestions);
+        const request = new AbortController();
+        this.suggestRequest = request;
+        try {
+            const suggestions = await this.suggestAPI(value, request.signal);
+            if (this.suggestRequest === request) {
+                this.showSuggestions(suggestions.map(suggestion => suggestion.text));
+            }
+        } catch (error) {
+            if (error.name !== 'AbortError') {
+                console.error('获取搜索建议失败:', error);
+                this.hideSuggestions();
+            }
+        } finally {
+            if (this.suggestRequest === request) {
+                this.suggestRequest = null;
+            }
+        }
     }
 
     /**
-     * 生成搜索建议
+     * 调用补全API，返回按文档频率降序排列的建议
      */
-    generateSuggestions(query) {
-        // 示例建议，实际应用中可以从服务器获取
-        const commonQueries = [
-            'C++ 教程',
-            'Boost 库使用',
-            '搜索引擎原理',
-            '倒排索引',
-            'TF-IDF 算法',
-            '文本处理',
-            '网络编程',
-            '多线程编程'
-        ];
-
-        return commonQueries
-            .filter(suggestion =>
-                suggestion.toLowerCase().includes(query.toLowerCase())
-            )
-            .slice(0, 5);
+    async suggestAPI(query, signal) {
+        const response = await fetch(`/api/suggest?q=${encodeURIComponent(query)}`, { signal });
+
+        if (!response.ok) {
+            throw new Error(`HTTP error! status: ${response.status}`);
+        }
+
+        const data = await response.json();
+        if (data.error) {
+            throw new Error(data.error);
+        }
+        return data.suggestions || [];
     }
 
     /**
@@ -194,8 +227,10 @@ class SearchEngine {
             return;
         }
 
-        this.suggestions.innerHTML = suggestions.map(suggestion => `
-            <div class="suggestion-item" onclick="searchEngine.selectSuggestion('${suggestion}')">
+        // 建议文本来自索引词项，点击时按序号取回，不把文本拼进onclick
+        this.currentSuggestions = suggestions;
+        this.suggestions.innerHTML = suggestions.map((suggestion, index) => `
+            <div class="suggestion-item" onclick="searchEngine.selectSuggestion(${index})">
                 ${this.escapeHtml(suggestion)}
             </div>
         `).join('');
@@ -213,8 +248,8 @@ class SearchEngine {
     /**
      * 选择搜索建议
      */
-    selectSuggestion(suggestion) {
-        this.searchInput.value = suggestion;
+    selectSuggestion(index) {
+        this.searchInput.value = this.currentSuggestions[index];
         this.hideSuggestions();
         this.performSearch();
     }